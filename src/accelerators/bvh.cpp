@@ -346,6 +346,35 @@ bool BVHAccel::IntersectP(const Ray &ray) const {
     return false;
 }
 
+bool BVHAccel::ForEachPrimitive(
+    const std::function<bool(const Bounds3f &)> &overlaps,
+    const std::function<bool(const GeometricPrimitive &)> &visit) const {
+    if (!nodes) return true;
+
+    int nodesToVisit[64];
+    int toVisitOffset = 0, currentNodeIndex = 0;
+
+    while (true) {
+        const LinearBVHNode *node = &nodes[currentNodeIndex];
+        if (overlaps(node->bounds)) {
+            if (node->nPrimitives > 0) {
+                for (int i = 0; i < node->nPrimitives; ++i)
+                    if (!primitives[node->primitivesOffset + i]
+                             ->ForEachPrimitive(overlaps, visit))
+                        return false;
+            } else {
+                // Visit the first child next and the second one later
+                nodesToVisit[toVisitOffset++] = node->secondChildOffset;
+                currentNodeIndex = currentNodeIndex + 1;
+                continue;
+            }
+        }
+        if (toVisitOffset == 0) break;
+        currentNodeIndex = nodesToVisit[--toVisitOffset];
+    }
+    return true;
+}
+
 std::shared_ptr<BVHAccel> CreateBVHAccelerator(std::vector<std::shared_ptr<Primitive>> prims) {
     int maxPrimsInNode = 4;
     return std::make_shared<BVHAccel>(std::move(prims), maxPrimsInNode);
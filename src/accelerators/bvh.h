@@ -19,6 +19,9 @@ class BVHAccel : public Aggregate {
         ~BVHAccel();
         bool Intersect(const Ray &ray, SurfaceInteraction *isect) const;
         bool IntersectP(const Ray &ray) const;
+        bool ForEachPrimitive(
+            const std::function<bool(const Bounds3f &)> &overlaps,
+            const std::function<bool(const GeometricPrimitive &)> &visit) const;
     
     private:
         BVHBuildNode *recursiveBuild(
@@ -27,7 +27,7 @@ float OrthographicCamera::GenerateRay(const CameraSample &sample,
     }
     
     // ray->time = Lerp(sample.time, shutterOpen, shutterClose);
-    // ray->medium = medium;
+    ray->medium = medium;
     *ray = CameraToWorld(*ray);
     return 1;
 }
@@ -78,7 +78,7 @@ float OrthographicCamera::GenerateRayDifferential(const CameraSample &sample,
     }
     // ray->time = Lerp(sample.time, shutterOpen, shutterClose);
     ray->hasDifferentials = true;
-    // ray->medium = medium;
+    ray->medium = medium;
     *ray = CameraToWorld(*ray);
     return 1;
 }
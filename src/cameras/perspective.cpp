@@ -1,5 +1,6 @@
 #include "cameras/perspective.h"
 #include "sampling.h"
+#include "light.h"
 
 namespace PBRender {
 
@@ -24,6 +25,9 @@ PerspectiveCamera::PerspectiveCamera(const Transform &CameraToWorld,
     pMin /= pMin.z;
     pMax /= pMax.z;
     A = std::abs((pMax.x - pMin.x) * (pMax.y - pMin.y));
+
+    WorldToRaster = Inverse(RasterToCamera) * Inverse(CameraToWorld);
+    rasterBounds = Bounds2f(Point2f(0, 0), Point2f(res.x, res.y));
 }
 
 float PerspectiveCamera::GenerateRay(const CameraSample &sample,
@@ -49,7 +53,7 @@ float PerspectiveCamera::GenerateRay(const CameraSample &sample,
     }
 
     // ray->time = Lerp(sample.time, shutterOpen, shutterClose);
-    // ray->medium = medium;
+    ray->medium = medium;
     *ray = CameraToWorld(*ray);
     return 1;
 }
@@ -101,13 +105,82 @@ float PerspectiveCamera::GenerateRayDifferential(const CameraSample &sample,
     }
 
     // ray->time = Lerp(sample.time, shutterOpen, shutterClose);
-    // ray->medium = medium;
+    ray->medium = medium;
     *ray = CameraToWorld(*ray);
     ray->hasDifferentials = true;
 
     return 1;
 }
 
+Spectrum PerspectiveCamera::We(const Ray &ray, Point2f *pRaster2) const {
+    // Return zero importance for rays leaving through the back of the camera
+    float cosTheta = Dot(ray.d, CameraToWorld(Vector3f(0, 0, 1)));
+    if (cosTheta <= 0) return Spectrum(0.f);
+
+    // Map _ray_ $(\p{}, \w{})$ onto the raster grid
+    Point3f pFocus = ray((lensRadius > 0 ? focalDistance : 1) / cosTheta);
+    Point3f pRaster = WorldToRaster(pFocus);
+
+    // Return raster position if requested
+    if (pRaster2) *pRaster2 = Point2f(pRaster.x, pRaster.y);
+
+    // Return zero importance for out of bounds points
+    if (pRaster.x < rasterBounds.pMin.x || pRaster.x >= rasterBounds.pMax.x ||
+        pRaster.y < rasterBounds.pMin.y || pRaster.y >= rasterBounds.pMax.y)
+        return Spectrum(0.f);
+
+    // Compute lens area of perspective camera
+    float lensArea = lensRadius != 0 ? (Pi * lensRadius * lensRadius) : 1;
+
+    // Return importance for point on image plane
+    float cos2Theta = cosTheta * cosTheta;
+    return Spectrum(1 / (A * lensArea * cos2Theta * cos2Theta));
+}
+
+void PerspectiveCamera::Pdf_We(const Ray &ray, float *pdfPos,
+                               float *pdfDir) const {
+    // Return zero probability for out of bounds points
+    float cosTheta = Dot(ray.d, CameraToWorld(Vector3f(0, 0, 1)));
+    if (cosTheta <= 0) {
+        *pdfPos = *pdfDir = 0;
+        return;
+    }
+    Point3f pFocus = ray((lensRadius > 0 ? focalDistance : 1) / cosTheta);
+    Point3f pRaster = WorldToRaster(pFocus);
+    if (pRaster.x < rasterBounds.pMin.x || pRaster.x >= rasterBounds.pMax.x ||
+        pRaster.y < rasterBounds.pMin.y || pRaster.y >= rasterBounds.pMax.y) {
+        *pdfPos = *pdfDir = 0;
+        return;
+    }
+
+    // Compute lens area of perspective camera
+    float lensArea = lensRadius != 0 ? (Pi * lensRadius * lensRadius) : 1;
+    *pdfPos = 1 / lensArea;
+    *pdfDir = 1 / (A * cosTheta * cosTheta * cosTheta);
+}
+
+Spectrum PerspectiveCamera::Sample_Wi(const Interaction &ref, const Point2f &u,
+                                      Vector3f *wi, float *pdf,
+                                      Point2f *pRaster,
+                                      VisibilityTester *vis) const {
+    // Uniformly sample a lens interaction _lensIntr_
+    Point2f pLens = lensRadius * ConcentricSampleDisk(u);
+    Point3f pLensWorld = CameraToWorld(Point3f(pLens.x, pLens.y, 0));
+    Interaction lensIntr(pLensWorld, ref.time);
+    lensIntr.n = Normal3f(CameraToWorld(Vector3f(0, 0, 1)));
+
+    // Populate arguments and compute the importance value
+    *vis = VisibilityTester(ref, lensIntr);
+    *wi = lensIntr.p - ref.p;
+    float dist = wi->Length();
+    *wi /= dist;
+
+    // Compute PDF for importance arriving at _ref_
+    float lensArea = lensRadius != 0 ? (Pi * lensRadius * lensRadius) : 1;
+    *pdf = (dist * dist) / (AbsDot(lensIntr.n, *wi) * lensArea);
+    return We(lensIntr.SpawnRay(-*wi), pRaster);
+}
+
 PerspectiveCamera *CreatePerspectiveCamera(const Transform &cam2world, const Vector2f &fullResolution,
                                            const float fov, const float lensradius, const float focaldistance) {
     float frame = fullResolution.x / fullResolution.y;
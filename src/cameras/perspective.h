@@ -18,11 +18,19 @@ class PerspectiveCamera : public ProjectiveCamera {
         float GenerateRay(const CameraSample &sample, Ray *) const;
         float GenerateRayDifferential(const CameraSample &sample, 
                                       RayDifferential *ray) const;
+        Spectrum We(const Ray &ray, Point2f *pRaster2 = nullptr) const;
+        void Pdf_We(const Ray &ray, float *pdfPos, float *pdfDir) const;
+        Spectrum Sample_Wi(const Interaction &ref, const Point2f &sample,
+                           Vector3f *wi, float *pdf, Point2f *pRaster,
+                           VisibilityTester *vis) const;
 
     private:
         // OrthographicCamera Private Data
         Vector3f dxCamera, dyCamera;
         float A;
+        // Maps world space points onto the image for the importance methods
+        Transform WorldToRaster;
+        Bounds2f rasterBounds;
 };
 
 PerspectiveCamera *CreatePerspectiveCamera(const Transform &cam2world, const Vector2f &fullResolution,
@@ -20,6 +20,7 @@ namespace PBRender {
 // Global Constants
 static constexpr float MachineEpsilon = std::numeric_limits<float>::epsilon() * 0.5;
 
+static constexpr float MaxFloat = std::numeric_limits<float>::max();
 static constexpr float Infinity = std::numeric_limits<float>::infinity();
 
 static constexpr float ShadowEpsilon = 0.0001f;
@@ -62,6 +63,11 @@ struct Interaction;
 class SurfaceInteraction;
 class MediumInteraction;
 
+// Medium
+class Medium;
+struct MediumInterface;
+class PhaseFunction;
+
 // Shape
 class Shape;
 
@@ -81,8 +87,9 @@ class Camera;
 struct CameraSample;
 class ProjectiveCamera;
 
-// class Film;
-// class FilmTile;
+class Film;
+class FilmTile;
+class Filter;
 
 // Sampler
 class Sampler;
@@ -112,10 +119,15 @@ class Texture;
 class Light;
 class VisibilityTester;
 class AreaLight;
+class LightDistribution;
+class VisibilityCache;
 
 struct Distribution1D;
 class Distribution2D;
 
+// Memory
+class MemoryArena;
+
 // BlockedArray definition
 template <typename T, int logBlockSize = 2>
 class BlockedArray {
@@ -127,9 +139,11 @@ class BlockedArray {
             // data = AllocAligned<T>(nAlloc);
             data = new T[nAlloc];
             for (int i = 0; i < nAlloc; ++i) new (&data[i]) T();
-            if (d)
+            if (d) {
+                #pragma omp parallel for
                 for (int v = 0; v < vRes; ++v)
                     for (int u = 0; u < uRes; ++u) (*this)(u, v) = d[v * uRes + u];
+            }
         }
 
         constexpr int BlockSize() const { return 1 << logBlockSize; }
@@ -291,6 +305,12 @@ inline float Radians(float deg) { return (Pi / 180) * deg; }
 
 inline float Degrees(float rad) { return (180 / Pi) * rad; }
 
+inline float SafeSqrt(float x) { return std::sqrt(std::max(x, 0.f)); }
+
+inline float SafeASin(float x) { return std::asin(Clamp(x, -1, 1)); }
+
+inline float SafeACos(float x) { return std::acos(Clamp(x, -1, 1)); }
+
 inline float Log2(float x) {
     const float invLog2 = 1.442695040888963387004650940071;
     return std::log(x) * invLog2;
@@ -0,0 +1,112 @@
+#include "aov.h"
+#include "scene.h"
+
+#include <algorithm>
+
+namespace PBRender {
+
+// AOV Function Definitions
+Spectrum AOVAlbedoEstimate(const SurfaceInteraction &isect) {
+    // Stratified 4x4 pattern of sample points
+    static const float strata[4] = {.125f, .375f, .625f, .875f};
+    Point2f u[16];
+    for (int i = 0; i < 16; ++i) u[i] = Point2f(strata[i % 4], strata[i / 4]);
+    return isect.bsdf ? isect.bsdf->rho(isect.wo, 16, u) : Spectrum(1.f);
+}
+
+void RecordFirstHitAOVs(const RayDifferential &ray, const Scene &scene,
+                        int channels, AOVSample *aov) {
+    SurfaceInteraction isect;
+    if (!scene.Intersect(ray, &isect)) return;
+    if (!isect.Le(-ray.d).IsBlack()) aov->emitter = true;
+    isect.ComputeScatteringFunctions(ray, true);
+
+    AOVSample all;
+    RecordAOVs<AOVAllChannels>(ray, isect, &all);
+    aov->hit = true;
+    if (channels & AOVAlbedo) aov->albedo = all.albedo;
+    if (channels & AOVNormal) aov->normal = all.normal;
+    if (channels & AOVDepth) aov->depth = all.depth;
+    if (channels & AOVMaterialId) aov->materialId = all.materialId;
+    if (channels & AOVPrimitiveId) aov->primitiveId = all.primitiveId;
+}
+
+// AOVBuffers Method Definitions
+AOVBuffers::AOVBuffers(const Point2i &resolution, int channels)
+    : resolution(resolution), channels(channels) {
+    int nPixels = resolution.x * resolution.y;
+    if (channels & AOVAlbedo) albedo.assign(nPixels, Spectrum(0.f));
+    if (channels & AOVNormal) normal.assign(nPixels, Normal3f(0, 0, 0));
+    if (channels & AOVDepth) depth.assign(nPixels, Infinity);
+    if (channels & AOVMaterialId) materialId.assign(nPixels, -1);
+    if (channels & AOVPrimitiveId) primitiveId.assign(nPixels, -1);
+    nHits.assign(nPixels, 0);
+    nEmitterHits.assign(nPixels, 0);
+}
+
+void AOVBuffers::AddSample(int offset, const AOVSample &aov) {
+    if (aov.emitter) ++nEmitterHits[offset];
+    if (!aov.hit || aov.emitter) return;
+
+    // Update running means of the continuous channels
+    int n = ++nHits[offset];
+    float w = 1.f / n;
+    if (channels & AOVAlbedo) albedo[offset] += w * (aov.albedo - albedo[offset]);
+    if (channels & AOVNormal) normal[offset] += w * (aov.normal - normal[offset]);
+    if (channels & AOVDepth)
+        depth[offset] = n == 1 ? aov.depth : depth[offset] + w * (aov.depth - depth[offset]);
+    if (n > 1) return;
+    if (channels & AOVMaterialId) materialId[offset] = aov.materialId;
+    if (channels & AOVPrimitiveId) primitiveId[offset] = aov.primitiveId;
+}
+
+// Maps an id to an arbitrary but stable color
+static Spectrum IdColor(int id) {
+    if (id < 0) return Spectrum(0.f);
+    uint32_t h = (uint32_t)id * 2654435761u;
+    float rgb[3] = {(h & 0xff) / 255.f, ((h >> 8) & 0xff) / 255.f,
+                    ((h >> 16) & 0xff) / 255.f};
+    return Spectrum::FromRGB(rgb);
+}
+
+void AOVBuffers::GetImage(AOVChannel channel, std::vector<Spectrum> &col) const {
+    int nPixels = resolution.x * resolution.y;
+    if (!(channels & channel)) {
+        std::fill(col.begin(), col.begin() + nPixels, Spectrum(0.f));
+        return;
+    }
+
+    // Depth is normalized by the largest finite depth in the image
+    float maxDepth = 0;
+    if (channel == AOVDepth)
+        for (float d : depth)
+            if (!std::isinf(d)) maxDepth = std::max(maxDepth, d);
+
+    for (int i = 0; i < nPixels; ++i) {
+        switch (channel) {
+        case AOVAlbedo:
+            col[i] = albedo[i];
+            break;
+        case AOVNormal: {
+            float rgb[3] = {.5f + .5f * normal[i].x, .5f + .5f * normal[i].y,
+                            .5f + .5f * normal[i].z};
+            col[i] = nHits[i] > 0 ? Spectrum::FromRGB(rgb) : Spectrum(0.f);
+            break;
+        }
+        case AOVDepth:
+            col[i] = Spectrum(std::isinf(depth[i]) || maxDepth == 0 ?
+                                  0.f : depth[i] / maxDepth);
+            break;
+        case AOVMaterialId:
+            col[i] = IdColor(materialId[i]);
+            break;
+        case AOVPrimitiveId:
+            col[i] = IdColor(primitiveId[i]);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "PBRender.h"
+#include "geometry.h"
+#include "spectrum.h"
+#include "interaction.h"
+#include "primitive.h"
+#include "reflection.h"
+
+namespace PBRender {
+
+// AOVChannel Declarations
+enum AOVChannel {
+    AOVAlbedo = 1 << 0,
+    AOVNormal = 1 << 1,
+    AOVDepth = 1 << 2,
+    AOVMaterialId = 1 << 3,
+    AOVPrimitiveId = 1 << 4,
+    AOVAllChannels = (1 << 5) - 1
+};
+
+// AOVSample Declarations
+// First-hit values of one camera sample. _emitter_ marks samples whose first
+// hit is a light source, which is recorded whenever any channel is enabled.
+struct AOVSample {
+    Spectrum albedo = Spectrum(0.f);
+    Normal3f normal;
+    float depth = Infinity;
+    int materialId = -1, primitiveId = -1;
+    bool hit = false, emitter = false;
+};
+
+// Hemispherical-directional reflectance of the first hit, estimated with a
+// fixed point set so that recording it does not consume sampler dimensions
+Spectrum AOVAlbedoEstimate(const SurfaceInteraction &isect);
+
+// Records the channels of _Channels_ for the first surface hit along _ray_;
+// _isect_ must already have its BSDF. The channel mask is a template
+// parameter, so an integrator instantiated with no channels contains no AOV
+// code at all.
+template <int Channels>
+inline void RecordAOVs(const Ray &ray, const SurfaceInteraction &isect,
+                       AOVSample *aov) {
+    if (Channels == 0) return;
+    aov->hit = true;
+    if (Channels & AOVAlbedo) aov->albedo = AOVAlbedoEstimate(isect);
+    if (Channels & AOVNormal) aov->normal = Faceforward(isect.shading.n, isect.wo);
+    if (Channels & AOVDepth) aov->depth = Distance(ray.o, isect.p);
+    if (Channels & AOVMaterialId) {
+        const Material *material = isect.primitive->GetMaterial();
+        aov->materialId = material ? material->id : -1;
+    }
+    if (Channels & AOVPrimitiveId) aov->primitiveId = isect.primitive->GetId();
+}
+
+// Records every channel of _channels_ by tracing _ray_ on its own; used by
+// integrators that do not record AOVs while tracing their paths
+void RecordFirstHitAOVs(const RayDifferential &ray, const Scene &scene,
+                        int channels, AOVSample *aov);
+
+// AOVBuffers Declarations
+// Per-pixel AOV images. Albedo, normal and depth are averaged over the
+// pixel's surface hits; ids are taken from the first one. Pixels without a
+// surface hit keep infinite depth and id -1.
+class AOVBuffers {
+    public:
+        AOVBuffers(const Point2i &resolution, int channels);
+
+        // Each pixel must be updated by a single thread at a time
+        void AddSample(int offset, const AOVSample &aov);
+        // Whether the pixel shows a surface rather than background or an
+        // emitter, which image-space filters should leave untouched
+        bool IsSurface(int offset) const {
+            return nHits[offset] > 0 && nHits[offset] >= nEmitterHits[offset];
+        }
+        // Whether any of the pixel's samples saw a light source directly
+        bool SeesEmitter(int offset) const { return nEmitterHits[offset] > 0; }
+        // Writes a displayable version of _channel_ to _col_
+        void GetImage(AOVChannel channel, std::vector<Spectrum> &col) const;
+
+        // AOVBuffers Public Data
+        const Point2i resolution;
+        const int channels;
+        std::vector<Spectrum> albedo;
+        std::vector<Normal3f> normal;
+        std::vector<float> depth;
+        std::vector<int> materialId, primitiveId;
+
+    private:
+        std::vector<int> nHits, nEmitterHits;
+};
+
+}
\ No newline at end of file
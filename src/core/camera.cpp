@@ -5,8 +5,8 @@ namespace PBRender {
 // Camera Method Definitions
 Camera::~Camera() {}
 
-Camera::Camera(const Transform &CameraToWorld)
-    : CameraToWorld(CameraToWorld) {
+Camera::Camera(const Transform &CameraToWorld, const Point2i &fullResolution)
+    : CameraToWorld(CameraToWorld), fullResolution(fullResolution) {
     if (CameraToWorld.HasScale())
         std::cerr <<
             "Scaling detected in world-to-camera transformation!\n"
@@ -74,20 +74,22 @@ float Camera::GenerateRayDifferential(const CameraSample &sample,
     return wt;
 }
 
-// Spectrum Camera::We(const Ray &ray, Point2f *raster) const {
-//     std::cerr << "Camera::We() is not implemented!";
-//     return Spectrum(0.f);
-// }
+Spectrum Camera::We(const Ray &ray, Point2f *raster) const {
+    std::cerr << "Camera::We() is not implemented!" << std::endl;
+    return Spectrum(0.f);
+}
 
-// void Camera::Pdf_We(const Ray &ray, float *pdfPos, float *pdfDir) const {
-//     std::cerr << "Camera::Pdf_We() is not implemented!";
-// }
+void Camera::Pdf_We(const Ray &ray, float *pdfPos, float *pdfDir) const {
+    std::cerr << "Camera::Pdf_We() is not implemented!" << std::endl;
+    *pdfPos = *pdfDir = 0;
+}
 
-// Spectrum Camera::Sample_Wi(const Interaction &ref, const Point2f &u,
-//                            Vector3f *wi, float *pdf, Point2f *pRaster,
-//                            VisibilityTester *vis) const {
-//     LOG(FATAL) << "Camera::Sample_Wi() is not implemented!";
-//     return Spectrum(0.f);
-// }
+Spectrum Camera::Sample_Wi(const Interaction &ref, const Point2f &u,
+                           Vector3f *wi, float *pdf, Point2f *pRaster,
+                           VisibilityTester *vis) const {
+    std::cerr << "Camera::Sample_Wi() is not implemented!" << std::endl;
+    *pdf = 0;
+    return Spectrum(0.f);
+}
 
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 
 #include "geometry.h"
 #include "transform.h"
+#include "spectrum.h"
 
 namespace PBRender {
 
@@ -13,25 +14,28 @@ class Camera {
         // Camera(const AnimatedTransform &CameraToWorld, Float shutterOpen,
         //    Float shutterClose, Film *film, const Medium *medium);
 
-        Camera(const Transform &CameraToWorld);
+        Camera(const Transform &CameraToWorld, const Point2i &fullResolution);
         virtual ~Camera();
 
         virtual float GenerateRay(const CameraSample &sample, Ray *ray) const = 0;
         virtual float GenerateRayDifferential(const CameraSample &sample, RayDifferential *rd) const;
 
-        // virtual Spectrum We(const Ray &ray, Point2f *pRaster2 = nullptr) const;
-        // virtual void Pdf_We(const Ray &ray, float *pdfPos, float *pdfDir) const;
+        virtual Spectrum We(const Ray &ray, Point2f *pRaster2 = nullptr) const;
+        virtual void Pdf_We(const Ray &ray, float *pdfPos, float *pdfDir) const;
 
-        // virtual Spectrum Sample_Wi(const Interaction &ref, const Point2f &u,
-        //                            Vector3f *wi, float *pdf, Point2f *pRaster,
-        //                            VisibilityTester *vis) const;
+        virtual Spectrum Sample_Wi(const Interaction &ref, const Point2f &u,
+                                   Vector3f *wi, float *pdf, Point2f *pRaster,
+                                   VisibilityTester *vis) const;
 
     public:
         // Camera Public Data
         Transform CameraToWorld;
+        // Resolution of the whole image that raster space spans
+        const Point2i fullResolution;
         // const float shutterOpen, shutterClose;
         // Film *film;
-        // const Medium *medium;
+        // Medium the camera sits in, if any
+        const Medium *medium = nullptr;
 };
 
 struct CameraSample {
@@ -77,7 +81,8 @@ class ProjectiveCamera : public Camera {
                           const Vector2f &fullResolution,
                           float lensr, float focald
                           )
-            : Camera(CameraToWorld), CameraToScreen(CameraToScreen) {
+            : Camera(CameraToWorld, Point2i(fullResolution)),
+              CameraToScreen(CameraToScreen) {
             // Initialize depth of field parameters
             lensRadius = lensr;
             focalDistance = focald;
@@ -0,0 +1,188 @@
+#include "denoiser.h"
+
+#include "omp.h"
+
+#include <algorithm>
+
+namespace PBRender {
+
+// Denoiser Local Definitions
+// Albedo components below this are not divided out of the image
+static const float MinAlbedo = .01f;
+
+static Spectrum Demodulate(const Spectrum &L, const Spectrum &albedo) {
+    Spectrum E;
+    for (int c = 0; c < Spectrum::nSamples; ++c)
+        E[c] = albedo[c] > MinAlbedo ? L[c] / albedo[c] : L[c];
+    return E;
+}
+
+static Spectrum Remodulate(const Spectrum &E, const Spectrum &albedo) {
+    Spectrum L;
+    for (int c = 0; c < Spectrum::nSamples; ++c)
+        L[c] = albedo[c] > MinAlbedo ? E[c] * albedo[c] : E[c];
+    return L;
+}
+
+// Denoiser Function Definitions
+void DenoiseImage(const AOVBuffers &aovs, const DenoiserOptions &options,
+                  std::vector<Spectrum> &col) {
+    const int required = AOVAlbedo | AOVNormal | AOVDepth;
+    if ((aovs.channels & required) != required) {
+        std::cerr << "DenoiseImage() needs albedo, normal and depth AOVs"
+                  << std::endl;
+        return;
+    }
+    int width = aovs.resolution.x, height = aovs.resolution.y;
+    int nPixels = width * height;
+
+    // Filter illumination rather than radiance
+    std::vector<Spectrum> E(nPixels), filtered(nPixels);
+    #pragma omp parallel for
+    for (int i = 0; i < nPixels; ++i)
+        E[i] = Demodulate(col[i], aovs.albedo[i]);
+
+    // Screen-space depth gradients let the depth test follow slanted
+    // surfaces; one-sided differences are used so that gradients are not
+    // smeared across silhouettes
+    std::vector<Vector2f> depthGrad(nPixels, Vector2f(0, 0));
+    auto gradient = [&](int p, int q0, int q1) {
+        float d = aovs.depth[p];
+        float d0 = aovs.depth[q0] - d, d1 = d - aovs.depth[q1];
+        if (!aovs.IsSurface(q0)) return aovs.IsSurface(q1) ? d1 : 0.f;
+        if (!aovs.IsSurface(q1)) return d0;
+        return std::abs(d0) < std::abs(d1) ? d0 : d1;
+    };
+    #pragma omp parallel for
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x) {
+            int p = x + width * y;
+            if (!aovs.IsSurface(p)) continue;
+            int xp = std::min(x + 1, width - 1), xm = std::max(x - 1, 0);
+            int yp = std::min(y + 1, height - 1), ym = std::max(y - 1, 0);
+            depthGrad[p] = Vector2f(gradient(p, xp + width * y, xm + width * y),
+                                    gradient(p, x + width * yp, x + width * ym));
+        }
+
+    // Geometry edge-stopping weight of pixel _q_ for pixel _p_, _offset_
+    // pixels away
+    float invSigmaNormal2 = 1 / (options.sigmaNormal * options.sigmaNormal);
+    auto geometryWeight = [&](int p, int q, const Vector2f &offset) {
+        float dNormal = (aovs.normal[q] - aovs.normal[p]).LengthSquared();
+        float predicted = aovs.depth[p] + Dot(offset, depthGrad[p]);
+        float dDepth = std::abs(aovs.depth[q] - predicted) /
+                       (options.sigmaDepth * aovs.depth[p]);
+        return std::exp(-dNormal * invSigmaNormal2 - dDepth);
+    };
+
+    // Only surfaces are filtered, and only if none of their samples saw a
+    // light source, whose radiance would otherwise bleed into the pixels
+    // around it
+    std::vector<bool> filterable(nPixels);
+    for (int i = 0; i < nPixels; ++i)
+        filterable[i] = aovs.IsSurface(i) && !aovs.SeesEmitter(i);
+
+    // Estimate the variance of each pixel's luminance from the moments of
+    // its 7x7 neighborhood on the same surface
+    std::vector<float> variance(nPixels, 0.f), filteredVariance(nPixels);
+    #pragma omp parallel for schedule(dynamic, 8)
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x) {
+            int p = x + width * y;
+            if (!filterable[p]) continue;
+            float m1 = 0, m2 = 0, weightSum = 0;
+            for (int dy = -3; dy <= 3; ++dy) {
+                int qy = y + dy;
+                if (qy < 0 || qy >= height) continue;
+                for (int dx = -3; dx <= 3; ++dx) {
+                    int qx = x + dx;
+                    if (qx < 0 || qx >= width) continue;
+                    int q = qx + width * qy;
+                    if (!filterable[q]) continue;
+                    float w = geometryWeight(p, q, Vector2f(dx, dy));
+                    float yQ = E[q].y();
+                    m1 += w * yQ;
+                    m2 += w * yQ * yQ;
+                    weightSum += w;
+                }
+            }
+            m1 /= weightSum;
+            variance[p] = std::max(0.f, m2 / weightSum - m1 * m1);
+        }
+
+    static const float kernel[5] = {1.f / 16, 1.f / 4, 3.f / 8, 1.f / 4,
+                                    1.f / 16};
+    static const float blur[3] = {1.f / 4, 1.f / 2, 1.f / 4};
+    float invSigmaColor2 = 1 / (options.sigmaColor * options.sigmaColor);
+    for (int iter = 0; iter < options.iterations; ++iter) {
+        int step = 1 << iter;
+
+        #pragma omp parallel for schedule(dynamic, 8)
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                int p = x + width * y;
+                if (!filterable[p]) {
+                    filtered[p] = E[p];
+                    continue;
+                }
+                float yP = E[p].y();
+
+                // Compare luminance against the pixel's noise, smoothed
+                // with a 3x3 blur of the variance as in SVGF
+                float varP = 0, blurSum = 0;
+                for (int dy = -1; dy <= 1; ++dy)
+                    for (int dx = -1; dx <= 1; ++dx) {
+                        int qx = x + dx, qy = y + dy;
+                        if (qx < 0 || qx >= width || qy < 0 || qy >= height ||
+                            !filterable[qx + width * qy])
+                            continue;
+                        float w = blur[dx + 1] * blur[dy + 1];
+                        varP += w * variance[qx + width * qy];
+                        blurSum += w;
+                    }
+                varP /= blurSum;
+                // The luminance term keeps pixels without noise from
+                // rejecting every neighbor, relative to exposure
+                float invColorScale2 =
+                    invSigmaColor2 / (varP + 1e-6f * yP * yP + 1e-20f);
+
+                Spectrum sum(0.f);
+                float weightSum = 0, varianceSum = 0;
+                for (int dy = -2; dy <= 2; ++dy) {
+                    int qy = y + dy * step;
+                    if (qy < 0 || qy >= height) continue;
+                    for (int dx = -2; dx <= 2; ++dx) {
+                        int qx = x + dx * step;
+                        if (qx < 0 || qx >= width) continue;
+                        int q = qx + width * qy;
+                        if (!filterable[q]) continue;
+
+                        // Edge-stopping functions for illumination, normal
+                        // and depth discontinuities
+                        float dColor = E[q].y() - yP;
+                        float w = kernel[dx + 2] * kernel[dy + 2] *
+                                  geometryWeight(p, q,
+                                                 Vector2f(dx * step, dy * step)) *
+                                  std::exp(-dColor * dColor * invColorScale2);
+                        sum += w * E[q];
+                        weightSum += w;
+                        varianceSum += w * w * variance[q];
+                    }
+                }
+                // The variance of the weighted mean follows the image
+                filtered[p] = weightSum > 0 ? sum / weightSum : E[p];
+                filteredVariance[p] = weightSum > 0
+                                          ? varianceSum / (weightSum * weightSum)
+                                          : variance[p];
+            }
+        }
+        std::swap(E, filtered);
+        std::swap(variance, filteredVariance);
+    }
+
+    #pragma omp parallel for
+    for (int i = 0; i < nPixels; ++i)
+        col[i] = Remodulate(E[i], aovs.albedo[i]);
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "PBRender.h"
+#include "geometry.h"
+#include "spectrum.h"
+#include "aov.h"
+
+namespace PBRender {
+
+// DenoiserOptions Declarations
+struct DenoiserOptions {
+    // Number of a-trous passes; the filter footprint doubles with each one
+    int iterations = 5;
+    // Edge-stopping width for illumination, in standard deviations of the
+    // pixel's estimated noise, and widths for normals and relative depth
+    float sigmaColor = 4.f;
+    float sigmaNormal = .1f;
+    float sigmaDepth = .05f;
+};
+
+// Edge-aware a-trous wavelet filter (Dammertz et al. 2010) guided by the
+// albedo, normal and depth channels of _aovs_. The image is divided by the
+// albedo before filtering so that only illumination is smoothed and texture
+// detail survives, and multiplied back afterwards. As in SVGF (Schied et
+// al. 2017), luminance differences are measured against the standard
+// deviation of the pixel's noise, estimated from its neighborhood and
+// filtered along with the image, so the filter doesn't depend on exposure.
+void DenoiseImage(const AOVBuffers &aovs, const DenoiserOptions &options,
+                  std::vector<Spectrum> &col);
+
+}
\ No newline at end of file
@@ -0,0 +1,126 @@
+#include "film.h"
+
+#include <algorithm>
+
+namespace PBRender {
+
+// Film Method Definitions
+Film::Film(const Point2i &resolution, std::unique_ptr<Filter> filt)
+    : fullResolution(resolution),
+      filter(std::move(filt)),
+      pixelBounds(Point2i(0, 0), resolution) {
+    // Allocate film image storage
+    pixels = std::unique_ptr<Pixel[]>(new Pixel[pixelBounds.Area()]);
+
+    // Precompute one filter table per axis; the filters are separable, so
+    // the weight of a sample is the product of two table entries
+    for (int i = 0; i < filterTableWidth; ++i) {
+        float t = (i + .5f) / filterTableWidth;
+        filterTableX[i] = filter->Evaluate1D(t * filter->radius.x, 0);
+        filterTableY[i] = filter->Evaluate1D(t * filter->radius.y, 1);
+    }
+}
+
+Bounds2i Film::GetSampleBounds() const { return pixelBounds; }
+
+std::unique_ptr<FilmTile> Film::GetFilmTile(const Bounds2i &sampleBounds) {
+    // Bound image pixels that samples in _sampleBounds_ contribute to
+    Vector2f halfPixel = Vector2f(0.5f, 0.5f);
+    Bounds2f floatBounds = (Bounds2f)sampleBounds;
+    Point2i p0 = (Point2i)Ceil(floatBounds.pMin - halfPixel - filter->radius);
+    Point2i p1 = (Point2i)Floor(floatBounds.pMax - halfPixel + filter->radius) +
+                 Point2i(1, 1);
+    Bounds2i tilePixelBounds = Intersect(Bounds2i(p0, p1), pixelBounds);
+    return std::unique_ptr<FilmTile>(new FilmTile(
+        tilePixelBounds, filter->radius, filterTableX, filterTableY,
+        filterTableWidth));
+}
+
+void Film::MergeFilmTile(std::unique_ptr<FilmTile> tile) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (Point2i pixel : tile->GetPixelBounds()) {
+        // Merge _pixel_ into _Film::pixels_
+        const FilmTilePixel &tilePixel = tile->GetPixel(pixel);
+        Pixel &mergePixel = GetPixel(pixel);
+        float rgb[3];
+        tilePixel.contribSum.ToRGB(rgb);
+        for (int i = 0; i < 3; ++i) mergePixel.rgb[i] += rgb[i];
+        mergePixel.filterWeightSum += tilePixel.filterWeightSum;
+    }
+}
+
+void Film::AddSplat(const Point2f &p, Spectrum v) {
+    if (v.HasNaNs() || v.y() < 0 || std::isinf(v.y())) return;
+    if (!InsideExclusive((Point2i)p, pixelBounds)) return;
+    float rgb[3];
+    v.ToRGB(rgb);
+    Pixel &pixel = GetPixel((Point2i)p);
+    for (int i = 0; i < 3; ++i) pixel.splatRGB[i].Add(rgb[i]);
+}
+
+void Film::GetImage(std::vector<Spectrum> &col, float splatScale) const {
+    int nPixels = pixelBounds.Area();
+
+    #pragma omp parallel for
+    for (int offset = 0; offset < nPixels; ++offset) {
+        // Normalize pixel with weight sum and add splat value
+        const Pixel &pixel = pixels[offset];
+        float rgb[3];
+        for (int i = 0; i < 3; ++i) {
+            rgb[i] = pixel.filterWeightSum != 0 ?
+                         std::max((float)0, pixel.rgb[i] / pixel.filterWeightSum) : 0;
+            rgb[i] += splatScale * pixel.splatRGB[i];
+        }
+        col[offset] = Spectrum::FromRGB(rgb);
+    }
+}
+
+void Film::Clear() {
+    for (Point2i p : pixelBounds) {
+        Pixel &pixel = GetPixel(p);
+        for (int c = 0; c < 3; ++c)
+            pixel.splatRGB[c] = pixel.rgb[c] = 0;
+        pixel.filterWeightSum = 0;
+    }
+}
+
+// FilmTile Method Definitions
+void FilmTile::AddSample(const Point2f &pFilm, Spectrum L,
+                         float sampleWeight) {
+    // Compute sample's raster bounds
+    Point2f pFilmDiscrete = pFilm - Vector2f(0.5f, 0.5f);
+    Point2i p0 = (Point2i)Ceil(pFilmDiscrete - filterRadius);
+    Point2i p1 =
+        (Point2i)Floor(pFilmDiscrete + filterRadius) + Point2i(1, 1);
+    p0 = Max(p0, pixelBounds.pMin);
+    p1 = Min(p1, pixelBounds.pMax);
+    if (p0.x >= p1.x || p0.y >= p1.y) return;
+
+    // Look up the filter factor of every covered column and row once
+    weightX.resize(p1.x - p0.x);
+    weightY.resize(p1.y - p0.y);
+    for (int x = p0.x; x < p1.x; ++x) {
+        float fx = std::abs((x - pFilmDiscrete.x) * invFilterRadius.x *
+                            filterTableSize);
+        weightX[x - p0.x] = filterTableX[std::min((int)fx, filterTableSize - 1)];
+    }
+    for (int y = p0.y; y < p1.y; ++y) {
+        float fy = std::abs((y - pFilmDiscrete.y) * invFilterRadius.y *
+                            filterTableSize);
+        weightY[y - p0.y] = filterTableY[std::min((int)fy, filterTableSize - 1)];
+    }
+
+    // Loop over filter support and add sample to pixel arrays
+    for (int y = p0.y; y < p1.y; ++y) {
+        for (int x = p0.x; x < p1.x; ++x) {
+            float filterWeight = weightX[x - p0.x] * weightY[y - p0.y];
+
+            // Update pixel values with filtered sample contribution
+            FilmTilePixel &pixel = GetPixel(Point2i(x, y));
+            pixel.contribSum += L * sampleWeight * filterWeight;
+            pixel.filterWeightSum += filterWeight;
+        }
+    }
+}
+
+}
\ No newline at end of file
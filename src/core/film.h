@@ -0,0 +1,112 @@
+#pragma once
+
+#include "PBRender.h"
+#include "geometry.h"
+#include "spectrum.h"
+#include "filter.h"
+#include "parallel.h"
+
+#include <mutex>
+
+namespace PBRender {
+
+// FilmTilePixel Declarations
+struct FilmTilePixel {
+    Spectrum contribSum = Spectrum(0.f);
+    float filterWeightSum = 0.f;
+};
+
+// Film Declarations
+class Film {
+    public:
+        // Film Public Methods
+        Film(const Point2i &resolution, std::unique_ptr<Filter> filter);
+
+        Bounds2i GetSampleBounds() const;
+        std::unique_ptr<FilmTile> GetFilmTile(const Bounds2i &sampleBounds);
+        void MergeFilmTile(std::unique_ptr<FilmTile> tile);
+        void AddSplat(const Point2f &p, Spectrum v);
+        void GetImage(std::vector<Spectrum> &col, float splatScale = 1) const;
+        void Clear();
+
+        // Film Public Data
+        const Point2i fullResolution;
+        std::unique_ptr<Filter> filter;
+        const Bounds2i pixelBounds;
+
+    private:
+        // Film Private Data
+        // Two pixels share a cache line, and a worker only writes the shared
+        // pixels when it merges a whole tile, so there is no false sharing
+        // while samples are being added
+        struct Pixel {
+            Pixel() { rgb[0] = rgb[1] = rgb[2] = filterWeightSum = 0; }
+            float rgb[3];
+            float filterWeightSum;
+            AtomicFloat splatRGB[3];
+            float pad;
+        };
+        std::unique_ptr<Pixel[]> pixels;
+        static constexpr int filterTableWidth = 64;
+        float filterTableX[filterTableWidth], filterTableY[filterTableWidth];
+        std::mutex mutex;
+
+        // Film Private Methods
+        Pixel &GetPixel(const Point2i &p) {
+            int width = pixelBounds.pMax.x - pixelBounds.pMin.x;
+            int offset = (p.x - pixelBounds.pMin.x) +
+                         (p.y - pixelBounds.pMin.y) * width;
+            return pixels[offset];
+        }
+};
+
+// FilmTile Declarations
+// Private accumulation target of one worker. Samples are filtered into the
+// tile without any synchronization and the tile is merged into the _Film_
+// once it is complete.
+class FilmTile {
+    public:
+        // FilmTile Public Methods
+        FilmTile(const Bounds2i &pixelBounds, const Vector2f &filterRadius,
+                 const float *filterTableX, const float *filterTableY,
+                 int filterTableSize)
+            : pixelBounds(pixelBounds),
+              filterRadius(filterRadius),
+              invFilterRadius(1 / filterRadius.x, 1 / filterRadius.y),
+              filterTableX(filterTableX),
+              filterTableY(filterTableY),
+              filterTableSize(filterTableSize) {
+            pixels = std::vector<FilmTilePixel>(std::max(0, pixelBounds.Area()));
+        }
+
+        void AddSample(const Point2f &pFilm, Spectrum L,
+                       float sampleWeight = 1.);
+
+        FilmTilePixel &GetPixel(const Point2i &p) {
+            int width = pixelBounds.pMax.x - pixelBounds.pMin.x;
+            int offset = (p.x - pixelBounds.pMin.x) +
+                         (p.y - pixelBounds.pMin.y) * width;
+            return pixels[offset];
+        }
+
+        const FilmTilePixel &GetPixel(const Point2i &p) const {
+            int width = pixelBounds.pMax.x - pixelBounds.pMin.x;
+            int offset = (p.x - pixelBounds.pMin.x) +
+                         (p.y - pixelBounds.pMin.y) * width;
+            return pixels[offset];
+        }
+
+        Bounds2i GetPixelBounds() const { return pixelBounds; }
+
+    private:
+        // FilmTile Private Data
+        const Bounds2i pixelBounds;
+        const Vector2f filterRadius, invFilterRadius;
+        const float *filterTableX, *filterTableY;
+        const int filterTableSize;
+        std::vector<FilmTilePixel> pixels;
+        // Per-sample filter weights along each axis
+        std::vector<float> weightX, weightY;
+};
+
+}
\ No newline at end of file
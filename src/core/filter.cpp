@@ -0,0 +1,8 @@
+#include "filter.h"
+
+namespace PBRender {
+
+// Filter Method Definitions
+Filter::~Filter() {}
+
+}
\ No newline at end of file
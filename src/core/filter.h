@@ -0,0 +1,28 @@
+#pragma once
+
+#include "PBRender.h"
+#include "geometry.h"
+
+namespace PBRender {
+
+// Filter Declarations
+// All reconstruction filters are separable, f(x, y) = f_x(x) f_y(y), which
+// lets the film tabulate one factor per axis instead of a 2D table.
+class Filter {
+    public:
+        // Filter Interface
+        virtual ~Filter();
+        Filter(const Vector2f &radius)
+            : radius(radius), invRadius(Vector2f(1 / radius.x, 1 / radius.y)) {}
+
+        // Returns the factor of the filter for offset _x_ along _axis_
+        virtual float Evaluate1D(float x, int axis) const = 0;
+        float Evaluate(const Point2f &p) const {
+            return Evaluate1D(p.x, 0) * Evaluate1D(p.y, 1);
+        }
+
+        // Filter Public Data
+        const Vector2f radius, invRadius;
+};
+
+}
\ No newline at end of file
@@ -2,4 +2,42 @@
 
 namespace PBRender {
 
+// DirectionCone Function Definitions
+DirectionCone Union(const DirectionCone &a, const DirectionCone &b) {
+    // Handle the cases where one or both cones are empty
+    if (a.IsEmpty()) return b;
+    if (b.IsEmpty()) return a;
+
+    // Handle the cases where one cone is inside the other
+    float theta_a = SafeACos(a.cosTheta), theta_b = SafeACos(b.cosTheta);
+    float theta_d = AngleBetween(a.w, b.w);
+    if (std::min(theta_d + theta_b, Pi) <= theta_a) return a;
+    if (std::min(theta_d + theta_a, Pi) <= theta_b) return b;
+
+    // Compute the spread angle of the merged cone, $\theta_o$
+    float theta_o = (theta_a + theta_d + theta_b) / 2;
+    if (theta_o >= Pi) return DirectionCone::EntireSphere();
+
+    // Rotate _a.w_ towards _b.w_ by $\theta_o - \theta_a$ to get the axis
+    float theta_r = theta_o - theta_a;
+    Vector3f wr = Cross(a.w, b.w);
+    if (wr.LengthSquared() == 0) return DirectionCone::EntireSphere();
+    Vector3f w = std::cos(theta_r) * a.w +
+                 std::sin(theta_r) * Cross(Normalize(wr), a.w);
+    return DirectionCone(w, std::cos(theta_o));
+}
+
+DirectionCone BoundSubtendedDirections(const Bounds3f &b, const Point3f &p) {
+    // Bound the directions with the bounding sphere of _b_
+    float radius;
+    Point3f pCenter;
+    b.BoundingSphere(&pCenter, &radius);
+    float d2 = DistanceSquared(p, pCenter);
+    if (d2 <= radius * radius) return DirectionCone::EntireSphere();
+
+    float sin2ThetaMax = radius * radius / d2;
+    float cosThetaMax = SafeSqrt(1 - sin2ThetaMax);
+    return DirectionCone(pCenter - p, cosThetaMax);
+}
+
 }
\ No newline at end of file
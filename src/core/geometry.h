@@ -527,10 +527,10 @@ typedef Point3<int> Point3i;
 
 class Ray {
     public:
-        Ray() : tMax(Infinity), time(0.f) {}
+        Ray() : tMax(Infinity), time(0.f), medium(nullptr) {}
         Ray(const Point3f &o, const Vector3f &d, float tMax = Infinity,
-            float time = 0.f)
-            : o(o), d(d), tMax(tMax), time(time) {}
+            float time = 0.f, const Medium *medium = nullptr)
+            : o(o), d(d), tMax(tMax), time(time), medium(medium) {}
         
         Point3f operator()(float t) const { return o + d * t; }
 
@@ -547,19 +547,15 @@ class Ray {
         Vector3f d;
         mutable float tMax;
         float time;
+        const Medium *medium;
 };
 
 class RayDifferential : public Ray {
     public:
         RayDifferential() { hasDifferentials = false; }
-        // RayDifferential(const Point3f &o, const Vector3f &d, Float tMax = Infinity,
-        //                 Float time = 0.f, const Medium *medium = nullptr)
-        //     : Ray(o, d, tMax, time, medium) {
-        //     hasDifferentials = false;
-        // }
         RayDifferential(const Point3f &o, const Vector3f &d, float tMax = Infinity,
-                        float time = 0.f)
-            : Ray(o, d, tMax, time) {
+                        float time = 0.f, const Medium *medium = nullptr)
+            : Ray(o, d, tMax, time, medium) {
             hasDifferentials = false;
         }
         RayDifferential(const Ray &ray) : Ray(ray) { hasDifferentials = false; }
@@ -1461,4 +1457,35 @@ inline float SphericalPhi(const Vector3f &v) {
     return (p < 0) ? (p + 2 * Pi) : p;
 }
 
+// Angle between two normalized vectors, computed without the precision
+// loss of acos() for nearly parallel vectors
+inline float AngleBetween(const Vector3f &v1, const Vector3f &v2) {
+    if (Dot(v1, v2) < 0)
+        return Pi - 2 * SafeASin((v1 + v2).Length() / 2);
+    else
+        return 2 * SafeASin((v2 - v1).Length() / 2);
+}
+
+// DirectionCone Declarations
+// The set of directions within an angle of _w_ whose cosine is _cosTheta_;
+// a default-constructed cone is empty.
+struct DirectionCone {
+    DirectionCone() {}
+    DirectionCone(const Vector3f &w, float cosTheta)
+        : w(Normalize(w)), cosTheta(cosTheta) {}
+    static DirectionCone EntireSphere() {
+        return DirectionCone(Vector3f(0, 0, 1), -1);
+    }
+    bool IsEmpty() const { return cosTheta == Infinity; }
+
+    // DirectionCone Public Data
+    Vector3f w;
+    float cosTheta = Infinity;
+};
+
+DirectionCone Union(const DirectionCone &a, const DirectionCone &b);
+
+// Returns a cone bounding the directions from _p_ towards points in _b_
+DirectionCone BoundSubtendedDirections(const Bounds3f &b, const Point3f &p);
+
 }
\ No newline at end of file
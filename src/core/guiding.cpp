@@ -0,0 +1,317 @@
+#include "guiding.h"
+#include "rng.h"
+
+#include "omp.h"
+
+namespace PBRender {
+
+// Guiding Local Functions
+static Point2f DirectionToCylindrical(const Vector3f &w) {
+    float cosTheta = Clamp(w.z, -1, 1);
+    float phi = std::atan2(w.y, w.x);
+    if (phi < 0) phi += 2 * Pi;
+    return Point2f(Clamp((cosTheta + 1) / 2, 0, OneMinusEpsilon),
+                   Clamp(phi * Inv2Pi, 0, OneMinusEpsilon));
+}
+
+static Vector3f CylindricalToDirection(const Point2f &p) {
+    float cosTheta = 2 * p.x - 1;
+    float sinTheta = SafeSqrt(1 - cosTheta * cosTheta);
+    float phi = 2 * Pi * p.y;
+    return Vector3f(sinTheta * std::cos(phi), sinTheta * std::sin(phi),
+                    cosTheta);
+}
+
+// DTree Method Definitions
+DTree::DTree() : nodes(1), total(0) {
+    for (int c = 0; c < 4; ++c) {
+        nodes[0].sum[c] = 0;
+        nodes[0].child[c] = 0;
+    }
+}
+
+// Antiderivative of $\sin\theta = \sqrt{1 - z^2}$ over $z = \cos\theta$
+static float SinThetaIntegral(float z) {
+    z = Clamp(z, -1, 1);
+    return .5f * (z * SafeSqrt(1 - z * z) + std::asin(z));
+}
+
+DTree::CosineCell DTree::RootCell() {
+    return CosineCell{{-1, 1}, {-Pi / 4, Pi / 4}, {0, 2 * Pi}, {0, 0}, {1, 1}};
+}
+
+bool DTree::Trained(const Vector3f *n) const {
+    if (!(total > 0)) return false;
+    if (!n) return true;
+    CosineCell root = RootCell();
+    float weight[4];
+    CosineCell quadrants[4];
+    Weights(nodes[0], n, root, weight, quadrants);
+    return weight[0] + weight[1] + weight[2] + weight[3] > 0;
+}
+
+void DTree::Weights(const Node &node, const Vector3f *n,
+                    const CosineCell &cell, float weight[4],
+                    CosineCell quadrants[4]) const {
+    if (!n) {
+        for (int c = 0; c < 4; ++c) weight[c] = node.sum[c];
+        return;
+    }
+    // Split the cell at the middle of its ranges, then integrate
+    // $\cos\theta_n = n_x \sin\theta \cos\phi + n_y \sin\theta \sin\phi + n_z
+    // \cos\theta$ over each quadrant; $d\omega = dz\,d\phi$
+    float zMid = (cell.z[0] + cell.z[1]) / 2;
+    float gMid = SinThetaIntegral(zMid);
+    float phiMid = (cell.phi[0] + cell.phi[1]) / 2;
+    float sinMid = std::sin(phiMid), cosMid = std::cos(phiMid);
+    for (int c = 0; c < 4; ++c) {
+        int cx = c & 1, cy = c >> 1;
+        CosineCell &q = quadrants[c];
+        q.z[0] = cx ? zMid : cell.z[0];
+        q.z[1] = cx ? cell.z[1] : zMid;
+        q.g[0] = cx ? gMid : cell.g[0];
+        q.g[1] = cx ? cell.g[1] : gMid;
+        q.phi[0] = cy ? phiMid : cell.phi[0];
+        q.phi[1] = cy ? cell.phi[1] : phiMid;
+        q.sinPhi[0] = cy ? sinMid : cell.sinPhi[0];
+        q.sinPhi[1] = cy ? cell.sinPhi[1] : sinMid;
+        q.cosPhi[0] = cy ? cosMid : cell.cosPhi[0];
+        q.cosPhi[1] = cy ? cell.cosPhi[1] : cosMid;
+        float integral =
+            (n->x * (q.sinPhi[1] - q.sinPhi[0]) -
+             n->y * (q.cosPhi[1] - q.cosPhi[0])) *
+                (q.g[1] - q.g[0]) +
+            n->z * (q.phi[1] - q.phi[0]) *
+                (q.z[1] * q.z[1] - q.z[0] * q.z[0]) / 2;
+        weight[c] = node.sum[c] * std::max(integral, 0.f);
+    }
+}
+
+Vector3f DTree::Sample(const Point2f &uSample, float *pdf,
+                       const Vector3f *n) const {
+    Point2f u = uSample, origin(0, 0);
+    float size = 1, density = 1;
+    CosineCell cell = RootCell();
+    int node = 0;
+    for (;;) {
+        // Choose a column of quadrants, then a quadrant within it, reusing
+        // the remapped sample at the next level
+        float w[4];
+        CosineCell quadrants[4];
+        Weights(nodes[node], n, cell, w, quadrants);
+        float nodeTotal = w[0] + w[1] + w[2] + w[3];
+        if (!(nodeTotal > 0)) {
+            *pdf = 0;
+            return Vector3f(0, 0, 1);
+        }
+        float pLeft = (w[0] + w[2]) / nodeTotal;
+        int cx = u.x < pLeft ? 0 : 1;
+        u.x = cx == 0 ? u.x / pLeft : (u.x - pLeft) / (1 - pLeft);
+        float pTop = w[cx] / (w[cx] + w[cx + 2]);
+        int cy = u.y < pTop ? 0 : 1;
+        u.y = cy == 0 ? u.y / pTop : (u.y - pTop) / (1 - pTop);
+        u = Point2f(std::min(u.x, OneMinusEpsilon), std::min(u.y, OneMinusEpsilon));
+
+        int c = cx + 2 * cy;
+        density *= 4 * w[c] / nodeTotal;
+        size /= 2;
+        origin = Point2f(origin.x + cx * size, origin.y + cy * size);
+        if (!nodes[node].child[c]) break;
+        node = nodes[node].child[c];
+        cell = quadrants[c];
+    }
+    *pdf = density * Inv4Pi;
+    return CylindricalToDirection(
+        Point2f(origin.x + u.x * size, origin.y + u.y * size));
+}
+
+float DTree::Pdf(const Vector3f &w, const Vector3f *n) const {
+    if (!Trained()) return 0;
+    Point2f p = DirectionToCylindrical(w);
+    float density = 1;
+    CosineCell cell = RootCell();
+    int node = 0;
+    for (;;) {
+        float weight[4];
+        CosineCell quadrants[4];
+        Weights(nodes[node], n, cell, weight, quadrants);
+        int cx = p.x < 0.5f ? 0 : 1, cy = p.y < 0.5f ? 0 : 1;
+        int c = cx + 2 * cy;
+        float nodeTotal = weight[0] + weight[1] + weight[2] + weight[3];
+        if (weight[c] == 0) return 0;
+        density *= 4 * weight[c] / nodeTotal;
+        if (!nodes[node].child[c]) break;
+        p = Point2f(2 * p.x - cx, 2 * p.y - cy);
+        node = nodes[node].child[c];
+        cell = quadrants[c];
+    }
+    return density * Inv4Pi;
+}
+
+int DTree::Slot(const Vector3f &w) const {
+    Point2f p = DirectionToCylindrical(w);
+    int node = 0;
+    for (;;) {
+        int cx = p.x < 0.5f ? 0 : 1, cy = p.y < 0.5f ? 0 : 1;
+        int c = cx + 2 * cy;
+        if (!nodes[node].child[c]) return 4 * node + c;
+        p = Point2f(2 * p.x - cx, 2 * p.y - cy);
+        node = nodes[node].child[c];
+    }
+}
+
+void DTree::Build(const float *energy, float rho, int maxDepth) {
+    // Sum the energy of every subtree; children are stored after their
+    // parents, so a reverse sweep sees them first
+    std::vector<float> subtreeEnergy(energy, energy + SlotCount());
+    for (int i = (int)nodes.size() - 1; i >= 0; --i)
+        for (int c = 0; c < 4; ++c) {
+            int child = nodes[i].child[c];
+            if (child)
+                subtreeEnergy[4 * i + c] =
+                    subtreeEnergy[4 * child] + subtreeEnergy[4 * child + 1] +
+                    subtreeEnergy[4 * child + 2] + subtreeEnergy[4 * child + 3];
+        }
+
+    // Keep the previous distribution if nothing was recorded
+    float newTotal = subtreeEnergy[0] + subtreeEnergy[1] + subtreeEnergy[2] +
+                     subtreeEnergy[3];
+    if (!(newTotal > 0)) return;
+
+    std::vector<Node> newNodes;
+    BuildNode(subtreeEnergy, 0, &subtreeEnergy[0], rho * newTotal, 1,
+              maxDepth, &newNodes);
+    nodes.swap(newNodes);
+    total = newTotal;
+}
+
+int DTree::BuildNode(const std::vector<float> &subtreeEnergy, int oldNode,
+                     const float energy[4], float threshold, int depth,
+                     int maxDepth, std::vector<Node> *newNodes) const {
+    int index = (int)newNodes->size();
+    newNodes->push_back(Node());
+    for (int c = 0; c < 4; ++c) {
+        (*newNodes)[index].sum[c] = energy[c];
+        (*newNodes)[index].child[c] = 0;
+    }
+
+    for (int c = 0; c < 4; ++c) {
+        if (depth >= maxDepth || energy[c] <= threshold) continue;
+        // Refine with the recorded energies where the old tree had a child
+        // and split the quadrant's energy evenly otherwise
+        int oldChild = oldNode >= 0 ? nodes[oldNode].child[c] : 0;
+        float childEnergy[4];
+        for (int k = 0; k < 4; ++k)
+            childEnergy[k] =
+                oldChild ? subtreeEnergy[4 * oldChild + k] : energy[c] / 4;
+        int child = BuildNode(subtreeEnergy, oldChild ? oldChild : -1,
+                              childEnergy, threshold, depth + 1, maxDepth,
+                              newNodes);
+        (*newNodes)[index].child[c] = child;
+    }
+    return index;
+}
+
+// SDTree Method Definitions
+SDTree::SDTree(const Bounds3f &sceneBounds) : nSlots(0) {
+    // Use a cube so that splitting along alternating axes keeps cells
+    // well shaped
+    Vector3f d = sceneBounds.Diagonal();
+    float size = std::max(d.x, std::max(d.y, d.z));
+    bounds = Bounds3f(sceneBounds.pMin,
+                      sceneBounds.pMin + Vector3f(size, size, size));
+
+    Node root;
+    root.axis = 0;
+    root.child[0] = root.child[1] = 0;
+    root.leaf = 0;
+    nodes.push_back(root);
+    dTrees.push_back(DTree());
+    slotOffset.push_back(0);
+    nSlots = dTrees[0].SlotCount();
+}
+
+int SDTree::Leaf(const Point3f &pWorld) const {
+    Vector3f p = bounds.Offset(pWorld);
+    for (int i = 0; i < 3; ++i) p[i] = Clamp(p[i], 0, OneMinusEpsilon);
+    int node = 0;
+    while (nodes[node].child[0]) {
+        int axis = nodes[node].axis;
+        if (p[axis] < 0.5f) {
+            p[axis] *= 2;
+            node = nodes[node].child[0];
+        } else {
+            p[axis] = 2 * p[axis] - 1;
+            node = nodes[node].child[1];
+        }
+    }
+    return nodes[node].leaf;
+}
+
+void SDTree::ResetRecorder(GuidingRecorder *recorder) const {
+    recorder->energy.assign(nSlots, 0.f);
+    recorder->count.assign(dTrees.size(), 0);
+}
+
+void SDTree::Record(GuidingRecorder *recorder, int leaf, const Vector3f &w,
+                    float energy) const {
+    ++recorder->count[leaf];
+    if (energy > 0 && !std::isinf(energy))
+        recorder->energy[slotOffset[leaf] + dTrees[leaf].Slot(w)] += energy;
+}
+
+void SDTree::Refine(const std::vector<GuidingRecorder> &recorders,
+                    int64_t splitThreshold, float rho, int maxDTreeDepth) {
+    // Merge the thread-local statistics of the pass
+    std::vector<float> energy(nSlots, 0.f);
+    std::vector<int64_t> count(dTrees.size(), 0);
+    for (const GuidingRecorder &recorder : recorders) {
+        if ((int)recorder.energy.size() != nSlots) continue;
+        #pragma omp parallel for
+        for (int i = 0; i < nSlots; ++i) energy[i] += recorder.energy[i];
+        for (size_t l = 0; l < count.size(); ++l) count[l] += recorder.count[l];
+    }
+
+    // Rebuild the directional distributions from the recorded energy
+    int nLeaves = (int)dTrees.size();
+    #pragma omp parallel for schedule(dynamic)
+    for (int l = 0; l < nLeaves; ++l)
+        dTrees[l].Build(&energy[slotOffset[l]], rho, maxDTreeDepth);
+
+    // Split densely sampled leaves; both halves start from the parent's
+    // distribution
+    int nNodes = (int)nodes.size();
+    for (int i = 0; i < nNodes; ++i)
+        if (!nodes[i].child[0]) Split(i, count[nodes[i].leaf], splitThreshold);
+
+    slotOffset.resize(dTrees.size());
+    nSlots = 0;
+    for (size_t l = 0; l < dTrees.size(); ++l) {
+        slotOffset[l] = nSlots;
+        nSlots += dTrees[l].SlotCount();
+    }
+}
+
+void SDTree::Split(int node, int64_t count, int64_t splitThreshold) {
+    if (count <= splitThreshold) return;
+    int leaf = nodes[node].leaf;
+    DTree copy = dTrees[leaf];
+    dTrees.push_back(std::move(copy));
+
+    Node child;
+    child.axis = (nodes[node].axis + 1) % 3;
+    child.child[0] = child.child[1] = 0;
+    int first = (int)nodes.size();
+    child.leaf = leaf;
+    nodes.push_back(child);
+    child.leaf = (int)dTrees.size() - 1;
+    nodes.push_back(child);
+    nodes[node].child[0] = first;
+    nodes[node].child[1] = first + 1;
+    nodes[node].leaf = -1;
+
+    Split(first, count / 2, splitThreshold);
+    Split(first + 1, count / 2, splitThreshold);
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "PBRender.h"
+#include "geometry.h"
+
+#include <vector>
+
+namespace PBRender {
+
+// DTree Declarations
+// Piecewise-constant distribution of incident radiance over directions,
+// stored as a quadtree over the cylindrical (equal-area) parameterization
+// $(\cos\theta + 1) / 2, \phi / 2\pi$ of the sphere. Each node keeps the
+// energy of its four quadrants; quadrants with a child node refine the
+// distribution, the others are uniform.
+class DTree {
+  public:
+    // DTree Public Methods
+    DTree();
+    // With _n_, the distribution is multiplied by the cosine to _n_,
+    // clamped to zero, which leaves out the directions below the plane of
+    // _n_. Each quadrant is then weighted by its energy times the exact
+    // integral of the cosine over it. Trained() tells whether there is
+    // anything to sample.
+    bool Trained(const Vector3f *n = nullptr) const;
+    Vector3f Sample(const Point2f &u, float *pdf,
+                    const Vector3f *n = nullptr) const;
+    float Pdf(const Vector3f &w, const Vector3f *n = nullptr) const;
+
+    // Energy is recorded per quadrant slot (4 per node) of the current tree
+    int SlotCount() const { return 4 * (int)nodes.size(); }
+    int Slot(const Vector3f &w) const;
+
+    // Replaces the tree with one built from the energies recorded in its
+    // slots: quadrants holding more than _rho_ of the total are subdivided
+    // (up to _maxDepth_ levels) and the others collapse to leaves.
+    void Build(const float *energy, float rho, int maxDepth);
+
+  private:
+    // DTree Private Declarations
+    struct Node {
+        float sum[4];
+        int child[4];  // 0 for leaf quadrants, as the root is never a child
+    };
+    // Ranges of $\cos\theta$ and $\phi$ covered by a node, with the values
+    // at their ends that the integral of the cosine to a direction needs
+    struct CosineCell {
+        float z[2], g[2], phi[2], sinPhi[2], cosPhi[2];
+    };
+
+    // DTree Private Methods
+    static CosineCell RootCell();
+    // Sets _weight_ to the sampling weights of the quadrants of _node_,
+    // and with _n_ also _quadrants_ to their cells within _cell_
+    void Weights(const Node &node, const Vector3f *n, const CosineCell &cell,
+                 float weight[4], CosineCell quadrants[4]) const;
+    int BuildNode(const std::vector<float> &subtreeEnergy, int oldNode,
+                  const float energy[4], float threshold, int depth,
+                  int maxDepth, std::vector<Node> *newNodes) const;
+
+    // DTree Private Data
+    std::vector<Node> nodes;
+    float total;
+};
+
+// GuidingRecorder Declarations
+// Statistics gathered by one thread during a training pass; the recorders
+// of all threads are merged by _SDTree::Refine()_ once the pass is done.
+struct GuidingRecorder {
+    std::vector<float> energy;
+    std::vector<int64_t> count;
+};
+
+// SDTree Declarations
+// Spatial binary tree over the scene bounds whose leaves each hold a
+// _DTree_. Leaves that receive many samples are split so the directional
+// distributions adapt to the local lighting.
+class SDTree {
+  public:
+    // SDTree Public Methods
+    SDTree(const Bounds3f &sceneBounds);
+    int Leaf(const Point3f &p) const;
+    const DTree &GetDTree(int leaf) const { return dTrees[leaf]; }
+
+    // Sizes _recorder_ for the current subdivision and clears it
+    void ResetRecorder(GuidingRecorder *recorder) const;
+    void Record(GuidingRecorder *recorder, int leaf, const Vector3f &w,
+                float energy) const;
+
+    // Merges the recorders of a pass, rebuilds the directional trees and
+    // splits leaves with more than _splitThreshold_ samples
+    void Refine(const std::vector<GuidingRecorder> &recorders,
+                int64_t splitThreshold, float rho = 0.01f,
+                int maxDTreeDepth = 20);
+    int LeafCount() const { return (int)dTrees.size(); }
+
+  private:
+    // SDTree Private Declarations
+    struct Node {
+        int axis;
+        int child[2];  // 0 for leaves, as the root is never a child
+        int leaf;
+    };
+
+    // SDTree Private Methods
+    void Split(int node, int64_t count, int64_t splitThreshold);
+
+    // SDTree Private Data
+    Bounds3f bounds;
+    std::vector<Node> nodes;
+    std::vector<DTree> dTrees;
+    std::vector<int> slotOffset;
+    int nSlots;
+};
+
+}
\ No newline at end of file
@@ -3,14 +3,22 @@
 #include "interaction.h"
 #include "sampling.h"
 // #include "parallel.h"
-// #include "film.h"
+#include "film.h"
+#include "filters/box.h"
 #include "sampler.h"
 // #include "progressreporter.h"
 #include "camera.h"
+#include "lightdistrib.h"
+#include "visibilitycache.h"
+#include "memory.h"
 // #include "stats.h"
 
 #include "omp.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
 namespace PBRender {
 
 static long long nCameraRays = 0;
@@ -54,11 +62,34 @@ Spectrum UniformSampleAllLights(const Interaction &it,
     return L;
 }
 
+// Estimates direct lighting from the chosen light _lightNum_, selected with
+// probability _lightPdf_
+static Spectrum SampleChosenLight(const Interaction &it, const Scene &scene,
+                                  Sampler &sampler, int lightNum,
+                                  float lightPdf, bool handleMedia,
+                                  DeferredShadowRay *deferred) {
+    const std::shared_ptr<Light> &light = scene.lights[lightNum];
+    Point2f uLight = sampler.Get2D();
+    Point2f uScattering = sampler.Get2D();
+    Spectrum Ld = EstimateDirect(it, uScattering, *light, uLight,
+                                 scene, sampler, 
+                                //  arena, 
+                                 handleMedia, false, deferred);
+    if (deferred) {
+        deferred->Ld /= lightPdf;
+        deferred->lightNum = lightNum;
+    }
+    return Ld / lightPdf;
+}
+
 Spectrum UniformSampleOneLight(const Interaction &it, const Scene &scene,
                             //    MemoryArena &arena, 
                                Sampler &sampler,
-                               bool handleMedia, const Distribution1D *lightDistrib) {
+                               bool handleMedia, const Distribution1D *lightDistrib,
+                               DeferredShadowRay *deferred) {
     // ProfilePhase p(Prof::DirectLighting);
+    if (deferred) deferred->Ld = Spectrum(0.f);
+
     // Randomly choose a single light to sample, _light_
     int nLights = int(scene.lights.size());
     if (nLights == 0) return Spectrum(0.f);
@@ -74,20 +105,30 @@ Spectrum UniformSampleOneLight(const Interaction &it, const Scene &scene,
         lightPdf = float(1) / nLights;
     }
     
-    const std::shared_ptr<Light> &light = scene.lights[lightNum];
-    Point2f uLight = sampler.Get2D();
-    Point2f uScattering = sampler.Get2D();
-    return EstimateDirect(it, uScattering, *light, uLight,
-                          scene, sampler, 
-                        //   arena, 
-                          handleMedia) / lightPdf;
+    return SampleChosenLight(it, scene, sampler, lightNum, lightPdf,
+                             handleMedia, deferred);
+}
+
+Spectrum UniformSampleOneLight(const Interaction &it, const Scene &scene,
+                               Sampler &sampler,
+                               const LightDistribution &lightDistrib,
+                               bool handleMedia, DeferredShadowRay *deferred) {
+    if (deferred) deferred->Ld = Spectrum(0.f);
+    if (scene.lights.empty()) return Spectrum(0.f);
+
+    float lightPdf;
+    int lightNum = lightDistrib.Sample(it, sampler.Get1D(), &lightPdf);
+    if (lightNum < 0 || lightPdf == 0) return Spectrum(0.f);
+    return SampleChosenLight(it, scene, sampler, lightNum, lightPdf,
+                             handleMedia, deferred);
 }
 
 Spectrum EstimateDirect(const Interaction &it, const Point2f &uScattering,
                         const Light &light, const Point2f &uLight,
                         const Scene &scene, Sampler &sampler,
                         // MemoryArena &arena, 
-                        bool handleMedia, bool specular) {
+                        bool handleMedia, bool specular,
+                        DeferredShadowRay *deferred) {
     BxDFType bsdfFlags =
         specular ? BSDF_ALL : BxDFType(BSDF_ALL & ~BSDF_SPECULAR);
     Spectrum Ld(0.f);
@@ -99,6 +140,14 @@ Spectrum EstimateDirect(const Interaction &it, const Point2f &uScattering,
     // VLOG(2) << "EstimateDirect uLight:" << uLight << " -> Li: " << Li << ", wi: "
     //         << wi << ", pdf: " << lightPdf;
     if (lightPdf > 0 && !Li.IsBlack()) {
+        // Skip the shadow ray if the visibility cache proves its outcome. The
+        // cache treats medium boundaries as opaque, so it is only consulted
+        // without media.
+        LightVisibility cached =
+            scene.visibilityCache && !handleMedia
+                ? scene.visibilityCache->Lookup(light, it)
+                : LightVisibility::Penumbra;
+
         // Compute BSDF or phase function's value for light sample
         Spectrum f;
         if (it.IsSurfaceInteraction()) {
@@ -110,18 +159,28 @@ Spectrum EstimateDirect(const Interaction &it, const Point2f &uScattering,
             // VLOG(2) << "  surf f*dot :" << f << ", scatteringPdf: " << scatteringPdf;
         } else {
             // Evaluate phase function for light sampling strategy
-            // const MediumInteraction &mi = (const MediumInteraction &)it;
-            // float p = mi.phase->p(mi.wo, wi);
-            // f = Spectrum(p);
-            // scatteringPdf = p;
+            const MediumInteraction &mi = (const MediumInteraction &)it;
+            float p = mi.phase->p(mi.wo, wi);
+            f = Spectrum(p);
+            scatteringPdf = p;
             // VLOG(2) << "  medium p: " << p;
         }
-        if (!f.IsBlack()) {
+        if (cached == LightVisibility::Occluded) f = Spectrum(0.f);
+        if (!f.IsBlack() && deferred && cached == LightVisibility::Penumbra) {
+            // Hand the shadow ray back to the caller instead of tracing it
+            deferred->ray = visibility.P0().SpawnRayTo(visibility.P1());
+            if (IsDeltaLight(light.flags))
+                deferred->Ld = f * Li / lightPdf;
+            else
+                deferred->Ld = f * Li *
+                               PowerHeuristic(1, lightPdf, 1, scatteringPdf) /
+                               lightPdf;
+        } else if (!f.IsBlack()) {
             // Compute effect of visibility for light source sample
             if (handleMedia) {
                 Li *= visibility.Tr(scene, sampler);
                 // VLOG(2) << "  after Tr, Li: " << Li;
-            } else {
+            } else if (cached == LightVisibility::Penumbra) {
               if (!visibility.Unoccluded(scene)) {
                 // VLOG(2) << "  shadow ray blocked";
                 Li = Spectrum(0.f);
@@ -156,21 +215,19 @@ Spectrum EstimateDirect(const Interaction &it, const Point2f &uScattering,
             sampledSpecular = (sampledType & BSDF_SPECULAR) != 0;
         } else {
             // Sample scattered direction for medium interactions
-            // const MediumInteraction &mi = (const MediumInteraction &)it;
-            // float p = mi.phase->Sample_p(mi.wo, &wi, uScattering);
-            // f = Spectrum(p);
-            // scatteringPdf = p;
+            const MediumInteraction &mi = (const MediumInteraction &)it;
+            float p = mi.phase->Sample_p(mi.wo, &wi, uScattering);
+            f = Spectrum(p);
+            scatteringPdf = p;
         }
         // VLOG(2) << "  BSDF / phase sampling f: " << f << ", scatteringPdf: " <<
         //     scatteringPdf;
         if (!f.IsBlack() && scatteringPdf > 0) {
-            // Account for light contributions along sampled direction _wi_
-            float weight = 1;
-            if (!sampledSpecular) {
-                lightPdf = light.Pdf_Li(it, wi);
-                if (lightPdf == 0) return Ld;
-                weight = PowerHeuristic(1, scatteringPdf, 1, lightPdf);
-            }
+            // Nothing reaches the light where it is proven to be occluded
+            if (scene.visibilityCache && !handleMedia &&
+                scene.visibilityCache->Lookup(light, it) ==
+                    LightVisibility::Occluded)
+                return Ld;
 
             // Find intersection and compute transmittance
             SurfaceInteraction lightIsect;
@@ -182,60 +239,285 @@ Spectrum EstimateDirect(const Interaction &it, const Point2f &uScattering,
 
             // Add light contribution from material sampling
             Spectrum Li(0.f);
+            const AreaLight *areaLight = nullptr;
             if (foundSurfaceInteraction) {
-                if (lightIsect.primitive->GetAreaLight() == &light)
+                if (lightIsect.primitive->GetAreaLight() == &light) {
+                    areaLight = lightIsect.primitive->GetAreaLight();
                     Li = lightIsect.Le(-wi);
+                }
             } else
                 Li = light.Le(ray);
-            if (!Li.IsBlack()) Ld += f * Li * Tr * weight / scatteringPdf;
+            if (Li.IsBlack()) return Ld;
+
+            // Weight the contribution against light sampling; a hit on an
+            // area light gives its density without another intersection
+            float weight = 1;
+            if (!sampledSpecular) {
+                lightPdf = areaLight ? areaLight->Pdf_Li(it, wi, lightIsect)
+                                     : light.Pdf_Li(it, wi);
+                if (lightPdf == 0) return Ld;
+                weight = PowerHeuristic(1, scatteringPdf, 1, lightPdf);
+            }
+            Ld += f * Li * Tr * weight / scatteringPdf;
         }
     }
     return Ld;
 }
 
+std::unique_ptr<Distribution1D> ComputeLightPowerDistribution(
+    const Scene &scene) {
+    if (scene.lights.empty()) return nullptr;
+    std::vector<float> lightPower;
+    for (const auto &light : scene.lights)
+        lightPower.push_back(light->Power().y());
+    return std::unique_ptr<Distribution1D>(
+        new Distribution1D(&lightPower[0], (int)lightPower.size(), true));
+}
+
+// ShadowRayBatch Method Definitions
+void ShadowRayBatch::Trace(const Scene &scene, Spectrum *L) {
+    // Order the rays by light with a counting sort
+    int nLights = (int)scene.lights.size();
+    lightOffsets.assign(nLights + 1, 0);
+    for (const Entry &e : entries) ++lightOffsets[e.lightNum + 1];
+    for (int i = 0; i < nLights; ++i) lightOffsets[i + 1] += lightOffsets[i];
+    order.resize(entries.size());
+    for (int i = 0; i < (int)entries.size(); ++i)
+        order[lightOffsets[entries[i].lightNum]++] = i;
+
+    for (int i : order)
+        if (!scene.IntersectP(entries[i].ray))
+            L[entries[i].sample] += entries[i].Ld;
+    entries.clear();
+}
+
+// SamplerIntegrator Local Declarations
+// Camera samples that wait for their shadow rays before they are filtered
+struct PendingSamples {
+    int Size() const { return (int)L.size(); }
+    void Push(const Point2f &p, const Spectrum &l, float w) {
+        pFilm.push_back(p);
+        L.push_back(l);
+        rayWeight.push_back(w);
+    }
+    void Clear() {
+        pFilm.clear();
+        L.clear();
+        rayWeight.clear();
+    }
+
+    std::vector<Point2f> pFilm;
+    std::vector<Spectrum> L;
+    std::vector<float> rayWeight;
+};
+
+// Number of queued shadow rays after which a tile resolves its batch
+static const int shadowRayBatchSize = 4096;
+
+static void ResolvePendingSamples(const Scene &scene,
+                                  ShadowRayBatch *shadowRays,
+                                  PendingSamples *pending,
+                                  FilmTile *filmTile) {
+    shadowRays->Trace(scene, pending->L.data());
+    for (int i = 0; i < pending->Size(); ++i)
+        filmTile->AddSample(pending->pFilm[i], pending->L[i],
+                            pending->rayWeight[i]);
+    pending->Clear();
+}
+
+// Camera sample whose first hit waits to be shaded with those of the other
+// samples of its run
+struct FirstHitSample {
+    Point2i pixel;
+    int64_t sampleNum;
+    Point2f pFilm;
+    RayDifferential ray;
+    float rayWeight;
+    SurfaceInteraction isect;
+};
+
+// Number of camera samples after which a tile shades its first hits
+static const int firstHitBatchSize = 1024;
+
 // void SamplerIntegrator::Render(const Scene &scene) {}
 
 
-// current rendering pipeline, to be changed later...
+// Renders into a plain image through a film with a one-pixel box filter
 void SamplerIntegrator::Render(const Scene &scene, std::vector<Spectrum> &col) {
-    Preprocess(scene, *sampler);
-
     int rasterX = pixelBounds.pMax.x - pixelBounds.pMin.x;
     int rasterY = pixelBounds.pMax.y - pixelBounds.pMin.y;
+    std::unique_ptr<Filter> filter(CreateBoxFilter());
+    Film film(Point2i(rasterX, rasterY), std::move(filter));
 
-    omp_set_num_threads(4);
-    #pragma omp parallel for
-    {
-    for (size_t i = 0; i < rasterX; ++i) {
-        for (size_t j = 0; j < rasterY; ++j) {
-            int offset = (i + rasterX * j);
-            std::unique_ptr<Sampler> pixel_sampler = sampler->Clone(offset);
-
-            Point2i pixel(i, j);
-            pixel_sampler->StartPixel(pixel);
-            Spectrum colObj(0.0f);
+    Render(scene, film);
+    film.GetImage(col);
+}
 
-            do {
-                CameraSample cs = pixel_sampler->GetCameraSample(pixel);
+void SamplerIntegrator::Render(const Scene &scene, Film &film,
+                               AOVBuffers *aovs) {
+    Preprocess(scene, *sampler);
 
-                Ray r;
-                camera->GenerateRay(cs, &r);
+    // Compute number of tiles to use for parallel rendering
+    Bounds2i sampleBounds = Intersect(film.GetSampleBounds(), pixelBounds);
+    Vector2i sampleExtent = sampleBounds.Diagonal();
+    const int tileSize = 16;
+    Point2i nTiles((sampleExtent.x + tileSize - 1) / tileSize,
+                   (sampleExtent.y + tileSize - 1) / tileSize);
+    int nTotalTiles = nTiles.x * nTiles.y;
+    float diffScale = 1 / std::sqrt((float)sampler->samplesPerPixel);
+
+    #pragma omp parallel for schedule(dynamic)
+    for (int tile = 0; tile < nTotalTiles; ++tile) {
+        // Render section of image corresponding to _tile_
+        int tileX = tile % nTiles.x, tileY = tile / nTiles.x;
+        std::unique_ptr<Sampler> tileSampler = sampler->Clone(tile);
+
+        // Compute sample bounds for tile
+        int x0 = sampleBounds.pMin.x + tileX * tileSize;
+        int x1 = std::min(x0 + tileSize, sampleBounds.pMax.x);
+        int y0 = sampleBounds.pMin.y + tileY * tileSize;
+        int y1 = std::min(y0 + tileSize, sampleBounds.pMax.y);
+        Bounds2i tileBounds(Point2i(x0, y0), Point2i(x1, y1));
+
+        // Samples are filtered into a private tile and merged once at the end
+        std::unique_ptr<FilmTile> filmTile = film.GetFilmTile(tileBounds);
+
+        // Scattering functions come from an arena that is reset after every
+        // camera sample
+        MemoryArena arena;
+        ScopedThreadArena scopedArena(&arena);
+
+        if (ShadesFirstHitsByMaterial() && !DefersShadowRays() && !aovs) {
+            RenderTileByMaterial(scene, tileBounds, *tileSampler, diffScale,
+                                 &arena, filmTile.get());
+            film.MergeFilmTile(std::move(filmTile));
+            continue;
+        }
 
-                colObj += Li(r, scene, *pixel_sampler, 0);
-                    
-            } while (pixel_sampler->StartNextSample());
+        // In deferred mode samples are held back until their shadow rays
+        // have been traced
+        bool deferShadowRays = DefersShadowRays() && !aovs;
+        ShadowRayBatch shadowRays;
+        PendingSamples pending;
 
-            colObj /= (float)pixel_sampler->samplesPerPixel;
-            col[offset] = colObj;
+        for (Point2i pixel : tileBounds) {
+            tileSampler->StartPixel(pixel);
+            do {
+                CameraSample cameraSample = tileSampler->GetCameraSample(pixel);
+
+                RayDifferential ray;
+                float rayWeight =
+                    camera->GenerateRayDifferential(cameraSample, &ray);
+                ray.ScaleDifferentials(diffScale);
+
+                Spectrum L(0.f);
+                if (rayWeight > 0 && aovs) {
+                    // Pixels belong to a single tile, so AOVs are written
+                    // directly
+                    AOVSample aov;
+                    L = LiAOV(ray, scene, *tileSampler, aovs->channels, &aov);
+                    int offset = (pixel.x - pixelBounds.pMin.x) +
+                                 (pixel.y - pixelBounds.pMin.y) *
+                                     (pixelBounds.pMax.x - pixelBounds.pMin.x);
+                    aovs->AddSample(offset, aov);
+                } else if (rayWeight > 0 && deferShadowRays) {
+                    L = LiDeferred(ray, scene, *tileSampler, &shadowRays,
+                                   pending.Size());
+                } else if (rayWeight > 0)
+                    L = Li(ray, scene, *tileSampler, 0);
+                if (deferShadowRays)
+                    pending.Push(cameraSample.pFilm, L, rayWeight);
+                else
+                    filmTile->AddSample(cameraSample.pFilm, L, rayWeight);
+                arena.Reset();
+            } while (tileSampler->StartNextSample());
+
+            if (shadowRays.Size() >= shadowRayBatchSize)
+                ResolvePendingSamples(scene, &shadowRays, &pending,
+                                      filmTile.get());
         }
-        
-    }
-    }
+        if (deferShadowRays)
+            ResolvePendingSamples(scene, &shadowRays, &pending,
+                                  filmTile.get());
 
+        film.MergeFilmTile(std::move(filmTile));
+    }
 
     std::cout << "Rendering is finished!" << std::endl;
+}
 
-};
+void SamplerIntegrator::RenderTileByMaterial(const Scene &scene,
+                                             const Bounds2i &tileBounds,
+                                             Sampler &tileSampler,
+                                             float diffScale,
+                                             MemoryArena *arena,
+                                             FilmTile *filmTile) const {
+    std::vector<FirstHitSample> batch;
+    std::vector<SurfaceInteraction *> hits;
+    batch.reserve(firstHitBatchSize + tileSampler.samplesPerPixel);
+    // The first hits' BSDFs live until the whole batch is done, so they get
+    // an arena of their own
+    MemoryArena batchArena;
+    auto traceBatch = [&]() {
+        // Shade the first hits by material
+        hits.clear();
+        for (FirstHitSample &s : batch)
+            if (s.isect.primitive) hits.push_back(&s.isect);
+        {
+            ScopedThreadArena scopedArena(&batchArena);
+            ComputeScatteringFunctionsByMaterial(hits.data(), (int)hits.size(),
+                                                 TransportMode::Radiance, true);
+        }
+
+        // Replay each sample's camera dimensions and trace the rest of its
+        // path
+        Point2i pixel(tileBounds.pMin.x - 1, tileBounds.pMin.y);
+        for (FirstHitSample &s : batch) {
+            Spectrum L(0.f);
+            if (s.rayWeight > 0) {
+                if (s.pixel != pixel) {
+                    pixel = s.pixel;
+                    tileSampler.StartPixel(pixel);
+                }
+                tileSampler.SetSampleNumber(s.sampleNum);
+                tileSampler.GetCameraSample(pixel);
+                L = LiShaded(s.ray, &s.isect, scene, tileSampler);
+            }
+            filmTile->AddSample(s.pFilm, L, s.rayWeight);
+            arena->Reset();
+        }
+        batch.clear();
+        batchArena.Reset();
+    };
+
+    for (Point2i pixel : tileBounds) {
+        tileSampler.StartPixel(pixel);
+        int64_t sampleNum = 0;
+        do {
+            // Trace the camera ray up to its first hit
+            batch.emplace_back();
+            FirstHitSample &s = batch.back();
+            CameraSample cameraSample = tileSampler.GetCameraSample(pixel);
+            s.pixel = pixel;
+            s.sampleNum = sampleNum++;
+            s.pFilm = cameraSample.pFilm;
+            s.rayWeight = camera->GenerateRayDifferential(cameraSample, &s.ray);
+            s.ray.ScaleDifferentials(diffScale);
+            if (s.rayWeight > 0 && scene.Intersect(s.ray, &s.isect))
+                s.isect.ComputeDifferentials(s.ray);
+        } while (tileSampler.StartNextSample());
+
+        if ((int)batch.size() >= firstHitBatchSize) traceBatch();
+    }
+    traceBatch();
+}
+
+Spectrum SamplerIntegrator::LiAOV(const RayDifferential &ray,
+                                  const Scene &scene, Sampler &sampler,
+                                  int channels, AOVSample *aov) const {
+    RecordFirstHitAOVs(ray, scene, channels, aov);
+    return Li(ray, scene, sampler, 0);
+}
 
 Spectrum SamplerIntegrator::RenderPixel(const Scene &scene, int i, int j) {
     Spectrum L(0.0f);
@@ -249,6 +531,9 @@ Spectrum SamplerIntegrator::RenderPixel(const Scene &scene, int i, int j) {
     Point2i pixel(i, j);
     pixel_sampler->StartPixel(pixel);
 
+    MemoryArena arena;
+    ScopedThreadArena scopedArena(&arena);
+
     do {
         CameraSample cameraSample = pixel_sampler->GetCameraSample(pixel);
 
@@ -259,6 +544,7 @@ Spectrum SamplerIntegrator::RenderPixel(const Scene &scene, int i, int j) {
 
         if (rayWeight > 0)
             L += Li(ray, scene, *pixel_sampler, 0);
+        arena.Reset();
         
     } while (pixel_sampler->StartNextSample());
 
@@ -267,11 +553,148 @@ Spectrum SamplerIntegrator::RenderPixel(const Scene &scene, int i, int j) {
     return L;
 }
 
+void SamplerIntegrator::RenderProgressive(const Scene &scene,
+                                          const ProgressiveOptions &options,
+                                          std::vector<Spectrum> &col,
+                                          AOVBuffers *aovs) {
+    Preprocess(scene, *sampler);
+
+    int rasterX = pixelBounds.pMax.x - pixelBounds.pMin.x;
+    int rasterY = pixelBounds.pMax.y - pixelBounds.pMin.y;
+    int64_t spp = sampler->samplesPerPixel;
+    float diffScale = 1 / std::sqrt((float)spp);
+
+    AccumulationBuffer buffer(Point2i(rasterX, rasterY));
+    bool checkpointing = !options.checkpointFile.empty();
+    if (checkpointing && buffer.ReadCheckpoint(options.checkpointFile))
+        std::cout << "Resuming from \"" << options.checkpointFile << "\" at "
+                  << buffer.MinSamples() << " spp" << std::endl;
+
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point startTime = Clock::now(), lastCheckpoint = startTime;
+    auto seconds = [](Clock::time_point from) {
+        return std::chrono::duration<float>(Clock::now() - from).count();
+    };
+    std::atomic<bool> outOfTime(false);
+
+    // In adaptive mode the uniform passes stop at _adaptiveBaseSamples_;
+    // afterwards only pixels whose estimate is still noisy get samples
+    bool adaptive = options.adaptiveThreshold > 0;
+    int64_t uniformSamples =
+        adaptive ? std::min(spp, std::max((int64_t)1, options.adaptiveBaseSamples))
+                 : spp;
+    int nPixels = rasterX * rasterY;
+    std::vector<int64_t> passEnd(nPixels);
+
+    int64_t passSamples = 1;
+    while (!outOfTime) {
+        // Choose how many samples each pixel should have after this pass
+        int64_t minSamples = buffer.MinSamples();
+        int nActive = 0;
+        for (int offset = 0; offset < nPixels; ++offset) {
+            int64_t n = buffer.nSamples[offset];
+            if (minSamples < uniformSamples)
+                // Pixels that are ahead after an interrupted pass just take
+                // fewer samples
+                passEnd[offset] = std::max(
+                    n, std::min(uniformSamples, minSamples + passSamples));
+            else if (adaptive && n < spp &&
+                     buffer.RelativeError(offset) > options.adaptiveThreshold)
+                // Double the sample count of pixels above the error threshold
+                passEnd[offset] = std::min(
+                    spp, n + std::min(n, options.maxPassSamples));
+            else
+                passEnd[offset] = n;
+            if (passEnd[offset] > n) ++nActive;
+        }
+        if (nActive == 0) break;
+
+        #pragma omp parallel for schedule(dynamic)
+        for (int j = 0; j < rasterY; ++j) {
+            if (outOfTime) continue;
+            if (options.timeBudget > 0 && seconds(startTime) > options.timeBudget) {
+                outOfTime = true;
+                continue;
+            }
+
+            std::unique_ptr<Sampler> rowSampler = sampler->Clone(j);
+            MemoryArena arena;
+            ScopedThreadArena scopedArena(&arena);
+            for (int i = 0; i < rasterX; ++i) {
+                int offset = i + rasterX * j;
+                if (buffer.nSamples[offset] >= passEnd[offset]) continue;
+                Point2i pixel(pixelBounds.pMin.x + i, pixelBounds.pMin.y + j);
+                rowSampler->StartPixel(pixel);
+
+                // The pixel's sample count is the index of its next sample
+                while (buffer.nSamples[offset] < passEnd[offset]) {
+                    rowSampler->SetSampleNumber(buffer.nSamples[offset]);
+                    CameraSample cameraSample = rowSampler->GetCameraSample(pixel);
+
+                    RayDifferential ray;
+                    float rayWeight =
+                        camera->GenerateRayDifferential(cameraSample, &ray);
+                    ray.ScaleDifferentials(diffScale);
+
+                    Spectrum L(0.f);
+                    if (rayWeight > 0 && aovs) {
+                        AOVSample aov;
+                        L = LiAOV(ray, scene, *rowSampler, aovs->channels, &aov);
+                        aovs->AddSample(offset, aov);
+                    } else if (rayWeight > 0)
+                        L = Li(ray, scene, *rowSampler, 0);
+                    buffer.AddSample(offset, L);
+                    arena.Reset();
+                }
+            }
+        }
+
+        std::cout << "Pass finished: " << nActive << " pixels sampled, "
+                  << buffer.MeanSamples() << " spp on average after "
+                  << seconds(startTime) << "s" << std::endl;
+        passSamples = std::min(2 * passSamples, options.maxPassSamples);
+
+        if (checkpointing && seconds(lastCheckpoint) > options.checkpointInterval) {
+            buffer.WriteCheckpoint(options.checkpointFile);
+            lastCheckpoint = Clock::now();
+        }
+    }
+
+    // Always leave a checkpoint of the final state behind
+    if (checkpointing) buffer.WriteCheckpoint(options.checkpointFile);
+    buffer.Resolve(col);
+
+    if (outOfTime)
+        std::cout << "Time budget exhausted, stopped at "
+                  << buffer.MeanSamples() << " spp on average" << std::endl;
+    std::cout << "Rendering is finished!" << std::endl;
+}
+
 Spectrum SamplerIntegrator::SpecularReflect(
     const RayDifferential &ray, const SurfaceInteraction &isect,
     const Scene &scene, Sampler &sampler, 
     // MemoryArena &arena, 
     int depth) const {
+    RayDifferential rd;
+    Spectrum beta = SampleSpecularReflect(ray, isect, sampler, &rd);
+    if (beta.IsBlack()) return Spectrum(0.f);
+    return beta * Li(rd, scene, sampler, depth + 1);
+}
+
+Spectrum SamplerIntegrator::SpecularTransmit(
+    const RayDifferential &ray, const SurfaceInteraction &isect,
+    const Scene &scene, Sampler &sampler, 
+    // MemoryArena &arena, 
+    int depth) const {
+    RayDifferential rd;
+    Spectrum beta = SampleSpecularTransmit(ray, isect, sampler, &rd);
+    if (beta.IsBlack()) return Spectrum(0.f);
+    return beta * Li(rd, scene, sampler, depth + 1);
+}
+
+Spectrum SampleSpecularReflect(const RayDifferential &ray,
+                               const SurfaceInteraction &isect,
+                               Sampler &sampler, RayDifferential *rdOut) {
     // Compute specular reflection direction _wi_ and BSDF value
     Vector3f wo = isect.wo, wi;
     float pdf;
@@ -301,16 +724,15 @@ Spectrum SamplerIntegrator::SpecularReflect(
             rd.ryDirection =
                 wi - dwody + 2.f * Vector3f(Dot(wo, ns) * dndy + dDNdy * ns);
         }
-        return f * Li(rd, scene, sampler, depth + 1) * AbsDot(wi, ns) / pdf;
+        *rdOut = rd;
+        return f * AbsDot(wi, ns) / pdf;
     } else
         return Spectrum(0.f);
 }
 
-Spectrum SamplerIntegrator::SpecularTransmit(
-    const RayDifferential &ray, const SurfaceInteraction &isect,
-    const Scene &scene, Sampler &sampler, 
-    // MemoryArena &arena, 
-    int depth) const {
+Spectrum SampleSpecularTransmit(const RayDifferential &ray,
+                                const SurfaceInteraction &isect,
+                                Sampler &sampler, RayDifferential *rdOut) {
     Vector3f wo = isect.wo, wi;
     float pdf;
     const Point3f &p = isect.p;
@@ -383,9 +805,36 @@ Spectrum SamplerIntegrator::SpecularTransmit(
             rd.ryDirection =
                 wi - eta * dwody + Vector3f(mu * dndy + dmudy * ns);
         }
-        L = f * Li(rd, scene, sampler, depth + 1) * AbsDot(wi, ns) / pdf;
+        *rdOut = rd;
+        L = f * AbsDot(wi, ns) / pdf;
     }
     return L;
 }
 
+bool FollowSpecular(SpecularPath *path, const SurfaceInteraction &isect,
+                    Sampler &sampler, SpecularStack *stack) {
+    RayDifferential rdR, rdT;
+    Spectrum betaR = SampleSpecularReflect(path->ray, isect, sampler, &rdR);
+    Spectrum betaT = SampleSpecularTransmit(path->ray, isect, sampler, &rdT);
+    int depth = path->depth + 1;
+    if (betaR.IsBlack() && betaT.IsBlack()) return false;
+    if (betaT.IsBlack()) {
+        *path = {rdR, path->beta * betaR, depth};
+    } else if (betaR.IsBlack()) {
+        *path = {rdT, path->beta * betaT, depth};
+    } else if (!stack->Full()) {
+        stack->Push({rdT, path->beta * betaT, depth});
+        *path = {rdR, path->beta * betaR, depth};
+    } else {
+        // Follow one of the two paths, chosen by throughput
+        float yR = std::max(betaR.y(), 0.f), yT = std::max(betaT.y(), 0.f);
+        float pR = (yR + yT > 0) ? yR / (yR + yT) : 0.5f;
+        if (sampler.Get1D() < pR)
+            *path = {rdR, path->beta * betaR / pR, depth};
+        else
+            *path = {rdT, path->beta * betaT / (1 - pR), depth};
+    }
+    return true;
+}
+
 }
\ No newline at end of file
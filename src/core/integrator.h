@@ -8,6 +8,8 @@
 #include "reflection.h"
 #include "sampler.h"
 #include "material.h"
+#include "progressive.h"
+#include "aov.h"
 
 namespace PBRender {
 
@@ -20,6 +22,43 @@ class Integrator {
         virtual void Render(const Scene &scene, std::vector<Spectrum> &col) = 0;
 };
 
+// Light-sampling contribution whose shadow ray has not been traced yet. When
+// one is passed to _UniformSampleOneLight()_ the occlusion test is left to
+// the caller; _Ld_ holds the unoccluded contribution and is black if there
+// is nothing to test, and _lightNum_ is the index of the sampled light.
+struct DeferredShadowRay {
+    Ray ray;
+    Spectrum Ld = Spectrum(0.f);
+    int lightNum = -1;
+};
+
+// ShadowRayBatch Declarations
+// Deferred shadow rays of many camera samples. _Trace()_ groups them by the
+// light they were sampled from, so rays toward the same light, which take
+// similar routes through the acceleration structure, are traced one after
+// another, and adds the contributions of the unoccluded ones to their
+// samples.
+class ShadowRayBatch {
+    public:
+        int Size() const { return (int)entries.size(); }
+        void Push(const DeferredShadowRay &shadow, const Spectrum &beta,
+                  int sample) {
+            entries.push_back({shadow.ray, beta * shadow.Ld, sample,
+                               shadow.lightNum});
+        }
+        void Trace(const Scene &scene, Spectrum *L);
+
+    private:
+        // ShadowRayBatch Private Data
+        struct Entry {
+            Ray ray;
+            Spectrum Ld;
+            int sample, lightNum;
+        };
+        std::vector<Entry> entries;
+        std::vector<int> order, lightOffsets;
+};
+
 Spectrum UniformSampleAllLights(const Interaction &it, 
                                 const Scene &scene,
                                 // MemoryArena &arena, 
@@ -32,14 +71,72 @@ Spectrum UniformSampleOneLight(const Interaction &it,
                             //    MemoryArena &arena, 
                                Sampler &sampler,
                                bool handleMedia = false,
-                               const Distribution1D *lightDistrib = nullptr);
+                               const Distribution1D *lightDistrib = nullptr,
+                               DeferredShadowRay *deferred = nullptr);
+
+// Chooses the light with _lightDistrib_'s point-dependent _Sample()_
+Spectrum UniformSampleOneLight(const Interaction &it, const Scene &scene,
+                               Sampler &sampler,
+                               const LightDistribution &lightDistrib,
+                               bool handleMedia = false,
+                               DeferredShadowRay *deferred = nullptr);
+
+std::unique_ptr<Distribution1D> ComputeLightPowerDistribution(
+    const Scene &scene);
 
 Spectrum EstimateDirect(const Interaction &it, const Point2f &uShading,
                         const Light &light, const Point2f &uLight,
                         const Scene &scene, Sampler &sampler,
                         // MemoryArena &arena, 
                         bool handleMedia = false,
-                        bool specular = false);
+                        bool specular = false,
+                        DeferredShadowRay *deferred = nullptr);
+
+// Samples the specular reflection (or transmission) of _isect_'s BSDF and
+// returns the path throughput factor $f \cos\theta / p$, which is black if
+// there is nothing to follow. The outgoing ray, with differentials when
+// _ray_ has them, is stored in _rd_.
+Spectrum SampleSpecularReflect(const RayDifferential &ray,
+                               const SurfaceInteraction &isect,
+                               Sampler &sampler, RayDifferential *rd);
+
+Spectrum SampleSpecularTransmit(const RayDifferential &ray,
+                                const SurfaceInteraction &isect,
+                                Sampler &sampler, RayDifferential *rd);
+
+// SpecularStack Declarations
+// Specular path of the iterative Whitted style integrators: a ray with its
+// differentials, the throughput it carries and its depth
+struct SpecularPath {
+    RayDifferential ray;
+    Spectrum beta;
+    int depth;
+};
+
+// Fixed-capacity stack of the specular paths that still have to be traced,
+// so that deep mirror and glass recursions neither grow the call stack nor
+// allocate
+class SpecularStack {
+    public:
+        static const int Capacity = 32;
+
+        bool Empty() const { return size == 0; }
+        bool Full() const { return size == Capacity; }
+        void Push(const SpecularPath &path) { paths[size++] = path; }
+        const SpecularPath &Pop() { return paths[--size]; }
+
+    private:
+        SpecularPath paths[Capacity];
+        int size = 0;
+};
+
+// Continues _path_ along the specular reflection and transmission at
+// _isect_: _path_ follows one of them and the other is pushed onto _stack_.
+// If the stack is full, only one of the two is followed, chosen with
+// probability proportional to its throughput and reweighted accordingly.
+// Returns false if neither carries light.
+bool FollowSpecular(SpecularPath *path, const SurfaceInteraction &isect,
+                    Sampler &sampler, SpecularStack *stack);
 
 // SamplerIntegrator Declarations
 class SamplerIntegrator : public Integrator {
@@ -47,21 +144,67 @@ class SamplerIntegrator : public Integrator {
         SamplerIntegrator(std::shared_ptr<const Camera> camera,
                           std::shared_ptr<Sampler> sampler,
                           const Bounds2i &pixelBounds)
-            : camera(camera), sampler(sampler), pixelBounds(pixelBounds) {}
+            : camera(camera), pixelBounds(pixelBounds), sampler(sampler) {}
 
         virtual void Preprocess(const Scene &scene, Sampler &sampler) {}
 
         // void Render(const Scene &scene);
         void Render(const Scene &scene, std::vector<Spectrum> &col);
+        // Renders the image in tiles, each filtered into a private _FilmTile_,
+        // and records the channels of _aovs_ from the same camera samples
+        void Render(const Scene &scene, Film &film, AOVBuffers *aovs = nullptr);
 
         // current setting for openmp
         Spectrum RenderPixel(const Scene &scene, int i, int j);
 
+        // Renders in passes of growing sample counts until every pixel has
+        // _samplesPerPixel_ samples (or, in adaptive mode, is below the error
+        // threshold) or the time budget runs out, resuming from and
+        // periodically writing _options.checkpointFile_. AOVs are recorded
+        // for the samples taken by this call only; they are not checkpointed.
+        void RenderProgressive(const Scene &scene,
+                               const ProgressiveOptions &options,
+                               std::vector<Spectrum> &col,
+                               AOVBuffers *aovs = nullptr);
+
         virtual Spectrum Li(const RayDifferential &ray, const Scene &scene,
                             Sampler &sampler, 
                             // MemoryArena &arena,
                             int depth = 0) const = 0;
 
+        // Whether _Render()_ traces camera rays with _LiDeferred()_ and
+        // resolves their shadow rays in batches per tile
+        virtual bool DefersShadowRays() const { return false; }
+
+        // Radiance along a camera ray without the light samples whose shadow
+        // rays were queued on _shadowRays_ for camera sample _sample_
+        virtual Spectrum LiDeferred(const RayDifferential &ray,
+                                    const Scene &scene, Sampler &sampler,
+                                    ShadowRayBatch *shadowRays,
+                                    int sample) const {
+            return Li(ray, scene, sampler, 0);
+        }
+
+        // Whether _Render()_ intersects the camera rays of several pixels
+        // before shading any of them, so that their first hits are shaded in
+        // per-material batches, and finishes the paths with _LiShaded()_
+        virtual bool ShadesFirstHitsByMaterial() const { return false; }
+
+        // Radiance along a camera ray whose first hit _isect_ already has
+        // its scattering functions; _isect_ has a null primitive if the ray
+        // escaped
+        virtual Spectrum LiShaded(const RayDifferential &ray,
+                                  SurfaceInteraction *isect,
+                                  const Scene &scene, Sampler &sampler) const {
+            return Li(ray, scene, sampler, 0);
+        }
+
+        // Radiance along a camera ray that also fills the AOV channels of
+        // _channels_; the default traces the first hit separately
+        virtual Spectrum LiAOV(const RayDifferential &ray, const Scene &scene,
+                               Sampler &sampler, int channels,
+                               AOVSample *aov) const;
+
         Spectrum SpecularReflect(const RayDifferential &ray,
                                  const SurfaceInteraction &isect,
                                  const Scene &scene, Sampler &sampler,
@@ -77,11 +220,20 @@ class SamplerIntegrator : public Integrator {
     protected:
         // SamplerIntegrator Protected Data
         std::shared_ptr<const Camera> camera;
+        const Bounds2i pixelBounds;
     
     private:
+        // SamplerIntegrator Private Methods
+        // Renders the pixels of _tileBounds_ in runs whose first hits are
+        // shaded by material before the paths are traced further
+        void RenderTileByMaterial(const Scene &scene,
+                                  const Bounds2i &tileBounds,
+                                  Sampler &tileSampler, float diffScale,
+                                  MemoryArena *arena,
+                                  FilmTile *filmTile) const;
+
         // SamplerIntegrator Private Data
         std::shared_ptr<Sampler> sampler;
-        const Bounds2i pixelBounds;
 };
 
 }
\ No newline at end of file
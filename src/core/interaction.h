@@ -3,7 +3,7 @@
 #include "PBRender.h"
 #include "geometry.h"
 #include "transform.h"
-// #include "medium.h"
+#include "medium.h"
 #include "material.h"
 
 namespace PBRender {
@@ -11,53 +11,49 @@ namespace PBRender {
 struct Interaction {
     Interaction() : time(0) {}
     Interaction(const Point3f &p, const Normal3f &n, const Vector3f &pError,
-                const Vector3f &wo, float time)
+                const Vector3f &wo, float time,
+                const MediumInterface &mediumInterface = MediumInterface())
         : p(p),
           time(time),
 		  pError(pError),
           wo(Normalize(wo)),
-          n(n) {}
+          n(n),
+          mediumInterface(mediumInterface) {}
 	
-	Interaction(const Point3f &p, const Vector3f &wo, float time
-                // const MediumInterface &mediumInterface
-				)
-        : p(p), time(time), wo(wo)
-		//   mediumInterface(mediumInterface) 
-		{}
-    Interaction(const Point3f &p, float time
-                // const MediumInterface &mediumInterface
-				)
-        : p(p), time(time)
-		//   mediumInterface(mediumInterface) 
-		{}
+	Interaction(const Point3f &p, const Vector3f &wo, float time,
+                const MediumInterface &mediumInterface = MediumInterface())
+        : p(p), time(time), wo(wo), mediumInterface(mediumInterface) {}
+    Interaction(const Point3f &p, float time,
+                const MediumInterface &mediumInterface = MediumInterface())
+        : p(p), time(time), mediumInterface(mediumInterface) {}
 	
 	bool IsSurfaceInteraction() const { return n != Normal3f(); }
 	bool IsMediumInteraction() const { return !IsSurfaceInteraction(); }
 
 	Ray SpawnRay(const Vector3f &d) const {
         Point3f o = OffsetRayOrigin(p, pError, n, d);
-        return Ray(o, d, Infinity, time);
+        return Ray(o, d, Infinity, time, GetMedium(d));
     }
 
 	Ray SpawnRayTo(const Point3f &p2) const {
         Point3f origin = OffsetRayOrigin(p, pError, n, p2 - p);
         Vector3f d = p2 - p;
-        return Ray(origin, d, 1 - ShadowEpsilon, time);
+        return Ray(origin, d, 1 - ShadowEpsilon, time, GetMedium(d));
     }
 	Ray SpawnRayTo(const Interaction &it) const {
         Point3f origin = OffsetRayOrigin(p, pError, n, it.p - p);
         Point3f target = OffsetRayOrigin(it.p, it.pError, it.n, origin - it.p);
         Vector3f d = target - origin;
-        return Ray(origin, d, 1 - ShadowEpsilon, time);
+        return Ray(origin, d, 1 - ShadowEpsilon, time, GetMedium(d));
     }
 
-	// const Medium *GetMedium(const Vector3f &w) const {
-    //     return Dot(w, n) > 0 ? mediumInterface.outside : mediumInterface.inside;
-    // }
-    // const Medium *GetMedium() const {
-    //     CHECK_EQ(mediumInterface.inside, mediumInterface.outside);
-    //     return mediumInterface.inside;
-    // }
+	const Medium *GetMedium(const Vector3f &w) const {
+        return Dot(w, n) > 0 ? mediumInterface.outside : mediumInterface.inside;
+    }
+    const Medium *GetMedium() const {
+        assert(mediumInterface.inside == mediumInterface.outside);
+        return mediumInterface.inside;
+    }
 
     // Interaction Public Data
     Point3f p;
@@ -65,6 +61,7 @@ struct Interaction {
 	Vector3f pError;
     Vector3f wo;
     Normal3f n;
+    MediumInterface mediumInterface;
 };
 
 class SurfaceInteraction : public Interaction {
@@ -112,7 +109,17 @@ class SurfaceInteraction : public Interaction {
 };
 
 class MediumInteraction : public Interaction {
+    public:
+        MediumInteraction() : phase(nullptr) {}
+        MediumInteraction(const Point3f &p, const Vector3f &wo, float time,
+                          const Medium *medium,
+                          std::shared_ptr<PhaseFunction> phase)
+            : Interaction(p, wo, time, MediumInterface(medium)),
+              phase(phase) {}
+        bool IsValid() const { return phase != nullptr; }
 
+    public:
+        std::shared_ptr<PhaseFunction> phase;
 };
 
 }
\ No newline at end of file
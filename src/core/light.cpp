@@ -23,29 +23,96 @@ Light::~Light() {}
 
 Spectrum Light::Le(const RayDifferential &ray) const { return Spectrum(0.f); }
 
+// LightBounds Method Definitions
+float LightBounds::Importance(const Point3f &p, const Normal3f &n) const {
+    // Return importance for light bounds at reference point
+    // Compute clamped squared distance to reference point
+    Point3f pc = Centroid();
+    float d2 = DistanceSquared(p, pc);
+    d2 = std::max(d2, bounds.Diagonal().Length() / 2);
+
+    // Define cosine and sine clamped subtraction lambdas
+    auto cosSubClamped = [](float sinTheta_a, float cosTheta_a,
+                            float sinTheta_b, float cosTheta_b) -> float {
+        if (cosTheta_a > cosTheta_b) return 1;
+        return cosTheta_a * cosTheta_b + sinTheta_a * sinTheta_b;
+    };
+    auto sinSubClamped = [](float sinTheta_a, float cosTheta_a,
+                            float sinTheta_b, float cosTheta_b) -> float {
+        if (cosTheta_a > cosTheta_b) return 0;
+        return sinTheta_a * cosTheta_b - cosTheta_a * sinTheta_b;
+    };
+
+    // Compute sine and cosine of angle to vector _w_, $\theta_\roman{w}$
+    Vector3f wi = Normalize(p - pc);
+    float cosTheta_w = Dot(w, wi);
+    if (twoSided) cosTheta_w = std::abs(cosTheta_w);
+    float sinTheta_w = SafeSqrt(1 - cosTheta_w * cosTheta_w);
+
+    // Compute $\cos\,\theta_\roman{\+b}$ for reference point
+    float cosTheta_b = BoundSubtendedDirections(bounds, p).cosTheta;
+    float sinTheta_b = SafeSqrt(1 - cosTheta_b * cosTheta_b);
+
+    // Compute $\cos\,\theta'$ and test against $\cos\,\theta_\roman{e}$
+    float sinTheta_o = SafeSqrt(1 - cosTheta_o * cosTheta_o);
+    float cosTheta_x =
+        cosSubClamped(sinTheta_w, cosTheta_w, sinTheta_o, cosTheta_o);
+    float sinTheta_x =
+        sinSubClamped(sinTheta_w, cosTheta_w, sinTheta_o, cosTheta_o);
+    float cosThetap =
+        cosSubClamped(sinTheta_x, cosTheta_x, sinTheta_b, cosTheta_b);
+    if (cosThetap <= cosTheta_e) return 0;
+
+    // Return final importance at reference point
+    float importance = phi * cosThetap / d2;
+    // Account for $\cos\theta_\roman{i}$ in importance at surfaces
+    if (n != Normal3f(0, 0, 0)) {
+        float cosTheta_i = AbsDot(wi, n);
+        float sinTheta_i = SafeSqrt(1 - cosTheta_i * cosTheta_i);
+        float cosThetap_i =
+            cosSubClamped(sinTheta_i, cosTheta_i, sinTheta_b, cosTheta_b);
+        importance *= cosThetap_i;
+    }
+    return std::max(importance, 0.f);
+}
+
+LightBounds Union(const LightBounds &a, const LightBounds &b) {
+    // If one _LightBounds_ has zero power, return the other
+    if (a.phi == 0) return b;
+    if (b.phi == 0) return a;
+
+    // Find average direction and updated angles for _LightBounds_
+    DirectionCone cone = Union(DirectionCone(a.w, a.cosTheta_o),
+                               DirectionCone(b.w, b.cosTheta_o));
+    float cosTheta_o = cone.cosTheta;
+    float cosTheta_e = std::min(a.cosTheta_e, b.cosTheta_e);
+
+    return LightBounds(Union(a.bounds, b.bounds), cone.w, a.phi + b.phi,
+                       cosTheta_o, cosTheta_e, a.twoSided | b.twoSided);
+}
+
 bool VisibilityTester::Unoccluded(const Scene &scene) const {
     return !scene.IntersectP(p0.SpawnRayTo(p1));
 }
 
 Spectrum VisibilityTester::Tr(const Scene &scene, Sampler &sampler) const {
-    // Ray ray(p0.SpawnRayTo(p1));
-    // Spectrum Tr(1.f);
-    // while (true) {
-    //     SurfaceInteraction isect;
-    //     bool hitSurface = scene.Intersect(ray, &isect);
-    //     // Handle opaque surface along ray's path
-    //     if (hitSurface && isect.primitive->GetMaterial() != nullptr)
-    //         return Spectrum(0.0f);
-
-    //     // Update transmittance for current ray segment
-    //     if (ray.medium) Tr *= ray.medium->Tr(ray, sampler);
-
-    //     // Generate next ray segment or return final transmittance
-    //     if (!hitSurface) break;
-    //     ray = isect.SpawnRayTo(p1);
-    // }
-    // return Tr;
-    return Spectrum(0.0f);
+    Ray ray(p0.SpawnRayTo(p1));
+    Spectrum Tr(1.f);
+    while (true) {
+        SurfaceInteraction isect;
+        bool hitSurface = scene.Intersect(ray, &isect);
+        // Handle opaque surface along ray's path
+        if (hitSurface && isect.primitive->GetMaterial() != nullptr)
+            return Spectrum(0.0f);
+
+        // Update transmittance for current ray segment
+        if (ray.medium) Tr *= ray.medium->Tr(ray, sampler);
+
+        // Generate next ray segment or return final transmittance
+        if (!hitSurface) break;
+        ray = isect.SpawnRayTo(p1);
+    }
+    return Tr;
 }
 
 // AreaLight
@@ -20,6 +20,38 @@ inline bool IsDeltaLight(int flags) {
            flags & (int)LightFlags::DeltaDirection;
 }
 
+// LightBounds Declarations
+// Conservative description of where a light emits from and in which
+// directions: the emitters lie in _bounds_ with total power _phi_, their
+// surface normals lie within _cosTheta_o_ of _w_, and each point emits
+// within _cosTheta_e_ of its normal.
+struct LightBounds {
+    LightBounds() {}
+    LightBounds(const Bounds3f &b, const Vector3f &w, float phi,
+                float cosTheta_o, float cosTheta_e, bool twoSided)
+        : bounds(b),
+          w(Normalize(w)),
+          phi(phi),
+          cosTheta_o(cosTheta_o),
+          cosTheta_e(cosTheta_e),
+          twoSided(twoSided) {}
+
+    Point3f Centroid() const { return (bounds.pMin + bounds.pMax) / 2; }
+
+    // Conservative estimate of the light's contribution at point _p_ with
+    // surface normal _n_ (or zero normal for points in media)
+    float Importance(const Point3f &p, const Normal3f &n) const;
+
+    // LightBounds Public Data
+    Bounds3f bounds;
+    Vector3f w;
+    float phi = 0;
+    float cosTheta_o, cosTheta_e;
+    bool twoSided;
+};
+
+LightBounds Union(const LightBounds &a, const LightBounds &b);
+
 class Light {
     public:
         Light(int flags, const Transform &LightToWorld,
@@ -31,6 +63,9 @@ class Light {
                                    Vector3f *wi, float *pdf,
                                    VisibilityTester *vis) const = 0;
         virtual Spectrum Power() const = 0;
+        // Returns false for lights that can't be bounded in space, such as
+        // infinite lights
+        virtual bool Bounds(LightBounds *bounds) const { return false; }
         virtual void Preprocess(const Scene &scene) {}
         virtual Spectrum Le(const RayDifferential &r) const;
         virtual float Pdf_Li(const Interaction &ref, const Vector3f &wi) const = 0;
@@ -74,6 +109,11 @@ class AreaLight : public Light {
                   int nSamples);
         
         virtual Spectrum L(const Interaction &intr, const Vector3f &w) const = 0;
+        // _Pdf_Li()_ for the point _pLight_ that the ray from _ref_ along _wi_
+        // hits on the light's shape
+        virtual float Pdf_Li(const Interaction &ref, const Vector3f &wi,
+                             const Interaction &pLight) const = 0;
+        using Light::Pdf_Li;
 };
 
 }
\ No newline at end of file
@@ -1,36 +1,49 @@
 #include "lightdistrib.h"
 #include "lowdiscrepancy.h"
-// #include "parallel.h"
 #include "scene.h"
-// #include "stats.h"
 #include "integrator.h"
 
+#include "omp.h"
+
+#include <algorithm>
+#include <numeric>
+
 namespace PBRender {
 
 LightDistribution::~LightDistribution() {}
 
+int LightDistribution::Sample(const Interaction &ref, float u,
+                              float *pmf) const {
+    return Lookup(ref.p)->SampleDiscrete(u, pmf);
+}
+
+float LightDistribution::Pmf(const Interaction &ref, int lightIndex) const {
+    return Lookup(ref.p)->DiscretePDF(lightIndex);
+}
+
 std::unique_ptr<LightDistribution> CreateLightSampleDistribution(
     const std::string &name, const Scene &scene) {
     if (name == "uniform" || scene.lights.size() == 1)
         return std::unique_ptr<LightDistribution>{
             new UniformLightDistribution(scene)};
-    // else if (name == "power")
-    //     return std::unique_ptr<LightDistribution>{
-    //         new PowerLightDistribution(scene)};
-    // else if (name == "spatial")
-    //     return std::unique_ptr<LightDistribution>{
-    //         new SpatialLightDistribution(scene)};
-    // else {
-    //     // Error(
-    //     //     "Light sample distribution type \"%s\" unknown. Using \"spatial\".",
-    //     //     name.c_str());
-    //     std::cerr << "Light sample distribution type " << name << " unknown. Using \"spatial\"."
-    //               << std::endl;
-    //     return std::unique_ptr<LightDistribution>{
-    //         new SpatialLightDistribution(scene)};
-    // }
-    return std::unique_ptr<LightDistribution>{
-            new UniformLightDistribution(scene)};
+    else if (name == "power")
+        return std::unique_ptr<LightDistribution>{
+            new PowerLightDistribution(scene)};
+    else if (name == "spatial")
+        return std::unique_ptr<LightDistribution>{
+            new SpatialLightDistribution(scene)};
+    else if (name == "spatial-prefill")
+        return std::unique_ptr<LightDistribution>{
+            new SpatialLightDistribution(scene, 64, true)};
+    else if (name == "bvh")
+        return std::unique_ptr<LightDistribution>{
+            new BVHLightDistribution(scene)};
+    else {
+        std::cerr << "Light sample distribution type \"" << name
+                  << "\" unknown. Using \"spatial\"." << std::endl;
+        return std::unique_ptr<LightDistribution>{
+            new SpatialLightDistribution(scene)};
+    }
 }
 
 UniformLightDistribution::UniformLightDistribution(const Scene &scene) {
@@ -42,11 +55,415 @@ const Distribution1D *UniformLightDistribution::Lookup(const Point3f &p) const {
     return distrib.get();
 }
 
-// PowerLightDistribution::PowerLightDistribution(const Scene &scene)
-//     : distrib(ComputeLightPowerDistribution(scene)) {}
+PowerLightDistribution::PowerLightDistribution(const Scene &scene)
+    : distrib(ComputeLightPowerDistribution(scene)) {}
+
+const Distribution1D *PowerLightDistribution::Lookup(const Point3f &p) const {
+    return distrib.get();
+}
+
+// SpatialLightDistribution
+
+// Voxel coordinates are packed into a uint64_t for hash table lookups;
+// 20 bits are allocated to each coordinate.  invalidPackedPos is an impossible
+// packed coordinate value, which we use to represent unused hash table
+// entries.
+static const uint64_t invalidPackedPos = 0xffffffffffffffff;
+
+SpatialLightDistribution::SpatialLightDistribution(const Scene &scene,
+                                                   int maxVoxels, bool prefill)
+    : scene(scene) {
+    // Compute the number of voxels so that the widest scene bounding box
+    // dimension has maxVoxels voxels and the other dimensions have a number
+    // of voxels so that voxels are roughly cube shaped.
+    Bounds3f b = scene.WorldBound();
+    Vector3f diag = b.Diagonal();
+    float bmax = diag[b.MaximumExtent()];
+    for (int i = 0; i < 3; ++i) {
+        nVoxels[i] = std::max(1, int(std::round(diag[i] / bmax * maxVoxels)));
+        // In the Lookup() method, we require that 20 or fewer bits be
+        // sufficient to represent each coordinate value. It's fairly hard
+        // to imagine that this would ever be a problem.
+        assert(nVoxels[i] <= 1 << 20);
+    }
+
+    hashTableSize = 4 * nVoxels[0] * nVoxels[1] * nVoxels[2];
+    hashTable.reset(new HashEntry[hashTableSize]);
+    for (size_t i = 0; i < hashTableSize; ++i) {
+        hashTable[i].packedPos.store(invalidPackedPos);
+        hashTable[i].distribution.store(nullptr);
+    }
+    if (prefill) Prefill();
+}
+
+SpatialLightDistribution::~SpatialLightDistribution() {
+    for (size_t i = 0; i < hashTableSize; ++i) {
+        HashEntry &entry = hashTable[i];
+        if (entry.distribution.load()) delete entry.distribution.load();
+    }
+}
+
+const Distribution1D *SpatialLightDistribution::Lookup(const Point3f &p) const {
+    // First, compute integer voxel coordinates for the given point |p|
+    // with respect to the overall voxel grid.
+    Vector3f offset = scene.WorldBound().Offset(p);  // offset in [0,1].
+    Point3i pi;
+    for (int i = 0; i < 3; ++i)
+        // The clamp should almost never be necessary, but is there to be
+        // robust to computed intersection points being slightly outside
+        // the scene bounds due to floating-point roundoff error.
+        pi[i] = Clamp(int(offset[i] * nVoxels[i]), 0, nVoxels[i] - 1);
+    return Lookup(pi);
+}
+
+const Distribution1D *SpatialLightDistribution::Lookup(const Point3i &pi) const {
+    // Pack the 3D integer voxel coordinates into a single 64-bit value.
+    uint64_t packedPos = (uint64_t(pi[0]) << 40) | (uint64_t(pi[1]) << 20) | pi[2];
+    assert(packedPos != invalidPackedPos);
+
+    // Compute a hash value from the packed voxel coordinates.  We could
+    // just take packedPos mod the hash table size, but since packedPos
+    // isn't necessarily well distributed on its own, it's worthwhile to do
+    // a little work to make sure that its bits values are individually
+    // fairly random. For details of and motivation for the following, see:
+    // http://zimbry.blogspot.ch/2011/09/better-bit-mixing-improving-on.html
+    uint64_t hash = packedPos;
+    hash ^= (hash >> 31);
+    hash *= 0x7fb5d329728ea185;
+    hash ^= (hash >> 27);
+    hash *= 0x81dadef4bc2dd44d;
+    hash ^= (hash >> 33);
+    hash %= hashTableSize;
+
+    // Now, see if the hash table already has an entry for the voxel. We'll
+    // use quadratic probing when the hash table entry is already used for
+    // another value; step stores the square root of the probe step.
+    int step = 1;
+    while (true) {
+        HashEntry &entry = hashTable[hash];
+        // Does the hash table entry at offset |hash| match the current point?
+        uint64_t entryPackedPos = entry.packedPos.load(std::memory_order_acquire);
+        if (entryPackedPos == packedPos) {
+            // Yes! Most of the time, there should already by a light
+            // sampling distribution available.
+            Distribution1D *dist = entry.distribution.load(std::memory_order_acquire);
+            if (dist == nullptr) {
+                // Rarely, another thread will have already done a lookup
+                // at this point, found that there isn't a sampling
+                // distribution, and will already be computing the
+                // distribution for the point.  In this case, we spin until
+                // the sampling distribution is ready.  We assume that this
+                // is a rare case, so don't do anything more sophisticated
+                // than spinning.
+                while ((dist = entry.distribution.load(std::memory_order_acquire)) ==
+                       nullptr)
+                    // spin :-(. If we were fancy, we'd have any threads
+                    // that hit this instead help out with computing the
+                    // distribution for the voxel...
+                    ;
+            }
+            // We have a valid sampling distribution.
+            return dist;
+        } else if (entryPackedPos != invalidPackedPos) {
+            // The hash table entry we're checking has already been
+            // allocated for another voxel. Advance to the next entry with
+            // quadratic probing.
+            hash += step * step;
+            if (hash >= hashTableSize) hash %= hashTableSize;
+            ++step;
+        } else {
+            // We have found an invalid entry. (Though this may have
+            // changed by the time we get here, in case another thread
+            // allocated it.)  Try to claim this entry for the voxel
+            // by atomically writing our packed coordinates.
+            uint64_t invalid = invalidPackedPos;
+            if (entry.packedPos.compare_exchange_weak(invalid, packedPos)) {
+                // Success; we've claimed this position for this voxel's
+                // distribution. Now compute the sampling distribution and
+                // add it to the hash table. As long as packedPos has been
+                // set but the entry's distribution pointer is nullptr, any
+                // other threads looking up the distribution for this voxel
+                // will spin wait until the distribution pointer is
+                // written.
+                Distribution1D *dist = ComputeDistribution(pi);
+                entry.distribution.store(dist, std::memory_order_release);
+                return dist;
+            }
+        }
+    }
+}
+
+void SpatialLightDistribution::Prefill() {
+    // Compute the distributions of all voxels up front rather than lazily
+    // during rendering; concurrent insertions go through the same lock-free
+    // path as _Lookup()_.
+    int nx = nVoxels[0], ny = nVoxels[1], nz = nVoxels[2];
+    int nTotal = nx * ny * nz;
+    #pragma omp parallel for schedule(dynamic, 16)
+    for (int i = 0; i < nTotal; ++i)
+        Lookup(Point3i(i % nx, (i / nx) % ny, i / (nx * ny)));
+}
+
+Distribution1D *
+SpatialLightDistribution::ComputeDistribution(Point3i pi) const {
+    // Compute the world-space bounding box of the voxel corresponding to
+    // |pi|.
+    Point3f p0(float(pi[0]) / float(nVoxels[0]),
+               float(pi[1]) / float(nVoxels[1]),
+               float(pi[2]) / float(nVoxels[2]));
+    Point3f p1(float(pi[0] + 1) / float(nVoxels[0]),
+               float(pi[1] + 1) / float(nVoxels[1]),
+               float(pi[2] + 1) / float(nVoxels[2]));
+    Bounds3f voxelBounds(scene.WorldBound().Lerp(p0),
+                         scene.WorldBound().Lerp(p1));
 
-// const Distribution1D *PowerLightDistribution::Lookup(const Point3f &p) const {
-//     return distrib.get();
-// }
+    // Compute the sampling distribution. Sample a number of points inside
+    // voxelBounds using a 3D Halton sequence; at each one, sample each
+    // light source and compute a weight based on Li/pdf for the light's
+    // sample (ignoring visibility between the point in the voxel and the
+    // point on the light source) as an approximation to how much the light
+    // is likely to contribute to illumination in the voxel.
+    const int nSamples = 128;
+    std::vector<float> lightContrib(scene.lights.size(), float(0));
+    for (int i = 0; i < nSamples; ++i) {
+        Point3f po = voxelBounds.Lerp(Point3f(
+            RadicalInverse(0, i), RadicalInverse(1, i), RadicalInverse(2, i)));
+        Interaction intr(po, Normal3f(), Vector3f(), Vector3f(1, 0, 0),
+                         0 /* time */);
+
+        // Use the next two Halton dimensions to sample a point on the
+        // light source.
+        Point2f u(RadicalInverse(3, i), RadicalInverse(4, i));
+        for (size_t j = 0; j < scene.lights.size(); ++j) {
+            float pdf;
+            Vector3f wi;
+            VisibilityTester vis;
+            Spectrum Li = scene.lights[j]->Sample_Li(intr, u, &wi, &pdf, &vis);
+            if (pdf > 0) lightContrib[j] += Li.y() / pdf;
+        }
+    }
+
+    // We don't want to leave any lights with a zero probability; it's
+    // possible that a light contributes to points in the voxel even though
+    // we didn't find such a point when sampling above.  Therefore, compute
+    // a minimum (small) weight and ensure that all lights are given at
+    // least the corresponding probability.
+    float sumContrib =
+        std::accumulate(lightContrib.begin(), lightContrib.end(), float(0));
+    float avgContrib = sumContrib / (nSamples * lightContrib.size());
+    float minContrib = (avgContrib > 0) ? .001 * avgContrib : 1;
+    for (size_t i = 0; i < lightContrib.size(); ++i)
+        lightContrib[i] = std::max(lightContrib[i], minContrib);
+
+    // Compute a sampling distribution from the accumulated contributions.
+    return new Distribution1D(&lightContrib[0], int(lightContrib.size()),
+                              true);
+}
+
+// BVHLightDistribution
+
+// Normal used to weight light importance at |ref|: the shading normal at
+// surfaces, and no normal for points in media.
+static Normal3f ReferenceNormal(const Interaction &ref) {
+    if (!ref.IsSurfaceInteraction()) return Normal3f(0, 0, 0);
+    return ((const SurfaceInteraction &)ref).shading.n;
+}
+
+BVHLightDistribution::BVHLightDistribution(const Scene &scene)
+    : lightToNode(scene.lights.size(), -1),
+      isInfinite(scene.lights.size(), false),
+      powerDistrib(ComputeLightPowerDistribution(scene)) {
+    // Separate the lights into bounded lights and infinite lights
+    std::vector<std::pair<int, LightBounds>> bvhLights;
+    for (size_t i = 0; i < scene.lights.size(); ++i) {
+        LightBounds lb;
+        if (!scene.lights[i]->Bounds(&lb)) {
+            infiniteLights.push_back((int)i);
+            isInfinite[i] = true;
+        } else if (lb.phi > 0)
+            bvhLights.push_back(std::make_pair((int)i, lb));
+    }
+    if (!bvhLights.empty()) {
+        nodes.reserve(2 * bvhLights.size() - 1);
+        BuildBVH(bvhLights, 0, (int)bvhLights.size(), -1);
+    }
+}
+
+int BVHLightDistribution::BuildBVH(
+    std::vector<std::pair<int, LightBounds>> &bvhLights, int start, int end,
+    int parent) {
+    int nodeIndex = (int)nodes.size();
+    nodes.push_back(LightBVHNode());
+    nodes[nodeIndex].parent = parent;
+
+    // Initialize leaf node if only a single light remains
+    if (end - start == 1) {
+        int lightIndex = bvhLights[start].first;
+        nodes[nodeIndex].bounds = bvhLights[start].second;
+        nodes[nodeIndex].childOrLightIndex = lightIndex;
+        nodes[nodeIndex].isLeaf = true;
+        lightToNode[lightIndex] = nodeIndex;
+        return nodeIndex;
+    }
+
+    // Compute bounds and centroid bounds for the lights in the range
+    Bounds3f bounds, centroidBounds;
+    for (int i = start; i < end; ++i) {
+        const LightBounds &lb = bvhLights[i].second;
+        bounds = Union(bounds, lb.bounds);
+        centroidBounds = Union(centroidBounds, lb.Centroid());
+    }
+
+    // Find the bucket split of minimum cost over all three dimensions
+    const int nBuckets = 12;
+    float minCost = Infinity;
+    int minCostSplitBucket = -1, minCostSplitDim = -1;
+    for (int dim = 0; dim < 3; ++dim) {
+        if (centroidBounds.pMax[dim] == centroidBounds.pMin[dim]) continue;
+        // Compute _LightBounds_ for each bucket
+        LightBounds bucketLightBounds[nBuckets];
+        for (int i = start; i < end; ++i) {
+            const LightBounds &lb = bvhLights[i].second;
+            int b = nBuckets * centroidBounds.Offset(lb.Centroid())[dim];
+            if (b == nBuckets) b = nBuckets - 1;
+            bucketLightBounds[b] = Union(bucketLightBounds[b], lb);
+        }
+
+        // Compute costs for splitting lights after each bucket
+        for (int i = 0; i < nBuckets - 1; ++i) {
+            LightBounds b0, b1;
+            for (int j = 0; j <= i; ++j)
+                b0 = Union(b0, bucketLightBounds[j]);
+            for (int j = i + 1; j < nBuckets; ++j)
+                b1 = Union(b1, bucketLightBounds[j]);
+            if (b0.phi == 0 || b1.phi == 0) continue;
+            float cost = EvaluateCost(b0, bounds, dim) +
+                         EvaluateCost(b1, bounds, dim);
+            if (cost > 0 && cost < minCost) {
+                minCost = cost;
+                minCostSplitBucket = i;
+                minCostSplitDim = dim;
+            }
+        }
+    }
+
+    // Partition lights according to the chosen split
+    int mid;
+    if (minCostSplitDim == -1)
+        mid = (start + end) / 2;
+    else {
+        auto pmid = std::partition(
+            &bvhLights[start], &bvhLights[end - 1] + 1,
+            [=](const std::pair<int, LightBounds> &l) {
+                int b = nBuckets *
+                        centroidBounds.Offset(l.second.Centroid())[minCostSplitDim];
+                if (b == nBuckets) b = nBuckets - 1;
+                return b <= minCostSplitBucket;
+            });
+        mid = int(pmid - &bvhLights[0]);
+        if (mid == start || mid == end) mid = (start + end) / 2;
+    }
+
+    // Build the children; the first one directly follows this node
+    int child0 = BuildBVH(bvhLights, start, mid, nodeIndex);
+    int child1 = BuildBVH(bvhLights, mid, end, nodeIndex);
+    nodes[nodeIndex].bounds = Union(nodes[child0].bounds, nodes[child1].bounds);
+    nodes[nodeIndex].childOrLightIndex = child1;
+    nodes[nodeIndex].isLeaf = false;
+    return nodeIndex;
+}
+
+float BVHLightDistribution::EvaluateCost(const LightBounds &b,
+                                         const Bounds3f &bounds,
+                                         int dim) const {
+    // Evaluate direction bounds measure for _LightBounds_
+    float theta_o = std::acos(b.cosTheta_o), theta_e = std::acos(b.cosTheta_e);
+    float theta_w = std::min(theta_o + theta_e, Pi);
+    float sinTheta_o = SafeSqrt(1 - b.cosTheta_o * b.cosTheta_o);
+    float M_omega = 2 * Pi * (1 - b.cosTheta_o) +
+                    Pi / 2 *
+                        (2 * theta_w * sinTheta_o -
+                         std::cos(theta_o - 2 * theta_w) -
+                         2 * theta_o * sinTheta_o + b.cosTheta_o);
+
+    // Penalize splits along the short axes of elongated bounds
+    Vector3f d = bounds.Diagonal();
+    float Kr = std::max(d.x, std::max(d.y, d.z)) / d[dim];
+
+    return b.phi * M_omega * Kr * b.bounds.SurfaceArea();
+}
+
+const Distribution1D *BVHLightDistribution::Lookup(const Point3f &p) const {
+    return powerDistrib.get();
+}
+
+int BVHLightDistribution::Sample(const Interaction &ref, float u,
+                                 float *pmf) const {
+    // Choose between the infinite lights and the BVH
+    float pInfinite = PInfinite();
+    if (u < pInfinite) {
+        int nInfinite = (int)infiniteLights.size();
+        int index = std::min(int(u / pInfinite * nInfinite), nInfinite - 1);
+        *pmf = pInfinite / nInfinite;
+        return infiniteLights[index];
+    }
+    *pmf = 0;
+    if (nodes.empty()) return -1;
+
+    // Traverse the BVH, reusing _u_ for the choice at each level
+    Point3f p = ref.p;
+    Normal3f n = ReferenceNormal(ref);
+    u = std::min((u - pInfinite) / (1 - pInfinite), OneMinusEpsilon);
+    float nodePmf = 1 - pInfinite;
+    int nodeIndex = 0;
+    while (!nodes[nodeIndex].isLeaf) {
+        const LightBVHNode &node = nodes[nodeIndex];
+        int child0 = nodeIndex + 1, child1 = node.childOrLightIndex;
+        float ci0 = nodes[child0].bounds.Importance(p, n);
+        float ci1 = nodes[child1].bounds.Importance(p, n);
+        if (ci0 == 0 && ci1 == 0) return -1;
+
+        // Pick a child in proportion to its importance and remap _u_
+        float p0 = ci0 / (ci0 + ci1);
+        if (u < p0) {
+            nodePmf *= p0;
+            u = std::min(u / p0, OneMinusEpsilon);
+            nodeIndex = child0;
+        } else {
+            nodePmf *= 1 - p0;
+            u = std::min((u - p0) / (1 - p0), OneMinusEpsilon);
+            nodeIndex = child1;
+        }
+    }
+
+    // A lone light at the root hasn't had its importance checked yet
+    if (nodeIndex == 0 && nodes[0].bounds.Importance(p, n) == 0) return -1;
+    *pmf = nodePmf;
+    return nodes[nodeIndex].childOrLightIndex;
+}
+
+float BVHLightDistribution::Pmf(const Interaction &ref, int lightIndex) const {
+    if (isInfinite[lightIndex]) return PInfinite() / infiniteLights.size();
+    int nodeIndex = lightToNode[lightIndex];
+    if (nodeIndex == -1) return 0;
+
+    // Walk up from the light's leaf, multiplying in the probability of each
+    // child choice made on the way down
+    Point3f p = ref.p;
+    Normal3f n = ReferenceNormal(ref);
+    if (nodeIndex == 0 && nodes[0].bounds.Importance(p, n) == 0) return 0;
+    float pmf = 1 - PInfinite();
+    while (nodes[nodeIndex].parent != -1) {
+        int parent = nodes[nodeIndex].parent;
+        int child0 = parent + 1, child1 = nodes[parent].childOrLightIndex;
+        float ci0 = nodes[child0].bounds.Importance(p, n);
+        float ci1 = nodes[child1].bounds.Importance(p, n);
+        float ci = nodeIndex == child0 ? ci0 : ci1;
+        if (ci == 0) return 0;
+        pmf *= ci / (ci0 + ci1);
+        nodeIndex = parent;
+    }
+    return pmf;
+}
 
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "PBRender.h"
 
 #include "geometry.h"
+#include "light.h"
 #include "sampling.h"
 #include <atomic>
 #include <functional>
@@ -19,6 +20,16 @@ class LightDistribution {
     // Given a point |p| in space, this method returns a (hopefully
     // effective) sampling distribution for light sources at that point.
     virtual const Distribution1D *Lookup(const Point3f &p) const = 0;
+
+    // Chooses a light for the reference point |ref| and returns its index
+    // in Scene::lights along with its probability |pmf|, or -1 if no light
+    // can contribute.  The default implementation samples the distribution
+    // returned by Lookup().
+    virtual int Sample(const Interaction &ref, float u, float *pmf) const;
+
+    // Returns the probability that Sample() chooses light |lightIndex| at
+    // |ref|.
+    virtual float Pmf(const Interaction &ref, int lightIndex) const;
 };
 
 std::unique_ptr<LightDistribution> CreateLightSampleDistribution(
@@ -64,11 +75,23 @@ class PowerLightDistribution : public LightDistribution {
 // and a sampling distribution is computed as needed for each voxel.
 class SpatialLightDistribution : public LightDistribution {
   public:
-    SpatialLightDistribution(const Scene &scene, int maxVoxels = 64);
+    // With _prefill_ the distributions of all voxels are computed by
+    // _Prefill()_ in the constructor; "spatial-prefill" selects this in
+    // CreateLightSampleDistribution().
+    SpatialLightDistribution(const Scene &scene, int maxVoxels = 64,
+                             bool prefill = false);
     ~SpatialLightDistribution();
     const Distribution1D *Lookup(const Point3f &p) const;
 
+    // Computes the distributions of all voxels in parallel, so that
+    // rendering threads never stall on a voxel's first lookup. This visits
+    // empty space as well, so it only pays off for coarse grids or for
+    // renders that will touch most of the scene volume anyway.
+    void Prefill();
+
   private:
+    const Distribution1D *Lookup(const Point3i &pi) const;
+
     // Compute the sampling distribution for the voxel with integer
     // coordiantes given by "pi".
     Distribution1D *ComputeDistribution(Point3i pi) const;
@@ -89,5 +112,49 @@ class SpatialLightDistribution : public LightDistribution {
     size_t hashTableSize;
 };
 
+// A bounding volume hierarchy over the lights' spatial and directional
+// bounds.  Sampling walks from the root to a single light, choosing each
+// child in proportion to a conservative estimate of its contribution at
+// the reference point, so the cost is logarithmic in the number of lights
+// and the pmf adapts to both distance and orientation.  Lights without
+// bounds (infinite lights) are chosen uniformly alongside the tree.
+class BVHLightDistribution : public LightDistribution {
+  public:
+    BVHLightDistribution(const Scene &scene);
+
+    // Lookup() has no reference point to adapt to and returns the
+    // power-based distribution.
+    const Distribution1D *Lookup(const Point3f &p) const;
+    int Sample(const Interaction &ref, float u, float *pmf) const;
+    float Pmf(const Interaction &ref, int lightIndex) const;
+
+  private:
+    // The first child of an interior node directly follows it in |nodes|
+    struct LightBVHNode {
+        LightBounds bounds;
+        int parent;
+        // Index of the second child for interior nodes or of the light in
+        // Scene::lights for leaves
+        int childOrLightIndex;
+        bool isLeaf;
+    };
+
+    int BuildBVH(std::vector<std::pair<int, LightBounds>> &bvhLights,
+                 int start, int end, int parent);
+    float EvaluateCost(const LightBounds &b, const Bounds3f &bounds,
+                       int dim) const;
+    float PInfinite() const {
+        return float(infiniteLights.size()) /
+               float(infiniteLights.size() + (nodes.empty() ? 0 : 1));
+    }
+
+    std::vector<LightBVHNode> nodes;
+    std::vector<int> infiniteLights;
+    // Leaf node of each light, or -1 if the light isn't in the tree
+    std::vector<int> lightToNode;
+    std::vector<bool> isInfinite;
+    std::unique_ptr<Distribution1D> powerDistrib;
+};
+
 
 }
\ No newline at end of file
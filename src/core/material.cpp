@@ -3,12 +3,30 @@
 #include "texture.h"
 #include "spectrum.h"
 #include "reflection.h"
+#include "interaction.h"
+
+#include "omp.h"
+
+#include <algorithm>
+#include <atomic>
+#include <unordered_map>
 
 namespace PBRender {
 
 // Material Method Definitions
+static std::atomic<int> nextMaterialId{0};
+
+Material::Material() : id(nextMaterialId++) {}
+
 Material::~Material() {}
 
+void Material::ComputeScatteringFunctionsBatch(SurfaceInteraction *const *si,
+                                               int n, TransportMode mode,
+                                               bool allowMultipleLobes) const {
+    for (int i = 0; i < n; ++i)
+        ComputeScatteringFunctions(si[i], mode, allowMultipleLobes);
+}
+
 void Material::Bump(const std::shared_ptr<Texture<float>> &d,
                     SurfaceInteraction *si) {
     // Compute offset positions and evaluate displacement texture
@@ -48,4 +66,59 @@ void Material::Bump(const std::shared_ptr<Texture<float>> &d,
                            false);
 }
 
+// Number of hits handed to one _ComputeScatteringFunctionsBatch()_ call
+static const int ShadingBatchSize = 64;
+
+void ComputeScatteringFunctionsByMaterial(SurfaceInteraction *const *isects,
+                                          int n, TransportMode mode,
+                                          bool allowMultipleLobes,
+                                          std::vector<int> *order) {
+    // Assign each distinct material a bucket in order of first appearance
+    std::vector<const Material *> materials;
+    std::vector<int> bucket(n);
+    std::unordered_map<const Material *, int> bucketIndex;
+    for (int i = 0; i < n; ++i) {
+        const Material *material = isects[i]->primitive->GetMaterial();
+        auto iter = bucketIndex.find(material);
+        if (iter == bucketIndex.end()) {
+            iter = bucketIndex.insert({material, (int)materials.size()}).first;
+            materials.push_back(material);
+        }
+        bucket[i] = iter->second;
+    }
+
+    // Counting sort of the hits by bucket, keeping their relative order
+    int nBuckets = (int)materials.size();
+    std::vector<int> bucketStart(nBuckets + 1, 0);
+    for (int i = 0; i < n; ++i) ++bucketStart[bucket[i] + 1];
+    for (int b = 0; b < nBuckets; ++b) bucketStart[b + 1] += bucketStart[b];
+    std::vector<int> sorted(n);
+    std::vector<int> offset(bucketStart.begin(), bucketStart.end() - 1);
+    for (int i = 0; i < n; ++i) sorted[offset[bucket[i]]++] = i;
+
+    // Split every bucket into batches that never mix materials
+    std::vector<int> batchStart;
+    for (int b = 0; b < nBuckets; ++b) {
+        if (!materials[b]) continue;
+        for (int s = bucketStart[b]; s < bucketStart[b + 1];
+             s += ShadingBatchSize)
+            batchStart.push_back(s);
+    }
+
+    int nBatches = (int)batchStart.size();
+    #pragma omp parallel for schedule(dynamic)
+    for (int k = 0; k < nBatches; ++k) {
+        int start = batchStart[k];
+        const Material *material = materials[bucket[sorted[start]]];
+        int end = std::min(start + ShadingBatchSize,
+                           bucketStart[bucket[sorted[start]] + 1]);
+        SurfaceInteraction *batch[ShadingBatchSize];
+        for (int s = start; s < end; ++s) batch[s - start] = isects[sorted[s]];
+        material->ComputeScatteringFunctionsBatch(batch, end - start, mode,
+                                                  allowMultipleLobes);
+    }
+
+    if (order) order->swap(sorted);
+}
+
 }
\ No newline at end of file
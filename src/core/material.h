@@ -10,13 +10,31 @@ enum class TransportMode { Radiance, Importance };
 class Material {
   public:
     // Material Interface
+    Material();
     virtual void ComputeScatteringFunctions(SurfaceInteraction *si,
                                             // MemoryArena &arena,
                                             TransportMode mode,
                                             bool allowMultipleLobes) const = 0;
+    // Shades _n_ hits that all use this material; overrides evaluate each
+    // texture over the whole batch before constructing the BxDFs
+    virtual void ComputeScatteringFunctionsBatch(SurfaceInteraction *const *si,
+                                                 int n, TransportMode mode,
+                                                 bool allowMultipleLobes) const;
     virtual ~Material();
     static void Bump(const std::shared_ptr<Texture<float>> &d,
                      SurfaceInteraction *si);
+
+    // Unique index of the material, in creation order
+    const int id;
 };
 
+// Computes scattering functions for _n_ hits whose ray differentials are
+// already set, bucketing them by material so that each material shades its
+// hits in contiguous batches. If _order_ is given it receives the hit
+// indices grouped by material.
+void ComputeScatteringFunctionsByMaterial(SurfaceInteraction *const *isects,
+                                          int n, TransportMode mode,
+                                          bool allowMultipleLobes,
+                                          std::vector<int> *order = nullptr);
+
 }
\ No newline at end of file
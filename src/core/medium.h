@@ -0,0 +1,66 @@
+#pragma once
+
+#include "PBRender.h"
+#include "geometry.h"
+#include "spectrum.h"
+
+namespace PBRender {
+
+// PhaseFunction Declarations
+class PhaseFunction {
+    public:
+        // PhaseFunction Interface
+        virtual ~PhaseFunction();
+        virtual float p(const Vector3f &wo, const Vector3f &wi) const = 0;
+        virtual float Sample_p(const Vector3f &wo, Vector3f *wi,
+                               const Point2f &u) const = 0;
+};
+
+// Media Inline Functions
+inline float PhaseHG(float cosTheta, float g) {
+    float denom = 1 + g * g + 2 * g * cosTheta;
+    return Inv4Pi * (1 - g * g) / (denom * std::sqrt(denom));
+}
+
+// HenyeyGreenstein Declarations
+class HenyeyGreenstein : public PhaseFunction {
+    public:
+        // HenyeyGreenstein Public Methods
+        HenyeyGreenstein(float g) : g(g) {}
+        float p(const Vector3f &wo, const Vector3f &wi) const;
+        float Sample_p(const Vector3f &wo, Vector3f *wi,
+                       const Point2f &sample) const;
+
+    private:
+        const float g;
+};
+
+// Medium Declarations
+class Medium {
+    public:
+        // Medium Interface
+        virtual ~Medium() {}
+        // Transmittance along _ray_ up to _ray.tMax_
+        virtual Spectrum Tr(const Ray &ray, Sampler &sampler) const = 0;
+        // Samples a scattering event along _ray_; _mi_ is left invalid if
+        // the ray passes through to _ray.tMax_. Returns the path throughput
+        // weight of the sample.
+        virtual Spectrum Sample(const Ray &ray, Sampler &sampler,
+                                MediumInteraction *mi) const = 0;
+};
+
+// MediumInterface Declarations
+// The media on the two sides of a surface; _outside_ is on the side its
+// geometric normal points to. Rays leaving a surface that isn't a medium
+// transition stay in the medium they arrived in.
+struct MediumInterface {
+    MediumInterface() : inside(nullptr), outside(nullptr) {}
+    MediumInterface(const Medium *medium) : inside(medium), outside(medium) {}
+    MediumInterface(const Medium *inside, const Medium *outside)
+        : inside(inside), outside(outside) {}
+    bool IsMediumTransition() const { return inside != outside; }
+
+    const Medium *inside, *outside;
+};
+
+}
\ No newline at end of file
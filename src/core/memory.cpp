@@ -0,0 +1,51 @@
+#include "memory.h"
+
+#include <algorithm>
+#include <stdlib.h>
+
+namespace PBRender {
+
+// MemoryArena Method Definitions
+MemoryArena::~MemoryArena() {
+    free(currentBlock);
+    for (auto &block : usedBlocks) free(block.second);
+    for (auto &block : availableBlocks) free(block.second);
+}
+
+void *MemoryArena::Alloc(size_t nBytes) {
+    // Keep every allocation 16-byte aligned
+    const size_t align = 16;
+    nBytes = (nBytes + align - 1) & ~(align - 1);
+    if (currentBlockPos + nBytes > currentAllocSize) {
+        // Retire the current block and take a reused or new one
+        if (currentBlock) {
+            usedBlocks.push_back(std::make_pair(currentAllocSize, currentBlock));
+            currentBlock = nullptr;
+            currentAllocSize = 0;
+        }
+        for (auto iter = availableBlocks.begin(); iter != availableBlocks.end();
+             ++iter) {
+            if (iter->first >= nBytes) {
+                currentAllocSize = iter->first;
+                currentBlock = iter->second;
+                availableBlocks.erase(iter);
+                break;
+            }
+        }
+        if (!currentBlock) {
+            currentAllocSize = std::max(nBytes, blockSize);
+            currentBlock = (uint8_t *)malloc(currentAllocSize);
+        }
+        currentBlockPos = 0;
+    }
+    void *ret = currentBlock + currentBlockPos;
+    currentBlockPos += nBytes;
+    return ret;
+}
+
+MemoryArena *&ThreadArena() {
+    static thread_local MemoryArena *arena = nullptr;
+    return arena;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "PBRender.h"
+
+#include <list>
+#include <utility>
+
+namespace PBRender {
+
+// MemoryArena Declarations
+class MemoryArena {
+    public:
+        // MemoryArena Public Methods
+        MemoryArena(size_t blockSize = 262144) : blockSize(blockSize) {}
+        MemoryArena(const MemoryArena &) = delete;
+        MemoryArena &operator=(const MemoryArena &) = delete;
+        ~MemoryArena();
+
+        void *Alloc(size_t nBytes);
+
+        // Every allocation must be dead before the arena is reset; its blocks
+        // are kept for reuse
+        void Reset() {
+            currentBlockPos = 0;
+            availableBlocks.splice(availableBlocks.begin(), usedBlocks);
+        }
+
+    private:
+        // MemoryArena Private Data
+        const size_t blockSize;
+        size_t currentBlockPos = 0, currentAllocSize = 0;
+        uint8_t *currentBlock = nullptr;
+        std::list<std::pair<size_t, uint8_t *>> usedBlocks, availableBlocks;
+};
+
+// Allocator that hands out arena memory and never frees it, so that
+// std::allocate_shared can place an object and its control block there
+template <typename T>
+struct ArenaAllocator {
+    typedef T value_type;
+
+    ArenaAllocator(MemoryArena *arena) : arena(arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &a) : arena(a.arena) {}
+
+    T *allocate(size_t n) {
+        return static_cast<T *>(arena->Alloc(n * sizeof(T)));
+    }
+    void deallocate(T *, size_t) {}
+
+    MemoryArena *arena;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) {
+    return a.arena == b.arena;
+}
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) {
+    return a.arena != b.arena;
+}
+
+// Arena that per-sample allocations of the calling thread go to, or nullptr
+MemoryArena *&ThreadArena();
+
+// Makes _arena_ the calling thread's arena for the lifetime of the object
+class ScopedThreadArena {
+    public:
+        ScopedThreadArena(MemoryArena *arena) : previous(ThreadArena()) {
+            ThreadArena() = arena;
+        }
+        ~ScopedThreadArena() { ThreadArena() = previous; }
+
+    private:
+        MemoryArena *previous;
+};
+
+// Creates a shared object in the thread's arena if one is active and on the
+// heap otherwise
+template <typename T, typename... Args>
+std::shared_ptr<T> AllocShared(Args &&... args) {
+    MemoryArena *arena = ThreadArena();
+    if (!arena) return std::make_shared<T>(std::forward<Args>(args)...);
+    return std::allocate_shared<T>(ArenaAllocator<T>(arena),
+                                   std::forward<Args>(args)...);
+}
+
+}
\ No newline at end of file
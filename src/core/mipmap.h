@@ -102,6 +102,7 @@ MIPMap<T>::MIPMap(const Point2i &res, const T *img, bool doTrilinear,
         resampledImage.reset(new T[resPow2[0] * resPow2[1]]);
 
         // Apply _sWeights_ to zoom in $s$ direction
+        #pragma omp parallel for schedule(dynamic, 16)
         for (int t = 0; t < resolution[1]; ++t) {
             for (int s = 0; s < resPow2[0]; ++s) {
                 // Compute texel $(s,t)$ in $s$-zoomed image
@@ -125,7 +126,12 @@ MIPMap<T>::MIPMap(const Point2i &res, const T *img, bool doTrilinear,
         std::unique_ptr<ResampleWeight[]> tWeights =
             resampleWeights(resolution[1], resPow2[1]);
         
-        T *workData = new T[resPow2[1]];
+        // Columns are resampled in parallel, each thread with its own
+        // column buffer
+        #pragma omp parallel
+        {
+        std::unique_ptr<T[]> workData(new T[resPow2[1]]);
+        #pragma omp for schedule(dynamic, 32)
         for (int s = 0; s < resPow2[0]; ++s) {
             for (int t = 0; t < resPow2[1]; ++t) {
                 workData[t] = 0.f;
@@ -145,8 +151,7 @@ MIPMap<T>::MIPMap(const Point2i &res, const T *img, bool doTrilinear,
             for (int t = 0; t < resPow2[1]; ++t)
                 resampledImage[t * resPow2[0] + s] = clamp(workData[t]);
         }
-        
-        delete[] workData;
+        }
 
         resolution = resPow2;
     }
@@ -159,6 +164,8 @@ MIPMap<T>::MIPMap(const Point2i &res, const T *img, bool doTrilinear,
     pyramid[0].reset(
         new BlockedArray<T>(resolution[0], resolution[1],
                             resampledImage ? resampledImage.get() : img));
+    // The pyramid keeps its own copy of the image
+    resampledImage.reset();
     
     for (int i = 1; i < nLevels; ++i) {
         // Initialize $i$th MIPMap level from $i-1$st level
@@ -166,6 +173,7 @@ MIPMap<T>::MIPMap(const Point2i &res, const T *img, bool doTrilinear,
         int tRes = std::max(1, pyramid[i - 1]->vSize() / 2);
         pyramid[i].reset(new BlockedArray<T>(sRes, tRes));
 
+        #pragma omp parallel for schedule(dynamic, 16)
         for (int t = 0; t < tRes; ++t) {
             for (int s = 0; s < sRes; ++s) {
                 (*pyramid[i])(s, t) =
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "PBRender.h"
+
+#include <atomic>
+
+namespace PBRender {
+
+// AtomicFloat Declarations
+class AtomicFloat {
+    public:
+        // AtomicFloat Public Methods
+        explicit AtomicFloat(float v = 0) { bits = FloatToBits(v); }
+        operator float() const { return BitsToFloat(bits); }
+        float operator=(float v) {
+            bits = FloatToBits(v);
+            return v;
+        }
+        void Add(float v) {
+            uint32_t oldBits = bits, newBits;
+            do {
+                newBits = FloatToBits(BitsToFloat(oldBits) + v);
+            } while (!bits.compare_exchange_weak(oldBits, newBits));
+        }
+
+    private:
+        // AtomicFloat Private Data
+        std::atomic<uint32_t> bits;
+};
+
+}
\ No newline at end of file
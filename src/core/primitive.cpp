@@ -2,9 +2,12 @@
 #include "light.h"
 #include "interaction.h"
 
+#include <atomic>
+
 namespace PBRender {
 
 static long long primitiveMemory = 0;
+static std::atomic<int> nextPrimitiveId{0};
 
 Primitive::~Primitive() {}
 
@@ -24,6 +27,14 @@ const Material *Aggregate::GetMaterial() const {
     return nullptr;
 }
 
+int Aggregate::GetId() const {
+    std::cerr <<
+        "Aggregate::GetId() method"
+        "called; should have gone to GeometricPrimitive"
+        << std::endl;
+    return -1;
+}
+
 void Aggregate::ComputeScatteringFunctions(SurfaceInteraction *isect,
                                            TransportMode mode,
                                            bool allowMultipleLobes) const {
@@ -35,15 +46,24 @@ void Aggregate::ComputeScatteringFunctions(SurfaceInteraction *isect,
 
 GeometricPrimitive::GeometricPrimitive(const std::shared_ptr<Shape> &shape,
                                        const std::shared_ptr<Material> &material,
-                                       const std::shared_ptr<AreaLight> &areaLight)
-    : shape(shape),
+                                       const std::shared_ptr<AreaLight> &areaLight,
+                                       const MediumInterface &mediumInterface)
+    : id(nextPrimitiveId++),
+      shape(shape),
       material(material),
-      areaLight(areaLight) {
+      areaLight(areaLight),
+      mediumInterface(mediumInterface) {
     primitiveMemory += sizeof(*this);
 }
 
 Bounds3f GeometricPrimitive::WorldBound() const { return shape->WorldBound(); }
 
+bool GeometricPrimitive::ForEachPrimitive(
+    const std::function<bool(const Bounds3f &)> &overlaps,
+    const std::function<bool(const GeometricPrimitive &)> &visit) const {
+    return !overlaps(WorldBound()) || visit(*this);
+}
+
 bool GeometricPrimitive::IntersectP(const Ray &r) const {
     return shape->IntersectP(r);
 }
@@ -57,10 +77,10 @@ bool GeometricPrimitive::Intersect(const Ray &r,
     assert(Dot(isect->n, isect->shading.n) > 0.);
 
     // Initialize _SurfaceInteraction::mediumInterface_ after _Shape_ intersection
-    // if (mediumInterface.IsMediumTransition())
-    //     isect->mediumInterface = mediumInterface;
-    // else
-    //     isect->mediumInterface = MediumInterface(r.medium);
+    if (mediumInterface.IsMediumTransition())
+        isect->mediumInterface = mediumInterface;
+    else
+        isect->mediumInterface = MediumInterface(r.medium);
 
     return true;
 }
@@ -3,8 +3,11 @@
 #include "PBRender.h"
 #include "shape.h"
 #include "material.h"
+#include "medium.h"
 #include "transform.h"
 
+#include <functional>
+
 namespace PBRender {
 
 class Primitive {
@@ -18,6 +21,8 @@ class Primitive {
 
         virtual const AreaLight *GetAreaLight() const = 0;
         virtual const Material *GetMaterial() const = 0;
+        // Unique index of a _GeometricPrimitive_, in creation order
+        virtual int GetId() const = 0;
 
         virtual void ComputeScatteringFunctions(
             SurfaceInteraction *isect,
@@ -25,13 +30,24 @@ class Primitive {
             bool allowMultipleLobes
         ) const = 0;
 
+        // Calls _visit_ for every geometric primitive whose bounds _overlaps_
+        // accepts, skipping subtrees whose bounds it rejects; stops and
+        // returns false as soon as _visit_ does
+        virtual bool ForEachPrimitive(
+            const std::function<bool(const Bounds3f &)> &overlaps,
+            const std::function<bool(const GeometricPrimitive &)> &visit)
+            const = 0;
 };
 
 class GeometricPrimitive : public Primitive {
     public:
+        // Shapes with a null _material_ only mark the boundary between the
+        // media of _mediumInterface_
         GeometricPrimitive(const std::shared_ptr<Shape> &shape,
                            const std::shared_ptr<Material> &material,
-                           const std::shared_ptr<AreaLight> &areaLight);
+                           const std::shared_ptr<AreaLight> &areaLight,
+                           const MediumInterface &mediumInterface =
+                               MediumInterface());
         
         virtual Bounds3f WorldBound() const;
 
@@ -40,21 +56,30 @@ class GeometricPrimitive : public Primitive {
 
         const AreaLight *GetAreaLight() const;
         const Material *GetMaterial() const;
+        int GetId() const { return id; }
 
         void ComputeScatteringFunctions(SurfaceInteraction *isect,
                                         TransportMode mode,
                                         bool allowMultipleLobes) const;
 
+        bool ForEachPrimitive(
+            const std::function<bool(const Bounds3f &)> &overlaps,
+            const std::function<bool(const GeometricPrimitive &)> &visit) const;
+        const Shape &GetShape() const { return *shape; }
+
     private:
+        const int id;
         std::shared_ptr<Shape> shape;
         std::shared_ptr<Material> material;
         std::shared_ptr<AreaLight> areaLight;
+        MediumInterface mediumInterface;
 };
 
 class Aggregate : public Primitive {
     public:
         const AreaLight *GetAreaLight() const;
         const Material *GetMaterial() const;
+        int GetId() const;
         void ComputeScatteringFunctions(SurfaceInteraction *isect,
                                         TransportMode mode,
                                         bool allowMultipleLobes) const;
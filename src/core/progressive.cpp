@@ -0,0 +1,114 @@
+#include "progressive.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+namespace PBRender {
+
+// Checkpoint file layout: magic, version, resolution, then the per-pixel
+// sample counts, RGB sums, luminance means and luminance squared deviations
+static const char CheckpointMagic[8] = {'P', 'B', 'R', 'C', 'K', 'P', 'T', '\0'};
+static const int32_t CheckpointVersion = 2;
+
+// AccumulationBuffer Method Definitions
+AccumulationBuffer::AccumulationBuffer(const Point2i &resolution)
+    : resolution(resolution),
+      Lsum(resolution.x * resolution.y, Spectrum(0.f)),
+      nSamples(resolution.x * resolution.y, 0),
+      yMean(resolution.x * resolution.y, 0.f),
+      yM2(resolution.x * resolution.y, 0.f) {}
+
+float AccumulationBuffer::RelativeError(int offset) const {
+    int64_t n = nSamples[offset];
+    if (n < 2) return Infinity;
+    // Standard error of the mean relative to the mean; the floor on the
+    // denominator keeps near-black pixels from demanding endless samples
+    float variance = yM2[offset] / (n - 1);
+    return std::sqrt(variance / n) / std::max(yMean[offset], .01f);
+}
+
+int64_t AccumulationBuffer::MinSamples() const {
+    return nSamples.empty() ? 0 : *std::min_element(nSamples.begin(),
+                                                    nSamples.end());
+}
+
+float AccumulationBuffer::MeanSamples() const {
+    double sum = 0;
+    for (int64_t n : nSamples) sum += n;
+    return nSamples.empty() ? 0.f : float(sum / nSamples.size());
+}
+
+void AccumulationBuffer::Resolve(std::vector<Spectrum> &col) const {
+    for (size_t i = 0; i < Lsum.size(); ++i)
+        col[i] = nSamples[i] > 0 ? Lsum[i] / (float)nSamples[i] : Spectrum(0.f);
+}
+
+bool AccumulationBuffer::WriteCheckpoint(const std::string &filename) const {
+    // Write to a temporary file first so that a job killed mid-write never
+    // leaves a truncated checkpoint behind
+    std::string tmpName = filename + ".tmp";
+    {
+        std::ofstream out(tmpName, std::ios::binary);
+        if (!out) {
+            std::cerr << "Unable to write checkpoint \"" << tmpName << "\""
+                      << std::endl;
+            return false;
+        }
+        int32_t header[3] = {CheckpointVersion, resolution.x, resolution.y};
+        out.write(CheckpointMagic, sizeof(CheckpointMagic));
+        out.write((const char *)header, sizeof(header));
+        out.write((const char *)nSamples.data(),
+                  nSamples.size() * sizeof(int64_t));
+        for (const Spectrum &L : Lsum) {
+            float rgb[3];
+            L.ToRGB(rgb);
+            out.write((const char *)rgb, sizeof(rgb));
+        }
+        out.write((const char *)yMean.data(), yMean.size() * sizeof(float));
+        out.write((const char *)yM2.data(), yM2.size() * sizeof(float));
+        if (!out) {
+            std::cerr << "Error writing checkpoint \"" << tmpName << "\""
+                      << std::endl;
+            return false;
+        }
+    }
+    return std::rename(tmpName.c_str(), filename.c_str()) == 0;
+}
+
+bool AccumulationBuffer::ReadCheckpoint(const std::string &filename) {
+    std::ifstream in(filename, std::ios::binary);
+    if (!in) return false;
+
+    char magic[sizeof(CheckpointMagic)];
+    int32_t header[3];
+    in.read(magic, sizeof(magic));
+    in.read((char *)header, sizeof(header));
+    if (!in || !std::equal(magic, magic + sizeof(magic), CheckpointMagic) ||
+        header[0] != CheckpointVersion || header[1] != resolution.x ||
+        header[2] != resolution.y) {
+        std::cerr << "Ignoring checkpoint \"" << filename
+                  << "\" written for a different image" << std::endl;
+        return false;
+    }
+
+    std::vector<int64_t> counts(nSamples.size());
+    std::vector<float> rgb(3 * Lsum.size()), mean(yMean.size()), m2(yM2.size());
+    in.read((char *)counts.data(), counts.size() * sizeof(int64_t));
+    in.read((char *)rgb.data(), rgb.size() * sizeof(float));
+    in.read((char *)mean.data(), mean.size() * sizeof(float));
+    in.read((char *)m2.data(), m2.size() * sizeof(float));
+    if (!in) {
+        std::cerr << "Ignoring truncated checkpoint \"" << filename << "\""
+                  << std::endl;
+        return false;
+    }
+    nSamples.swap(counts);
+    yMean.swap(mean);
+    yM2.swap(m2);
+    for (size_t i = 0; i < Lsum.size(); ++i)
+        Lsum[i] = Spectrum::FromRGB(&rgb[3 * i]);
+    return true;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "PBRender.h"
+#include "geometry.h"
+#include "spectrum.h"
+
+namespace PBRender {
+
+// ProgressiveOptions Declarations
+struct ProgressiveOptions {
+    // Wall-clock budget in seconds; the render runs to completion if <= 0
+    float timeBudget = 0;
+    // Checkpoints are written only if _checkpointFile_ is set
+    std::string checkpointFile;
+    float checkpointInterval = 300;
+    // Upper bound on the samples a pixel takes in one pass, which keeps the
+    // time between checkpoints bounded as the passes grow
+    int64_t maxPassSamples = 16;
+    // Adaptive sampling is enabled by a positive error threshold: after
+    // _adaptiveBaseSamples_ uniform samples, only pixels whose relative
+    // standard error exceeds the threshold keep sampling, up to the
+    // sampler's _samplesPerPixel_
+    float adaptiveThreshold = 0;
+    int64_t adaptiveBaseSamples = 16;
+};
+
+// AccumulationBuffer Declarations
+// Per-pixel sums of radiance estimates and sample counts. The count of a
+// pixel is also the index of its next sample in the sampler's sequence, so
+// a render restored from a checkpoint continues exactly where it stopped.
+// Welford's running mean and squared deviation of the sample luminance give
+// each pixel's variance for adaptive sampling.
+class AccumulationBuffer {
+    public:
+        AccumulationBuffer(const Point2i &resolution);
+
+        void AddSample(int offset, const Spectrum &L) {
+            Lsum[offset] += L;
+            int64_t n = ++nSamples[offset];
+            float y = L.y();
+            float delta = y - yMean[offset];
+            yMean[offset] += delta / n;
+            yM2[offset] += delta * (y - yMean[offset]);
+        }
+        float RelativeError(int offset) const;
+
+        int64_t MinSamples() const;
+        float MeanSamples() const;
+        void Resolve(std::vector<Spectrum> &col) const;
+
+        bool WriteCheckpoint(const std::string &filename) const;
+        bool ReadCheckpoint(const std::string &filename);
+
+        // AccumulationBuffer Public Data
+        const Point2i resolution;
+        std::vector<Spectrum> Lsum;
+        std::vector<int64_t> nSamples;
+        std::vector<float> yMean, yM2;
+};
+
+}
\ No newline at end of file
@@ -0,0 +1,127 @@
+#include "radiancecache.h"
+
+namespace PBRender {
+
+static const uint64_t invalidPackedCell = 0xffffffffffffffff;
+
+// Give up on a cell after this many probes, which only happens when the
+// table is close to full
+static const int maxProbes = 64;
+
+// RadianceCache Method Definitions
+RadianceCache::RadianceCache(const Bounds3f &b, int maxResolution,
+                             int maxCells, int minSamples)
+    : bounds(b), minSamples(std::max(minSamples, 1)), nCells(0) {
+    // Use roughly cubic cells, _maxResolution_ along the longest axis
+    Vector3f diag = bounds.Diagonal();
+    float maxExtent = std::max(diag.x, std::max(diag.y, diag.z));
+    maxResolution = Clamp(maxResolution, 1, (1 << 20) - 1);
+    int64_t nGridCells = 6;
+    for (int i = 0; i < 3; ++i) {
+        resolution[i] =
+            Clamp((int)std::ceil(maxResolution * diag[i] / maxExtent), 1,
+                  maxResolution);
+        nGridCells *= resolution[i];
+    }
+
+    // Keep the table at most half full
+    hashTableSize = 2 * (int)std::min(nGridCells, (int64_t)maxCells);
+    hashTable.reset(new HashEntry[hashTableSize]);
+    for (int i = 0; i < hashTableSize; ++i) {
+        hashTable[i].packedCell.store(invalidPackedCell);
+        hashTable[i].count.store(0);
+    }
+    radiance.assign(hashTableSize, Spectrum(0.f));
+    secondMoment.assign(hashTableSize, 0.f);
+    count.assign(hashTableSize, 0);
+}
+
+uint64_t RadianceCache::PackCell(const Point3f &p, const Normal3f &n) const {
+    // Pack the cell coordinates and the bin of the normal's major axis and
+    // sign into a single 64-bit value
+    Vector3f o = bounds.Offset(p);
+    uint64_t packedCell = 0;
+    for (int i = 0; i < 3; ++i)
+        packedCell = (packedCell << 20) |
+                     (uint64_t)Clamp((int)(o[i] * resolution[i]), 0,
+                                     resolution[i] - 1);
+    int axis = MaxDimension(Abs(Vector3f(n)));
+    uint64_t bin = 2 * axis + (n[axis] < 0 ? 1 : 0);
+    return (bin << 60) | packedCell;
+}
+
+// Mixes the bits of a packed cell so that neighboring cells are spread over
+// the table; see SpatialLightDistribution::Lookup()
+static int HashCell(uint64_t packedCell, int hashTableSize) {
+    uint64_t hash = packedCell;
+    hash ^= (hash >> 31);
+    hash *= 0x7fb5d329728ea185;
+    hash ^= (hash >> 27);
+    hash *= 0x81dadef4bc2dd44d;
+    hash ^= (hash >> 33);
+    return (int)(hash % hashTableSize);
+}
+
+int RadianceCache::FindEntry(uint64_t packedCell, bool insert) const {
+    // Probe quadratically, claiming the first empty entry with an atomic
+    // compare and exchange, so that threads recording into the same cell
+    // agree on its entry
+    int64_t hash = HashCell(packedCell, hashTableSize);
+    for (int step = 1; step <= maxProbes; ++step) {
+        HashEntry &entry = hashTable[hash];
+        uint64_t entryPackedCell =
+            entry.packedCell.load(std::memory_order_acquire);
+        if (entryPackedCell == packedCell) return (int)hash;
+        if (entryPackedCell == invalidPackedCell) {
+            if (!insert) return -1;
+            uint64_t invalid = invalidPackedCell;
+            if (entry.packedCell.compare_exchange_strong(invalid, packedCell))
+                return (int)hash;
+            // Another thread claimed the entry; it may have been for the
+            // same cell
+            if (invalid == packedCell) return (int)hash;
+        }
+        hash = (hash + step * step) % hashTableSize;
+    }
+    return -1;
+}
+
+int RadianceCache::CellCount() const { return nCells; }
+
+void RadianceCache::Record(const Point3f &p, const Normal3f &n,
+                           const Spectrum &L) {
+    if (L.HasNaNs() || std::isinf(L.y())) return;
+    int index = FindEntry(PackCell(p, n), true);
+    if (index < 0) return;
+    HashEntry &entry = hashTable[index];
+    for (int c = 0; c < Spectrum::nSamples; ++c) entry.sum[c].Add(L[c]);
+    entry.sumSquared.Add(L.y() * L.y());
+    entry.count.fetch_add(1, std::memory_order_relaxed);
+}
+
+void RadianceCache::Update() {
+    int n = 0;
+    #pragma omp parallel for reduction(+ : n)
+    for (int i = 0; i < hashTableSize; ++i) {
+        const HashEntry &entry = hashTable[i];
+        count[i] = entry.count.load(std::memory_order_relaxed);
+        if (count[i] == 0) continue;
+        for (int c = 0; c < Spectrum::nSamples; ++c)
+            radiance[i][c] = entry.sum[c] / count[i];
+        secondMoment[i] = entry.sumSquared / count[i];
+        ++n;
+    }
+    nCells = n;
+}
+
+bool RadianceCache::Lookup(const Point3f &p, const Normal3f &n, Spectrum *L,
+                           float *secondMoment, int *nSamples) const {
+    int index = FindEntry(PackCell(p, n), false);
+    if (index < 0 || count[index] < minSamples) return false;
+    *L = radiance[index];
+    if (secondMoment) *secondMoment = this->secondMoment[index];
+    if (nSamples) *nSamples = count[index];
+    return true;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "PBRender.h"
+#include "geometry.h"
+#include "spectrum.h"
+#include "parallel.h"
+
+#include <atomic>
+#include <vector>
+
+namespace PBRender {
+
+// RadianceCacheOptions Declarations
+struct RadianceCacheOptions {
+    // Number of diffuse bounces after which paths terminate into the cache;
+    // the cache is disabled if <= 0
+    int diffuseBounces = 0;
+    // Samples per pixel of the pass that fills the cache before rendering
+    int trainingSpp = 4;
+    // Trades bias for speed: the cells are 1/64th of the scene's longest
+    // axis at accuracy 1 and shrink in proportion to it, and a cell is only
+    // used once it holds _4 * accuracy_ samples. Lower accuracy blurs the
+    // indirect light over larger regions but lets more paths terminate.
+    float accuracy = 1;
+};
+
+// RadianceCache Declarations
+// Coarse estimate of the radiance that surfaces reflect, kept as the mean of
+// the recorded samples in the cells of a uniform grid over the scene bounds.
+// Every cell has a bin for each of the six major directions of the normal,
+// so the two sides of a thin surface don't share an estimate. Cells also
+// keep the second moment of the samples' luminance.
+//
+// Only cells that receive samples are stored, in a fixed-size hash table
+// that _Record()_ fills without locks, so any number of threads can record
+// at once. _Update()_ then computes the cells' means, which _Lookup()_ reads
+// concurrently until the next _Update()_.
+class RadianceCache {
+    public:
+        // RadianceCache Public Methods
+        RadianceCache(const Bounds3f &bounds, int maxResolution = 16,
+                      int maxCells = 1 << 18, int minSamples = 1);
+
+        // Samples that find the table full are dropped
+        void Record(const Point3f &p, const Normal3f &n, const Spectrum &L);
+        void Update();
+
+        // Returns false if fewer than _minSamples_ were recorded near _p_
+        // before the last _Update()_; _nSamples_ receives their number
+        bool Lookup(const Point3f &p, const Normal3f &n, Spectrum *L,
+                    float *secondMoment = nullptr,
+                    int *nSamples = nullptr) const;
+        int CellCount() const;
+
+    private:
+        // RadianceCache Private Methods
+        uint64_t PackCell(const Point3f &p, const Normal3f &n) const;
+        // Returns the entry of _packedCell_, or -1 if it isn't in the table.
+        // With _insert_, an empty entry is claimed for the cell if possible.
+        int FindEntry(uint64_t packedCell, bool insert) const;
+
+        // RadianceCache Private Data
+        Bounds3f bounds;
+        int resolution[3];
+        const int minSamples;
+
+        struct HashEntry {
+            std::atomic<uint64_t> packedCell;
+            AtomicFloat sum[Spectrum::nSamples];
+            AtomicFloat sumSquared;
+            std::atomic<int> count;
+        };
+        std::unique_ptr<HashEntry[]> hashTable;
+        int hashTableSize;
+
+        // Means of the entries as of the last _Update()_
+        std::vector<Spectrum> radiance;
+        std::vector<float> secondMoment;
+        std::vector<int> count;
+        int nCells;
+};
+
+}
\ No newline at end of file
@@ -216,9 +216,7 @@ class BSDF {
         void Add(std::shared_ptr<BxDF> b) {
             // CHECK_LT(nBxDFs, MaxBxDFs);
             assert(nBxDFs < MaxBxDFs);
-            // bxdfs[nBxDFs++] = b;
-            bxdfs.push_back(b);
-            nBxDFs++;
+            bxdfs[nBxDFs++] = b;
         }
 
         int NumComponents(BxDFType flags = BSDF_ALL) const;
@@ -260,8 +258,7 @@ class BSDF {
         const Vector3f ss, ts;
         int nBxDFs = 0;
         static constexpr int MaxBxDFs = 8;
-        // BxDF *bxdfs[MaxBxDFs];
-        std::vector<std::shared_ptr<BxDF>> bxdfs;
+        std::shared_ptr<BxDF> bxdfs[MaxBxDFs];
         friend class MixMaterial;
 };
 
@@ -2,6 +2,8 @@
 #include "geometry.h"
 #include "shape.h"
 
+#include "omp.h"
+
 namespace PBRender {
 
 // Sampling Function Definitions
@@ -123,18 +125,189 @@ Point2f UniformSampleTriangle(const Point2f &u) {
     return Point2f(1 - su0, u[1] * su0);
 }
 
-Distribution2D::Distribution2D(const float *func, int nu, int nv) {
-    pConditionalV.reserve(nv);
-    for (int v = 0; v < nv; ++v) {
-        // Compute conditional sampling distribution for $\tilde{v}$
-        pConditionalV.emplace_back(new Distribution1D(&func[v * nu], nu));
+std::array<float, 3> SampleSphericalTriangle(const std::array<Point3f, 3> &v,
+                                             const Point3f &p, const Point2f &u,
+                                             float *pdf) {
+    if (pdf) *pdf = 0;
+    // Compute vectors _a_, _b_, and _c_ to spherical triangle vertices
+    Vector3f a = Normalize(v[0] - p), b = Normalize(v[1] - p),
+             c = Normalize(v[2] - p);
+
+    // Compute normalized cross products of all direction pairs
+    Vector3f n_ab = Cross(a, b), n_bc = Cross(b, c), n_ca = Cross(c, a);
+    if (n_ab.LengthSquared() == 0 || n_bc.LengthSquared() == 0 ||
+        n_ca.LengthSquared() == 0)
+        return {};
+    n_ab = Normalize(n_ab);
+    n_bc = Normalize(n_bc);
+    n_ca = Normalize(n_ca);
+
+    // Find angles $\alpha$, $\beta$, and $\gamma$ at the vertices
+    float alpha = AngleBetween(n_ab, -n_ca);
+    float beta = AngleBetween(n_bc, -n_ab);
+    float gamma = AngleBetween(n_ca, -n_bc);
+
+    // Uniformly sample triangle area $A$ to compute $A'$
+    float A_pi = alpha + beta + gamma;
+    float Ap_pi = Lerp(u[0], Pi, A_pi);
+    float A = A_pi - Pi;
+    if (A <= 0) return {};
+    if (pdf) *pdf = 1 / A;
+
+    // Find $\cos\beta'$ for point along _b_ for sampled area
+    float cosAlpha = std::cos(alpha), sinAlpha = std::sin(alpha);
+    float sinPhi = std::sin(Ap_pi) * cosAlpha - std::cos(Ap_pi) * sinAlpha;
+    float cosPhi = std::cos(Ap_pi) * cosAlpha + std::sin(Ap_pi) * sinAlpha;
+    float k1 = cosPhi + cosAlpha;
+    float k2 = sinPhi - sinAlpha * Dot(a, b);
+    float cosBp = (k2 + (k2 * cosPhi - k1 * sinPhi) * cosAlpha) /
+                  ((k2 * sinPhi + k1 * cosPhi) * sinAlpha);
+    // Triangles covering nearly a whole hemisphere are left to the caller
+    if (std::isnan(cosBp)) {
+        if (pdf) *pdf = 0;
+        return {};
+    }
+    cosBp = Clamp(cosBp, -1, 1);
+
+    // Sample $c'$ along the arc between $a$ and $c$
+    float sinBp = SafeSqrt(1 - cosBp * cosBp);
+    Vector3f cp = cosBp * a + sinBp * Normalize(c - Dot(c, a) * a);
+
+    // Compute sampled spherical triangle direction
+    float cosTheta = 1 - u[1] * (1 - Dot(cp, b));
+    float sinTheta = SafeSqrt(1 - cosTheta * cosTheta);
+    Vector3f w = cosTheta * b + sinTheta * Normalize(cp - Dot(cp, b) * b);
+
+    // Find barycentric coordinates for sampled direction _w_
+    Vector3f e1 = v[1] - v[0], e2 = v[2] - v[0];
+    Vector3f s1 = Cross(w, e2);
+    float divisor = Dot(s1, e1);
+    if (divisor == 0) return {{1.f / 3.f, 1.f / 3.f, 1.f / 3.f}};
+    float invDivisor = 1 / divisor;
+    Vector3f s = p - v[0];
+    float b1 = Clamp(Dot(s, s1) * invDivisor, 0, 1);
+    float b2 = Clamp(Dot(w, Cross(s, e1)) * invDivisor, 0, 1);
+    if (b1 + b2 > 1) {
+        float sum = b1 + b2;
+        b1 /= sum;
+        b2 /= sum;
+    }
+    return {{1 - b1 - b2, b1, b2}};
+}
+
+Point2f InvertSphericalTriangleSample(const std::array<Point3f, 3> &v,
+                                      const Point3f &p, const Vector3f &w) {
+    // Compute vectors _a_, _b_, and _c_ to spherical triangle vertices
+    Vector3f a = Normalize(v[0] - p), b = Normalize(v[1] - p),
+             c = Normalize(v[2] - p);
+
+    // Compute normalized cross products of all direction pairs
+    Vector3f n_ab = Cross(a, b), n_bc = Cross(b, c), n_ca = Cross(c, a);
+    if (n_ab.LengthSquared() == 0 || n_bc.LengthSquared() == 0 ||
+        n_ca.LengthSquared() == 0)
+        return Point2f(0.5f, 0.5f);
+    n_ab = Normalize(n_ab);
+    n_bc = Normalize(n_bc);
+    n_ca = Normalize(n_ca);
+
+    float alpha = AngleBetween(n_ab, -n_ca);
+    float beta = AngleBetween(n_bc, -n_ab);
+    float gamma = AngleBetween(n_ca, -n_bc);
+
+    // Find vertex $c'$ along the $ac$ arc for _w_
+    Vector3f cp = Cross(Cross(b, w), Cross(c, a));
+    if (cp.LengthSquared() == 0) return Point2f(0.5f, 0.5f);
+    cp = Normalize(cp);
+    if (Dot(cp, a + c) < 0) cp = -cp;
+
+    // Invert uniform area sampling to find _u0_
+    float u0;
+    if (Dot(a, cp) > 0.99999847691f)  // within 0.1 degrees of _a_
+        u0 = 0;
+    else {
+        // Compute area $A'$ of the subtriangle $a b c'$
+        Vector3f n_cpb = Cross(cp, b), n_acp = Cross(a, cp);
+        if (n_cpb.LengthSquared() == 0 || n_acp.LengthSquared() == 0)
+            return Point2f(0.5f, 0.5f);
+        n_cpb = Normalize(n_cpb);
+        n_acp = Normalize(n_acp);
+        float Ap = alpha + AngleBetween(n_ab, n_cpb) +
+                   AngleBetween(n_acp, -n_cpb) - Pi;
+        float A = alpha + beta + gamma - Pi;
+        u0 = Ap / A;
+    }
+
+    // Invert arc sampling to find _u1_
+    float u1 = (1 - Dot(w, b)) / (1 - Dot(cp, b));
+    return Point2f(Clamp(u0, 0, 1), Clamp(u1, 0, 1));
+}
+
+float SampleLinear(float u, float a, float b) {
+    if (u == 0 && a == 0) return 0;
+    float x = u * (a + b) / (a + std::sqrt(Lerp(u, a * a, b * b)));
+    return std::min(x, OneMinusEpsilon);
+}
+
+Point2f SampleBilinear(const Point2f &u, const float w[4]) {
+    // Sample $y$ from the marginal, then $x$ from the conditional
+    Point2f p;
+    p.y = SampleLinear(u[1], w[0] + w[1], w[2] + w[3]);
+    p.x = SampleLinear(u[0], Lerp(p.y, w[0], w[2]), Lerp(p.y, w[1], w[3]));
+    return p;
+}
+
+float BilinearPdf(const Point2f &p, const float w[4]) {
+    if (p.x < 0 || p.x > 1 || p.y < 0 || p.y > 1) return 0;
+    if (w[0] + w[1] + w[2] + w[3] == 0) return 1;
+    return 4 *
+           ((1 - p[0]) * (1 - p[1]) * w[0] + p[0] * (1 - p[1]) * w[1] +
+            (1 - p[0]) * p[1] * w[2] + p[0] * p[1] * w[3]) /
+           (w[0] + w[1] + w[2] + w[3]);
+}
+
+void Distribution1D::BuildAliasTable() {
+    // Scale the probabilities so that their mean is one; a uniform table
+    // stands in for an all-zero function, as the CDF does
+    int n = Count();
+    std::vector<float> p(n);
+    for (int i = 0; i < n; ++i) p[i] = (funcInt > 0) ? func[i] / funcInt : 1;
+
+    // Pair each underfull bin with an overfull one (Vose's method)
+    alias.resize(n);
+    std::vector<int> under, over;
+    for (int i = 0; i < n; ++i) (p[i] < 1 ? under : over).push_back(i);
+    while (!under.empty() && !over.empty()) {
+        int u = under.back(), o = over.back();
+        under.pop_back();
+        alias[u] = {p[u], o};
+        // _o_ gives up the remainder of _u_'s bin
+        p[o] = (p[o] + p[u]) - 1;
+        if (p[o] < 1) {
+            over.pop_back();
+            under.push_back(o);
+        }
     }
+    // Whatever is left is full up to round-off error
+    for (int i : under) alias[i] = {1, i};
+    for (int i : over) alias[i] = {1, i};
+}
+
+Distribution2D::Distribution2D(const float *func, int nu, int nv,
+                               bool useAliasTables) {
+    // Compute conditional sampling distributions for $\tilde{v}$, in
+    // parallel for large images
+    pConditionalV.resize(nv);
+    #pragma omp parallel for schedule(dynamic, 16) if (nu * nv > 1 << 16)
+    for (int v = 0; v < nv; ++v)
+        pConditionalV[v].reset(
+            new Distribution1D(&func[v * nu], nu, useAliasTables));
+
     // Compute marginal sampling distribution $p[\tilde{v}]$
     std::vector<float> marginalFunc;
     marginalFunc.reserve(nv);
     for (int v = 0; v < nv; ++v)
         marginalFunc.push_back(pConditionalV[v]->funcInt);
-    pMarginal.reset(new Distribution1D(&marginalFunc[0], nv));
+    pMarginal.reset(new Distribution1D(&marginalFunc[0], nv, useAliasTables));
 }
 
 }
\ No newline at end of file
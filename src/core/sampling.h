@@ -5,6 +5,7 @@
 #include "rng.h"
 
 #include <algorithm>
+#include <array>
 
 namespace PBRender {
 
@@ -17,7 +18,11 @@ void LatinHypercube(float *samples, int nSamples, int nDim, RNG &rng);
 
 struct Distribution1D {
     // Distribution1D Public Methods
-    Distribution1D(const float *f, int n) : func(f, f + n), cdf(n + 1) {
+    // With _useAliasTable_ set, sampling looks the result up in an alias
+    // table in constant time instead of searching the CDF. The pdfs are
+    // the same, but the mapping from _u_ to samples is no longer monotonic.
+    Distribution1D(const float *f, int n, bool useAliasTable = false)
+        : func(f, f + n), cdf(n + 1) {
         // Compute integral of step function at $x_i$
         cdf[0] = 0;
         for (int i = 1; i < n + 1; ++i) cdf[i] = cdf[i - 1] + func[i - 1] / n;
@@ -29,9 +34,20 @@ struct Distribution1D {
         } else {
             for (int i = 1; i < n + 1; ++i) cdf[i] /= funcInt;
         }
+        if (useAliasTable) BuildAliasTable();
     }
     int Count() const { return (int)func.size(); }
     float SampleContinuous(float u, float *pdf, int *off = nullptr) const {
+        if (!alias.empty()) {
+            // Pick the segment from the alias table; the remapped sample
+            // gives the position inside it
+            float du;
+            int offset = SampleAlias(u, &du);
+            if (off) *off = offset;
+            if (pdf) *pdf = (funcInt > 0) ? func[offset] / funcInt : 0;
+            return (offset + du) / Count();
+        }
+
         // Find surrounding CDF segments and _offset_
         int offset = FindInterval((int)cdf.size(),
                                   [&](int index) { return cdf[index] <= u; });
@@ -52,6 +68,14 @@ struct Distribution1D {
     }
     int SampleDiscrete(float u, float *pdf = nullptr,
                        float *uRemapped = nullptr) const {
+        if (!alias.empty()) {
+            float du;
+            int offset = SampleAlias(u, &du);
+            if (pdf) *pdf = (funcInt > 0) ? func[offset] / (funcInt * Count()) : 0;
+            if (uRemapped) *uRemapped = du;
+            return offset;
+        }
+
         // Find surrounding CDF segments and _offset_
         int offset = FindInterval((int)cdf.size(),
                                   [&](int index) { return cdf[index] <= u; });
@@ -69,6 +93,33 @@ struct Distribution1D {
     // Distribution1D Public Data
     std::vector<float> func, cdf;
     float funcInt;
+
+  private:
+    // Distribution1D Private Methods
+    void BuildAliasTable();
+    int SampleAlias(float u, float *uRemapped) const {
+        // Split _u_ into a uniformly chosen bin and a position inside it
+        int n = Count();
+        float un = u * n;
+        int offset = std::min(int(un), n - 1);
+        float up = std::min(un - offset, OneMinusEpsilon);
+        const AliasBin &bin = alias[offset];
+        if (up < bin.q) {
+            *uRemapped = std::min(up / bin.q, OneMinusEpsilon);
+            return offset;
+        }
+        *uRemapped = std::min((up - bin.q) / (1 - bin.q), OneMinusEpsilon);
+        return bin.alias;
+    }
+
+    // Distribution1D Private Data
+    // Each bin keeps its own index with probability _q_ and otherwise
+    // redirects to _alias_
+    struct AliasBin {
+        float q;
+        int alias;
+    };
+    std::vector<AliasBin> alias;
 };
 
 Point2f RejectionSampleDisk(RNG &rng);
@@ -84,10 +135,26 @@ Point2f UniformSampleDisk(const Point2f &u);
 Point2f ConcentricSampleDisk(const Point2f &u);
 Point2f UniformSampleTriangle(const Point2f &u);
 
+// Samples a direction uniformly over the solid angle subtended by the
+// triangle _v_ as seen from _p_ and returns the barycentrics of the point it
+// hits; _InvertSphericalTriangleSample()_ maps a direction back to _u_.
+std::array<float, 3> SampleSphericalTriangle(const std::array<Point3f, 3> &v,
+                                             const Point3f &p, const Point2f &u,
+                                             float *pdf);
+Point2f InvertSphericalTriangleSample(const std::array<Point3f, 3> &v,
+                                      const Point3f &p, const Vector3f &w);
+
+// Bilinear distribution over $[0,1]^2$ with corner weights _w_ ordered
+// (0,0), (1,0), (0,1), (1,1)
+float SampleLinear(float u, float a, float b);
+Point2f SampleBilinear(const Point2f &u, const float w[4]);
+float BilinearPdf(const Point2f &p, const float w[4]);
+
 class Distribution2D {
   public:
     // Distribution2D Public Methods
-    Distribution2D(const float *data, int nu, int nv);
+    Distribution2D(const float *data, int nu, int nv,
+                   bool useAliasTables = false);
     Point2f SampleContinuous(const Point2f &u, float *pdf) const {
         float pdfs[2];
         int v;
@@ -110,6 +177,43 @@ class Distribution2D {
     std::unique_ptr<Distribution1D> pMarginal;
 };
 
+// WeightedReservoirSampler Declarations
+// Streams over candidates, keeping one of them with probability proportional
+// to its weight in constant space. _Merge()_ folds in the sample of another
+// reservoir that summarized _count_ candidates.
+template <typename T>
+class WeightedReservoirSampler {
+  public:
+    // WeightedReservoirSampler Public Methods
+    void Reset() {
+        weightSum = sampleWeight = 0;
+        count = 0;
+    }
+    bool Add(const T &sample, float weight, float u) {
+        return Merge(sample, weight, 1, u);
+    }
+    bool Merge(const T &sample, float weight, int64_t n, float u) {
+        count += n;
+        if (weight <= 0) return false;
+        weightSum += weight;
+        if (u * weightSum >= weight) return false;
+        reservoir = sample;
+        sampleWeight = weight;
+        return true;
+    }
+    bool HasSample() const { return sampleWeight > 0; }
+    const T &GetSample() const { return reservoir; }
+    float SampleProbability() const { return sampleWeight / weightSum; }
+    float WeightSum() const { return weightSum; }
+    int64_t Count() const { return count; }
+
+  private:
+    // WeightedReservoirSampler Private Data
+    T reservoir;
+    float weightSum = 0, sampleWeight = 0;
+    int64_t count = 0;
+};
+
 // Sampling Inline Functions
 template <typename T>
 void Shuffle(T *samp, int count, int nDimensions, RNG &rng) {
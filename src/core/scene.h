@@ -28,6 +28,14 @@ class Scene {
         bool IntersectP(const Ray &ray) const;
         bool IntersectTr(Ray ray, Sampler &sampler, SurfaceInteraction *isect,
                         Spectrum *transmittance) const;
+        // Calls _visit_ for the primitives whose bounds _overlaps_ accepts;
+        // see _Primitive::ForEachPrimitive()_
+        bool ForEachPrimitive(
+            const std::function<bool(const Bounds3f &)> &overlaps,
+            const std::function<bool(const GeometricPrimitive &)> &visit)
+            const {
+            return aggregate->ForEachPrimitive(overlaps, visit);
+        }
     
     public:
         // Scene Public Data
@@ -35,6 +43,8 @@ class Scene {
         // Store infinite light sources separately for cases where we only want
         // to loop over them.
         std::vector<std::shared_ptr<Light>> infiniteLights;
+        // Optional precomputed visibility of the lights, for static scenes
+        std::shared_ptr<const VisibilityCache> visibilityCache;
     
     private:
         // Scene Private Data
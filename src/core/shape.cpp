@@ -46,10 +46,14 @@ float Shape::Pdf(const Interaction &ref, const Vector3f &wi) const {
     // this intersection. Hack for the "San Miguel" scene, where this is used
     // to make an invisible area light.
     if (!Intersect(ray, &tHit, &isectLight, false)) return 0;
+    return Pdf(ref, wi, isectLight);
+}
 
+float Shape::Pdf(const Interaction &ref, const Vector3f &wi,
+                 const Interaction &pShape) const {
     // Convert light sample weight to solid angle measure
-    float pdf = DistanceSquared(ref.p, isectLight.p) /
-                (AbsDot(isectLight.n, -wi) * Area());
+    float pdf = DistanceSquared(ref.p, pShape.p) /
+                (AbsDot(pShape.n, -wi) * Area());
     if (std::isinf(pdf)) pdf = 0.f;
     return pdf;
 }
@@ -38,6 +38,11 @@ class Shape {
         virtual Interaction Sample(const Interaction &ref, const Point2f &u,
                                    float *pdf) const;
         virtual float Pdf(const Interaction &ref, const Vector3f &wi) const;
+        // Same as above for the point _pShape_ that the ray from _ref_ along
+        // _wi_ hits on the shape, which callers that already traced the ray
+        // pass in to spare the intersection
+        virtual float Pdf(const Interaction &ref, const Vector3f &wi,
+                          const Interaction &pShape) const;
 
         // Returns the solid angle subtended by the shape w.r.t. the reference
         // point p, given in world space. Some shapes compute this value in
@@ -46,6 +51,12 @@ class Shape {
         // used in this case.
         virtual float SolidAngle(const Point3f &p, int nSamples = 512) const;
 
+        // Returns a cone bounding the shape's surface normals; shapes that
+        // don't know better report the entire sphere of directions.
+        virtual DirectionCone NormalBounds() const {
+            return DirectionCone::EntireSphere();
+        }
+
         // Shape Public Data
         const Transform *ObjectToWorld, *WorldToObject;
         const bool reverseOrientation;
@@ -219,10 +219,10 @@ class CoefficientSpectrum {
             std::ostringstream ss;
             ss << "[ ";
 
-            for (size_t i = 0; i < nSpectralSamples; ++i)
+            for (size_t i = 0; i < nSpectrumSamples; ++i)
             {
                 ss << c[i];
-                if (i + 1 < nSpectralSamples) ss << ", ";
+                if (i + 1 < nSpectrumSamples) ss << ", ";
             }
 
             ss << " ]";
@@ -277,10 +277,10 @@ class CoefficientSpectrum {
         }
     
     public:
-        static const int nSamples = nSpectralSamples;
+        static const int nSamples = nSpectrumSamples;
     
     protected:
-        float c[nSpectralSamples];
+        float c[nSpectrumSamples];
 };
 
 class SampledSpectrum : public CoefficientSpectrum<nSpectralSamples> {
@@ -101,6 +101,12 @@ class Texture {
 public:
 	// Texture Interface
 	virtual T Evaluate(const SurfaceInteraction &) const = 0;
+	// Evaluates the texture at _n_ hits; textures with per-lookup setup
+	// override this to amortize it over the batch
+	virtual void EvaluateBatch(SurfaceInteraction *const *si, int n,
+	                           T *values) const {
+		for (int i = 0; i < n; ++i) values[i] = Evaluate(*si[i]);
+	}
 	virtual ~Texture() {}
 };
 
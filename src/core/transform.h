@@ -211,13 +211,12 @@ inline Ray Transform::operator()(const Ray &r) const {
     Point3f o = (*this)(r.o);
     Vector3f d = (*this)(r.d);
 
-    return Ray(o, d, r.tMax, r.time);
+    return Ray(o, d, r.tMax, r.time, r.medium);
 }
 
 inline RayDifferential Transform::operator()(const RayDifferential &r) const {
     Ray tr = (*this)(Ray(r));
-    // RayDifferential ret(tr.o, tr.d, tr.tMax, tr.time, tr.medium);
-    RayDifferential ret(tr.o, tr.d, tr.tMax, tr.time);
+    RayDifferential ret(tr.o, tr.d, tr.tMax, tr.time, tr.medium);
     ret.hasDifferentials = r.hasDifferentials;
     ret.rxOrigin = (*this)(r.rxOrigin);
     ret.ryOrigin = (*this)(r.ryOrigin);
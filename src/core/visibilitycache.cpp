@@ -0,0 +1,316 @@
+#include "visibilitycache.h"
+#include "interaction.h"
+#include "light.h"
+#include "lowdiscrepancy.h"
+#include "primitive.h"
+#include "scene.h"
+
+#include <algorithm>
+
+namespace PBRender {
+
+// Lines traced along each axis per voxel, in each of the other dimensions
+static const int linesPerVoxel = 2;
+
+// Plane of the points _p_ with Dot(n, p) == d
+struct Plane {
+    Vector3f n;
+    float d;
+};
+
+// Range of the signed distances of the points of _b_ from _plane_
+static void PlaneDistances(const Plane &plane, const Bounds3f &b, float *dMin,
+                           float *dMax) {
+    *dMin = *dMax = -plane.d;
+    for (int i = 0; i < 3; ++i) {
+        float d0 = plane.n[i] * b.pMin[i], d1 = plane.n[i] * b.pMax[i];
+        *dMin += std::min(d0, d1);
+        *dMax += std::max(d0, d1);
+    }
+}
+
+// Finds the plane of a primitive whose shape is flat
+static bool PrimitivePlane(const GeometricPrimitive &prim, Plane *plane) {
+    DirectionCone normals = prim.GetShape().NormalBounds();
+    if (normals.cosTheta < 1) return false;
+    float pdf;
+    Point3f p = prim.GetShape().Sample(Point2f(.5f, .5f), &pdf).p;
+    *plane = Plane{normals.w, Dot(normals.w, Vector3f(p))};
+    return true;
+}
+
+// Convex hull of two boxes, kept as its bounds and the planes of its faces
+// with their normals pointing out
+class Shaft {
+    public:
+        Shaft(const Bounds3f &b0, const Bounds3f &b1, float epsilon)
+            : bounds(Union(b0, b1)) {
+            std::vector<Point3f> p;
+            for (const Bounds3f &b : {b0, b1})
+                for (int c = 0; c < 8; ++c)
+                    if (std::find(p.begin(), p.end(), b.Corner(c)) == p.end())
+                        p.push_back(b.Corner(c));
+            // Keep the planes through three corners that have all of the
+            // corners on one side, padded by _epsilon_
+            for (size_t i = 0; i < p.size(); ++i)
+                for (size_t j = i + 1; j < p.size(); ++j)
+                    for (size_t k = j + 1; k < p.size(); ++k) {
+                        Vector3f n = Cross(p[j] - p[i], p[k] - p[i]);
+                        if (n.LengthSquared() == 0) continue;
+                        Plane plane{Normalize(n), 0};
+                        plane.d = Dot(plane.n, Vector3f(p[i]));
+                        float dMin = Infinity, dMax = -Infinity;
+                        for (const Point3f &q : p) {
+                            float d = Dot(plane.n, Vector3f(q)) - plane.d;
+                            dMin = std::min(dMin, d);
+                            dMax = std::max(dMax, d);
+                        }
+                        if (dMin >= -epsilon) plane = Plane{-plane.n, -plane.d};
+                        else if (dMax > epsilon) continue;
+                        plane.d += epsilon;
+                        bool duplicate = false;
+                        for (const Plane &f : faces)
+                            if (Dot(f.n, plane.n) > 1 - 1e-6f &&
+                                std::abs(f.d - plane.d) < epsilon)
+                                duplicate = true;
+                        if (!duplicate) faces.push_back(plane);
+                    }
+        }
+
+        // Only reports false if _b_ is entirely outside the hull
+        bool Overlaps(const Bounds3f &b) const {
+            if (!PBRender::Overlaps(bounds, b)) return false;
+            for (const Plane &face : faces) {
+                float dMin, dMax;
+                PlaneDistances(face, b, &dMin, &dMax);
+                if (dMin > 0) return false;
+            }
+            return true;
+        }
+
+    private:
+        Bounds3f bounds;
+        std::vector<Plane> faces;
+};
+
+// VisibilityCache Method Definitions
+VisibilityCache::VisibilityCache(const Scene &scene, int maxResolution,
+                                 int nLightSamples)
+    : bounds(scene.WorldBound()) {
+    // Use roughly cubic voxels, _maxResolution_ along the longest axis.
+    // The bounds are padded so that points on the scene's boundary don't
+    // fall outside due to roundoff error.
+    Vector3f diag = bounds.Diagonal();
+    float maxExtent = std::max(diag.x, std::max(diag.y, diag.z));
+    bounds = Expand(bounds, 1e-3f * maxExtent);
+    diag = bounds.Diagonal();
+    for (int i = 0; i < 3; ++i)
+        resolution[i] =
+            Clamp((int)std::ceil(maxResolution * diag[i] / maxExtent), 1,
+                  maxResolution);
+    int nVoxels = resolution[0] * resolution[1] * resolution[2];
+
+    // Only lights with a position are cached
+    std::vector<const Light *> lights;
+    for (const auto &light : scene.lights)
+        if (light->flags &
+            ((int)LightFlags::Area | (int)LightFlags::DeltaPosition)) {
+            lightToIndex[light.get()] = (int)lights.size();
+            lights.push_back(light.get());
+        }
+    visibility.assign(lights.size() * nVoxels, LightVisibility::Penumbra);
+    if (lights.empty()) return;
+
+    // Find the surface points along lines parallel to each axis
+    std::vector<std::vector<Interaction>> voxelPoints(nVoxels);
+    for (int axis = 0; axis < 3; ++axis) {
+        int u = (axis + 1) % 3, v = (axis + 2) % 3;
+        int nu = linesPerVoxel * resolution[u];
+        int nv = linesPerVoxel * resolution[v];
+        std::vector<std::vector<Interaction>> lineHits(nu * nv);
+        #pragma omp parallel for schedule(dynamic, 16)
+        for (int line = 0; line < nu * nv; ++line) {
+            Point3f o;
+            o[axis] = bounds.pMin[axis] - diag[axis];
+            o[u] = Lerp((line % nu + .5f) / nu, bounds.pMin[u],
+                        bounds.pMax[u]);
+            o[v] = Lerp((line / nu + .5f) / nv, bounds.pMin[v],
+                        bounds.pMax[v]);
+            Vector3f d(0, 0, 0);
+            d[axis] = 1;
+            Ray ray(o, d);
+            SurfaceInteraction isect;
+            while (scene.Intersect(ray, &isect)) {
+                lineHits[line].push_back(isect);
+                ray = isect.SpawnRay(d);
+            }
+        }
+        for (const std::vector<Interaction> &hits : lineHits)
+            for (const Interaction &it : hits) {
+                Point3i voxel;
+                if (Voxel(it.p, &voxel))
+                    voxelPoints[Index(voxel)].push_back(it);
+            }
+    }
+
+    // Trace shadow rays to every light from the points of each voxel. A
+    // voxel can only be proven lit if all of them reach the light and
+    // occluded if none do, so only that proof is attempted, and voxels
+    // whose rays disagree are left in the penumbra as soon as they do.
+    #pragma omp parallel for schedule(dynamic, 4)
+    for (int index = 0; index < nVoxels; ++index) {
+        if (voxelPoints[index].empty()) continue;
+        Point3i voxel(index % resolution[0],
+                      (index / resolution[0]) % resolution[1],
+                      index / (resolution[0] * resolution[1]));
+        for (size_t l = 0; l < lights.size(); ++l) {
+            int nReached = 0, nOccluded = 0;
+            for (const Interaction &it : voxelPoints[index]) {
+                for (int i = 0; i < nLightSamples; ++i) {
+                    Point2f uLight((i + .5f) / nLightSamples,
+                                   RadicalInverse(0, i));
+                    Vector3f wi;
+                    float pdf;
+                    VisibilityTester vis;
+                    Spectrum Li =
+                        lights[l]->Sample_Li(it, uLight, &wi, &pdf, &vis);
+                    if (pdf == 0 || Li.IsBlack()) continue;
+                    if (vis.Unoccluded(scene))
+                        ++nReached;
+                    else
+                        ++nOccluded;
+                    if (nReached > 0 && nOccluded > 0) break;
+                }
+                if (nReached > 0 && nOccluded > 0) break;
+            }
+            if ((nReached > 0) == (nOccluded > 0)) continue;
+            LightVisibility candidate = nOccluded == 0
+                                            ? LightVisibility::Lit
+                                            : LightVisibility::Occluded;
+            visibility[l * nVoxels + index] =
+                Classify(scene, *lights[l], VoxelBounds(voxel), candidate);
+        }
+    }
+}
+
+LightVisibility VisibilityCache::Classify(const Scene &scene,
+                                          const Light &light,
+                                          const Bounds3f &voxelBounds,
+                                          LightVisibility candidate) const {
+    LightBounds lightBounds;
+    if (!light.Bounds(&lightBounds)) return LightVisibility::Penumbra;
+
+    // Pad the voxel and the light's bounds so that they contain the
+    // offset origins and targets of shadow rays; _epsilon_ bounds the
+    // roundoff error of the plane tests
+    float maxExtent = MaxComponent(bounds.Diagonal());
+    float epsilon = 1e-6f * maxExtent;
+    Bounds3f b = Expand(voxelBounds, 1e-4f * maxExtent);
+    Bounds3f lb = Expand(lightBounds.bounds, 1e-4f * maxExtent);
+    auto side = [&](const Plane &plane, const Bounds3f &box) {
+        float dMin, dMax;
+        PlaneDistances(plane, box, &dMin, &dMax);
+        return dMin > epsilon ? 1 : (dMax < -epsilon ? -1 : 0);
+    };
+    auto inPlane = [&](const Plane &plane, const Bounds3f &box) {
+        float dMin, dMax;
+        PlaneDistances(plane, box, &dMin, &dMax);
+        return dMin >= -epsilon && dMax <= epsilon;
+    };
+
+    // Gather the primitives that may block a segment from the voxel to the
+    // light
+    Shaft shaft(b, lb, epsilon);
+    std::vector<const GeometricPrimitive *> prims;
+    scene.ForEachPrimitive(
+        [&](const Bounds3f &primBounds) { return shaft.Overlaps(primBounds); },
+        [&](const GeometricPrimitive &prim) {
+            prims.push_back(&prim);
+            return true;
+        });
+
+    // Segments to a planar light meet its plane only at their end, unless
+    // they start in it
+    Plane lightPlane;
+    bool haveLightPlane = false;
+    for (const GeometricPrimitive *prim : prims)
+        if ((const Light *)prim->GetAreaLight() == &light &&
+            PrimitivePlane(*prim, &lightPlane) && side(lightPlane, b) != 0)
+            haveLightPlane = true;
+
+    // The voxel is lit if the other primitives all lie in one plane that
+    // the light is strictly on one side of: the segments leave it at their
+    // origin and never return
+    if (candidate == LightVisibility::Lit) {
+        bool haveReceiverPlane = false;
+        Plane receiverPlane;
+        for (const GeometricPrimitive *prim : prims) {
+            Bounds3f primBounds = prim->WorldBound();
+            if (haveLightPlane && inPlane(lightPlane, primBounds)) continue;
+            if (!haveReceiverPlane) {
+                if (!PrimitivePlane(*prim, &receiverPlane) ||
+                    side(receiverPlane, lb) == 0)
+                    return LightVisibility::Penumbra;
+                haveReceiverPlane = true;
+            }
+            if (!inPlane(receiverPlane, primBounds))
+                return LightVisibility::Penumbra;
+        }
+        return LightVisibility::Lit;
+    }
+
+    // The voxel is occluded if a flat, and so convex, opaque primitive
+    // separates it from the light and is crossed by the segments between
+    // all of their corners: any other segment crosses its plane inside the
+    // convex hull of those crossings
+    for (const GeometricPrimitive *prim : prims) {
+        Plane plane;
+        if (!prim->GetMaterial() || !PrimitivePlane(*prim, &plane)) continue;
+        int voxelSide = side(plane, b);
+        if (voxelSide == 0 || side(plane, lb) != -voxelSide) continue;
+        bool blocked = true;
+        for (int i = 0; i < 8 && blocked; ++i)
+            for (int j = 0; j < 8 && blocked; ++j) {
+                Point3f p0 = b.Corner(i), p1 = lb.Corner(j);
+                if (!prim->IntersectP(Ray(p0, p1 - p0, 1.f))) blocked = false;
+            }
+        if (blocked) return LightVisibility::Occluded;
+    }
+    return LightVisibility::Penumbra;
+}
+
+int VisibilityCache::Index(const Point3i &voxel) const {
+    return voxel.x + resolution[0] * (voxel.y + resolution[1] * voxel.z);
+}
+
+Bounds3f VisibilityCache::VoxelBounds(const Point3i &voxel) const {
+    Vector3f diag = bounds.Diagonal();
+    Point3f pMin, pMax;
+    for (int i = 0; i < 3; ++i) {
+        pMin[i] = bounds.pMin[i] + diag[i] * voxel[i] / resolution[i];
+        pMax[i] = bounds.pMin[i] + diag[i] * (voxel[i] + 1) / resolution[i];
+    }
+    return Bounds3f(pMin, pMax);
+}
+
+bool VisibilityCache::Voxel(const Point3f &p, Point3i *voxel) const {
+    if (!Inside(p, bounds)) return false;
+    Vector3f o = bounds.Offset(p);
+    for (int i = 0; i < 3; ++i)
+        (*voxel)[i] = Clamp((int)(o[i] * resolution[i]), 0, resolution[i] - 1);
+    return true;
+}
+
+LightVisibility VisibilityCache::Lookup(const Light &light,
+                                        const Interaction &it) const {
+    auto iter = lightToIndex.find(&light);
+    Point3i voxel;
+    if (iter == lightToIndex.end() || !it.IsSurfaceInteraction() ||
+        !Voxel(it.p, &voxel))
+        return LightVisibility::Penumbra;
+    return visibility[iter->second * resolution[0] * resolution[1] *
+                          resolution[2] +
+                      Index(voxel)];
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "PBRender.h"
+#include "geometry.h"
+
+#include <unordered_map>
+#include <vector>
+
+namespace PBRender {
+
+// LightVisibility Declarations
+enum class LightVisibility : uint8_t { Penumbra, Lit, Occluded };
+
+// VisibilityCache Declarations
+// Precomputed visibility of the scene's area and point lights for static
+// scenes. Surface points are found along a dense set of axis-aligned lines
+// through the scene and binned into the voxels of a uniform grid; from each
+// one, up to _nLightSamples_ light samples are tested with shadow rays.
+//
+// The shadow rays only choose which proof to attempt for a voxel, over
+// the shaft, the convex hull of the voxel and the light's bounds. If all
+// of them reached the light, the voxel is lit if every primitive in the
+// shaft lies in the plane of a planar light or in a single plane that the
+// light's bounds are strictly on one side of, so that no segment between
+// a surface point of the voxel and the light can be blocked. If none did,
+// it is occluded if a single planar primitive whose plane separates the
+// voxel from the light is crossed by the segments between all of their
+// corners, and so by every segment between them. Everything else,
+// including voxels whose rays disagree, is penumbra, where shadow rays are
+// still traced.
+class VisibilityCache {
+    public:
+        // VisibilityCache Public Methods
+        VisibilityCache(const Scene &scene, int maxResolution = 32,
+                        int nLightSamples = 16);
+
+        // Classifies the light samples from _it_; lights that aren't cached
+        // are always in the penumbra
+        LightVisibility Lookup(const Light &light, const Interaction &it) const;
+
+    private:
+        // VisibilityCache Private Methods
+        int Index(const Point3i &voxel) const;
+        bool Voxel(const Point3f &p, Point3i *voxel) const;
+        Bounds3f VoxelBounds(const Point3i &voxel) const;
+        // Attempts to prove that the voxel is _candidate_, either lit or
+        // occluded, and returns the penumbra if it can't
+        LightVisibility Classify(const Scene &scene, const Light &light,
+                                 const Bounds3f &voxelBounds,
+                                 LightVisibility candidate) const;
+
+        // VisibilityCache Private Data
+        Bounds3f bounds;
+        int resolution[3];
+        std::unordered_map<const Light *, int> lightToIndex;
+        // Per light and voxel
+        std::vector<LightVisibility> visibility;
+};
+
+}
\ No newline at end of file
@@ -0,0 +1,12 @@
+#include "filters/box.h"
+
+namespace PBRender {
+
+// BoxFilter Method Definitions
+float BoxFilter::Evaluate1D(float x, int axis) const { return 1.; }
+
+BoxFilter *CreateBoxFilter(const Vector2f &radius) {
+    return new BoxFilter(radius);
+}
+
+}
\ No newline at end of file
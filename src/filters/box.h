@@ -0,0 +1,17 @@
+#pragma once
+
+#include "PBRender.h"
+#include "filter.h"
+
+namespace PBRender {
+
+// BoxFilter Declarations
+class BoxFilter : public Filter {
+    public:
+        BoxFilter(const Vector2f &radius) : Filter(radius) {}
+        float Evaluate1D(float x, int axis) const;
+};
+
+BoxFilter *CreateBoxFilter(const Vector2f &radius = Vector2f(.5f, .5f));
+
+}
\ No newline at end of file
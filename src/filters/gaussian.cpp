@@ -0,0 +1,10 @@
+#include "filters/gaussian.h"
+
+namespace PBRender {
+
+// GaussianFilter Method Definitions
+GaussianFilter *CreateGaussianFilter(const Vector2f &radius, float alpha) {
+    return new GaussianFilter(radius, alpha);
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "PBRender.h"
+#include "filter.h"
+
+#include <algorithm>
+
+namespace PBRender {
+
+// GaussianFilter Declarations
+class GaussianFilter : public Filter {
+    public:
+        // GaussianFilter Public Methods
+        GaussianFilter(const Vector2f &radius, float alpha)
+            : Filter(radius),
+              alpha(alpha),
+              expX(std::exp(-alpha * radius.x * radius.x)),
+              expY(std::exp(-alpha * radius.y * radius.y)) {}
+
+        float Evaluate1D(float x, int axis) const {
+            return Gaussian(x, axis == 0 ? expX : expY);
+        }
+
+    private:
+        // GaussianFilter Private Data
+        const float alpha;
+        const float expX, expY;
+
+        // GaussianFilter Utility Functions
+        float Gaussian(float d, float expv) const {
+            return std::max((float)0, float(std::exp(-alpha * d * d) - expv));
+        }
+};
+
+GaussianFilter *CreateGaussianFilter(const Vector2f &radius = Vector2f(1.5f, 1.5f),
+                                     float alpha = 2.f);
+
+}
\ No newline at end of file
@@ -0,0 +1,10 @@
+#include "filters/mitchell.h"
+
+namespace PBRender {
+
+// MitchellFilter Method Definitions
+MitchellFilter *CreateMitchellFilter(const Vector2f &radius, float B, float C) {
+    return new MitchellFilter(radius, B, C);
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "PBRender.h"
+#include "filter.h"
+
+namespace PBRender {
+
+// MitchellFilter Declarations
+class MitchellFilter : public Filter {
+    public:
+        // MitchellFilter Public Methods
+        MitchellFilter(const Vector2f &radius, float B, float C)
+            : Filter(radius), B(B), C(C) {}
+
+        float Evaluate1D(float x, int axis) const {
+            return Mitchell1D(x * invRadius[axis]);
+        }
+
+        float Mitchell1D(float x) const {
+            x = std::abs(2 * x);
+            if (x > 1)
+                return ((-B - 6 * C) * x * x * x + (6 * B + 30 * C) * x * x +
+                        (-12 * B - 48 * C) * x + (8 * B + 24 * C)) *
+                       (1.f / 6.f);
+            else
+                return ((12 - 9 * B - 6 * C) * x * x * x +
+                        (-18 + 12 * B + 6 * C) * x * x + (6 - 2 * B)) *
+                       (1.f / 6.f);
+        }
+
+    private:
+        const float B, C;
+};
+
+MitchellFilter *CreateMitchellFilter(const Vector2f &radius = Vector2f(2.f, 2.f),
+                                     float B = 1.f / 3.f, float C = 1.f / 3.f);
+
+}
\ No newline at end of file
@@ -0,0 +1,371 @@
+#include "integrators/adrrs.h"
+#include "camera.h"
+#include "film.h"
+#include "filters/box.h"
+#include "interaction.h"
+#include "scene.h"
+
+namespace PBRender {
+
+// Radiance is only recorded for this many vertices of a path
+static const int MaxRecordedVertices = 32;
+
+// Split continuations of a path that are waiting to be traced
+static const int MaxPendingBranches = 32;
+
+// Paths below the weight window survive roulette at least this often, which
+// bounds the weight a survivor gains where the cache is wrong
+static const float MinSurvivalProbability = .5f;
+
+// ADRRS Local Declarations
+struct RecordedVertex {
+    Point3f p;
+    Normal3f n;
+    // Path throughput up to this vertex
+    Spectrum throughput;
+    // Radiance reflected toward the previous vertex by the rest of the path,
+    // accumulated as the path continues
+    Spectrum radiance;
+};
+
+struct PathBranch {
+    RayDifferential ray;
+    Spectrum beta;
+    float etaScale;
+    int bounces;
+    bool specularBounce, split;
+};
+
+// Sampler for the continuations split off a path and for the window's
+// roulette. They use independent random numbers, since a tree of paths
+// would run through the dimensions of a low-discrepancy sampler.
+class SplitSampler : public Sampler {
+    public:
+        SplitSampler(uint64_t sequenceIndex)
+            : Sampler(1), rng(sequenceIndex) {}
+        float Get1D() { return rng.UniformFloat(); }
+        Point2f Get2D() {
+            float u = rng.UniformFloat();
+            return Point2f(u, rng.UniformFloat());
+        }
+        std::unique_ptr<Sampler> Clone(int seed) {
+            return std::unique_ptr<Sampler>(new SplitSampler(seed));
+        }
+
+    private:
+        RNG rng;
+};
+
+// ADRRSPathIntegrator Method Definitions
+ADRRSPathIntegrator::ADRRSPathIntegrator(
+    int maxDepth, std::shared_ptr<const Camera> camera,
+    std::shared_ptr<Sampler> sampler, const Bounds2i &pixelBounds,
+    float rrThreshold, const std::string &lightSampleStrategy, int trainingSpp,
+    float windowWidth, int maxSplit, int minCacheSamples)
+    : camera(camera),
+      sampler(sampler),
+      pixelBounds(pixelBounds),
+      maxDepth(maxDepth),
+      rrThreshold(rrThreshold),
+      lightSampleStrategy(lightSampleStrategy),
+      trainingSpp(trainingSpp),
+      windowWidth(std::max(windowWidth, 1.f)),
+      maxSplit(Clamp(maxSplit, 1, MaxPendingBranches)),
+      minCacheSamples(minCacheSamples) {}
+
+void ADRRSPathIntegrator::Preprocess(const Scene &scene) {
+    lightDistribution =
+        CreateLightSampleDistribution(lightSampleStrategy, scene);
+    radianceCache.reset(new RadianceCache(scene.WorldBound(), 16, 1 << 18,
+                                          minCacheSamples));
+    pixelEstimate.assign(pixelBounds.Area(), 0.f);
+}
+
+void ADRRSPathIntegrator::Render(const Scene &scene,
+                                 std::vector<Spectrum> &col) {
+    int rasterX = pixelBounds.pMax.x - pixelBounds.pMin.x;
+    int rasterY = pixelBounds.pMax.y - pixelBounds.pMin.y;
+    std::unique_ptr<Filter> filter(CreateBoxFilter());
+    Film film(Point2i(rasterX, rasterY), std::move(filter));
+
+    Render(scene, film);
+    film.GetImage(col);
+}
+
+void ADRRSPathIntegrator::Render(const Scene &scene, Film &film) {
+    Preprocess(scene);
+
+    // Train on at most half of the samples
+    int64_t spp = sampler->samplesPerPixel;
+    int64_t nTraining = std::min((int64_t)trainingSpp, spp / 2);
+    if (nTraining > 0) {
+        RenderPass(scene, &film, 0, nTraining, true);
+        radianceCache->Update();
+
+        // Smooth the pixels' second moments over 3x3 neighborhoods, which
+        // keeps a few unlucky training samples from setting a pixel's window,
+        // and keep their roots
+        int width = pixelBounds.pMax.x - pixelBounds.pMin.x;
+        int height = pixelBounds.pMax.y - pixelBounds.pMin.y;
+        std::vector<float> smoothed(pixelEstimate.size());
+        for (int y = 0; y < height; ++y)
+            for (int x = 0; x < width; ++x) {
+                float sum = 0;
+                int n = 0;
+                for (int dy = -1; dy <= 1; ++dy)
+                    for (int dx = -1; dx <= 1; ++dx) {
+                        int xx = x + dx, yy = y + dy;
+                        if (xx < 0 || xx >= width || yy < 0 || yy >= height)
+                            continue;
+                        sum += pixelEstimate[xx + yy * width];
+                        ++n;
+                    }
+                smoothed[x + y * width] = std::sqrt(sum / n);
+            }
+        pixelEstimate.swap(smoothed);
+        std::cout << "ADRRS training pass with " << nTraining << " spp, "
+                  << radianceCache->CellCount() << " cache cells" << std::endl;
+    }
+
+    RenderPass(scene, &film, nTraining, spp - nTraining, false);
+    std::cout << "Rendering is finished!" << std::endl;
+}
+
+void ADRRSPathIntegrator::RenderPass(
+    const Scene &scene, Film *film, int64_t firstSample, int64_t nSamples,
+    bool training) {
+    // Compute number of tiles to use for parallel rendering
+    Bounds2i sampleBounds = Intersect(film->GetSampleBounds(), pixelBounds);
+    Vector2i sampleExtent = sampleBounds.Diagonal();
+    const int tileSize = 16;
+    Point2i nTiles((sampleExtent.x + tileSize - 1) / tileSize,
+                   (sampleExtent.y + tileSize - 1) / tileSize);
+    int nTotalTiles = nTiles.x * nTiles.y;
+    int width = pixelBounds.pMax.x - pixelBounds.pMin.x;
+    float diffScale = 1 / std::sqrt((float)sampler->samplesPerPixel);
+
+    #pragma omp parallel for schedule(dynamic)
+    for (int tile = 0; tile < nTotalTiles; ++tile) {
+        int tileX = tile % nTiles.x, tileY = tile / nTiles.x;
+        std::unique_ptr<Sampler> tileSampler = sampler->Clone(tile);
+        SplitSampler splitSampler(tile);
+
+        // Compute sample bounds for tile
+        int x0 = sampleBounds.pMin.x + tileX * tileSize;
+        int x1 = std::min(x0 + tileSize, sampleBounds.pMax.x);
+        int y0 = sampleBounds.pMin.y + tileY * tileSize;
+        int y1 = std::min(y0 + tileSize, sampleBounds.pMax.y);
+        Bounds2i tileBounds(Point2i(x0, y0), Point2i(x1, y1));
+        std::unique_ptr<FilmTile> filmTile = film->GetFilmTile(tileBounds);
+
+        for (Point2i pixel : tileBounds) {
+            // Pixels belong to a single tile, so the estimates are written
+            // directly
+            float &estimate = pixelEstimate[(pixel.x - pixelBounds.pMin.x) +
+                                            (pixel.y - pixelBounds.pMin.y) *
+                                                width];
+            tileSampler->StartPixel(pixel);
+            tileSampler->SetSampleNumber(firstSample);
+            for (int64_t i = 0; i < nSamples; ++i) {
+                if (i > 0) tileSampler->StartNextSample();
+                CameraSample cameraSample = tileSampler->GetCameraSample(pixel);
+
+                RayDifferential ray;
+                float rayWeight =
+                    camera->GenerateRayDifferential(cameraSample, &ray);
+                ray.ScaleDifferentials(diffScale);
+
+                Spectrum L(0.f);
+                if (rayWeight > 0)
+                    L = Li(ray, scene, *tileSampler, splitSampler, estimate,
+                           training);
+                if (training && !L.HasNaNs() && !std::isinf(L.y()))
+                    estimate += L.y() * L.y() / nSamples;
+                filmTile->AddSample(cameraSample.pFilm, L, rayWeight);
+            }
+        }
+
+        film->MergeFilmTile(std::move(filmTile));
+    }
+}
+
+Spectrum ADRRSPathIntegrator::Li(const RayDifferential &r, const Scene &scene,
+                                 Sampler &pathSampler, Sampler &splitSampler,
+                                 float pixelEstimate, bool training) const {
+    Spectrum L(0.f);
+
+    // Vertices whose reflected radiance is recorded for training. This and
+    // the branch stack are left uninitialized, since constructing them for
+    // every camera sample took a noticeable share of the time.
+    RecordedVertex *vertices = ALLOCA(RecordedVertex, MaxRecordedVertices);
+    int nVertices = 0;
+    auto addRadiance = [&](const Spectrum &contribution) {
+        L += contribution;
+        for (int i = 0; i < nVertices; ++i)
+            for (int c = 0; c < Spectrum::nSamples; ++c)
+                if (vertices[i].throughput[c] > 0)
+                    vertices[i].radiance[c] +=
+                        contribution[c] / vertices[i].throughput[c];
+    };
+
+    // Trace the path and, depth first, the continuations split off from it
+    PathBranch *branches = ALLOCA(PathBranch, MaxPendingBranches);
+    int nBranches = 0;
+    PathBranch path = {r, Spectrum(1.f), 1.f, 0, false, false};
+    while (true) {
+        Sampler &sampler = path.split ? splitSampler : pathSampler;
+        while (true) {
+            // Intersect _ray_ with scene and store intersection in _isect_
+            SurfaceInteraction isect;
+            bool foundIntersection = scene.Intersect(path.ray, &isect);
+
+            // Possibly add emitted light at intersection
+            if (path.bounces == 0 || path.specularBounce) {
+                if (foundIntersection)
+                    addRadiance(path.beta * isect.Le(-path.ray.d));
+                else
+                    for (const auto &light : scene.infiniteLights)
+                        addRadiance(path.beta * light->Le(path.ray));
+            }
+
+            // Terminate path if ray escaped or _maxDepth_ was reached
+            if (!foundIntersection || path.bounces >= maxDepth) break;
+
+            // Compute scattering functions and skip over medium boundaries
+            isect.ComputeScatteringFunctions(path.ray, true);
+            if (!isect.bsdf) {
+                path.ray = isect.SpawnRay(path.ray.d);
+                continue;
+            }
+            bool nonSpecular =
+                isect.bsdf->NumComponents(BxDFType(BSDF_ALL & ~BSDF_SPECULAR)) >
+                0;
+            Normal3f n = Faceforward(isect.n, isect.wo);
+
+            // Sample illumination from lights to find path contribution
+            if (nonSpecular)
+                addRadiance(path.beta *
+                            UniformSampleOneLight(isect, scene, sampler,
+                                                  *lightDistribution));
+
+            // Remember the vertex to record the radiance that its
+            // continuation brings back, which is what splitting multiplies
+            if (training && nonSpecular && nVertices < MaxRecordedVertices)
+                vertices[nVertices++] = {isect.p, n, path.beta,
+                                         Spectrum(0.f)};
+
+            // Compare the contribution of the path's continuation with the
+            // pixel estimate to decide how many continuations to trace. Both
+            // are measured by the root of their second moment rather than
+            // their mean, which keeps rare but bright continuations such as
+            // caustics from being terminated.
+            int nSplit = 1;
+            bool windowed = false;
+            Spectrum Lr;
+            float LrSecondMoment;
+            int nCached;
+            if (!training && nonSpecular && pixelEstimate > 0 &&
+                radianceCache->Lookup(isect.p, n, &Lr, &LrSecondMoment,
+                                      &nCached)) {
+                windowed = true;
+                float importance = std::sqrt(LrSecondMoment);
+                float lower = importance > 0 ? 2 * pixelEstimate /
+                                                   (importance *
+                                                    (1 + windowWidth))
+                                             : Infinity;
+                float upper = windowWidth * lower;
+
+                // Widen the window by two standard errors of the cell's
+                // estimate, so that paths are only terminated or split as
+                // far as the cache can be trusted
+                float mean = Lr.y();
+                if (mean > 0) {
+                    float relativeError =
+                        std::sqrt(std::max(LrSecondMoment - mean * mean, 0.f) /
+                                  nCached) /
+                        mean;
+                    lower /= 1 + 2 * relativeError;
+                    upper *= 1 + 2 * relativeError;
+                }
+
+                // Roulette uses the independent sampler too, which leaves
+                // the path's low-discrepancy dimensions where the plain path
+                // tracer has them
+                float w = path.beta.y();
+                if (w < lower) {
+                    // Terminate with probability that brings the survivors'
+                    // throughput toward the window
+                    float q = std::max(w / lower, MinSurvivalProbability);
+                    if (splitSampler.Get1D() >= q) break;
+                    path.beta /= q;
+                } else if (w > upper) {
+                    nSplit = std::min({(int)std::ceil(w / upper), maxSplit,
+                                       MaxPendingBranches - nBranches + 1});
+                }
+            }
+
+            // Sample BSDF to get the directions of the continuations
+            Vector3f wo = -path.ray.d;
+            PathBranch vertex = path;
+            bool followed = false;
+            for (int i = 0; i < nSplit; ++i) {
+                Vector3f wi;
+                float pdf;
+                BxDFType flags;
+                bool split = vertex.split || i > 0;
+                Sampler &branchSampler = i > 0 ? splitSampler : sampler;
+                Spectrum f = isect.bsdf->Sample_f(wo, &wi,
+                                                  branchSampler.Get2D(), &pdf,
+                                                  BSDF_ALL, &flags);
+                if (f.IsBlack() || pdf == 0.f) continue;
+                PathBranch branch = {
+                    isect.SpawnRay(wi),
+                    vertex.beta * f * AbsDot(wi, isect.shading.n) /
+                        (pdf * nSplit),
+                    vertex.etaScale, vertex.bounces + 1,
+                    (flags & BSDF_SPECULAR) != 0, split};
+                assert(!std::isinf(branch.beta.y()));
+                if ((flags & BSDF_SPECULAR) && (flags & BSDF_TRANSMISSION)) {
+                    float eta = isect.bsdf->eta;
+                    // Update the term that tracks radiance scaling for
+                    // refraction
+                    branch.etaScale *= (Dot(wo, isect.n) > 0)
+                                           ? (eta * eta)
+                                           : 1 / (eta * eta);
+                }
+                if (i == 0) {
+                    path = branch;
+                    followed = true;
+                } else
+                    branches[nBranches++] = branch;
+            }
+            if (!followed) break;
+
+            // Possibly terminate the path with Russian roulette where the
+            // window gives no guidance
+            if (!windowed) {
+                Spectrum rrBeta = path.beta * path.etaScale;
+                if (rrBeta.MaxComponentValue() < rrThreshold &&
+                    vertex.bounces > 3) {
+                    float q =
+                        std::max((float).05, 1 - rrBeta.MaxComponentValue());
+                    if (sampler.Get1D() < q) break;
+                    path.beta /= 1 - q;
+                    assert(!std::isinf(path.beta.y()));
+                }
+            }
+        }
+
+        if (nBranches == 0) break;
+        path = branches[--nBranches];
+    }
+
+    // Each vertex records the radiance its continuation reflected toward the
+    // previous one
+    for (int i = 0; i < nVertices; ++i)
+        radianceCache->Record(vertices[i].p, vertices[i].n,
+                              vertices[i].radiance);
+    return L;
+}
+
+}
\ No newline at end of file
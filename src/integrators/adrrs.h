@@ -0,0 +1,68 @@
+#pragma once
+
+#include "PBRender.h"
+#include "integrator.h"
+#include "radiancecache.h"
+#include "lightdistrib.h"
+
+namespace PBRender {
+
+// ADRRSPathIntegrator Declarations
+// Path tracer with adjoint-driven Russian roulette and splitting. A training
+// pass of _trainingSpp_ samples per pixel renders with the usual roulette
+// and records, for each path vertex, the radiance that the rest of the path
+// brings back beyond the vertex's direct lighting into a _RadianceCache_,
+// along with an estimate of every pixel's radiance. The remaining samples
+// compare a path's expected contribution, its throughput times the cached
+// estimate, with the pixel estimate: paths well below it are terminated
+// with roulette and paths well above it are split into up to _maxSplit_
+// continuations. The factor between the bounds of this weight window is
+// _windowWidth_, and the window is widened by the uncertainty of the cached
+// estimate; cells with fewer than _minCacheSamples_ samples leave the path
+// to the usual roulette. Both passes contribute to the image.
+//
+// Use it only for scenes lit mostly indirectly, such as a room whose light
+// is hidden behind an occluder, where it is about 20% more efficient than
+// _PathIntegrator_ at equal time. Where direct light dominates, the
+// training pass and cache lookups cost more than the window saves: it is
+// 2-4% behind on the diffuse Cornell box and 5-7% behind with the glass
+// sphere, and no setting of _windowWidth_, _maxSplit_ or _minCacheSamples_
+// brings it to break-even there.
+class ADRRSPathIntegrator : public Integrator {
+    public:
+        ADRRSPathIntegrator(int maxDepth, std::shared_ptr<const Camera> camera,
+                            std::shared_ptr<Sampler> sampler,
+                            const Bounds2i &pixelBounds, float rrThreshold = 1,
+                            const std::string &lightSampleStrategy = "uniform",
+                            int trainingSpp = 16, float windowWidth = 5,
+                            int maxSplit = 2, int minCacheSamples = 16);
+
+        void Preprocess(const Scene &scene);
+        void Render(const Scene &scene, std::vector<Spectrum> &col);
+        void Render(const Scene &scene, Film &film);
+
+    private:
+        // ADRRSPathIntegrator Private Methods
+        void RenderPass(const Scene &scene, Film *film, int64_t firstSample,
+                        int64_t nSamples, bool training);
+        Spectrum Li(const RayDifferential &ray, const Scene &scene,
+                    Sampler &pathSampler, Sampler &splitSampler,
+                    float pixelEstimate, bool training) const;
+
+        // ADRRSPathIntegrator Private Data
+        std::shared_ptr<const Camera> camera;
+        std::shared_ptr<Sampler> sampler;
+        const Bounds2i pixelBounds;
+        const int maxDepth;
+        const float rrThreshold;
+        const std::string lightSampleStrategy;
+        const int trainingSpp;
+        const float windowWidth;
+        const int maxSplit;
+        const int minCacheSamples;
+        std::unique_ptr<LightDistribution> lightDistribution;
+        std::unique_ptr<RadianceCache> radianceCache;
+        std::vector<float> pixelEstimate;
+};
+
+}
\ No newline at end of file
@@ -0,0 +1,434 @@
+#include "integrators/bdpt.h"
+#include "film.h"
+#include "filters/box.h"
+
+#include "omp.h"
+
+namespace PBRender {
+
+// BDPT Local Definitions
+// Temporarily overrides a value and restores it when leaving the scope
+template <typename Type>
+class ScopedAssignment {
+    public:
+        // ScopedAssignment Public Methods
+        ScopedAssignment(Type *target = nullptr, Type value = Type())
+            : target(target) {
+            if (target) {
+                backup = *target;
+                *target = value;
+            }
+        }
+        ~ScopedAssignment() {
+            if (target) *target = backup;
+        }
+        ScopedAssignment(const ScopedAssignment &) = delete;
+        ScopedAssignment &operator=(const ScopedAssignment &) = delete;
+        ScopedAssignment &operator=(ScopedAssignment &&other) {
+            if (target) *target = backup;
+            target = other.target;
+            backup = other.backup;
+            other.target = nullptr;
+            return *this;
+        }
+
+    private:
+        Type *target, backup;
+};
+
+static int RandomWalk(const Scene &scene, RayDifferential ray,
+                      Sampler &sampler, Spectrum beta, float pdf, int maxDepth,
+                      TransportMode mode, Vertex *path) {
+    if (maxDepth == 0) return 0;
+    int bounces = 0;
+    // Declare variables for forward and reverse probability densities
+    float pdfFwd = pdf, pdfRev = 0;
+    while (true) {
+        // Attempt to create the next subpath vertex in _path_
+        SurfaceInteraction isect;
+        bool foundIntersection = scene.Intersect(ray, &isect);
+        if (beta.IsBlack()) break;
+        Vertex &vertex = path[bounces], &prev = path[bounces - 1];
+
+        // Capture escaped rays when tracing from the camera
+        if (!foundIntersection) {
+            if (mode == TransportMode::Radiance) {
+                vertex = Vertex::CreateLight(EndpointInteraction(ray), beta,
+                                             pdfFwd);
+                ++bounces;
+            }
+            break;
+        }
+
+        // Compute scattering functions for _mode_ and skip over medium
+        // boundaries
+        isect.ComputeScatteringFunctions(ray, true, mode);
+        if (!isect.bsdf) {
+            ray = isect.SpawnRay(ray.d);
+            continue;
+        }
+
+        // Initialize _vertex_ with surface intersection information
+        vertex = Vertex::CreateSurface(isect, beta, pdfFwd, prev);
+        if (++bounces >= maxDepth) break;
+
+        // Sample BSDF at current vertex and compute reverse probability
+        Vector3f wi, wo = isect.wo;
+        BxDFType type;
+        Spectrum f = isect.bsdf->Sample_f(wo, &wi, sampler.Get2D(), &pdfFwd,
+                                          BSDF_ALL, &type);
+        if (f.IsBlack() || pdfFwd == 0.f) break;
+        beta *= f * AbsDot(wi, isect.shading.n) / pdfFwd;
+        pdfRev = isect.bsdf->Pdf(wi, wo, BSDF_ALL);
+        if (type & BSDF_SPECULAR) {
+            vertex.delta = true;
+            pdfRev = pdfFwd = 0;
+        }
+        beta *= CorrectShadingNormal(isect, wo, wi, mode);
+        ray = isect.SpawnRay(wi);
+
+        // Compute reverse area density at preceding vertex
+        prev.pdfRev = vertex.ConvertDensity(pdfRev, prev);
+    }
+    return bounces;
+}
+
+// Geometry term between two vertices, including their visibility; there
+// are no media, so transmittance is binary
+static Spectrum G(const Scene &scene, const Vertex &v0, const Vertex &v1) {
+    Vector3f d = v0.p() - v1.p();
+    float g = 1 / d.LengthSquared();
+    d *= std::sqrt(g);
+    if (v0.IsOnSurface()) g *= AbsDot(v0.ns(), d);
+    if (v1.IsOnSurface()) g *= AbsDot(v1.ns(), d);
+    VisibilityTester vis(v0.GetInteraction(), v1.GetInteraction());
+    return vis.Unoccluded(scene) ? Spectrum(g) : Spectrum(0.f);
+}
+
+static float MISWeight(
+    const Scene &scene, Vertex *lightVertices, Vertex *cameraVertices,
+    Vertex &sampled, int s, int t, const Distribution1D &lightPdf,
+    const std::unordered_map<const Light *, size_t> &lightToIndex) {
+    if (s + t == 2) return 1;
+    float sumRi = 0;
+    // Define helper function _remap0_ that deals with Dirac delta functions
+    auto remap0 = [](float f) -> float { return f != 0 ? f : 1; };
+
+    // Temporarily update vertex properties for current strategy
+
+    // Look up connection vertices and their predecessors
+    Vertex *qs = s > 0 ? &lightVertices[s - 1] : nullptr,
+           *pt = t > 0 ? &cameraVertices[t - 1] : nullptr,
+           *qsMinus = s > 1 ? &lightVertices[s - 2] : nullptr,
+           *ptMinus = t > 1 ? &cameraVertices[t - 2] : nullptr;
+
+    // Update sampled vertex for $s=1$ or $t=1$ strategy
+    ScopedAssignment<Vertex> a1;
+    if (s == 1)
+        a1 = ScopedAssignment<Vertex>(qs, sampled);
+    else if (t == 1)
+        a1 = ScopedAssignment<Vertex>(pt, sampled);
+
+    // Mark connection vertices as non-degenerate
+    ScopedAssignment<bool> a2, a3;
+    if (pt) a2 = ScopedAssignment<bool>(&pt->delta, false);
+    if (qs) a3 = ScopedAssignment<bool>(&qs->delta, false);
+
+    // Update reverse density of vertex $\pt{}_{t-1}$
+    ScopedAssignment<float> a4;
+    if (pt)
+        a4 = ScopedAssignment<float>(
+            &pt->pdfRev, s > 0 ? qs->Pdf(scene, qsMinus, *pt)
+                               : pt->PdfLightOrigin(scene, *ptMinus, lightPdf,
+                                                    lightToIndex));
+
+    // Update reverse density of vertex $\pt{}_{t-2}$
+    ScopedAssignment<float> a5;
+    if (ptMinus)
+        a5 = ScopedAssignment<float>(
+            &ptMinus->pdfRev, s > 0 ? pt->Pdf(scene, qs, *ptMinus)
+                                    : pt->PdfLight(scene, *ptMinus));
+
+    // Update reverse density of vertices $\pq{}_{s-1}$ and $\pq{}_{s-2}$
+    ScopedAssignment<float> a6;
+    if (qs)
+        a6 = ScopedAssignment<float>(&qs->pdfRev,
+                                     pt->Pdf(scene, ptMinus, *qs));
+    ScopedAssignment<float> a7;
+    if (qsMinus)
+        a7 = ScopedAssignment<float>(&qsMinus->pdfRev,
+                                     qs->Pdf(scene, pt, *qsMinus));
+
+    // Consider hypothetical connection strategies along the camera subpath
+    float ri = 1;
+    for (int i = t - 1; i > 0; --i) {
+        ri *= remap0(cameraVertices[i].pdfRev) /
+              remap0(cameraVertices[i].pdfFwd);
+        if (!cameraVertices[i].delta && !cameraVertices[i - 1].delta)
+            sumRi += ri;
+    }
+
+    // Consider hypothetical connection strategies along the light subpath
+    ri = 1;
+    for (int i = s - 1; i >= 0; --i) {
+        ri *= remap0(lightVertices[i].pdfRev) / remap0(lightVertices[i].pdfFwd);
+        bool deltaLightvertex = i > 0 ? lightVertices[i - 1].delta
+                                      : lightVertices[0].IsDeltaLight();
+        if (!lightVertices[i].delta && !deltaLightvertex) sumRi += ri;
+    }
+    return 1 / (1 + sumRi);
+}
+
+// BDPT Utility Functions
+float InfiniteLightDensity(
+    const Scene &scene, const Distribution1D &lightDistr,
+    const std::unordered_map<const Light *, size_t> &lightToDistrIndex,
+    const Vector3f &w) {
+    float pdf = 0;
+    for (const auto &light : scene.infiniteLights) {
+        auto iter = lightToDistrIndex.find(light.get());
+        assert(iter != lightToDistrIndex.end());
+        pdf += light->Pdf_Li(Interaction(), -w) * lightDistr.func[iter->second];
+    }
+    return pdf / (lightDistr.funcInt * lightDistr.Count());
+}
+
+int GenerateCameraSubpath(const Scene &scene, Sampler &sampler, int maxDepth,
+                          const Camera &camera,
+                          const CameraSample &cameraSample, Vertex *path) {
+    if (maxDepth == 0) return 0;
+    // Generate a camera ray for the camera sample
+    RayDifferential ray;
+    Spectrum beta(camera.GenerateRayDifferential(cameraSample, &ray));
+    ray.ScaleDifferentials(1 / std::sqrt((float)sampler.samplesPerPixel));
+
+    // Generate first vertex on camera subpath and start random walk
+    float pdfPos, pdfDir;
+    path[0] = Vertex::CreateCamera(&camera, ray, beta);
+    camera.Pdf_We(ray, &pdfPos, &pdfDir);
+    return RandomWalk(scene, ray, sampler, beta, pdfDir, maxDepth - 1,
+                      TransportMode::Radiance, path + 1) +
+           1;
+}
+
+int GenerateLightSubpath(
+    const Scene &scene, Sampler &sampler, int maxDepth, float time,
+    const Distribution1D &lightDistr,
+    const std::unordered_map<const Light *, size_t> &lightToIndex,
+    Vertex *path) {
+    if (maxDepth == 0) return 0;
+    // Sample initial ray for light subpath
+    float lightPdf;
+    int lightNum = lightDistr.SampleDiscrete(sampler.Get1D(), &lightPdf);
+    const std::shared_ptr<Light> &light = scene.lights[lightNum];
+    RayDifferential ray;
+    Normal3f nLight;
+    float pdfPos, pdfDir;
+    Point2f u1 = sampler.Get2D(), u2 = sampler.Get2D();
+    Spectrum Le = light->Sample_Le(u1, u2, time, &ray, &nLight, &pdfPos,
+                                   &pdfDir);
+    if (pdfPos == 0 || pdfDir == 0 || Le.IsBlack()) return 0;
+
+    // Generate first vertex on light subpath and start random walk
+    path[0] =
+        Vertex::CreateLight(light.get(), ray, nLight, Le, pdfPos * lightPdf);
+    Spectrum beta = Le * AbsDot(nLight, ray.d) / (lightPdf * pdfPos * pdfDir);
+    int nVertices = RandomWalk(scene, ray, sampler, beta, pdfDir, maxDepth - 1,
+                               TransportMode::Importance, path + 1);
+
+    // Correct subpath sampling densities for infinite area lights
+    if (path[0].IsInfiniteLight()) {
+        // Set spatial density of _path[1]_ for infinite area light
+        if (nVertices > 0) {
+            path[1].pdfFwd = pdfPos;
+            if (path[1].IsOnSurface())
+                path[1].pdfFwd *= AbsDot(ray.d, path[1].ng());
+        }
+
+        // Set spatial density of _path[0]_ for infinite area light
+        path[0].pdfFwd =
+            InfiniteLightDensity(scene, lightDistr, lightToIndex, ray.d);
+    }
+    return nVertices + 1;
+}
+
+Spectrum ConnectBDPT(
+    const Scene &scene, Vertex *lightVertices, Vertex *cameraVertices, int s,
+    int t, const Distribution1D &lightDistr,
+    const std::unordered_map<const Light *, size_t> &lightToIndex,
+    const Camera &camera, Sampler &sampler, Point2f *pRaster,
+    float *misWeightPtr) {
+    Spectrum L(0.f);
+    // Ignore invalid connections related to infinite area lights
+    if (t > 1 && s != 0 && cameraVertices[t - 1].type == VertexType::Light)
+        return Spectrum(0.f);
+
+    // Perform connection and write contribution to _L_
+    Vertex sampled;
+    if (s == 0) {
+        // Interpret the camera subpath as a complete path
+        const Vertex &pt = cameraVertices[t - 1];
+        if (pt.IsLight()) L = pt.Le(scene, cameraVertices[t - 2]) * pt.beta;
+    } else if (t == 1) {
+        // Sample a point on the camera and connect it to the light subpath
+        const Vertex &qs = lightVertices[s - 1];
+        if (qs.IsConnectible()) {
+            VisibilityTester vis;
+            Vector3f wi;
+            float pdf;
+            Spectrum Wi = camera.Sample_Wi(qs.GetInteraction(),
+                                           sampler.Get2D(), &wi, &pdf,
+                                           pRaster, &vis);
+            if (pdf > 0 && !Wi.IsBlack()) {
+                // Initialize dynamically sampled vertex and _L_ for $t=1$ case
+                sampled = Vertex::CreateCamera(&camera, vis.P1(), Wi / pdf);
+                L = qs.beta * qs.f(sampled, TransportMode::Importance) *
+                    sampled.beta;
+                if (qs.IsOnSurface()) L *= AbsDot(wi, qs.ns());
+                // Only check visibility after we know that the path would
+                // make a non-zero contribution.
+                if (!L.IsBlack() && !vis.Unoccluded(scene)) L = Spectrum(0.f);
+            }
+        }
+    } else if (s == 1) {
+        // Sample a point on a light and connect it to the camera subpath
+        const Vertex &pt = cameraVertices[t - 1];
+        if (pt.IsConnectible()) {
+            float lightPdf;
+            VisibilityTester vis;
+            Vector3f wi;
+            float pdf;
+            int lightNum =
+                lightDistr.SampleDiscrete(sampler.Get1D(), &lightPdf);
+            const std::shared_ptr<Light> &light = scene.lights[lightNum];
+            Spectrum lightWeight = light->Sample_Li(
+                pt.GetInteraction(), sampler.Get2D(), &wi, &pdf, &vis);
+            if (pdf > 0 && !lightWeight.IsBlack()) {
+                EndpointInteraction ei(vis.P1(), light.get());
+                sampled =
+                    Vertex::CreateLight(ei, lightWeight / (pdf * lightPdf), 0);
+                sampled.pdfFwd =
+                    sampled.PdfLightOrigin(scene, pt, lightDistr, lightToIndex);
+                L = pt.beta * pt.f(sampled, TransportMode::Radiance) *
+                    sampled.beta;
+                if (pt.IsOnSurface()) L *= AbsDot(wi, pt.ns());
+                // Only check visibility if the path would carry radiance.
+                if (!L.IsBlack() && !vis.Unoccluded(scene)) L = Spectrum(0.f);
+            }
+        }
+    } else {
+        // Handle all other bidirectional connection cases
+        const Vertex &qs = lightVertices[s - 1], &pt = cameraVertices[t - 1];
+        if (qs.IsConnectible() && pt.IsConnectible()) {
+            L = qs.beta * qs.f(pt, TransportMode::Importance) *
+                pt.f(qs, TransportMode::Radiance) * pt.beta;
+            if (!L.IsBlack()) L *= G(scene, qs, pt);
+        }
+    }
+
+    // Compute MIS weight for connection strategy
+    float misWeight =
+        L.IsBlack() ? 0.f : MISWeight(scene, lightVertices, cameraVertices,
+                                      sampled, s, t, lightDistr, lightToIndex);
+    L *= misWeight;
+    if (misWeightPtr) *misWeightPtr = misWeight;
+    return L;
+}
+
+// BDPTIntegrator Method Definitions
+void BDPTIntegrator::Render(const Scene &scene, std::vector<Spectrum> &col) {
+    int rasterX = pixelBounds.pMax.x - pixelBounds.pMin.x;
+    int rasterY = pixelBounds.pMax.y - pixelBounds.pMin.y;
+    std::unique_ptr<Filter> filter(CreateBoxFilter());
+    Film film(Point2i(rasterX, rasterY), std::move(filter));
+
+    Render(scene, film);
+    // Splats are sums over all samples of the image rather than averages
+    film.GetImage(col, 1 / (float)sampler->samplesPerPixel);
+}
+
+void BDPTIntegrator::Render(const Scene &scene, Film &film) {
+    std::unique_ptr<Distribution1D> lightDistr =
+        ComputeLightPowerDistribution(scene);
+    if (!lightDistr) {
+        std::cerr << "BDPTIntegrator: the scene has no lights" << std::endl;
+        return;
+    }
+
+    // Compute a reverse mapping from light pointers to offsets into the
+    // scene lights vector (and, equivalently, offsets into _lightDistr_)
+    std::unordered_map<const Light *, size_t> lightToIndex;
+    for (size_t i = 0; i < scene.lights.size(); ++i)
+        lightToIndex[scene.lights[i].get()] = i;
+
+    // Compute number of tiles to use for parallel rendering
+    Bounds2i sampleBounds = Intersect(film.GetSampleBounds(), pixelBounds);
+    Vector2i sampleExtent = sampleBounds.Diagonal();
+    const int tileSize = 16;
+    Point2i nTiles((sampleExtent.x + tileSize - 1) / tileSize,
+                   (sampleExtent.y + tileSize - 1) / tileSize);
+    int nTotalTiles = nTiles.x * nTiles.y;
+
+    #pragma omp parallel for schedule(dynamic)
+    for (int tile = 0; tile < nTotalTiles; ++tile) {
+        int tileX = tile % nTiles.x, tileY = tile / nTiles.x;
+        std::unique_ptr<Sampler> tileSampler = sampler->Clone(tile);
+
+        // Compute sample bounds for tile
+        int x0 = sampleBounds.pMin.x + tileX * tileSize;
+        int x1 = std::min(x0 + tileSize, sampleBounds.pMax.x);
+        int y0 = sampleBounds.pMin.y + tileY * tileSize;
+        int y1 = std::min(y0 + tileSize, sampleBounds.pMax.y);
+        Bounds2i tileBounds(Point2i(x0, y0), Point2i(x1, y1));
+        std::unique_ptr<FilmTile> filmTile = film.GetFilmTile(tileBounds);
+
+        // Subpath storage is reused by all samples of the tile
+        std::vector<Vertex> cameraVertices(maxDepth + 2);
+        std::vector<Vertex> lightVertices(maxDepth + 1);
+
+        for (Point2i pixel : tileBounds) {
+            tileSampler->StartPixel(pixel);
+            do {
+                // Generate a single sample using BDPT
+                CameraSample cameraSample = tileSampler->GetCameraSample(pixel);
+
+                // Trace the camera and light subpaths
+                int nCamera = GenerateCameraSubpath(
+                    scene, *tileSampler, maxDepth + 2, *camera, cameraSample,
+                    &cameraVertices[0]);
+                int nLight = GenerateLightSubpath(
+                    scene, *tileSampler, maxDepth + 1,
+                    cameraVertices[0].time(), *lightDistr, lightToIndex,
+                    &lightVertices[0]);
+
+                // Execute all BDPT connection strategies
+                Spectrum L(0.f);
+                for (int t = 1; t <= nCamera; ++t) {
+                    for (int s = 0; s <= nLight; ++s) {
+                        int depth = t + s - 2;
+                        if ((s == 1 && t == 1) || depth < 0 ||
+                            depth > maxDepth)
+                            continue;
+                        // Execute the $(s, t)$ connection strategy and
+                        // update _L_
+                        Point2f pFilmNew = cameraSample.pFilm;
+                        Spectrum Lpath = ConnectBDPT(
+                            scene, &lightVertices[0], &cameraVertices[0], s, t,
+                            *lightDistr, lightToIndex, *camera, *tileSampler,
+                            &pFilmNew);
+                        if (t != 1)
+                            L += Lpath;
+                        else
+                            film.AddSplat(pFilmNew, Lpath);
+                    }
+                }
+                filmTile->AddSample(cameraSample.pFilm, L);
+            } while (tileSampler->StartNextSample());
+        }
+
+        film.MergeFilmTile(std::move(filmTile));
+    }
+    std::cout << "Rendering is finished!" << std::endl;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,354 @@
+#pragma once
+
+#include "PBRender.h"
+#include "integrator.h"
+#include "interaction.h"
+#include "camera.h"
+#include "light.h"
+#include "primitive.h"
+#include "reflection.h"
+#include "sampling.h"
+#include "scene.h"
+
+#include <unordered_map>
+
+namespace PBRender {
+
+// EndpointInteraction Declarations
+// Interaction at the first vertex of a subpath, which lies on the camera
+// lens or on a light. Camera paths that escape the scene end in an
+// endpoint with no light whose normal faces back along the ray.
+struct EndpointInteraction : Interaction {
+    union {
+        const Camera *camera;
+        const Light *light;
+    };
+    // EndpointInteraction Public Methods
+    EndpointInteraction() : Interaction(), light(nullptr) {}
+    EndpointInteraction(const Interaction &it, const Camera *camera)
+        : Interaction(it), camera(camera) {}
+    EndpointInteraction(const Camera *camera, const Ray &ray)
+        : Interaction(ray.o, ray.time), camera(camera) {}
+    EndpointInteraction(const Light *light, const Ray &r, const Normal3f &nl)
+        : Interaction(r.o, r.time), light(light) {
+        n = nl;
+    }
+    EndpointInteraction(const Interaction &it, const Light *light)
+        : Interaction(it), light(light) {}
+    EndpointInteraction(const Ray &ray)
+        : Interaction(ray(1), ray.time), light(nullptr) {
+        n = Normal3f(-ray.d);
+    }
+};
+
+// BDPT Helper Definitions
+enum class VertexType { Camera, Light, Surface };
+
+inline float CorrectShadingNormal(const SurfaceInteraction &isect,
+                                  const Vector3f &wo, const Vector3f &wi,
+                                  TransportMode mode) {
+    // Shading normals make the adjoint BSDF asymmetric; light paths carry
+    // the correction factor
+    if (mode == TransportMode::Importance) {
+        float num = AbsDot(wo, isect.shading.n) * AbsDot(wi, isect.n);
+        float denom = AbsDot(wo, isect.n) * AbsDot(wi, isect.shading.n);
+        // wi is occasionally perpendicular to isect.shading.n; this is
+        // fine, but we don't want to return an infinite or NaN value in
+        // that case.
+        if (denom == 0) return 0;
+        return num / denom;
+    } else
+        return 1;
+}
+
+float InfiniteLightDensity(
+    const Scene &scene, const Distribution1D &lightDistr,
+    const std::unordered_map<const Light *, size_t> &lightToDistrIndex,
+    const Vector3f &w);
+
+// Vertex Declarations
+// Vertex of a camera or light subpath. _pdfFwd_ is the area density of
+// sampling the vertex from its predecessor on the same subpath and
+// _pdfRev_ the density of sampling it from the other direction, as needed
+// by the MIS weights. Medium vertices are not supported as the renderer
+// has no participating media.
+struct Vertex {
+    // Vertex Public Data
+    VertexType type;
+    Spectrum beta;
+    EndpointInteraction ei;
+    SurfaceInteraction si;
+    bool delta = false;
+    float pdfFwd = 0, pdfRev = 0;
+
+    // Vertex Public Methods
+    Vertex() {}
+    Vertex(VertexType type, const EndpointInteraction &ei,
+           const Spectrum &beta)
+        : type(type), beta(beta), ei(ei) {}
+    Vertex(const SurfaceInteraction &si, const Spectrum &beta)
+        : type(VertexType::Surface), beta(beta), si(si) {}
+
+    static inline Vertex CreateCamera(const Camera *camera, const Ray &ray,
+                                      const Spectrum &beta);
+    static inline Vertex CreateCamera(const Camera *camera,
+                                      const Interaction &it,
+                                      const Spectrum &beta);
+    static inline Vertex CreateLight(const Light *light, const Ray &ray,
+                                     const Normal3f &nLight,
+                                     const Spectrum &Le, float pdf);
+    static inline Vertex CreateLight(const EndpointInteraction &ei,
+                                     const Spectrum &beta, float pdf);
+    static inline Vertex CreateSurface(const SurfaceInteraction &si,
+                                       const Spectrum &beta, float pdf,
+                                       const Vertex &prev);
+
+    const Interaction &GetInteraction() const {
+        if (type == VertexType::Surface) return si;
+        return ei;
+    }
+    const Point3f &p() const { return GetInteraction().p; }
+    float time() const { return GetInteraction().time; }
+    const Normal3f &ng() const { return GetInteraction().n; }
+    const Normal3f &ns() const {
+        if (type == VertexType::Surface) return si.shading.n;
+        return GetInteraction().n;
+    }
+    bool IsOnSurface() const { return ng() != Normal3f(); }
+
+    Spectrum f(const Vertex &next, TransportMode mode) const {
+        Vector3f wi = next.p() - p();
+        if (wi.LengthSquared() == 0) return Spectrum(0.f);
+        wi = Normalize(wi);
+        if (type != VertexType::Surface) return Spectrum(0.f);
+        return si.bsdf->f(si.wo, wi) * CorrectShadingNormal(si, si.wo, wi, mode);
+    }
+
+    bool IsConnectible() const {
+        switch (type) {
+        case VertexType::Light:
+            return (ei.light->flags & (int)LightFlags::DeltaDirection) == 0;
+        case VertexType::Camera:
+            return true;
+        case VertexType::Surface:
+            return si.bsdf->NumComponents(BxDFType(BSDF_DIFFUSE | BSDF_GLOSSY |
+                                                   BSDF_REFLECTION |
+                                                   BSDF_TRANSMISSION)) > 0;
+        }
+        return false;
+    }
+
+    bool IsLight() const {
+        return type == VertexType::Light ||
+               (type == VertexType::Surface && si.primitive->GetAreaLight());
+    }
+    bool IsDeltaLight() const {
+        return type == VertexType::Light && ei.light &&
+               PBRender::IsDeltaLight(ei.light->flags);
+    }
+    bool IsInfiniteLight() const {
+        return type == VertexType::Light &&
+               (!ei.light || ei.light->flags & (int)LightFlags::Infinite ||
+                ei.light->flags & (int)LightFlags::DeltaDirection);
+    }
+
+    Spectrum Le(const Scene &scene, const Vertex &v) const {
+        if (!IsLight()) return Spectrum(0.f);
+        Vector3f w = v.p() - p();
+        if (w.LengthSquared() == 0) return Spectrum(0.f);
+        w = Normalize(w);
+        if (IsInfiniteLight()) {
+            // Return emitted radiance for infinite light sources
+            Spectrum Le(0.f);
+            for (const auto &light : scene.infiniteLights)
+                Le += light->Le(Ray(p(), -w));
+            return Le;
+        } else {
+            const AreaLight *light = si.primitive->GetAreaLight();
+            return light->L(si, w);
+        }
+    }
+
+    // Converts the solid angle density _pdf_ of sampling _next_ from this
+    // vertex to an area density
+    float ConvertDensity(float pdf, const Vertex &next) const {
+        // Return solid angle density if _next_ is an infinite area light
+        if (next.IsInfiniteLight()) return pdf;
+        Vector3f w = next.p() - p();
+        if (w.LengthSquared() == 0) return 0;
+        float invDist2 = 1 / w.LengthSquared();
+        if (next.IsOnSurface())
+            pdf *= AbsDot(next.ng(), w * std::sqrt(invDist2));
+        return pdf * invDist2;
+    }
+
+    // Area density of sampling _next_ from this vertex when _prev_ precedes
+    // it on the subpath
+    float Pdf(const Scene &scene, const Vertex *prev,
+              const Vertex &next) const {
+        if (type == VertexType::Light) return PdfLight(scene, next);
+        // Compute directions to preceding and next vertex
+        Vector3f wn = next.p() - p();
+        if (wn.LengthSquared() == 0) return 0;
+        wn = Normalize(wn);
+        Vector3f wp;
+        if (prev) {
+            wp = prev->p() - p();
+            if (wp.LengthSquared() == 0) return 0;
+            wp = Normalize(wp);
+        } else
+            assert(type == VertexType::Camera);
+
+        // Compute directional density depending on the vertex type
+        float pdf = 0, unused;
+        if (type == VertexType::Camera)
+            ei.camera->Pdf_We(ei.SpawnRay(wn), &unused, &pdf);
+        else if (type == VertexType::Surface)
+            pdf = si.bsdf->Pdf(wp, wn);
+
+        // Return probability per unit area at vertex _next_
+        return ConvertDensity(pdf, next);
+    }
+
+    float PdfLight(const Scene &scene, const Vertex &v) const {
+        Vector3f w = v.p() - p();
+        float invDist2 = 1 / w.LengthSquared();
+        w *= std::sqrt(invDist2);
+        float pdf;
+        if (IsInfiniteLight()) {
+            // Compute planar sampling density for infinite light sources
+            Point3f worldCenter;
+            float worldRadius;
+            scene.WorldBound().BoundingSphere(&worldCenter, &worldRadius);
+            pdf = 1 / (Pi * worldRadius * worldRadius);
+        } else {
+            // Get pointer _light_ to the light source at the vertex
+            const Light *light = type == VertexType::Light
+                                     ? ei.light
+                                     : si.primitive->GetAreaLight();
+
+            // Compute sampling density for non-infinite light sources
+            float pdfPos, pdfDir;
+            light->Pdf_Le(Ray(p(), w, Infinity, time()), ng(), &pdfPos, &pdfDir);
+            pdf = pdfDir * invDist2;
+        }
+        if (v.IsOnSurface()) pdf *= AbsDot(v.ng(), w);
+        return pdf;
+    }
+
+    float PdfLightOrigin(const Scene &scene, const Vertex &v,
+                         const Distribution1D &lightDistr,
+                         const std::unordered_map<const Light *, size_t>
+                             &lightToDistrIndex) const {
+        Vector3f w = v.p() - p();
+        if (w.LengthSquared() == 0) return 0.;
+        w = Normalize(w);
+        if (IsInfiniteLight()) {
+            // Return solid angle density for infinite light sources
+            return InfiniteLightDensity(scene, lightDistr, lightToDistrIndex,
+                                        w);
+        } else {
+            // Return solid angle density for non-infinite light sources
+            float pdfPos, pdfDir, pdfChoice = 0;
+
+            // Get pointer _light_ to the light source at the vertex
+            const Light *light = type == VertexType::Light
+                                     ? ei.light
+                                     : si.primitive->GetAreaLight();
+
+            // Compute the discrete probability of sampling _light_
+            auto iter = lightToDistrIndex.find(light);
+            assert(iter != lightToDistrIndex.end());
+            pdfChoice = lightDistr.DiscretePDF(iter->second);
+
+            light->Pdf_Le(Ray(p(), w, Infinity, time()), ng(), &pdfPos, &pdfDir);
+            return pdfPos * pdfChoice;
+        }
+    }
+};
+
+// BDPT Utility Functions
+// Traces a subpath from the camera through _cameraSample_ into _path_,
+// which must have room for _maxDepth_ vertices, and returns its length
+int GenerateCameraSubpath(const Scene &scene, Sampler &sampler, int maxDepth,
+                          const Camera &camera,
+                          const CameraSample &cameraSample, Vertex *path);
+
+int GenerateLightSubpath(
+    const Scene &scene, Sampler &sampler, int maxDepth, float time,
+    const Distribution1D &lightDistr,
+    const std::unordered_map<const Light *, size_t> &lightToIndex,
+    Vertex *path);
+
+// Contribution of the strategy that joins the first _s_ light vertices to
+// the first _t_ camera vertices. Strategies with _t_ = 1 project onto the
+// image at _pRaster_ and must be splatted by the caller.
+Spectrum ConnectBDPT(
+    const Scene &scene, Vertex *lightVertices, Vertex *cameraVertices, int s,
+    int t, const Distribution1D &lightDistr,
+    const std::unordered_map<const Light *, size_t> &lightToIndex,
+    const Camera &camera, Sampler &sampler, Point2f *pRaster,
+    float *misWeight = nullptr);
+
+// BDPTIntegrator Declarations
+// Bidirectional path tracer: every camera sample traces a camera and a
+// light subpath and combines all ways of connecting their prefixes with
+// the balance heuristic. Light-subpath vertices connected straight to the
+// camera land on arbitrary pixels and are splatted into the _Film_.
+class BDPTIntegrator : public Integrator {
+    public:
+        // BDPTIntegrator Public Methods
+        BDPTIntegrator(std::shared_ptr<Sampler> sampler,
+                       std::shared_ptr<const Camera> camera, int maxDepth,
+                       const Bounds2i &pixelBounds)
+            : sampler(sampler),
+              camera(camera),
+              maxDepth(maxDepth),
+              pixelBounds(pixelBounds) {}
+
+        void Render(const Scene &scene, std::vector<Spectrum> &col);
+        void Render(const Scene &scene, Film &film);
+
+    private:
+        // BDPTIntegrator Private Data
+        std::shared_ptr<Sampler> sampler;
+        std::shared_ptr<const Camera> camera;
+        const int maxDepth;
+        const Bounds2i pixelBounds;
+};
+
+// Vertex Inline Method Definitions
+inline Vertex Vertex::CreateCamera(const Camera *camera, const Ray &ray,
+                                   const Spectrum &beta) {
+    return Vertex(VertexType::Camera, EndpointInteraction(camera, ray), beta);
+}
+
+inline Vertex Vertex::CreateCamera(const Camera *camera, const Interaction &it,
+                                   const Spectrum &beta) {
+    return Vertex(VertexType::Camera, EndpointInteraction(it, camera), beta);
+}
+
+inline Vertex Vertex::CreateLight(const Light *light, const Ray &ray,
+                                  const Normal3f &Nl, const Spectrum &Le,
+                                  float pdf) {
+    Vertex v(VertexType::Light, EndpointInteraction(light, ray, Nl), Le);
+    v.pdfFwd = pdf;
+    return v;
+}
+
+inline Vertex Vertex::CreateLight(const EndpointInteraction &ei,
+                                  const Spectrum &beta, float pdf) {
+    Vertex v(VertexType::Light, ei, beta);
+    v.pdfFwd = pdf;
+    return v;
+}
+
+inline Vertex Vertex::CreateSurface(const SurfaceInteraction &si,
+                                    const Spectrum &beta, float pdf,
+                                    const Vertex &prev) {
+    Vertex v(si, beta);
+    v.pdfFwd = prev.ConvertDensity(pdf, v);
+    return v;
+}
+
+}
\ No newline at end of file
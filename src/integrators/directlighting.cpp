@@ -28,38 +28,49 @@ Spectrum DirectLightingIntegrator::Li(const RayDifferential &ray,
                                       int depth) const {
     Spectrum L(0.f);
 
-    // Find closest ray intersection or return background radiance
+    // Trace the tree of specular paths below _ray_ depth first, following
+    // one branch in _path_ and keeping the others on _stack_
+    SpecularStack stack;
+    SpecularPath path = {ray, Spectrum(1.f), depth};
     SurfaceInteraction isect;
-    if (!scene.Intersect(ray, &isect)) {
-        for (const auto &light : scene.lights) L += light->Le(ray);
-        return L;
-    }
+    while (true) {
+        // Find closest ray intersection or add background radiance
+        if (!scene.Intersect(path.ray, &isect)) {
+            for (const auto &light : scene.lights)
+                L += path.beta * light->Le(path.ray);
+        } else {
+            // Compute scattering functions for surface interaction
+            isect.ComputeScatteringFunctions(path.ray);
+            if (!isect.bsdf) {
+                path.ray = isect.SpawnRay(path.ray.d);
+                continue;
+            }
 
-    // Compute scattering functions for surface interaction
-    isect.ComputeScatteringFunctions(ray);
-    if (!isect.bsdf)
-        return Li(isect.SpawnRay(ray.d), scene, sampler, depth);
+            Vector3f wo = isect.wo;
+            L += path.beta * isect.Le(wo);
 
-    Vector3f wo = isect.wo;
-    L += isect.Le(wo);
-    
-    if (scene.lights.size() > 0) {
-        // Compute direct lighting for _DirectLightingIntegrator_ integrator
-        if (strategy == LightStrategy::UniformSampleAll)
-            L += UniformSampleAllLights(isect, scene, 
-                                        // arena, 
-                                        sampler,
-                                        nLightSamples);
-        else
-            L += UniformSampleOneLight(isect, scene, 
-                                    //    arena, 
-                                       sampler);
-    }
-    
-    if (depth + 1 < maxDepth) {
-        // Trace rays for specular reflection and refraction
-        L += SpecularReflect(ray, isect, scene, sampler, depth);
-        L += SpecularTransmit(ray, isect, scene, sampler, depth);
+            if (scene.lights.size() > 0) {
+                // Compute direct lighting for _DirectLightingIntegrator_
+                // integrator
+                if (strategy == LightStrategy::UniformSampleAll)
+                    L += path.beta * UniformSampleAllLights(isect, scene,
+                                                            // arena,
+                                                            sampler,
+                                                            nLightSamples);
+                else
+                    L += path.beta * UniformSampleOneLight(isect, scene,
+                                                        //    arena,
+                                                           sampler);
+            }
+
+            // Follow specular reflection and refraction
+            if (path.depth + 1 < maxDepth &&
+                FollowSpecular(&path, isect, sampler, &stack))
+                continue;
+        }
+
+        if (stack.Empty()) break;
+        path = stack.Pop();
     }
 
     return L;
@@ -0,0 +1,325 @@
+#include "integrators/guidedpath.h"
+#include "camera.h"
+#include "film.h"
+#include "filters/box.h"
+#include "interaction.h"
+#include "scene.h"
+
+#include "omp.h"
+
+namespace PBRender {
+
+// Radiance is only recorded for this many vertices of a path
+static const int MaxGuidingVertices = 32;
+
+// GuidingVertex Declarations
+struct GuidingVertex {
+    int leaf;
+    Vector3f wi;
+    // Path throughput up to and including the scattering at this vertex
+    Spectrum throughput;
+    // Radiance arriving along _wi_, accumulated as the path continues
+    Spectrum radiance;
+    float pdf;
+};
+
+// GuidedPathIntegrator Method Definitions
+GuidedPathIntegrator::GuidedPathIntegrator(
+    int maxDepth, std::shared_ptr<const Camera> camera,
+    std::shared_ptr<Sampler> sampler, const Bounds2i &pixelBounds,
+    float rrThreshold, const std::string &lightSampleStrategy,
+    float bsdfSamplingFraction, int64_t splitThreshold)
+    : camera(camera),
+      sampler(sampler),
+      pixelBounds(pixelBounds),
+      maxDepth(maxDepth),
+      rrThreshold(rrThreshold),
+      lightSampleStrategy(lightSampleStrategy),
+      bsdfSamplingFraction(Clamp(bsdfSamplingFraction, 0.05f, 1.f)),
+      splitThreshold(splitThreshold) {
+    std::cerr << "GuidedPathIntegrator: experimental, slower than "
+                 "PathIntegrator at equal render time in the tested scenes"
+              << std::endl;
+}
+
+void GuidedPathIntegrator::Preprocess(const Scene &scene) {
+    lightDistribution =
+        CreateLightSampleDistribution(lightSampleStrategy, scene);
+    sdTree.reset(new SDTree(scene.WorldBound()));
+}
+
+void GuidedPathIntegrator::Render(const Scene &scene,
+                                  std::vector<Spectrum> &col) {
+    int rasterX = pixelBounds.pMax.x - pixelBounds.pMin.x;
+    int rasterY = pixelBounds.pMax.y - pixelBounds.pMin.y;
+    std::unique_ptr<Filter> filter(CreateBoxFilter());
+    Film film(Point2i(rasterX, rasterY), std::move(filter));
+
+    Render(scene, film);
+    film.GetImage(col);
+}
+
+void GuidedPathIntegrator::Render(const Scene &scene, Film &film) {
+    Preprocess(scene);
+
+    // Passes are rendered into _passFilm_ and accumulated into _image_ with
+    // their inverse variance weights
+    std::unique_ptr<Filter> filter(CreateBoxFilter());
+    Film passFilm(film.fullResolution, std::move(filter));
+    std::vector<Spectrum> image(passFilm.pixelBounds.Area(), Spectrum(0.f));
+    std::vector<Spectrum> passImage(image.size());
+    float weightSum = 0;
+    auto accumulatePass = [&](float variance) {
+        if (variance > 0) {
+            passFilm.GetImage(passImage);
+            float weight = 1 / variance;
+            for (size_t i = 0; i < image.size(); ++i)
+                image[i] += weight * passImage[i];
+            weightSum += weight;
+        }
+        passFilm.Clear();
+    };
+
+    // Train with passes of doubling sample counts while the final pass can
+    // still take at least half of the budget
+    int64_t spp = sampler->samplesPerPixel;
+    int64_t firstSample = 0;
+    std::vector<GuidingRecorder> recorders(omp_get_max_threads());
+    for (int64_t passSamples = 1; firstSample + 3 * passSamples <= spp;
+         passSamples *= 2) {
+        for (GuidingRecorder &recorder : recorders)
+            sdTree->ResetRecorder(&recorder);
+        float variance =
+            RenderPass(scene, &passFilm, firstSample, passSamples, &recorders);
+        accumulatePass(variance);
+        firstSample += passSamples;
+
+        // Leaves may hold more samples as the tree gets trained
+        sdTree->Refine(recorders, (int64_t)(splitThreshold *
+                                            std::sqrt((float)passSamples)));
+        std::cout << "Guiding pass with " << passSamples << " spp, "
+                  << sdTree->LeafCount() << " spatial cells" << std::endl;
+    }
+    recorders.clear();
+
+    // The final pass always enters the image, even if it has no variance
+    float variance =
+        RenderPass(scene, &passFilm, firstSample, spp - firstSample, nullptr);
+    if (variance == 0 && weightSum == 0) variance = 1;
+    accumulatePass(variance);
+
+    // Splat the weighted average of the passes
+    Bounds2i sampleBounds = Intersect(film.GetSampleBounds(), pixelBounds);
+    int width = passFilm.fullResolution.x;
+    for (Point2i p : sampleBounds)
+        film.AddSplat(Point2f(p.x + .5f, p.y + .5f),
+                      image[p.x + p.y * width] / weightSum);
+    std::cout << "Rendering is finished!" << std::endl;
+}
+
+float GuidedPathIntegrator::RenderPass(const Scene &scene, Film *film,
+                                       int64_t firstSample, int64_t nSamples,
+                                       std::vector<GuidingRecorder> *recorders) {
+    // Compute number of tiles to use for parallel rendering
+    Bounds2i sampleBounds = pixelBounds;
+    if (film) sampleBounds = Intersect(film->GetSampleBounds(), pixelBounds);
+    Vector2i sampleExtent = sampleBounds.Diagonal();
+    const int tileSize = 16;
+    Point2i nTiles((sampleExtent.x + tileSize - 1) / tileSize,
+                   (sampleExtent.y + tileSize - 1) / tileSize);
+    int nTotalTiles = nTiles.x * nTiles.y;
+    float diffScale = 1 / std::sqrt((float)sampler->samplesPerPixel);
+    double varianceSum = 0;
+
+    #pragma omp parallel for schedule(dynamic) reduction(+ : varianceSum)
+    for (int tile = 0; tile < nTotalTiles; ++tile) {
+        int tileX = tile % nTiles.x, tileY = tile / nTiles.x;
+        std::unique_ptr<Sampler> tileSampler = sampler->Clone(tile);
+        GuidingRecorder *recorder =
+            recorders ? &(*recorders)[omp_get_thread_num()] : nullptr;
+
+        // Compute sample bounds for tile
+        int x0 = sampleBounds.pMin.x + tileX * tileSize;
+        int x1 = std::min(x0 + tileSize, sampleBounds.pMax.x);
+        int y0 = sampleBounds.pMin.y + tileY * tileSize;
+        int y1 = std::min(y0 + tileSize, sampleBounds.pMax.y);
+        Bounds2i tileBounds(Point2i(x0, y0), Point2i(x1, y1));
+        std::unique_ptr<FilmTile> filmTile;
+        if (film) filmTile = film->GetFilmTile(tileBounds);
+
+        for (Point2i pixel : tileBounds) {
+            tileSampler->StartPixel(pixel);
+            tileSampler->SetSampleNumber(firstSample);
+            double sum = 0, sumSq = 0;
+            for (int64_t i = 0; i < nSamples; ++i) {
+                if (i > 0) tileSampler->StartNextSample();
+                CameraSample cameraSample = tileSampler->GetCameraSample(pixel);
+
+                RayDifferential ray;
+                float rayWeight =
+                    camera->GenerateRayDifferential(cameraSample, &ray);
+                ray.ScaleDifferentials(diffScale);
+
+                Spectrum L(0.f);
+                if (rayWeight > 0) L = Li(ray, scene, *tileSampler, recorder);
+                if (filmTile)
+                    filmTile->AddSample(cameraSample.pFilm, L, rayWeight);
+                float y = rayWeight * L.y();
+                sum += y;
+                sumSq += (double)y * y;
+            }
+
+            // Add the variance of the pixel's estimate over the pass
+            if (nSamples > 1)
+                varianceSum += std::max(0., sumSq - sum * sum / nSamples) /
+                               ((nSamples - 1) * nSamples);
+        }
+
+        if (film) film->MergeFilmTile(std::move(filmTile));
+    }
+    return (float)(varianceSum / std::max(1, sampleBounds.Area()));
+}
+
+Spectrum GuidedPathIntegrator::Li(const RayDifferential &r, const Scene &scene,
+                                  Sampler &sampler,
+                                  GuidingRecorder *recorder) const {
+    Spectrum L(0.f), beta(1.f);
+    RayDifferential ray(r);
+    bool specularBounce = false;
+    float etaScale = 1;
+
+    // Vertices whose incident radiance is recorded for training
+    GuidingVertex vertices[MaxGuidingVertices];
+    int nVertices = 0;
+    auto addRadiance = [&](const Spectrum &contribution) {
+        L += contribution;
+        for (int i = 0; i < nVertices; ++i)
+            for (int c = 0; c < Spectrum::nSamples; ++c)
+                if (vertices[i].throughput[c] > 0)
+                    vertices[i].radiance[c] +=
+                        contribution[c] / vertices[i].throughput[c];
+    };
+
+    for (int bounces = 0;; ++bounces) {
+        // Intersect _ray_ with scene and store intersection in _isect_
+        SurfaceInteraction isect;
+        bool foundIntersection = scene.Intersect(ray, &isect);
+
+        // Possibly add emitted light at intersection
+        if (bounces == 0 || specularBounce) {
+            if (foundIntersection)
+                addRadiance(beta * isect.Le(-ray.d));
+            else
+                for (const auto &light : scene.infiniteLights)
+                    addRadiance(beta * light->Le(ray));
+        }
+
+        // Terminate path if ray escaped or _maxDepth_ was reached
+        if (!foundIntersection || bounces >= maxDepth) break;
+
+        // Compute scattering functions and skip over medium boundaries
+        isect.ComputeScatteringFunctions(ray, true);
+        if (!isect.bsdf) {
+            ray = isect.SpawnRay(ray.d);
+            bounces--;
+            continue;
+        }
+
+        // Sample illumination from lights to find path contribution
+        bool nonSpecular =
+            isect.bsdf->NumComponents(BxDFType(BSDF_ALL & ~BSDF_SPECULAR)) > 0;
+        if (nonSpecular)
+            addRadiance(beta * UniformSampleOneLight(isect, scene, sampler,
+                                                     *lightDistribution));
+
+        // Sample the BSDF or the guiding distribution for the new direction
+        Vector3f wo = -ray.d, wi;
+        float pdf;
+        BxDFType flags;
+        Spectrum f;
+        int leaf = nonSpecular ? sdTree->Leaf(isect.p) : -1;
+        const DTree *dTree = nonSpecular ? &sdTree->GetDTree(leaf) : nullptr;
+
+        // The trees learn incident radiance over the whole sphere. Where the
+        // BSDF only reflects, they are sampled in product with the cosine to
+        // the shading normal on the side of _wo_, so no guided direction is
+        // wasted below the surface.
+        Vector3f n(isect.shading.n);
+        if (Dot(wo, n) < 0) n = -n;
+        const Vector3f *cosineNormal =
+            isect.bsdf->NumComponents(BSDF_TRANSMISSION) == 0 ? &n : nullptr;
+        bool guided = dTree && dTree->Trained(cosineNormal);
+
+        // The choice between the strategies reuses the first dimension of
+        // the direction sample, so paths consume the same sampler dimensions
+        // as in _PathIntegrator_ and keep their stratification
+        Point2f u = sampler.Get2D();
+        bool sampleBSDF = true;
+        if (guided) {
+            sampleBSDF = u.x < bsdfSamplingFraction;
+            u.x = sampleBSDF ? u.x / bsdfSamplingFraction
+                             : (u.x - bsdfSamplingFraction) /
+                                   (1 - bsdfSamplingFraction);
+            u.x = std::min(u.x, OneMinusEpsilon);
+        }
+        if (!guided) {
+            f = isect.bsdf->Sample_f(wo, &wi, u, &pdf, BSDF_ALL, &flags);
+        } else if (sampleBSDF) {
+            f = isect.bsdf->Sample_f(wo, &wi, u, &pdf, BSDF_ALL, &flags);
+            // Specular lobes can only come from BSDF sampling
+            if (flags & BSDF_SPECULAR)
+                pdf *= bsdfSamplingFraction;
+            else if (pdf > 0)
+                pdf = bsdfSamplingFraction * pdf +
+                      (1 - bsdfSamplingFraction) *
+                          dTree->Pdf(wi, cosineNormal);
+        } else {
+            float guidePdf;
+            wi = dTree->Sample(u, &guidePdf, cosineNormal);
+            f = isect.bsdf->f(wo, wi);
+            flags = BxDFType(BSDF_ALL & ~BSDF_SPECULAR);
+            pdf = bsdfSamplingFraction * isect.bsdf->Pdf(wo, wi) +
+                  (1 - bsdfSamplingFraction) * guidePdf;
+        }
+        if (f.IsBlack() || pdf == 0.f) break;
+        beta *= f * AbsDot(wi, isect.shading.n) / pdf;
+        assert(!std::isinf(beta.y()));
+
+        // Remember the vertex to record the radiance found along _wi_
+        if (recorder && leaf >= 0 && !(flags & BSDF_SPECULAR) &&
+            nVertices < MaxGuidingVertices) {
+            GuidingVertex &v = vertices[nVertices++];
+            v.leaf = leaf;
+            v.wi = wi;
+            v.throughput = beta;
+            v.radiance = Spectrum(0.f);
+            v.pdf = pdf;
+        }
+
+        specularBounce = (flags & BSDF_SPECULAR) != 0;
+        if ((flags & BSDF_SPECULAR) && (flags & BSDF_TRANSMISSION)) {
+            float eta = isect.bsdf->eta;
+            // Update the term that tracks radiance scaling for refraction
+            etaScale *= (Dot(wo, isect.n) > 0) ? (eta * eta) : 1 / (eta * eta);
+        }
+        ray = isect.SpawnRay(wi);
+
+        // Possibly terminate the path with Russian roulette
+        Spectrum rrBeta = beta * etaScale;
+        if (rrBeta.MaxComponentValue() < rrThreshold && bounces > 3) {
+            float q = std::max((float).05, 1 - rrBeta.MaxComponentValue());
+            if (sampler.Get1D() < q) break;
+            beta /= 1 - q;
+            assert(!std::isinf(beta.y()));
+        }
+    }
+
+    // Each vertex contributes its incident radiance estimate divided by the
+    // sampling density, i.e. an estimate of the energy of its direction bin
+    for (int i = 0; i < nVertices; ++i)
+        sdTree->Record(recorder, vertices[i].leaf, vertices[i].wi,
+                       vertices[i].radiance.y() / vertices[i].pdf);
+    return L;
+}
+
+}
\ No newline at end of file
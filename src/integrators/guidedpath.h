@@ -0,0 +1,73 @@
+#pragma once
+
+#include "PBRender.h"
+#include "integrator.h"
+#include "guiding.h"
+#include "lightdistrib.h"
+
+namespace PBRender {
+
+// GuidedPathIntegrator Declarations
+// Path tracer that learns the incident radiance field in an _SDTree_ and
+// samples indirect directions from it. The sample budget is spent in passes
+// of 1, 2, 4, ... samples per pixel; each training pass records radiance
+// into thread-local statistics that are merged to refine the tree for the
+// next pass, and the final pass takes the remaining samples. Directions are
+// drawn from the BSDF with probability _bsdfSamplingFraction_ and from the
+// tree otherwise, weighted by the one-sample MIS mixture of both densities.
+//
+// Early passes are guided by a barely trained tree and are noisier, so each
+// pass enters the image weighted by the inverse of its variance, estimated
+// as the mean over the pixels of the variance of their pass estimates. The
+// passes are filtered with a box filter, and the combined image is splatted
+// into the film. The one sample per pixel pass has no variance estimate and
+// only trains the tree.
+//
+// At reflective vertices the tree's distribution is sampled in product with
+// the clamped cosine to the shading normal, so no guided direction is lost
+// below the surface. The choice between the BSDF and the tree reuses the
+// direction sample, so paths consume the sampler dimensions of
+// _PathIntegrator_.
+//
+// Experimental: the tree lookups and recording cost about 40% more time per
+// sample than they save in variance. On the occluded Cornell box at 256 spp
+// it reaches an RMSE of 0.0208 in 7.0s where _PathIntegrator_ reaches 0.0200
+// in 5.0s, and the constructor warns that it is experimental.
+class GuidedPathIntegrator : public Integrator {
+    public:
+        GuidedPathIntegrator(int maxDepth, std::shared_ptr<const Camera> camera,
+                             std::shared_ptr<Sampler> sampler,
+                             const Bounds2i &pixelBounds, float rrThreshold = 1,
+                             const std::string &lightSampleStrategy = "spatial",
+                             float bsdfSamplingFraction = 0.5f,
+                             int64_t splitThreshold = 12000);
+
+        void Preprocess(const Scene &scene);
+        void Render(const Scene &scene, std::vector<Spectrum> &col);
+        void Render(const Scene &scene, Film &film);
+
+    private:
+        // GuidedPathIntegrator Private Methods
+        // Renders samples _firstSample_ to _firstSample + nSamples - 1_ of
+        // every pixel and returns the mean variance of the pixels' estimates
+        // over the pass, which is zero for single-sample passes
+        float RenderPass(const Scene &scene, Film *film, int64_t firstSample,
+                         int64_t nSamples,
+                         std::vector<GuidingRecorder> *recorders);
+        Spectrum Li(const RayDifferential &ray, const Scene &scene,
+                    Sampler &sampler, GuidingRecorder *recorder) const;
+
+        // GuidedPathIntegrator Private Data
+        std::shared_ptr<const Camera> camera;
+        std::shared_ptr<Sampler> sampler;
+        const Bounds2i pixelBounds;
+        const int maxDepth;
+        const float rrThreshold;
+        const std::string lightSampleStrategy;
+        const float bsdfSamplingFraction;
+        const int64_t splitThreshold;
+        std::unique_ptr<LightDistribution> lightDistribution;
+        std::unique_ptr<SDTree> sdTree;
+};
+
+}
\ No newline at end of file
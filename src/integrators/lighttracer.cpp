@@ -0,0 +1,240 @@
+#include "integrators/lighttracer.h"
+#include "integrators/bdpt.h"
+#include "filters/box.h"
+#include "interaction.h"
+#include "light.h"
+#include "lowdiscrepancy.h"
+#include "reflection.h"
+#include "sampling.h"
+#include "scene.h"
+
+#include "omp.h"
+
+namespace PBRender {
+
+// Buffers of the threads' splats may use at most this much memory in all;
+// larger images splat straight into the film
+static const size_t maxSplatBufferBytes = 256 << 20;
+
+// Adds _v_, scaled by _scale_, to the pixel of _splats_, an RGB image over
+// _bounds_, that _pRaster_ falls in, or to the film's pixel if there is no
+// buffer
+static void AddSplat(float *splats, const Bounds2i &bounds, float scale,
+                     Film &film, const Point2f &pRaster, Spectrum v) {
+    Point2i pi = (Point2i)pRaster;
+    if (!InsideExclusive(pi, bounds)) return;
+    v *= scale;
+    if (!splats) {
+        film.AddSplat(pRaster, v);
+        return;
+    }
+    if (v.HasNaNs() || v.y() < 0 || std::isinf(v.y())) return;
+    float rgb[3];
+    v.ToRGB(rgb);
+    int width = bounds.pMax.x - bounds.pMin.x;
+    int offset = 3 * ((pi.x - bounds.pMin.x) + (pi.y - bounds.pMin.y) * width);
+    for (int c = 0; c < 3; ++c) splats[offset + c] += rgb[c];
+}
+
+// LightTracerIntegrator Method Definitions
+void LightTracerIntegrator::Render(const Scene &scene,
+                                   std::vector<Spectrum> &col) {
+    // Splat into a film over the camera's whole image, whose pixel
+    // coordinates are the raster positions of the splats, and copy out the
+    // pixel bounds
+    std::unique_ptr<Filter> filter(CreateBoxFilter());
+    Film film(camera->fullResolution, std::move(filter));
+
+    Render(scene, film);
+    // Splats are sums over all light paths rather than averages
+    std::vector<Spectrum> image(film.pixelBounds.Area());
+    film.GetImage(image, 1 / (float)pathsPerPixel);
+    int width = pixelBounds.pMax.x - pixelBounds.pMin.x;
+    for (Point2i p : Intersect(pixelBounds, film.pixelBounds))
+        col[(p.x - pixelBounds.pMin.x) + (p.y - pixelBounds.pMin.y) * width] =
+            image[p.x + p.y * film.fullResolution.x];
+}
+
+void LightTracerIntegrator::Render(const Scene &scene, Film &film) {
+    std::unique_ptr<Distribution1D> lightDistr =
+        ComputeLightPowerDistribution(scene);
+    if (!lightDistr) {
+        std::cerr << "LightTracerIntegrator: the scene has no lights"
+                  << std::endl;
+        return;
+    }
+
+    // Trace the light paths, each thread splatting into its own buffer
+    // unless the buffers would take too much memory
+    Bounds2i sampleBounds = Intersect(film.GetSampleBounds(), pixelBounds);
+    if (sampleBounds.pMin.x >= sampleBounds.pMax.x ||
+        sampleBounds.pMin.y >= sampleBounds.pMax.y) {
+        std::cerr << "LightTracerIntegrator: the pixel bounds miss the film"
+                  << std::endl;
+        return;
+    }
+    int nPixels = sampleBounds.Area();
+    int64_t nPaths = (int64_t)pathsPerPixel * nPixels;
+    // The camera's importance spreads every path over the whole image, so
+    // with paths for only part of it, each splat stands for the paths that
+    // would have been traced for the rest
+    float splatScale = (float)camera->fullResolution.x *
+                       camera->fullResolution.y / nPixels;
+    bool useBuffers = (size_t)omp_get_max_threads() * nPixels * 3 *
+                          sizeof(float) <=
+                      maxSplatBufferBytes;
+    std::vector<std::vector<float>> threadSplats(
+        useBuffers ? omp_get_max_threads() : 0);
+    #pragma omp parallel
+    {
+        // Each thread allocates its own buffer, so that its pages are local
+        // to the thread
+        float *splats = nullptr;
+        if (useBuffers) {
+            threadSplats[omp_get_thread_num()].assign(3 * nPixels, 0.f);
+            splats = &threadSplats[omp_get_thread_num()][0];
+        }
+        #pragma omp for schedule(dynamic, 4096)
+        for (int64_t pathIndex = 0; pathIndex < nPaths; ++pathIndex)
+            TracePath(scene, *lightDistr, pathIndex, sampleBounds,
+                      splatScale, splats, film);
+    }
+
+    // Sum the thread buffers into the film's splat channels
+    if (useBuffers) {
+        int width = sampleBounds.pMax.x - sampleBounds.pMin.x;
+        #pragma omp parallel for schedule(dynamic, 4096)
+        for (int i = 0; i < nPixels; ++i) {
+            float rgb[3] = {0, 0, 0};
+            for (const std::vector<float> &splats : threadSplats)
+                if (!splats.empty())
+                    for (int c = 0; c < 3; ++c) rgb[c] += splats[3 * i + c];
+            Point2i p(sampleBounds.pMin.x + i % width,
+                      sampleBounds.pMin.y + i / width);
+            film.AddSplat(Point2f(p.x + 0.5f, p.y + 0.5f),
+                          Spectrum::FromRGB(rgb));
+        }
+    }
+    std::cout << "Rendering is finished!" << std::endl;
+}
+
+void LightTracerIntegrator::TracePath(const Scene &scene,
+                                      const Distribution1D &lightDistr,
+                                      uint64_t pathIndex,
+                                      const Bounds2i &splatBounds,
+                                      float splatScale, float *splats,
+                                      Film &film) const {
+    // The path's samples are the dimensions of the Halton point
+    // _pathIndex_, as for the photons of SPPM
+    int haltonDim = 0;
+
+    // Choose light to trace path from
+    float lightPdf;
+    float lightSample = RadicalInverse(haltonDim++, pathIndex);
+    int lightNum = lightDistr.SampleDiscrete(lightSample, &lightPdf);
+    const std::shared_ptr<Light> &light = scene.lights[lightNum];
+
+    // Generate _ray_ from light source and initialize _beta_
+    Point2f uLight0(RadicalInverse(haltonDim, pathIndex),
+                    RadicalInverse(haltonDim + 1, pathIndex));
+    Point2f uLight1(RadicalInverse(haltonDim + 2, pathIndex),
+                    RadicalInverse(haltonDim + 3, pathIndex));
+    haltonDim += 4;
+    RayDifferential ray;
+    Normal3f nLight;
+    float pdfPos, pdfDir;
+    Spectrum Le = light->Sample_Le(uLight0, uLight1, 0, &ray, &nLight,
+                                   &pdfPos, &pdfDir);
+    if (pdfPos == 0 || pdfDir == 0 || Le.IsBlack()) return;
+
+    // Connect the point on an area light to the camera, which makes the
+    // light visible
+    if (light->flags & (int)LightFlags::Area) {
+        Interaction lightIntr(ray.o, ray.time);
+        lightIntr.n = nLight;
+        Point2f uCamera(RadicalInverse(haltonDim, pathIndex),
+                        RadicalInverse(haltonDim + 1, pathIndex));
+        Vector3f wi;
+        float pdf;
+        Point2f pRaster;
+        VisibilityTester vis;
+        Spectrum We =
+            camera->Sample_Wi(lightIntr, uCamera, &wi, &pdf, &pRaster, &vis);
+        if (pdf > 0 && !We.IsBlack()) {
+            // The sampled point's error bounds aren't known, so the shadow
+            // ray is traced from the lens, stopping short of the light
+            Spectrum L = ((const AreaLight *)light.get())->L(lightIntr, wi);
+            if (!L.IsBlack() &&
+                VisibilityTester(vis.P1(), vis.P0()).Unoccluded(scene))
+                AddSplat(splats, splatBounds, splatScale, film, pRaster,
+                         L * We * AbsDot(nLight, wi) /
+                             (lightPdf * pdfPos * pdf));
+        }
+    }
+    haltonDim += 2;
+
+    Spectrum beta = (AbsDot(nLight, ray.d) * Le) / (lightPdf * pdfPos * pdfDir);
+    if (beta.IsBlack()) return;
+
+    // Follow the path through the scene, connecting each vertex to the
+    // camera. Paths stop early if they'd run out of Halton dimensions.
+    SurfaceInteraction isect;
+    for (int depth = 0; depth < maxDepth; ++depth) {
+        if (haltonDim + 5 > PrimeTableSize) break;
+        if (!scene.Intersect(ray, &isect)) break;
+
+        // Compute BSDF at the path vertex and skip over medium boundaries
+        isect.ComputeScatteringFunctions(ray, true, TransportMode::Importance);
+        if (!isect.bsdf) {
+            --depth;
+            ray = isect.SpawnRay(ray.d);
+            continue;
+        }
+        const BSDF &bsdf = *isect.bsdf;
+
+        // Connect the vertex to the camera unless its BSDF is specular
+        Point2f uCamera(RadicalInverse(haltonDim, pathIndex),
+                        RadicalInverse(haltonDim + 1, pathIndex));
+        haltonDim += 2;
+        if (bsdf.NumComponents(BxDFType(BSDF_ALL & ~BSDF_SPECULAR)) > 0) {
+            Vector3f wi;
+            float pdf;
+            Point2f pRaster;
+            VisibilityTester vis;
+            Spectrum We =
+                camera->Sample_Wi(isect, uCamera, &wi, &pdf, &pRaster, &vis);
+            if (pdf > 0 && !We.IsBlack()) {
+                Spectrum f = bsdf.f(isect.wo, wi) *
+                             AbsDot(wi, isect.shading.n) *
+                             CorrectShadingNormal(isect, isect.wo, wi,
+                                                  TransportMode::Importance);
+                if (!f.IsBlack() && vis.Unoccluded(scene))
+                    AddSplat(splats, splatBounds, splatScale, film, pRaster,
+                             beta * f * We / pdf);
+            }
+        }
+        if (depth + 1 == maxDepth) break;
+
+        // Sample BSDF _fr_ and direction _wi_ for the next vertex
+        Vector3f wi, wo = -ray.d;
+        float pdf;
+        BxDFType flags;
+        Point2f bsdfSample(RadicalInverse(haltonDim, pathIndex),
+                           RadicalInverse(haltonDim + 1, pathIndex));
+        haltonDim += 2;
+        Spectrum fr = bsdf.Sample_f(wo, &wi, bsdfSample, &pdf, BSDF_ALL, &flags);
+        if (fr.IsBlack() || pdf == 0.f) break;
+        Spectrum bnew = beta * fr * AbsDot(wi, isect.shading.n) *
+                        CorrectShadingNormal(isect, wo, wi,
+                                             TransportMode::Importance) /
+                        pdf;
+
+        // Possibly terminate the path with Russian roulette
+        float q = std::max(0.f, 1 - bnew.y() / beta.y());
+        if (RadicalInverse(haltonDim++, pathIndex) < q) break;
+        beta = bnew / (1 - q);
+        ray = (RayDifferential)isect.SpawnRay(wi);
+    }
+}
+
+}
\ No newline at end of file
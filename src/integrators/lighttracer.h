@@ -0,0 +1,59 @@
+#pragma once
+
+#include "PBRender.h"
+#include "integrator.h"
+#include "camera.h"
+#include "film.h"
+
+namespace PBRender {
+
+// LightTracerIntegrator Declarations
+// Particle tracing from the lights. _pathsPerPixel_ times the number of
+// pixels paths leave the lights with _Light::Sample_Le()_, and every vertex
+// they reach, as well as the point they leave the light from, is connected
+// to the camera with _Camera::Sample_Wi()_ and splatted where it lands on
+// the film. Caustics on diffuse surfaces, which path tracing can only find
+// by chance, come from every light path, but nothing is seen through
+// specular surfaces.
+//
+// The film's pixels are the camera's raster positions. With pixel bounds
+// that cover part of the image, only the paths for those pixels are traced
+// and only the splats inside them are kept, scaled by the ratio of the
+// image's pixels to theirs.
+//
+// Each thread splats into a private RGB buffer of the film's pixels, so the
+// splats need no synchronization; the buffers are summed once all the paths
+// are traced. They take 12 bytes per pixel and thread, so when that would
+// exceed 256MB in all, the splats go straight to the film's atomic splat
+// channels instead.
+class LightTracerIntegrator : public Integrator {
+    public:
+        // LightTracerIntegrator Public Methods
+        LightTracerIntegrator(std::shared_ptr<const Camera> camera,
+                              int pathsPerPixel, int maxDepth,
+                              const Bounds2i &pixelBounds)
+            : camera(camera),
+              pathsPerPixel(pathsPerPixel),
+              maxDepth(maxDepth),
+              pixelBounds(pixelBounds) {}
+
+        void Render(const Scene &scene, std::vector<Spectrum> &col);
+        void Render(const Scene &scene, Film &film);
+
+    private:
+        // LightTracerIntegrator Private Methods
+        // Traces light path _pathIndex_ and adds its camera connections
+        // within _splatBounds_, scaled by _splatScale_, to the RGB image
+        // _splats_ over them, or to _film_ if _splats_ is null
+        void TracePath(const Scene &scene, const Distribution1D &lightDistr,
+                       uint64_t pathIndex, const Bounds2i &splatBounds,
+                       float splatScale, float *splats, Film &film) const;
+
+        // LightTracerIntegrator Private Data
+        std::shared_ptr<const Camera> camera;
+        const int pathsPerPixel;
+        const int maxDepth;
+        const Bounds2i pixelBounds;
+};
+
+}
\ No newline at end of file
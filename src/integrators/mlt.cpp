@@ -0,0 +1,278 @@
+#include "integrators/mlt.h"
+#include "film.h"
+#include "filters/box.h"
+
+#include "omp.h"
+
+#include <atomic>
+
+namespace PBRender {
+
+// MLT Constants
+static const int cameraStreamIndex = 0;
+static const int lightStreamIndex = 1;
+static const int connectionStreamIndex = 2;
+static const int nSampleStreams = 3;
+
+// Splats of one mutation carry at most unit luminance, so the image can be
+// summed in 64-bit fixed point. Integer sums don't depend on the order of
+// the additions, which keeps the result independent of thread scheduling.
+static const double splatFixedPointScale = double(1 << 24);
+
+// MLTSampler Method Definitions
+float MLTSampler::Get1D() {
+    int index = GetNextIndex();
+    EnsureReady(index);
+    return X[index].value;
+}
+
+Point2f MLTSampler::Get2D() { return Point2f(Get1D(), Get1D()); }
+
+std::unique_ptr<Sampler> MLTSampler::Clone(int) {
+    // Every chain owns its sampler, so there is nothing to clone
+    return nullptr;
+}
+
+void MLTSampler::StartIteration() {
+    currentIteration++;
+    largeStep = rng.UniformFloat() < largeStepProbability;
+}
+
+void MLTSampler::Accept() {
+    if (largeStep) lastLargeStepIteration = currentIteration;
+}
+
+void MLTSampler::EnsureReady(int index) {
+    // Enlarge _MLTSampler::X_ if necessary and get current $\VEC{X}_i$
+    if (index >= (int)X.size()) X.resize(index + 1);
+    PrimarySample &Xi = X[index];
+
+    // Reset $\VEC{X}_i$ if a large step took place in the meantime
+    if (Xi.lastModificationIteration < lastLargeStepIteration) {
+        Xi.value = rng.UniformFloat();
+        Xi.lastModificationIteration = lastLargeStepIteration;
+    }
+
+    // Apply remaining sequence of mutations to _sample_
+    Xi.Backup();
+    if (largeStep) {
+        Xi.value = rng.UniformFloat();
+    } else {
+        int64_t nSmall = currentIteration - Xi.lastModificationIteration;
+        // Apply _nSmall_ small step mutations
+
+        // Sample the standard normal distribution $N(0, 1)$
+        float normalSample = Sqrt2 * ErfInv(2 * rng.UniformFloat() - 1);
+
+        // Compute the effective standard deviation and apply perturbation to
+        // $\VEC{X}_i$
+        float effSigma = sigma * std::sqrt((float)nSmall);
+        Xi.value += normalSample * effSigma;
+        Xi.value -= std::floor(Xi.value);
+        Xi.value = std::min(Xi.value, OneMinusEpsilon);
+    }
+    Xi.lastModificationIteration = currentIteration;
+}
+
+void MLTSampler::Reject() {
+    for (auto &Xi : X)
+        if (Xi.lastModificationIteration == currentIteration) Xi.Restore();
+    --currentIteration;
+}
+
+void MLTSampler::StartStream(int index) {
+    assert(index < streamCount);
+    streamIndex = index;
+    sampleIndex = 0;
+}
+
+// MLT Method Definitions
+Spectrum MLTIntegrator::L(
+    const Scene &scene, const Distribution1D &lightDistr,
+    const std::unordered_map<const Light *, size_t> &lightToIndex,
+    MLTSampler &sampler, int depth, Point2f *pRaster,
+    std::vector<Vertex> *cameraVertices, std::vector<Vertex> *lightVertices) {
+    sampler.StartStream(cameraStreamIndex);
+    // Determine the number of available strategies and pick a specific one
+    int s, t, nStrategies;
+    if (depth == 0) {
+        nStrategies = 1;
+        s = 0;
+        t = 2;
+    } else {
+        nStrategies = depth + 2;
+        s = std::min((int)(sampler.Get1D() * nStrategies), nStrategies - 1);
+        t = nStrategies - s;
+    }
+
+    // Generate a camera subpath with exactly _t_ vertices
+    Bounds2f sampleBounds = (Bounds2f)pixelBounds;
+    CameraSample cameraSample;
+    cameraSample.pFilm = sampleBounds.Lerp(sampler.Get2D());
+    cameraSample.pLens = sampler.Get2D();
+    cameraSample.time = sampler.Get1D();
+    *pRaster = cameraSample.pFilm;
+    if (GenerateCameraSubpath(scene, sampler, t, *camera, cameraSample,
+                              &(*cameraVertices)[0]) != t)
+        return Spectrum(0.f);
+
+    // Generate a light subpath with exactly _s_ vertices
+    sampler.StartStream(lightStreamIndex);
+    if (GenerateLightSubpath(scene, sampler, s, (*cameraVertices)[0].time(),
+                             lightDistr, lightToIndex,
+                             &(*lightVertices)[0]) != s)
+        return Spectrum(0.f);
+
+    // Execute connection strategy and return the radiance estimate
+    sampler.StartStream(connectionStreamIndex);
+    return ConnectBDPT(scene, &(*lightVertices)[0], &(*cameraVertices)[0], s,
+                       t, lightDistr, lightToIndex, *camera, sampler,
+                       pRaster) *
+           nStrategies;
+}
+
+void MLTIntegrator::Render(const Scene &scene, std::vector<Spectrum> &col) {
+    int rasterX = pixelBounds.pMax.x - pixelBounds.pMin.x;
+    int rasterY = pixelBounds.pMax.y - pixelBounds.pMin.y;
+    std::unique_ptr<Filter> filter(CreateBoxFilter());
+    Film film(Point2i(rasterX, rasterY), std::move(filter));
+
+    Render(scene, film);
+    film.GetImage(col);
+}
+
+void MLTIntegrator::Render(const Scene &scene, Film &film) {
+    std::unique_ptr<Distribution1D> lightDistr =
+        ComputeLightPowerDistribution(scene);
+    if (!lightDistr) {
+        std::cerr << "MLTIntegrator: the scene has no lights" << std::endl;
+        return;
+    }
+
+    // Compute a reverse mapping from light pointers to offsets into the
+    // scene lights vector (and, equivalently, offsets into _lightDistr_)
+    std::unordered_map<const Light *, size_t> lightToIndex;
+    for (size_t i = 0; i < scene.lights.size(); ++i)
+        lightToIndex[scene.lights[i].get()] = i;
+
+    // Generate bootstrap samples and compute normalization constant $b$
+    int nBootstrapSamples = nBootstrap * (maxDepth + 1);
+    std::vector<float> bootstrapWeights(nBootstrapSamples, 0);
+    #pragma omp parallel
+    {
+        std::vector<Vertex> cameraVertices(maxDepth + 2);
+        std::vector<Vertex> lightVertices(maxDepth + 1);
+        #pragma omp for schedule(dynamic, 64)
+        for (int i = 0; i < nBootstrap; ++i) {
+            // Generate _i_th bootstrap sample
+            for (int depth = 0; depth <= maxDepth; ++depth) {
+                int rngIndex = i * (maxDepth + 1) + depth;
+                MLTSampler sampler(mutationsPerPixel, SequenceIndex(rngIndex),
+                                   sigma, largeStepProbability,
+                                   nSampleStreams);
+                Point2f pRaster;
+                bootstrapWeights[rngIndex] =
+                    L(scene, *lightDistr, lightToIndex, sampler, depth,
+                      &pRaster, &cameraVertices, &lightVertices)
+                        .y();
+            }
+        }
+    }
+    Distribution1D bootstrap(&bootstrapWeights[0], nBootstrapSamples);
+    float b = bootstrap.funcInt * (maxDepth + 1);
+    if (b == 0) {
+        std::cerr << "MLTIntegrator: no bootstrap path carries light"
+                  << std::endl;
+        return;
+    }
+
+    // Run _nChains_ Markov chains in parallel
+    Bounds2i sampleBounds = pixelBounds;
+    int width = sampleBounds.pMax.x - sampleBounds.pMin.x;
+    int nPixels = sampleBounds.Area();
+    std::unique_ptr<std::atomic<uint64_t>[]> splats(
+        new std::atomic<uint64_t>[3 * nPixels]);
+    for (int i = 0; i < 3 * nPixels; ++i) splats[i] = 0;
+    auto addSplat = [&](const Point2f &p, const Spectrum &v) {
+        Point2i pi = (Point2i)p;
+        if (!InsideExclusive(pi, sampleBounds)) return;
+        if (v.HasNaNs() || std::isinf(v.y())) return;
+        float rgb[3];
+        v.ToRGB(rgb);
+        int offset = 3 * ((pi.x - sampleBounds.pMin.x) +
+                          (pi.y - sampleBounds.pMin.y) * width);
+        for (int c = 0; c < 3; ++c)
+            if (rgb[c] > 0)
+                splats[offset + c].fetch_add(
+                    (uint64_t)(rgb[c] * splatFixedPointScale + 0.5),
+                    std::memory_order_relaxed);
+    };
+
+    int64_t nTotalMutations = (int64_t)mutationsPerPixel * (int64_t)nPixels;
+    std::atomic<int64_t> acceptedMutations(0);
+    #pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < nChains; ++i) {
+        int64_t nChainMutations =
+            std::min((i + 1) * nTotalMutations / nChains, nTotalMutations) -
+            i * nTotalMutations / nChains;
+        // Follow _i_th Markov chain for _nChainMutations_
+        RNG rng(SequenceIndex(i));
+        std::vector<Vertex> cameraVertices(maxDepth + 2);
+        std::vector<Vertex> lightVertices(maxDepth + 1);
+
+        // Select initial state from the set of bootstrap samples
+        int bootstrapIndex = bootstrap.SampleDiscrete(rng.UniformFloat());
+        int depth = bootstrapIndex % (maxDepth + 1);
+
+        // Initialize local variables for selected state
+        MLTSampler sampler(mutationsPerPixel, SequenceIndex(bootstrapIndex),
+                           sigma, largeStepProbability, nSampleStreams);
+        Point2f pCurrent;
+        Spectrum LCurrent = L(scene, *lightDistr, lightToIndex, sampler, depth,
+                              &pCurrent, &cameraVertices, &lightVertices);
+
+        // Run the Markov chain for _nChainMutations_ steps
+        int64_t accepted = 0;
+        for (int64_t j = 0; j < nChainMutations; ++j) {
+            sampler.StartIteration();
+            Point2f pProposed;
+            Spectrum LProposed =
+                L(scene, *lightDistr, lightToIndex, sampler, depth, &pProposed,
+                  &cameraVertices, &lightVertices);
+            // Compute acceptance probability for proposed sample
+            float accept = std::min(1.f, LProposed.y() / LCurrent.y());
+
+            // Splat both current and proposed samples to the image
+            if (accept > 0)
+                addSplat(pProposed, LProposed * accept / LProposed.y());
+            addSplat(pCurrent, LCurrent * (1 - accept) / LCurrent.y());
+
+            // Accept or reject the proposal
+            if (rng.UniformFloat() < accept) {
+                pCurrent = pProposed;
+                LCurrent = LProposed;
+                sampler.Accept();
+                ++accepted;
+            } else
+                sampler.Reject();
+        }
+        acceptedMutations += accepted;
+    }
+
+    // Resolve the fixed point sums into the film's splat channels
+    float scale = b / mutationsPerPixel;
+    for (Point2i p : sampleBounds) {
+        int offset = 3 * ((p.x - sampleBounds.pMin.x) +
+                          (p.y - sampleBounds.pMin.y) * width);
+        float rgb[3];
+        for (int c = 0; c < 3; ++c)
+            rgb[c] = scale * (float)(splats[offset + c] / splatFixedPointScale);
+        film.AddSplat(Point2f(p.x + 0.5f, p.y + 0.5f), Spectrum::FromRGB(rgb));
+    }
+    std::cout << "MLT acceptance rate: "
+              << (float)acceptedMutations / (float)nTotalMutations
+              << std::endl;
+    std::cout << "Rendering is finished!" << std::endl;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "PBRender.h"
+#include "integrator.h"
+#include "integrators/bdpt.h"
+#include "rng.h"
+#include "sampler.h"
+
+#include <unordered_map>
+
+namespace PBRender {
+
+// MLTSampler Declarations
+// Sampler over primary sample space for Metropolis light transport. Each
+// iteration either replaces all sample values (a large step) or perturbs
+// them with a normal distribution of width _sigma_ (a small step); values
+// are generated lazily, so only the ones a path actually consumes are
+// mutated. The samples are interleaved into _streamCount_ streams so that
+// the camera subpath, light subpath and connection keep their own values.
+class MLTSampler : public Sampler {
+    public:
+        // MLTSampler Public Methods
+        MLTSampler(int mutationsPerPixel, uint64_t rngSequenceIndex,
+                   float sigma, float largeStepProbability, int streamCount)
+            : Sampler(mutationsPerPixel),
+              rng(rngSequenceIndex),
+              sigma(sigma),
+              largeStepProbability(largeStepProbability),
+              streamCount(streamCount) {}
+        float Get1D();
+        Point2f Get2D();
+        std::unique_ptr<Sampler> Clone(int);
+        void StartIteration();
+        void Accept();
+        void Reject();
+        void StartStream(int index);
+        int GetNextIndex() { return streamIndex + streamCount * sampleIndex++; }
+
+    protected:
+        // MLTSampler Private Declarations
+        struct PrimarySample {
+            float value = 0;
+            // PrimarySample Public Methods
+            void Backup() {
+                valueBackup = value;
+                modifyBackup = lastModificationIteration;
+            }
+            void Restore() {
+                value = valueBackup;
+                lastModificationIteration = modifyBackup;
+            }
+
+            // PrimarySample Public Data
+            int64_t lastModificationIteration = 0;
+            float valueBackup = 0;
+            int64_t modifyBackup = 0;
+        };
+
+        // MLTSampler Private Methods
+        void EnsureReady(int index);
+
+        // MLTSampler Private Data
+        RNG rng;
+        const float sigma, largeStepProbability;
+        const int streamCount;
+        std::vector<PrimarySample> X;
+        int64_t currentIteration = 0;
+        bool largeStep = true;
+        int64_t lastLargeStepIteration = 0;
+        int streamIndex, sampleIndex;
+};
+
+// MLT Declarations
+// Multiplexed Metropolis light transport over the BDPT connection
+// strategies. A bootstrap phase estimates the image brightness from
+// _nBootstrap_ independent paths per path depth and picks the starting
+// states of _nChains_ Markov chains, which then run in parallel and splat
+// both the current and the proposed path of every mutation. All random
+// numbers come from sequences indexed by _seed_ and the chain or bootstrap
+// sample, and splats are summed in fixed point, so a given seed renders
+// the same image with any number of threads.
+class MLTIntegrator : public Integrator {
+    public:
+        // MLTIntegrator Public Methods
+        MLTIntegrator(std::shared_ptr<const Camera> camera, int maxDepth,
+                      int nBootstrap, int nChains, int mutationsPerPixel,
+                      float sigma, float largeStepProbability,
+                      const Bounds2i &pixelBounds, uint32_t seed = 0)
+            : camera(camera),
+              maxDepth(maxDepth),
+              nBootstrap(nBootstrap),
+              nChains(nChains),
+              mutationsPerPixel(mutationsPerPixel),
+              sigma(sigma),
+              largeStepProbability(largeStepProbability),
+              pixelBounds(pixelBounds),
+              seed(seed) {}
+
+        void Render(const Scene &scene, std::vector<Spectrum> &col);
+        void Render(const Scene &scene, Film &film);
+
+    private:
+        // MLTIntegrator Private Methods
+        Spectrum L(const Scene &scene, const Distribution1D &lightDistr,
+                   const std::unordered_map<const Light *, size_t> &lightToIndex,
+                   MLTSampler &sampler, int depth, Point2f *pRaster,
+                   std::vector<Vertex> *cameraVertices,
+                   std::vector<Vertex> *lightVertices);
+        uint64_t SequenceIndex(uint64_t index) const {
+            return index ^ ((uint64_t)seed << 40);
+        }
+
+        // MLTIntegrator Private Data
+        std::shared_ptr<const Camera> camera;
+        const int maxDepth;
+        const int nBootstrap;
+        const int nChains;
+        const int mutationsPerPixel;
+        const float sigma, largeStepProbability;
+        const Bounds2i pixelBounds;
+        const uint32_t seed;
+};
+
+}
\ No newline at end of file
@@ -13,29 +13,171 @@ static float zeroRadiancePaths = 0;
 static float totalPaths        = 0;
 static long long pathLength    = 0;
 
+// Diffuse vertices of a path recorded for training the radiance cache
+static const int MaxCacheVertices = 32;
+
+struct CacheVertex {
+    Point3f p;
+    Normal3f n;
+    // Path throughput after sampling the vertex's BSDF, and the factor that
+    // turns the radiance arriving along the sampled direction, divided by
+    // it, into the incident light that is cached
+    Spectrum throughput;
+    float cosOverPdf;
+    // Radiance of the path before its continuation from the vertex
+    Spectrum L;
+};
+
+// Whether the radiance cache can stand in for the light that _bsdf_ reflects
+static bool IsDiffuse(const BSDF &bsdf) {
+    return bsdf.NumComponents(BxDFType(BSDF_DIFFUSE | BSDF_REFLECTION |
+                                       BSDF_TRANSMISSION)) ==
+           bsdf.NumComponents();
+}
+
+// The cache keeps the light arriving at a point scaled by 1/Pi, which the
+// albedo turns into the light a diffuse surface reflects. Lambertian
+// surfaces ignore the samples of the albedo estimate.
+static Spectrum DiffuseAlbedo(const BSDF &bsdf, const Vector3f &wo) {
+    const int nSamples = 4;
+    Point2f u[nSamples * nSamples];
+    for (int y = 0; y < nSamples; ++y)
+        for (int x = 0; x < nSamples; ++x)
+            u[x + y * nSamples] =
+                Point2f((x + .5f) / nSamples, (y + .5f) / nSamples);
+    return bsdf.rho(wo, nSamples * nSamples, u);
+}
+
 // PathIntegrator Method Definitions
 PathIntegrator::PathIntegrator(int maxDepth,
                                std::shared_ptr<const Camera> camera,
                                std::shared_ptr<Sampler> sampler,
                                const Bounds2i &pixelBounds, float rrThreshold,
-                               const std::string &lightSampleStrategy)
+                               const std::string &lightSampleStrategy,
+                               bool deferShadowRays,
+                               const RadianceCacheOptions &cacheOptions,
+                               bool shadeFirstHitsByMaterial)
     : SamplerIntegrator(camera, sampler, pixelBounds),
       maxDepth(maxDepth),
       rrThreshold(rrThreshold),
-      lightSampleStrategy(lightSampleStrategy) {}
+      lightSampleStrategy(lightSampleStrategy),
+      deferShadowRays(deferShadowRays),
+      cacheOptions(cacheOptions),
+      shadeFirstHitsByMaterial(shadeFirstHitsByMaterial) {}
 
 void PathIntegrator::Preprocess(const Scene &scene, Sampler &sampler) {
     lightDistribution =
         CreateLightSampleDistribution(lightSampleStrategy, scene);
+    if (cacheOptions.diffuseBounces > 0) TrainRadianceCache(scene, sampler);
+}
+
+void PathIntegrator::TrainRadianceCache(const Scene &scene, Sampler &sampler) {
+    float accuracy = std::max(cacheOptions.accuracy, .01f);
+    radianceCache.reset(new RadianceCache(scene.WorldBound(),
+                                          (int)std::ceil(64 * accuracy),
+                                          1 << 19,
+                                          (int)std::ceil(4 * accuracy)));
+
+    // Trace _trainingSpp_ paths through every pixel, in tiles as in
+    // _Render()_. They take the sample numbers past the image's, so the
+    // cache is independent of the paths that terminate into it.
+    Vector2i extent = pixelBounds.Diagonal();
+    const int tileSize = 16;
+    Point2i nTiles((extent.x + tileSize - 1) / tileSize,
+                   (extent.y + tileSize - 1) / tileSize);
+    int nTotalTiles = nTiles.x * nTiles.y;
+    int64_t firstSample = sampler.samplesPerPixel;
+    float diffScale = 1 / std::sqrt((float)cacheOptions.trainingSpp);
+
+    #pragma omp parallel for schedule(dynamic)
+    for (int tile = 0; tile < nTotalTiles; ++tile) {
+        int tileX = tile % nTiles.x, tileY = tile / nTiles.x;
+        std::unique_ptr<Sampler> tileSampler = sampler.Clone(tile);
+        int x0 = pixelBounds.pMin.x + tileX * tileSize;
+        int x1 = std::min(x0 + tileSize, pixelBounds.pMax.x);
+        int y0 = pixelBounds.pMin.y + tileY * tileSize;
+        int y1 = std::min(y0 + tileSize, pixelBounds.pMax.y);
+        for (Point2i pixel : Bounds2i(Point2i(x0, y0), Point2i(x1, y1))) {
+            tileSampler->StartPixel(pixel);
+            for (int i = 0; i < cacheOptions.trainingSpp; ++i) {
+                tileSampler->SetSampleNumber(firstSample + i);
+                CameraSample cameraSample = tileSampler->GetCameraSample(pixel);
+                RayDifferential ray;
+                if (camera->GenerateRayDifferential(cameraSample, &ray) == 0)
+                    continue;
+                ray.ScaleDifferentials(diffScale);
+                TracePath<0>(ray, scene, *tileSampler, nullptr, nullptr, 0,
+                             true);
+            }
+        }
+    }
+    radianceCache->Update();
+    std::cout << "Radiance cache trained with " << cacheOptions.trainingSpp
+              << " spp, " << radianceCache->CellCount() << " cells"
+              << std::endl;
 }
 
 Spectrum PathIntegrator::Li(const RayDifferential &r, const Scene &scene, Sampler &sampler, 
                             // MemoryArena &arena, 
                             int depth) const {
+    return TracePath<0>(r, scene, sampler, nullptr);
+}
+
+Spectrum PathIntegrator::LiDeferred(const RayDifferential &r,
+                                    const Scene &scene, Sampler &sampler,
+                                    ShadowRayBatch *shadowRays,
+                                    int sample) const {
+    return TracePath<0>(r, scene, sampler, nullptr, shadowRays, sample);
+}
+
+Spectrum PathIntegrator::LiShaded(const RayDifferential &r,
+                                  SurfaceInteraction *isect,
+                                  const Scene &scene, Sampler &sampler) const {
+    return TracePath<0>(r, scene, sampler, nullptr, nullptr, 0, false, isect);
+}
+
+// Selects the _TracePath()_ instantiation for a runtime channel mask
+template <int Channels>
+struct TracePathDispatch {
+    static Spectrum Run(const PathIntegrator &integrator, int channels,
+                        const RayDifferential &ray, const Scene &scene,
+                        Sampler &sampler, AOVSample *aov) {
+        if (channels == Channels)
+            return integrator.TracePath<Channels>(ray, scene, sampler, aov);
+        return TracePathDispatch<Channels - 1>::Run(integrator, channels, ray,
+                                                    scene, sampler, aov);
+    }
+};
+
+template <>
+struct TracePathDispatch<0> {
+    static Spectrum Run(const PathIntegrator &integrator, int channels,
+                        const RayDifferential &ray, const Scene &scene,
+                        Sampler &sampler, AOVSample *aov) {
+        return integrator.TracePath<0>(ray, scene, sampler, aov);
+    }
+};
+
+Spectrum PathIntegrator::LiAOV(const RayDifferential &ray, const Scene &scene,
+                               Sampler &sampler, int channels,
+                               AOVSample *aov) const {
+    return TracePathDispatch<AOVAllChannels>::Run(
+        *this, channels & AOVAllChannels, ray, scene, sampler, aov);
+}
+
+template <int Channels>
+Spectrum PathIntegrator::TracePath(const RayDifferential &r, const Scene &scene,
+                                   Sampler &sampler, AOVSample *aov,
+                                   ShadowRayBatch *shadowRays,
+                                   int sample, bool trainCache,
+                                   SurfaceInteraction *firstHit) const {
     Spectrum L(0.f), beta(1.f);
     RayDifferential ray(r);
     bool specularBounce = false;
     int bounces;
+    int diffuseBounces = 0;
+    CacheVertex cacheVertices[MaxCacheVertices];
+    int nCacheVertices = 0;
 
     float etaScale = 1;
 
@@ -44,15 +186,22 @@ Spectrum PathIntegrator::Li(const RayDifferential &r, const Scene &scene, Sample
         // std::cout << "Path tracer bounce " << bounces << ", current L = " << L
         //           << ", beta = " << beta << std::endl;
         
-        // Intersect _ray_ with scene and store intersection in _isect_
-        SurfaceInteraction isect;
-        bool foundIntersection = scene.Intersect(ray, &isect);
+        // Intersect _ray_ with scene and store intersection in _isect_,
+        // unless it is the camera ray's hit that was shaded beforehand
+        SurfaceInteraction hit;
+        SurfaceInteraction &isect = firstHit ? *firstHit : hit;
+        bool shaded = firstHit != nullptr;
+        bool foundIntersection = shaded ? isect.primitive != nullptr
+                                        : scene.Intersect(ray, &isect);
+        firstHit = nullptr;
 
         // Possibly add emitted light at intersection
         if (bounces == 0 || specularBounce) {
             // Add emitted light at path vertex or from the environment
             if (foundIntersection) {
-                L += beta * isect.Le(-ray.d);
+                Spectrum Le = isect.Le(-ray.d);
+                if (Channels && bounces == 0 && !Le.IsBlack()) aov->emitter = true;
+                L += beta * Le;
                 // std::cout << "Added Le -> L = " << L << std::endl;
             } else {
                 for (const auto &light : scene.infiniteLights)
@@ -65,31 +214,51 @@ Spectrum PathIntegrator::Li(const RayDifferential &r, const Scene &scene, Sample
         if (!foundIntersection || bounces >= maxDepth) break;
 
         // Compute scattering functions and skip over medium boundaries
-        isect.ComputeScatteringFunctions(ray, true);
+        if (!shaded) isect.ComputeScatteringFunctions(ray, true);
         if (!isect.bsdf) {
             // std::cout << "Skipping intersection due to null bsdf" << std::endl;
             ray = isect.SpawnRay(ray.d);
             bounces--;
             continue;
         }
-
-        const Distribution1D *distrib = lightDistribution->Lookup(isect.p);
+        if (Channels && bounces == 0) RecordAOVs<Channels>(ray, isect, aov);
 
         // Sample illumination from lights to find path contribution.
         // (But skip this for perfectly specular BSDFs.)
         if (isect.bsdf->NumComponents(BxDFType(BSDF_ALL & ~BSDF_SPECULAR)) > 0) {
             ++totalPaths;
+            DeferredShadowRay shadow;
             Spectrum Ld = beta * UniformSampleOneLight(isect, scene, 
                                                     //    arena,
-                                                       sampler, false, distrib);
-            if (Ld.IsBlack()) ++zeroRadiancePaths;
+                                                       sampler,
+                                                       *lightDistribution,
+                                                       false,
+                                                       shadowRays ? &shadow
+                                                                  : nullptr);
+            if (!shadow.Ld.IsBlack())
+                shadowRays->Push(shadow, beta, sample);
+            else if (Ld.IsBlack())
+                ++zeroRadiancePaths;
             // CHECK_GE(Ld.y(), 0.f);
             assert(Ld.y() >= 0.0f);
             L += Ld;
         }
 
-        // Sample BSDF to get new path direction
+        // After enough diffuse bounces, terminate the path with the light
+        // that the radiance cache has for the vertex
         Vector3f wo = -ray.d, wi;
+        bool cacheable = radianceCache && IsDiffuse(*isect.bsdf);
+        Normal3f n = Faceforward(isect.n, wo);
+        if (cacheable && !trainCache &&
+            diffuseBounces >= cacheOptions.diffuseBounces) {
+            Spectrum E;
+            if (radianceCache->Lookup(isect.p, n, &E)) {
+                L += beta * DiffuseAlbedo(*isect.bsdf, wo) * E;
+                break;
+            }
+        }
+
+        // Sample BSDF to get new path direction
         float pdf;
         BxDFType flags;
         Spectrum f = isect.bsdf->Sample_f(wo, &wi, sampler.Get2D(), &pdf,
@@ -103,6 +272,12 @@ Spectrum PathIntegrator::Li(const RayDifferential &r, const Scene &scene, Sample
         assert(beta.y() > 0.f);
         assert(!std::isinf(beta.y()));
 
+        if (trainCache && cacheable && nCacheVertices < MaxCacheVertices)
+            cacheVertices[nCacheVertices++] = {
+                isect.p, n, beta, AbsDot(wi, isect.shading.n) / (Pi * pdf),
+                L};
+        if (flags & BSDF_DIFFUSE) ++diffuseBounces;
+
         specularBounce = (flags & BSDF_SPECULAR) != 0;
         if ((flags & BSDF_SPECULAR) && (flags & BSDF_TRANSMISSION)) {
             float eta = isect.bsdf->eta;
@@ -148,6 +323,16 @@ Spectrum PathIntegrator::Li(const RayDifferential &r, const Scene &scene, Sample
         }
     }
 
+    // Record the light that the continuation from each diffuse vertex
+    // brought back
+    for (int i = 0; i < nCacheVertices; ++i) {
+        const CacheVertex &v = cacheVertices[i];
+        Spectrum E(0.f);
+        for (int c = 0; c < Spectrum::nSamples; ++c)
+            if (v.throughput[c] > 0)
+                E[c] = (L[c] - v.L[c]) / v.throughput[c] * v.cosOverPdf;
+        radianceCache->Record(v.p, v.n, E);
+    }
     return L;
 }
 
@@ -3,6 +3,7 @@
 #include "PBRender.h"
 #include "integrator.h"
 #include "lightdistrib.h"
+#include "radiancecache.h"
 
 namespace PBRender {
 
@@ -11,18 +12,57 @@ class PathIntegrator : public SamplerIntegrator {
         PathIntegrator(int maxDepth, std::shared_ptr<const Camera> camera,
                        std::shared_ptr<Sampler> sampler,
                        const Bounds2i &pixelBounds, float rrThreshold = 1,
-                       const std::string &lightSampleStrategy = "uniform");
+                       const std::string &lightSampleStrategy = "uniform",
+                       bool deferShadowRays = false,
+                       const RadianceCacheOptions &cacheOptions =
+                           RadianceCacheOptions(),
+                       bool shadeFirstHitsByMaterial = false);
 
         void Preprocess(const Scene &scene, Sampler &sampler);
         Spectrum Li(const RayDifferential &ray, const Scene &scene, Sampler &sampler, 
                     // MemoryArena &arena, 
                     int depth) const;
+        Spectrum LiAOV(const RayDifferential &ray, const Scene &scene,
+                       Sampler &sampler, int channels, AOVSample *aov) const;
+        bool DefersShadowRays() const { return deferShadowRays; }
+        Spectrum LiDeferred(const RayDifferential &ray, const Scene &scene,
+                            Sampler &sampler, ShadowRayBatch *shadowRays,
+                            int sample) const;
+        // Worth it in scenes with many materials, where it keeps the hits
+        // that share a material together
+        bool ShadesFirstHitsByMaterial() const {
+            return shadeFirstHitsByMaterial;
+        }
+        Spectrum LiShaded(const RayDifferential &ray, SurfaceInteraction *isect,
+                          const Scene &scene, Sampler &sampler) const;
+
+        // The path tracing loop. The AOV channels it records are a template
+        // policy, so the instantiation used by _Li()_ has no AOV code. With
+        // _shadowRays_ the shadow rays of the light samples are queued for
+        // camera sample _sample_ instead of being traced. With
+        // _trainCache_ the path records the light arriving at its diffuse
+        // vertices into the radiance cache rather than terminating into it.
+        // With _firstHit_ the camera ray's intersection, already shaded, is
+        // taken from there.
+        template <int Channels>
+        Spectrum TracePath(const RayDifferential &ray, const Scene &scene,
+                           Sampler &sampler, AOVSample *aov,
+                           ShadowRayBatch *shadowRays = nullptr,
+                           int sample = 0, bool trainCache = false,
+                           SurfaceInteraction *firstHit = nullptr) const;
 
     private:
+        // Fills the radiance cache from paths traced through every pixel
+        void TrainRadianceCache(const Scene &scene, Sampler &sampler);
+
         const int maxDepth;
         const float rrThreshold;
         const std::string lightSampleStrategy;
+        const bool deferShadowRays;
+        const RadianceCacheOptions cacheOptions;
+        const bool shadeFirstHitsByMaterial;
         std::unique_ptr<LightDistribution> lightDistribution;
+        std::unique_ptr<RadianceCache> radianceCache;
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,330 @@
+#include "integrators/restir.h"
+#include "film.h"
+#include "filters/box.h"
+#include "scene.h"
+
+#include "omp.h"
+
+#include <algorithm>
+
+namespace PBRender {
+
+// At most this many neighbors are merged into a pixel's reservoir
+static const int MaxSpatialSamples = 32;
+
+// ReSTIRIntegrator Method Definitions
+ReSTIRIntegrator::ReSTIRIntegrator(int maxDepth,
+                                   std::shared_ptr<const Camera> camera,
+                                   std::shared_ptr<Sampler> sampler,
+                                   const Bounds2i &pixelBounds,
+                                   int nCandidates, int spatialSamples,
+                                   int spatialRadius,
+                                   const std::string &lightSampleStrategy)
+    : camera(camera),
+      sampler(sampler),
+      pixelBounds(pixelBounds),
+      maxDepth(maxDepth),
+      nCandidates(std::max(1, nCandidates)),
+      spatialSamples(Clamp(spatialSamples, 0, MaxSpatialSamples)),
+      spatialRadius(std::max(1, spatialRadius)),
+      lightSampleStrategy(lightSampleStrategy) {}
+
+void ReSTIRIntegrator::Preprocess(const Scene &scene) {
+    lightDistribution =
+        CreateLightSampleDistribution(lightSampleStrategy, scene);
+    scene.WorldBound().BoundingSphere(&worldCenter, &worldRadius);
+}
+
+void ReSTIRIntegrator::Render(const Scene &scene, std::vector<Spectrum> &col) {
+    int rasterX = pixelBounds.pMax.x - pixelBounds.pMin.x;
+    int rasterY = pixelBounds.pMax.y - pixelBounds.pMin.y;
+    std::unique_ptr<Filter> filter(CreateBoxFilter());
+    Film film(Point2i(rasterX, rasterY), std::move(filter));
+
+    Render(scene, film);
+    film.GetImage(col);
+}
+
+void ReSTIRIntegrator::Render(const Scene &scene, Film &film) {
+    Preprocess(scene);
+    if (scene.lights.empty()) return;
+
+    // Compute number of tiles to use for parallel rendering
+    Bounds2i sampleBounds = Intersect(film.GetSampleBounds(), pixelBounds);
+    Vector2i sampleExtent = sampleBounds.Diagonal();
+    const int tileSize = 16;
+    Point2i nTiles((sampleExtent.x + tileSize - 1) / tileSize,
+                   (sampleExtent.y + tileSize - 1) / tileSize);
+    int nTotalTiles = nTiles.x * nTiles.y;
+    int64_t spp = sampler->samplesPerPixel;
+    float diffScale = 1 / std::sqrt((float)spp);
+
+    #pragma omp parallel for schedule(dynamic)
+    for (int tile = 0; tile < nTotalTiles; ++tile) {
+        int tileX = tile % nTiles.x, tileY = tile / nTiles.x;
+        std::unique_ptr<Sampler> tileSampler = sampler->Clone(tile);
+        // Candidates come from a per-tile stream so that results do not
+        // depend on the thread schedule
+        RNG rng(tile);
+
+        // Compute sample bounds for tile
+        int x0 = sampleBounds.pMin.x + tileX * tileSize;
+        int x1 = std::min(x0 + tileSize, sampleBounds.pMax.x);
+        int y0 = sampleBounds.pMin.y + tileY * tileSize;
+        int y1 = std::min(y0 + tileSize, sampleBounds.pMax.y);
+        Bounds2i tileBounds(Point2i(x0, y0), Point2i(x1, y1));
+        std::unique_ptr<FilmTile> filmTile = film.GetFilmTile(tileBounds);
+
+        int nPixels = tileBounds.Area();
+        std::vector<ShadingPoint> points(nPixels);
+        std::vector<WeightedReservoirSampler<RISLightSample>> reused(
+            spatialSamples > 0 ? nPixels : 0);
+        std::vector<float> reusedW(reused.size());
+
+        // All pixels of the tile advance one sample index at a time, so the
+        // reservoirs of neighbors are available for spatial reuse
+        for (int64_t sampleIndex = 0; sampleIndex < spp; ++sampleIndex) {
+            int i = 0;
+            for (Point2i pixel : tileBounds) {
+                tileSampler->StartPixel(pixel);
+                tileSampler->SetSampleNumber(sampleIndex);
+                GenerateShadingPoint(scene, *tileSampler, pixel, diffScale,
+                                     &points[i]);
+                if (points[i].shade) GenerateCandidates(scene, rng, &points[i]);
+                ++i;
+            }
+
+            if (spatialSamples > 0) {
+                for (i = 0; i < nPixels; ++i)
+                    if (points[i].shade)
+                        SpatialReuse(scene, rng, tileBounds, points, i,
+                                     &reused[i], &reusedW[i]);
+                for (i = 0; i < nPixels; ++i)
+                    if (points[i].shade) {
+                        points[i].reservoir = reused[i];
+                        points[i].W = reusedW[i];
+                    }
+            }
+
+            // Trace a single shadow ray for each pixel's selected sample
+            for (i = 0; i < nPixels; ++i) {
+                const ShadingPoint &sp = points[i];
+                Spectrum L = sp.L;
+                if (sp.shade && sp.W > 0) {
+                    VisibilityTester vis;
+                    Spectrum f = Evaluate(scene, sp.reservoir.GetSample(),
+                                          sp.isect, &vis);
+                    if (!f.IsBlack() && vis.Unoccluded(scene))
+                        L += sp.beta * f * sp.W;
+                }
+                filmTile->AddSample(sp.cameraSample.pFilm, L, sp.rayWeight);
+            }
+        }
+
+        film.MergeFilmTile(std::move(filmTile));
+    }
+
+    std::cout << "Rendering is finished!" << std::endl;
+}
+
+void ReSTIRIntegrator::GenerateShadingPoint(const Scene &scene,
+                                            Sampler &sampler,
+                                            const Point2i &pixel,
+                                            float diffScale,
+                                            ShadingPoint *sp) const {
+    sp->cameraSample = sampler.GetCameraSample(pixel);
+    RayDifferential ray;
+    sp->rayWeight = camera->GenerateRayDifferential(sp->cameraSample, &ray);
+    ray.ScaleDifferentials(diffScale);
+    sp->L = Spectrum(0.f);
+    sp->beta = Spectrum(1.f);
+    sp->shade = false;
+    sp->depth = 0;
+    sp->reservoir.Reset();
+    sp->W = 0;
+    if (sp->rayWeight == 0) return;
+
+    SurfaceInteraction &isect = sp->isect;
+    for (int bounces = 0;;) {
+        if (!scene.Intersect(ray, &isect)) {
+            for (const auto &light : scene.lights)
+                sp->L += sp->beta * light->Le(ray);
+            return;
+        }
+        sp->depth += Distance(ray.o, isect.p);
+
+        // Compute scattering functions and skip over medium boundaries
+        isect.ComputeScatteringFunctions(ray, true);
+        if (!isect.bsdf) {
+            ray = isect.SpawnRay(ray.d);
+            continue;
+        }
+        sp->L += sp->beta * isect.Le(isect.wo);
+
+        // Surfaces with a non-specular component are shaded here
+        if (isect.bsdf->NumComponents(BxDFType(BSDF_ALL & ~BSDF_SPECULAR)) > 0) {
+            sp->shade = true;
+            return;
+        }
+
+        // Follow one lobe of a perfectly specular surface
+        if (++bounces >= maxDepth) return;
+        Vector3f wi;
+        float pdf;
+        BxDFType flags;
+        Spectrum f = isect.bsdf->Sample_f(isect.wo, &wi, sampler.Get2D(), &pdf,
+                                          BSDF_ALL, &flags);
+        if (f.IsBlack() || pdf == 0) return;
+        sp->beta *= f * AbsDot(wi, isect.shading.n) / pdf;
+        ray = isect.SpawnRay(wi);
+    }
+}
+
+void ReSTIRIntegrator::GenerateCandidates(const Scene &scene, RNG &rng,
+                                          ShadingPoint *sp) const {
+    const SurfaceInteraction &isect = sp->isect;
+    WeightedReservoirSampler<RISLightSample> &reservoir = sp->reservoir;
+    float selectedTarget = 0;
+    for (int i = 0; i < nCandidates; ++i) {
+        float pmf;
+        int lightIndex =
+            lightDistribution->Sample(isect, rng.UniformFloat(), &pmf);
+        Point2f uLight(rng.UniformFloat(), rng.UniformFloat());
+        float u = rng.UniformFloat();
+        if (lightIndex < 0 || pmf == 0) {
+            reservoir.Add(RISLightSample(), 0, u);
+            continue;
+        }
+
+        const Light &light = *scene.lights[lightIndex];
+        Vector3f wi;
+        float pdf;
+        VisibilityTester vis;
+        Spectrum Li = light.Sample_Li(isect, uLight, &wi, &pdf, &vis);
+        if (pdf == 0 || Li.IsBlack()) {
+            reservoir.Add(RISLightSample(), 0, u);
+            continue;
+        }
+
+        // Express the candidate and its density in the light's measure
+        RISLightSample ls;
+        ls.lightIndex = lightIndex;
+        float sourcePdf = pmf;
+        if (light.flags & (int)LightFlags::Area) {
+            ls.p = vis.P1().p;
+            ls.n = vis.P1().n;
+            sourcePdf *= pdf * AbsDot(ls.n, wi) / DistanceSquared(isect.p, ls.p);
+        } else if (!IsDeltaLight(light.flags)) {
+            ls.w = wi;
+            sourcePdf *= pdf;
+        }
+
+        float target = TargetPdf(Evaluate(scene, ls, isect));
+        float weight = sourcePdf > 0 ? target / sourcePdf : 0;
+        if (reservoir.Add(ls, weight, u)) selectedTarget = target;
+    }
+
+    sp->W = reservoir.HasSample()
+                ? reservoir.WeightSum() / (reservoir.Count() * selectedTarget)
+                : 0;
+}
+
+void ReSTIRIntegrator::SpatialReuse(
+    const Scene &scene, RNG &rng, const Bounds2i &tileBounds,
+    const std::vector<ShadingPoint> &points, int index,
+    WeightedReservoirSampler<RISLightSample> *reservoir, float *W) const {
+    const ShadingPoint &sp = points[index];
+    int width = tileBounds.pMax.x - tileBounds.pMin.x;
+    int height = tileBounds.pMax.y - tileBounds.pMin.y;
+    int x = index % width, y = index / width;
+
+    // Each merged reservoir contributes its sample weighted by the target
+    // at this pixel over the sample's density there
+    int merged[MaxSpatialSamples + 1];
+    int nMerged = 0;
+    float selectedTarget = 0;
+    reservoir->Reset();
+    auto merge = [&](int j) {
+        const ShadingPoint &q = points[j];
+        float target = 0, weight = 0;
+        if (q.reservoir.HasSample()) {
+            target = TargetPdf(Evaluate(scene, q.reservoir.GetSample(), sp.isect));
+            weight = target * q.W * q.reservoir.Count();
+        }
+        if (reservoir->Merge(q.reservoir.GetSample(), weight,
+                             q.reservoir.Count(), rng.UniformFloat()))
+            selectedTarget = target;
+        merged[nMerged++] = j;
+    };
+
+    merge(index);
+    for (int k = 0; k < spatialSamples; ++k) {
+        Point2f d = ConcentricSampleDisk(
+            Point2f(rng.UniformFloat(), rng.UniformFloat()));
+        int nx = x + (int)std::round(d.x * spatialRadius);
+        int ny = y + (int)std::round(d.y * spatialRadius);
+        if (nx < 0 || nx >= width || ny < 0 || ny >= height) continue;
+        int j = ny * width + nx;
+        if (std::find(merged, merged + nMerged, j) != merged + nMerged)
+            continue;
+
+        // Only reuse from surfaces with similar normals and depths
+        const ShadingPoint &q = points[j];
+        if (!q.shade || Dot(q.isect.shading.n, sp.isect.shading.n) < 0.906f ||
+            std::abs(q.depth - sp.depth) > 0.1f * sp.depth)
+            continue;
+        merge(j);
+    }
+
+    *W = 0;
+    if (!reservoir->HasSample()) return;
+
+    // Normalize by the candidates of the merged pixels that could have
+    // produced the selected sample, which keeps the estimate unbiased
+    const RISLightSample &ls = reservoir->GetSample();
+    int64_t Z = 0;
+    for (int i = 0; i < nMerged; ++i) {
+        const ShadingPoint &q = points[merged[i]];
+        if (TargetPdf(Evaluate(scene, ls, q.isect)) > 0)
+            Z += q.reservoir.Count();
+    }
+    if (Z > 0) *W = reservoir->WeightSum() / (Z * selectedTarget);
+}
+
+Spectrum ReSTIRIntegrator::Evaluate(const Scene &scene,
+                                    const RISLightSample &ls,
+                                    const SurfaceInteraction &isect,
+                                    VisibilityTester *vis) const {
+    const Light &light = *scene.lights[ls.lightIndex];
+    Vector3f wi;
+    Spectrum Li;
+    VisibilityTester lightVis;
+    if (light.flags & (int)LightFlags::Area) {
+        // Radiance from the sampled point, with the change from solid angle
+        // to area measure
+        Vector3f d = ls.p - isect.p;
+        float dist2 = d.LengthSquared();
+        if (dist2 == 0) return Spectrum(0.f);
+        wi = d / std::sqrt(dist2);
+        Interaction pLight(ls.p, ls.n, Vector3f(), -wi, isect.time);
+        Li = static_cast<const AreaLight &>(light).L(pLight, -wi) *
+             AbsDot(ls.n, wi) / dist2;
+        lightVis = VisibilityTester(isect, pLight);
+    } else if (IsDeltaLight(light.flags)) {
+        // Delta lights are sampled the same way from every point
+        float pdf;
+        Li = light.Sample_Li(isect, Point2f(0.5f, 0.5f), &wi, &pdf, &lightVis);
+    } else {
+        wi = ls.w;
+        Li = light.Le(RayDifferential(isect.p, wi));
+        lightVis = VisibilityTester(
+            isect, Interaction(isect.p + wi * (2 * worldRadius), isect.time));
+    }
+    if (Li.IsBlack()) return Spectrum(0.f);
+
+    Spectrum f = isect.bsdf->f(isect.wo, wi) * AbsDot(wi, isect.shading.n);
+    if (vis) *vis = lightVis;
+    return f * Li;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "PBRender.h"
+#include "integrator.h"
+#include "interaction.h"
+#include "camera.h"
+#include "lightdistrib.h"
+#include "sampling.h"
+
+namespace PBRender {
+
+// RISLightSample Declarations
+// A light sample that can be evaluated again from another shading point.
+// Area lights keep the sampled point, so their samples live in area
+// measure; infinite lights keep the direction (solid angle measure), and a
+// delta light is fully described by its index.
+struct RISLightSample {
+    int lightIndex = -1;
+    Point3f p;
+    Normal3f n;
+    Vector3f w;
+};
+
+// ReSTIRIntegrator Declarations
+// Direct lighting through resampled importance sampling. For each shading
+// point, _nCandidates_ light samples are drawn from the light distribution
+// and their unshadowed contributions are streamed through a weighted
+// reservoir, so a single shadow ray is traced for the one that survives.
+// With _spatialSamples_ > 0 the reservoirs of similar pixels within
+// _spatialRadius_ in the same tile are merged before shading, using the
+// unbiased 1/Z normalization. Perfectly specular surfaces are followed up
+// to _maxDepth_ bounces before the first shading point.
+class ReSTIRIntegrator : public Integrator {
+    public:
+        ReSTIRIntegrator(int maxDepth, std::shared_ptr<const Camera> camera,
+                         std::shared_ptr<Sampler> sampler,
+                         const Bounds2i &pixelBounds, int nCandidates = 32,
+                         int spatialSamples = 0, int spatialRadius = 8,
+                         const std::string &lightSampleStrategy = "power");
+
+        void Preprocess(const Scene &scene);
+        void Render(const Scene &scene, std::vector<Spectrum> &col);
+        void Render(const Scene &scene, Film &film);
+
+    private:
+        // ReSTIRIntegrator Private Declarations
+        struct ShadingPoint {
+            CameraSample cameraSample;
+            float rayWeight = 0;
+            // Radiance not due to direct lighting and the throughput of the
+            // specular chain that led to _isect_
+            Spectrum L = Spectrum(0.f), beta = Spectrum(1.f);
+            SurfaceInteraction isect;
+            bool shade = false;
+            float depth = 0;
+            WeightedReservoirSampler<RISLightSample> reservoir;
+            // Unbiased contribution weight of the reservoir's sample
+            float W = 0;
+        };
+
+        // ReSTIRIntegrator Private Methods
+        void GenerateShadingPoint(const Scene &scene, Sampler &sampler,
+                                  const Point2i &pixel, float diffScale,
+                                  ShadingPoint *sp) const;
+        void GenerateCandidates(const Scene &scene, RNG &rng,
+                                ShadingPoint *sp) const;
+        void SpatialReuse(const Scene &scene, RNG &rng,
+                          const Bounds2i &tileBounds,
+                          const std::vector<ShadingPoint> &points,
+                          int index,
+                          WeightedReservoirSampler<RISLightSample> *reservoir,
+                          float *W) const;
+        // Unshadowed contribution of _ls_ at _isect_ in the sample's measure
+        Spectrum Evaluate(const Scene &scene, const RISLightSample &ls,
+                          const SurfaceInteraction &isect,
+                          VisibilityTester *vis = nullptr) const;
+        static float TargetPdf(const Spectrum &f) {
+            return std::max(0.f, f.y());
+        }
+
+        // ReSTIRIntegrator Private Data
+        std::shared_ptr<const Camera> camera;
+        std::shared_ptr<Sampler> sampler;
+        const Bounds2i pixelBounds;
+        const int maxDepth;
+        const int nCandidates, spatialSamples, spatialRadius;
+        const std::string lightSampleStrategy;
+        std::unique_ptr<LightDistribution> lightDistribution;
+        Point3f worldCenter;
+        float worldRadius = 0;
+};
+
+}
\ No newline at end of file
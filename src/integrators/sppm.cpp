@@ -0,0 +1,400 @@
+#include "integrators/sppm.h"
+#include "interaction.h"
+#include "lowdiscrepancy.h"
+#include "parallel.h"
+#include "reflection.h"
+#include "samplers/halton.h"
+#include "sampling.h"
+#include "scene.h"
+
+#include "omp.h"
+
+#include <atomic>
+#include <deque>
+
+namespace PBRender {
+
+// SPPM Local Definitions
+struct SPPMPixel {
+    // SPPMPixel Public Methods
+    SPPMPixel() : M(0) {}
+
+    // SPPMPixel Public Data
+    float radius = 0;
+    Spectrum Ld = Spectrum(0.f);
+    struct VisiblePoint {
+        Point3f p;
+        Vector3f wo;
+        std::shared_ptr<BSDF> bsdf;
+        Spectrum beta = Spectrum(0.f);
+    } vp;
+    AtomicFloat Phi[Spectrum::nSamples];
+    std::atomic<int> M;
+    float N = 0;
+    Spectrum tau = Spectrum(0.f);
+};
+
+// Entry of a hash grid bucket. A pixel is inserted once per grid cell its
+// search radius overlaps; the cell is kept so that cells sharing a bucket
+// don't deliver the same photon to a pixel twice.
+struct SPPMPixelListNode {
+    SPPMPixel *pixel;
+    uint64_t cell;
+    SPPMPixelListNode *next;
+};
+
+static bool ToGrid(const Point3f &p, const Bounds3f &bounds,
+                   const int gridRes[3], Point3i *pi) {
+    bool inBounds = true;
+    Vector3f pg = bounds.Offset(p);
+    for (int i = 0; i < 3; ++i) {
+        (*pi)[i] = (int)(gridRes[i] * pg[i]);
+        inBounds &= ((*pi)[i] >= 0 && (*pi)[i] < gridRes[i]);
+        (*pi)[i] = Clamp((*pi)[i], 0, gridRes[i] - 1);
+    }
+    return inBounds;
+}
+
+static inline uint64_t CellIndex(const Point3i &p, const int gridRes[3]) {
+    return (uint64_t)p.x +
+           (uint64_t)gridRes[0] * ((uint64_t)p.y + (uint64_t)gridRes[1] * p.z);
+}
+
+static inline unsigned int Hash(const Point3i &p, int hashSize) {
+    return (unsigned int)((p.x * 73856093) ^ (p.y * 19349663) ^
+                          (p.z * 83492791)) %
+           hashSize;
+}
+
+// SPPM Method Definitions
+void SPPMIntegrator::Render(const Scene &scene, std::vector<Spectrum> &col) {
+    // Initialize _pixelBounds_ and _pixels_ array for SPPM
+    int nPixels = pixelBounds.Area();
+    int width = pixelBounds.pMax.x - pixelBounds.pMin.x;
+    std::unique_ptr<SPPMPixel[]> pixels(new SPPMPixel[nPixels]);
+    for (int i = 0; i < nPixels; ++i) pixels[i].radius = initialSearchRadius;
+    const float invSqrtSPP = 1.f / std::sqrt((float)nIterations);
+
+    // Compute _lightDistr_ for sampling lights proportional to power
+    std::unique_ptr<Distribution1D> lightDistr =
+        ComputeLightPowerDistribution(scene);
+    if (!lightDistr) {
+        std::cerr << "SPPMIntegrator: the scene has no lights" << std::endl;
+        return;
+    }
+
+    // Perform _nIterations_ of SPPM integration
+    std::unique_ptr<Sampler> sampler(
+        CreateHaltonSampler(nIterations, pixelBounds));
+
+    // Compute number of tiles to use for SPPM camera pass
+    Vector2i pixelExtent = pixelBounds.Diagonal();
+    const int tileSize = 16;
+    Point2i nTiles((pixelExtent.x + tileSize - 1) / tileSize,
+                   (pixelExtent.y + tileSize - 1) / tileSize);
+    int nTotalTiles = nTiles.x * nTiles.y;
+
+    // Grid entries are allocated from per-thread pools that are recycled
+    // every iteration; deques keep the nodes in place as they grow
+    std::vector<std::deque<SPPMPixelListNode>> nodePools(omp_get_max_threads());
+    int hashSize = nPixels;
+    std::vector<std::atomic<SPPMPixelListNode *>> grid(hashSize);
+
+    for (int iter = 0; iter < nIterations; ++iter) {
+        // Generate SPPM visible points
+        #pragma omp parallel for schedule(dynamic)
+        for (int tile = 0; tile < nTotalTiles; ++tile) {
+            int tileX = tile % nTiles.x, tileY = tile / nTiles.x;
+            // Follow camera paths for _tile_ in image for SPPM
+            std::unique_ptr<Sampler> tileSampler = sampler->Clone(tile);
+
+            // Compute _tileBounds_ for SPPM tile
+            int x0 = pixelBounds.pMin.x + tileX * tileSize;
+            int x1 = std::min(x0 + tileSize, pixelBounds.pMax.x);
+            int y0 = pixelBounds.pMin.y + tileY * tileSize;
+            int y1 = std::min(y0 + tileSize, pixelBounds.pMax.y);
+            Bounds2i tileBounds(Point2i(x0, y0), Point2i(x1, y1));
+            for (Point2i pPixel : tileBounds) {
+                // Prepare _tileSampler_ for _pPixel_
+                tileSampler->StartPixel(pPixel);
+                tileSampler->SetSampleNumber(iter);
+
+                // Generate camera ray for pixel for SPPM
+                CameraSample cameraSample =
+                    tileSampler->GetCameraSample(pPixel);
+                RayDifferential ray;
+                Spectrum beta(
+                    camera->GenerateRayDifferential(cameraSample, &ray));
+                if (beta.IsBlack()) continue;
+                ray.ScaleDifferentials(invSqrtSPP);
+
+                // Follow camera ray path until a visible point is created
+
+                // Get _SPPMPixel_ for _pPixel_
+                Point2i pPixelO = Point2i(pPixel - pixelBounds.pMin);
+                int pixelOffset = pPixelO.x + pPixelO.y * width;
+                SPPMPixel &pixel = pixels[pixelOffset];
+                bool specularBounce = false;
+                for (int depth = 0; depth < maxDepth; ++depth) {
+                    SurfaceInteraction isect;
+                    if (!scene.Intersect(ray, &isect)) {
+                        // Accumulate light contributions for ray with no
+                        // intersection
+                        for (const auto &light : scene.lights)
+                            pixel.Ld += beta * light->Le(ray);
+                        break;
+                    }
+                    // Process SPPM camera ray intersection
+
+                    // Compute BSDF at SPPM camera ray intersection
+                    isect.ComputeScatteringFunctions(ray, true);
+                    if (!isect.bsdf) {
+                        ray = isect.SpawnRay(ray.d);
+                        --depth;
+                        continue;
+                    }
+                    const BSDF &bsdf = *isect.bsdf;
+
+                    // Accumulate direct illumination at SPPM camera ray
+                    // intersection
+                    Vector3f wo = -ray.d;
+                    if (depth == 0 || specularBounce)
+                        pixel.Ld += beta * isect.Le(wo);
+                    pixel.Ld +=
+                        beta * UniformSampleOneLight(isect, scene, *tileSampler);
+
+                    // Possibly create visible point and end camera path
+                    bool isDiffuse = bsdf.NumComponents(BxDFType(
+                                         BSDF_DIFFUSE | BSDF_REFLECTION |
+                                         BSDF_TRANSMISSION)) > 0;
+                    bool isGlossy = bsdf.NumComponents(BxDFType(
+                                        BSDF_GLOSSY | BSDF_REFLECTION |
+                                        BSDF_TRANSMISSION)) > 0;
+                    if (isDiffuse || (isGlossy && depth == maxDepth - 1)) {
+                        pixel.vp.p = isect.p;
+                        pixel.vp.wo = wo;
+                        pixel.vp.bsdf = isect.bsdf;
+                        pixel.vp.beta = beta;
+                        break;
+                    }
+
+                    // Spawn ray from SPPM camera path vertex
+                    if (depth < maxDepth - 1) {
+                        float pdf;
+                        Vector3f wi;
+                        BxDFType type;
+                        Spectrum f = bsdf.Sample_f(wo, &wi, tileSampler->Get2D(),
+                                                   &pdf, BSDF_ALL, &type);
+                        if (pdf == 0. || f.IsBlack()) break;
+                        specularBounce = (type & BSDF_SPECULAR) != 0;
+                        beta *= f * AbsDot(wi, isect.shading.n) / pdf;
+                        if (beta.y() < 0.25) {
+                            float continueProb = std::min(1.f, beta.y());
+                            if (tileSampler->Get1D() > continueProb) break;
+                            beta /= continueProb;
+                        }
+                        ray = (RayDifferential)isect.SpawnRay(wi);
+                    }
+                }
+            }
+        }
+
+        // Create grid of all SPPM visible points
+
+        // Compute grid bounds for SPPM visible points
+        Bounds3f gridBounds;
+        float maxRadius = 0.;
+        for (int i = 0; i < nPixels; ++i) {
+            const SPPMPixel &pixel = pixels[i];
+            if (pixel.vp.beta.IsBlack()) continue;
+            Bounds3f vpBound = Expand(Bounds3f(pixel.vp.p), pixel.radius);
+            gridBounds = Union(gridBounds, vpBound);
+            maxRadius = std::max(maxRadius, pixel.radius);
+        }
+
+        // Compute resolution of SPPM grid in each dimension
+        int gridRes[3];
+        Vector3f diag = gridBounds.Diagonal();
+        float maxDiag = MaxComponent(diag);
+        int baseGridRes = maxRadius > 0 ? (int)(maxDiag / maxRadius) : 1;
+        for (int i = 0; i < 3; ++i)
+            gridRes[i] = std::max((int)(baseGridRes * diag[i] / maxDiag), 1);
+
+        // Add visible points to SPPM grid; buckets are singly linked lists
+        // that every thread pushes to with a compare-and-swap
+        for (std::atomic<SPPMPixelListNode *> &bucket : grid)
+            bucket.store(nullptr, std::memory_order_relaxed);
+        for (std::deque<SPPMPixelListNode> &pool : nodePools) pool.clear();
+        #pragma omp parallel for schedule(dynamic, 4096)
+        for (int pixelIndex = 0; pixelIndex < nPixels; ++pixelIndex) {
+            SPPMPixel &pixel = pixels[pixelIndex];
+            if (pixel.vp.beta.IsBlack()) continue;
+            std::deque<SPPMPixelListNode> &pool =
+                nodePools[omp_get_thread_num()];
+            // Add pixel's visible point to applicable grid cells
+            float radius = pixel.radius;
+            Point3i pMin, pMax;
+            ToGrid(pixel.vp.p - Vector3f(radius, radius, radius), gridBounds,
+                   gridRes, &pMin);
+            ToGrid(pixel.vp.p + Vector3f(radius, radius, radius), gridBounds,
+                   gridRes, &pMax);
+            for (int z = pMin.z; z <= pMax.z; ++z)
+                for (int y = pMin.y; y <= pMax.y; ++y)
+                    for (int x = pMin.x; x <= pMax.x; ++x) {
+                        // Add visible point to grid cell $(x, y, z)$
+                        Point3i cell(x, y, z);
+                        int h = Hash(cell, hashSize);
+                        pool.push_back(SPPMPixelListNode());
+                        SPPMPixelListNode *node = &pool.back();
+                        node->pixel = &pixel;
+                        node->cell = CellIndex(cell, gridRes);
+
+                        // Atomically add _node_ to the start of _grid[h]_'s
+                        // linked list
+                        node->next = grid[h].load(std::memory_order_relaxed);
+                        while (!grid[h].compare_exchange_weak(node->next, node))
+                            ;
+                    }
+        }
+
+        // Trace photons and accumulate contributions
+        #pragma omp parallel for schedule(dynamic, 8192)
+        for (int photonIndex = 0; photonIndex < photonsPerIteration;
+             ++photonIndex) {
+            // Follow photon path for _photonIndex_
+            uint64_t haltonIndex =
+                (uint64_t)iter * (uint64_t)photonsPerIteration + photonIndex;
+            int haltonDim = 0;
+
+            // Choose light to shoot photon from
+            float lightPdf;
+            float lightSample = RadicalInverse(haltonDim++, haltonIndex);
+            int lightNum = lightDistr->SampleDiscrete(lightSample, &lightPdf);
+            const std::shared_ptr<Light> &light = scene.lights[lightNum];
+
+            // Compute sample values for photon ray leaving light source
+            Point2f uLight0(RadicalInverse(haltonDim, haltonIndex),
+                            RadicalInverse(haltonDim + 1, haltonIndex));
+            Point2f uLight1(RadicalInverse(haltonDim + 2, haltonIndex),
+                            RadicalInverse(haltonDim + 3, haltonIndex));
+            haltonDim += 4;
+
+            // Generate _photonRay_ from light source and initialize _beta_
+            RayDifferential photonRay;
+            Normal3f nLight;
+            float pdfPos, pdfDir;
+            Spectrum Le = light->Sample_Le(uLight0, uLight1, 0, &photonRay,
+                                           &nLight, &pdfPos, &pdfDir);
+            if (pdfPos == 0 || pdfDir == 0 || Le.IsBlack()) continue;
+            Spectrum beta = (AbsDot(nLight, photonRay.d) * Le) /
+                            (lightPdf * pdfPos * pdfDir);
+            if (beta.IsBlack()) continue;
+
+            // Follow photon path through scene and record intersections
+            SurfaceInteraction isect;
+            for (int depth = 0; depth < maxDepth; ++depth) {
+                if (!scene.Intersect(photonRay, &isect)) break;
+                if (depth > 0) {
+                    // Add photon contribution to nearby visible points
+                    Point3i photonGridIndex;
+                    if (ToGrid(isect.p, gridBounds, gridRes,
+                               &photonGridIndex)) {
+                        int h = Hash(photonGridIndex, hashSize);
+                        uint64_t cell = CellIndex(photonGridIndex, gridRes);
+                        // Add photon contribution to visible points in
+                        // _grid[h]_
+                        for (SPPMPixelListNode *node =
+                                 grid[h].load(std::memory_order_relaxed);
+                             node != nullptr; node = node->next) {
+                            if (node->cell != cell) continue;
+                            SPPMPixel &pixel = *node->pixel;
+                            float radius = pixel.radius;
+                            if (DistanceSquared(pixel.vp.p, isect.p) >
+                                radius * radius)
+                                continue;
+                            // Update _pixel_ $\Phi$ and $M$ for nearby photon
+                            Vector3f wi = -photonRay.d;
+                            Spectrum Phi =
+                                beta * pixel.vp.bsdf->f(pixel.vp.wo, wi);
+                            for (int i = 0; i < Spectrum::nSamples; ++i)
+                                pixel.Phi[i].Add(Phi[i]);
+                            ++pixel.M;
+                        }
+                    }
+                }
+                // Sample new photon ray direction
+
+                // Compute BSDF at photon intersection point
+                isect.ComputeScatteringFunctions(photonRay, true,
+                                                 TransportMode::Importance);
+                if (!isect.bsdf) {
+                    --depth;
+                    photonRay = isect.SpawnRay(photonRay.d);
+                    continue;
+                }
+                const BSDF &photonBSDF = *isect.bsdf;
+
+                // Sample BSDF _fr_ and direction _wi_ for reflected photon
+                Vector3f wi, wo = -photonRay.d;
+                float pdf;
+                BxDFType flags;
+
+                // Generate _bsdfSample_ for outgoing photon sample
+                Point2f bsdfSample(RadicalInverse(haltonDim, haltonIndex),
+                                   RadicalInverse(haltonDim + 1, haltonIndex));
+                haltonDim += 2;
+                Spectrum fr = photonBSDF.Sample_f(wo, &wi, bsdfSample, &pdf,
+                                                  BSDF_ALL, &flags);
+                if (fr.IsBlack() || pdf == 0.f) break;
+                Spectrum bnew =
+                    beta * fr * AbsDot(wi, isect.shading.n) / pdf;
+
+                // Possibly terminate photon path with Russian roulette
+                float q = std::max(0.f, 1 - bnew.y() / beta.y());
+                if (RadicalInverse(haltonDim++, haltonIndex) < q) break;
+                beta = bnew / (1 - q);
+                photonRay = (RayDifferential)isect.SpawnRay(wi);
+            }
+        }
+
+        // Update pixel values from this pass's photons
+        #pragma omp parallel for schedule(dynamic, 4096)
+        for (int i = 0; i < nPixels; ++i) {
+            SPPMPixel &p = pixels[i];
+            if (p.M > 0) {
+                // Update pixel photon count, search radius, and $\tau$ from
+                // photons
+                float gamma = (float)2 / (float)3;
+                float Nnew = p.N + gamma * p.M;
+                float Rnew = p.radius * std::sqrt(Nnew / (p.N + p.M));
+                Spectrum Phi;
+                for (int j = 0; j < Spectrum::nSamples; ++j) Phi[j] = p.Phi[j];
+                p.tau = (p.tau + p.vp.beta * Phi) * (Rnew * Rnew) /
+                        (p.radius * p.radius);
+                p.N = Nnew;
+                p.radius = Rnew;
+                p.M = 0;
+                for (int j = 0; j < Spectrum::nSamples; ++j) p.Phi[j] = 0.f;
+            }
+            // Reset _VisiblePoint_ in pixel
+            p.vp.beta = Spectrum(0.f);
+            p.vp.bsdf = nullptr;
+        }
+
+        if ((iter + 1) % 16 == 0 || iter + 1 == nIterations)
+            std::cout << "SPPM iteration " << iter + 1 << "/" << nIterations
+                      << std::endl;
+    }
+
+    // Compute the radiance estimate of every pixel
+    uint64_t Np = (uint64_t)nIterations * (uint64_t)photonsPerIteration;
+    for (int i = 0; i < nPixels; ++i) {
+        const SPPMPixel &pixel = pixels[i];
+        Spectrum L = pixel.Ld / nIterations;
+        L += pixel.tau / (Np * Pi * pixel.radius * pixel.radius);
+        col[i] = L;
+    }
+    std::cout << "Rendering is finished!" << std::endl;
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "PBRender.h"
+#include "integrator.h"
+#include "camera.h"
+
+namespace PBRender {
+
+// SPPM Declarations
+// Stochastic progressive photon mapping. Each iteration traces one camera
+// sample per pixel up to the first non-specular surface, inserts these
+// visible points into a spatial hash grid that is built in parallel with
+// lock-free list insertion, and traces _photonsPerIteration_ photons from
+// the lights whose flux is accumulated atomically into the visible points
+// they land near. The search radius of every pixel shrinks as photons
+// arrive, so the estimate converges, including on specular-diffuse-specular
+// paths that the path tracers cannot sample.
+class SPPMIntegrator : public Integrator {
+    public:
+        // SPPMIntegrator Public Methods
+        SPPMIntegrator(std::shared_ptr<const Camera> camera, int nIterations,
+                       int photonsPerIteration, int maxDepth,
+                       float initialSearchRadius, const Bounds2i &pixelBounds)
+            : camera(camera),
+              initialSearchRadius(initialSearchRadius),
+              nIterations(nIterations),
+              maxDepth(maxDepth),
+              photonsPerIteration(photonsPerIteration > 0
+                                      ? photonsPerIteration
+                                      : pixelBounds.Area()),
+              pixelBounds(pixelBounds) {}
+
+        void Render(const Scene &scene, std::vector<Spectrum> &col);
+
+    private:
+        // SPPMIntegrator Private Data
+        std::shared_ptr<const Camera> camera;
+        const float initialSearchRadius;
+        const int nIterations;
+        const int maxDepth;
+        const int photonsPerIteration;
+        const Bounds2i pixelBounds;
+};
+
+}
\ No newline at end of file
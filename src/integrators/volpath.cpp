@@ -0,0 +1,109 @@
+#include "integrators/volpath.h"
+#include "camera.h"
+#include "interaction.h"
+#include "medium.h"
+#include "scene.h"
+
+namespace PBRender {
+
+// VolPathIntegrator Method Definitions
+void VolPathIntegrator::Preprocess(const Scene &scene, Sampler &) {
+    lightDistribution =
+        CreateLightSampleDistribution(lightSampleStrategy, scene);
+}
+
+Spectrum VolPathIntegrator::Li(const RayDifferential &r, const Scene &scene,
+                               Sampler &sampler, int) const {
+    Spectrum L(0.f), beta(1.f);
+    RayDifferential ray(r);
+    bool specularBounce = false;
+    int bounces;
+    float etaScale = 1;
+
+    for (bounces = 0;; ++bounces) {
+        // Intersect _ray_ with scene and store intersection in _isect_
+        SurfaceInteraction isect;
+        bool foundIntersection = scene.Intersect(ray, &isect);
+
+        // Sample the participating medium, if present
+        MediumInteraction mi;
+        if (ray.medium) beta *= ray.medium->Sample(ray, sampler, &mi);
+        if (beta.IsBlack()) break;
+
+        // Handle an interaction with a medium or a surface
+        if (mi.IsValid()) {
+            // Terminate path if _maxDepth_ was reached
+            if (bounces >= maxDepth) break;
+
+            // Sample the lights and the phase function at the point in the
+            // medium
+            L += beta * UniformSampleOneLight(mi, scene, sampler,
+                                              *lightDistribution, true);
+            Vector3f wo = -ray.d, wi;
+            mi.phase->Sample_p(wo, &wi, sampler.Get2D());
+            ray = mi.SpawnRay(wi);
+            specularBounce = false;
+        } else {
+            // Possibly add emitted light at intersection
+            if (bounces == 0 || specularBounce) {
+                // Add emitted light at path vertex or from the environment
+                if (foundIntersection)
+                    L += beta * isect.Le(-ray.d);
+                else
+                    for (const auto &light : scene.infiniteLights)
+                        L += beta * light->Le(ray);
+            }
+
+            // Terminate path if ray escaped or _maxDepth_ was reached
+            if (!foundIntersection || bounces >= maxDepth) break;
+
+            // Compute scattering functions and skip over medium boundaries
+            isect.ComputeScatteringFunctions(ray, true);
+            if (!isect.bsdf) {
+                ray = isect.SpawnRay(ray.d);
+                bounces--;
+                continue;
+            }
+
+            // Sample illumination from lights to find attenuated path
+            // contribution
+            if (isect.bsdf->NumComponents(BxDFType(BSDF_ALL & ~BSDF_SPECULAR)) >
+                0)
+                L += beta * UniformSampleOneLight(isect, scene, sampler,
+                                                  *lightDistribution, true);
+
+            // Sample BSDF to get new path direction
+            Vector3f wo = -ray.d, wi;
+            float pdf;
+            BxDFType flags;
+            Spectrum f = isect.bsdf->Sample_f(wo, &wi, sampler.Get2D(), &pdf,
+                                              BSDF_ALL, &flags);
+            if (f.IsBlack() || pdf == 0.f) break;
+            beta *= f * AbsDot(wi, isect.shading.n) / pdf;
+            assert(!std::isinf(beta.y()));
+            specularBounce = (flags & BSDF_SPECULAR) != 0;
+            if ((flags & BSDF_SPECULAR) && (flags & BSDF_TRANSMISSION)) {
+                float eta = isect.bsdf->eta;
+                // Update the term that tracks radiance scaling for refraction
+                // depending on whether the ray is entering or leaving the
+                // medium.
+                etaScale *=
+                    (Dot(wo, isect.n) > 0) ? (eta * eta) : 1 / (eta * eta);
+            }
+            ray = isect.SpawnRay(wi);
+        }
+
+        // Possibly terminate the path with Russian roulette.
+        // Factor out radiance scaling due to refraction in rrBeta.
+        Spectrum rrBeta = beta * etaScale;
+        if (rrBeta.MaxComponentValue() < rrThreshold && bounces > 3) {
+            float q = std::max((float).05, 1 - rrBeta.MaxComponentValue());
+            if (sampler.Get1D() < q) break;
+            beta /= 1 - q;
+            assert(!std::isinf(beta.y()));
+        }
+    }
+    return L;
+}
+
+}
\ No newline at end of file
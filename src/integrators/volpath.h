@@ -0,0 +1,37 @@
+#pragma once
+
+#include "PBRender.h"
+#include "integrator.h"
+#include "lightdistrib.h"
+
+namespace PBRender {
+
+// VolPathIntegrator Declarations
+// Path tracing through participating media. Each path samples a scattering
+// event in the medium its ray travels through before considering the
+// surface it hits, and the light samples at both kinds of vertices account
+// for the transmittance to the light. Surfaces without a material only mark
+// the boundaries of media and are passed through.
+class VolPathIntegrator : public SamplerIntegrator {
+    public:
+        VolPathIntegrator(int maxDepth, std::shared_ptr<const Camera> camera,
+                          std::shared_ptr<Sampler> sampler,
+                          const Bounds2i &pixelBounds, float rrThreshold = 1,
+                          const std::string &lightSampleStrategy = "spatial")
+            : SamplerIntegrator(camera, sampler, pixelBounds),
+              maxDepth(maxDepth),
+              rrThreshold(rrThreshold),
+              lightSampleStrategy(lightSampleStrategy) {}
+
+        void Preprocess(const Scene &scene, Sampler &sampler);
+        Spectrum Li(const RayDifferential &ray, const Scene &scene,
+                    Sampler &sampler, int depth) const;
+
+    private:
+        const int maxDepth;
+        const float rrThreshold;
+        const std::string lightSampleStrategy;
+        std::unique_ptr<LightDistribution> lightDistribution;
+};
+
+}
\ No newline at end of file
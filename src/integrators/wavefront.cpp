@@ -0,0 +1,287 @@
+#include "integrators/wavefront.h"
+#include "camera.h"
+#include "interaction.h"
+#include "material.h"
+#include "scene.h"
+
+#include "omp.h"
+
+#include <algorithm>
+
+namespace PBRender {
+
+// Wavefront Local Declarations
+enum PathStatus : uint8_t { Active, Terminated, PassThrough };
+
+// Keep the paths of _queue_ whose status is not _Terminated_
+static void CompactQueue(const std::vector<uint8_t> &status,
+                         const std::vector<int> &queue,
+                         std::vector<int> *result) {
+    result->clear();
+    for (int i : queue)
+        if (status[i] != Terminated) result->push_back(i);
+}
+
+// PathStateQueue Method Definitions
+void PathStateQueue::Resize(int n) {
+    ray.resize(n);
+    isect.resize(n);
+    beta.resize(n);
+    L.resize(n);
+    etaScale.resize(n);
+    pixelIndex.resize(n);
+    bounces.resize(n);
+    specularBounce.resize(n);
+    status.resize(n);
+    samplers.resize(n);
+}
+
+void ShadowRayQueue::Resize(int n) {
+    ray.resize(n);
+    Ld.resize(n);
+    pathIndex.resize(n);
+    size = 0;
+}
+
+// WavefrontPathIntegrator Method Definitions
+WavefrontPathIntegrator::WavefrontPathIntegrator(
+    int maxDepth, std::shared_ptr<const Camera> camera,
+    std::shared_ptr<Sampler> sampler, const Bounds2i &pixelBounds,
+    float rrThreshold, const std::string &lightSampleStrategy,
+    int maxPathsInFlight)
+    : camera(camera),
+      sampler(sampler),
+      pixelBounds(pixelBounds),
+      maxDepth(maxDepth),
+      rrThreshold(rrThreshold),
+      lightSampleStrategy(lightSampleStrategy),
+      maxPathsInFlight(maxPathsInFlight) {}
+
+void WavefrontPathIntegrator::Preprocess(const Scene &scene) {
+    lightDistribution =
+        CreateLightSampleDistribution(lightSampleStrategy, scene);
+}
+
+void WavefrontPathIntegrator::Render(const Scene &scene,
+                                     std::vector<Spectrum> &col) {
+    Preprocess(scene);
+
+    int rasterX = pixelBounds.pMax.x - pixelBounds.pMin.x;
+    int rasterY = pixelBounds.pMax.y - pixelBounds.pMin.y;
+    int nPixels = rasterX * rasterY;
+    int64_t spp = sampler->samplesPerPixel;
+
+    // Allocate path state for one wave of camera samples
+    int waveSize = std::min(maxPathsInFlight, nPixels);
+    paths.Resize(waveSize);
+    shadowRays.Resize(waveSize);
+    for (int i = 0; i < waveSize; ++i) paths.samplers[i] = sampler->Clone(i);
+    active.reserve(waveSize);
+    next.reserve(waveSize);
+
+    std::fill(col.begin(), col.end(), Spectrum(0.f));
+
+    for (int64_t sampleIndex = 0; sampleIndex < spp; ++sampleIndex) {
+        for (int firstPixel = 0; firstPixel < nPixels; firstPixel += waveSize) {
+            // Advance one wave of paths until all of them have terminated
+            GenerateCameraRays(firstPixel, sampleIndex);
+            while (!active.empty()) {
+                Intersect(scene);
+                ComputeScatteringFunctions();
+                Shade(scene);
+                TraceShadowRays(scene);
+                RussianRoulette();
+            }
+
+            // Add the wave's radiance estimates to the image
+            int nPaths = std::min(waveSize, nPixels - firstPixel);
+            #pragma omp parallel for
+            for (int i = 0; i < nPaths; ++i)
+                col[paths.pixelIndex[i]] += paths.L[i];
+        }
+    }
+
+    #pragma omp parallel for
+    for (int i = 0; i < nPixels; ++i) col[i] /= (float)spp;
+
+    std::cout << "Rendering is finished!" << std::endl;
+}
+
+void WavefrontPathIntegrator::GenerateCameraRays(int firstPixel,
+                                                 int64_t sampleIndex) {
+    int rasterX = pixelBounds.pMax.x - pixelBounds.pMin.x;
+    int rasterY = pixelBounds.pMax.y - pixelBounds.pMin.y;
+    int nPaths = std::min(paths.Size(), rasterX * rasterY - firstPixel);
+    float diffScale = 1 / std::sqrt((float)sampler->samplesPerPixel);
+
+    #pragma omp parallel for schedule(dynamic, 256)
+    for (int i = 0; i < nPaths; ++i) {
+        int offset = firstPixel + i;
+        Point2i pixel(pixelBounds.pMin.x + offset % rasterX,
+                      pixelBounds.pMin.y + offset / rasterX);
+
+        // Position the path's sampler at _sampleIndex_ of _pixel_
+        Sampler &pathSampler = *paths.samplers[i];
+        pathSampler.StartPixel(pixel);
+        pathSampler.SetSampleNumber(sampleIndex);
+
+        CameraSample cameraSample = pathSampler.GetCameraSample(pixel);
+        float rayWeight =
+            camera->GenerateRayDifferential(cameraSample, &paths.ray[i]);
+        paths.ray[i].ScaleDifferentials(diffScale);
+
+        paths.pixelIndex[i] = offset;
+        paths.beta[i] = Spectrum(1.f);
+        paths.L[i] = Spectrum(0.f);
+        paths.etaScale[i] = 1;
+        paths.bounces[i] = 0;
+        paths.specularBounce[i] = false;
+        paths.status[i] = rayWeight > 0 ? Active : Terminated;
+    }
+
+    std::vector<int> all(nPaths);
+    for (int i = 0; i < nPaths; ++i) all[i] = i;
+    CompactQueue(paths.status, all, &active);
+}
+
+void WavefrontPathIntegrator::Intersect(const Scene &scene) {
+    int nActive = (int)active.size();
+
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (int k = 0; k < nActive; ++k) {
+        int i = active[k];
+        SurfaceInteraction &isect = paths.isect[i];
+        isect = SurfaceInteraction();
+        bool foundIntersection = scene.Intersect(paths.ray[i], &isect);
+
+        // Possibly add emitted light at intersection
+        if (paths.bounces[i] == 0 || paths.specularBounce[i]) {
+            if (foundIntersection)
+                paths.L[i] += paths.beta[i] * isect.Le(-paths.ray[i].d);
+            else
+                for (const auto &light : scene.infiniteLights)
+                    paths.L[i] += paths.beta[i] * light->Le(paths.ray[i]);
+        }
+
+        // Terminate path if ray escaped or _maxDepth_ was reached
+        if (!foundIntersection || paths.bounces[i] >= maxDepth) {
+            paths.status[i] = Terminated;
+            continue;
+        }
+        isect.ComputeDifferentials(paths.ray[i]);
+    }
+
+    CompactQueue(paths.status, active, &next);
+    std::swap(active, next);
+}
+
+void WavefrontPathIntegrator::ComputeScatteringFunctions() {
+    // Shade hits in per-material batches and keep them grouped by material,
+    // so the _Shade()_ kernel also walks runs of equal BSDFs
+    int nActive = (int)active.size();
+    std::vector<SurfaceInteraction *> hits(nActive);
+    for (int k = 0; k < nActive; ++k) hits[k] = &paths.isect[active[k]];
+    std::vector<int> order;
+    ComputeScatteringFunctionsByMaterial(hits.data(), nActive,
+                                         TransportMode::Radiance, true, &order);
+    next.resize(nActive);
+    for (int k = 0; k < nActive; ++k) next[k] = active[order[k]];
+    std::swap(active, next);
+}
+
+void WavefrontPathIntegrator::Shade(const Scene &scene) {
+    int nActive = (int)active.size();
+    shadowRays.Clear();
+
+    // Contiguous chunks keep each thread inside a run of equal materials
+    #pragma omp parallel for schedule(static)
+    for (int k = 0; k < nActive; ++k) {
+        int i = active[k];
+        SurfaceInteraction &isect = paths.isect[i];
+        RayDifferential &ray = paths.ray[i];
+        Sampler &pathSampler = *paths.samplers[i];
+
+        // Skip over medium boundaries
+        if (!isect.bsdf) {
+            ray = isect.SpawnRay(ray.d);
+            paths.status[i] = PassThrough;
+            continue;
+        }
+
+        // Sample illumination from lights, deferring the shadow ray
+        if (isect.bsdf->NumComponents(BxDFType(BSDF_ALL & ~BSDF_SPECULAR)) > 0) {
+            DeferredShadowRay shadow;
+            paths.L[i] += paths.beta[i] *
+                          UniformSampleOneLight(isect, scene, pathSampler,
+                                                *lightDistribution, false,
+                                                &shadow);
+            if (!shadow.Ld.IsBlack())
+                shadowRays.Push(shadow.ray, paths.beta[i] * shadow.Ld, i);
+        }
+
+        // Sample BSDF to get new path direction
+        Vector3f wo = -ray.d, wi;
+        float pdf;
+        BxDFType flags;
+        Spectrum f = isect.bsdf->Sample_f(wo, &wi, pathSampler.Get2D(), &pdf,
+                                          BSDF_ALL, &flags);
+        if (f.IsBlack() || pdf == 0.f) {
+            paths.status[i] = Terminated;
+            continue;
+        }
+        paths.beta[i] *= f * AbsDot(wi, isect.shading.n) / pdf;
+
+        paths.specularBounce[i] = (flags & BSDF_SPECULAR) != 0;
+        if ((flags & BSDF_SPECULAR) && (flags & BSDF_TRANSMISSION)) {
+            float eta = isect.bsdf->eta;
+            paths.etaScale[i] *=
+                (Dot(wo, isect.n) > 0) ? (eta * eta) : 1 / (eta * eta);
+        }
+        ray = isect.SpawnRay(wi);
+        paths.status[i] = Active;
+    }
+}
+
+void WavefrontPathIntegrator::TraceShadowRays(const Scene &scene) {
+    int nShadowRays = shadowRays.size;
+
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (int k = 0; k < nShadowRays; ++k) {
+        // Each path queues at most one shadow ray per bounce
+        if (!scene.IntersectP(shadowRays.ray[k]))
+            paths.L[shadowRays.pathIndex[k]] += shadowRays.Ld[k];
+    }
+}
+
+void WavefrontPathIntegrator::RussianRoulette() {
+    int nActive = (int)active.size();
+
+    #pragma omp parallel for schedule(static)
+    for (int k = 0; k < nActive; ++k) {
+        int i = active[k];
+        if (paths.status[i] == Terminated) continue;
+        if (paths.status[i] == PassThrough) {
+            paths.status[i] = Active;
+            continue;
+        }
+
+        // Possibly terminate the path with Russian roulette
+        Spectrum rrBeta = paths.beta[i] * paths.etaScale[i];
+        if (rrBeta.MaxComponentValue() < rrThreshold && paths.bounces[i] > 3) {
+            float q = std::max((float).05, 1 - rrBeta.MaxComponentValue());
+            if (paths.samplers[i]->Get1D() < q) {
+                paths.status[i] = Terminated;
+                continue;
+            }
+            paths.beta[i] /= 1 - q;
+        }
+        ++paths.bounces[i];
+    }
+
+    // Sorted order is irrelevant from here on; restore index order
+    CompactQueue(paths.status, active, &next);
+    std::sort(next.begin(), next.end());
+    std::swap(active, next);
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "PBRender.h"
+#include "integrator.h"
+#include "interaction.h"
+#include "lightdistrib.h"
+
+namespace PBRender {
+
+// PathStateQueue Declarations
+// Structure-of-arrays storage for all paths in flight. Each kernel of the
+// wavefront integrator only touches the arrays it needs, so a stage streams
+// through memory instead of dragging whole path records through the cache.
+struct PathStateQueue {
+    void Resize(int n);
+    int Size() const { return (int)pixelIndex.size(); }
+
+    // PathStateQueue Public Data
+    std::vector<RayDifferential> ray;
+    std::vector<SurfaceInteraction> isect;
+    std::vector<Spectrum> beta, L;
+    std::vector<float> etaScale;
+    std::vector<int> pixelIndex, bounces;
+    std::vector<uint8_t> specularBounce, status;
+    std::vector<std::unique_ptr<Sampler>> samplers;
+};
+
+// ShadowRayQueue Declarations
+struct ShadowRayQueue {
+    void Resize(int n);
+    void Clear() { size = 0; }
+    int Push(const Ray &r, const Spectrum &Ld, int pathIndex) {
+        int slot = size++;
+        ray[slot] = r;
+        this->Ld[slot] = Ld;
+        this->pathIndex[slot] = pathIndex;
+        return slot;
+    }
+
+    // ShadowRayQueue Public Data
+    std::vector<Ray> ray;
+    std::vector<Spectrum> Ld;
+    std::vector<int> pathIndex;
+    std::atomic<int> size{0};
+};
+
+// WavefrontPathIntegrator Declarations
+// Computes the same estimator as _PathIntegrator_, but instead of following
+// one path at a time it advances a large batch of paths through a sequence
+// of kernels (camera rays, intersection, per-material BSDF construction,
+// shading, shadow rays, Russian roulette), each of which runs in parallel
+// over its queue.
+class WavefrontPathIntegrator : public Integrator {
+    public:
+        WavefrontPathIntegrator(int maxDepth,
+                                std::shared_ptr<const Camera> camera,
+                                std::shared_ptr<Sampler> sampler,
+                                const Bounds2i &pixelBounds,
+                                float rrThreshold = 1,
+                                const std::string &lightSampleStrategy = "uniform",
+                                int maxPathsInFlight = 1 << 18);
+
+        void Preprocess(const Scene &scene);
+        void Render(const Scene &scene, std::vector<Spectrum> &col);
+
+    private:
+        // WavefrontPathIntegrator Kernels
+        void GenerateCameraRays(int firstPixel, int64_t sampleIndex);
+        void Intersect(const Scene &scene);
+        void ComputeScatteringFunctions();
+        void Shade(const Scene &scene);
+        void TraceShadowRays(const Scene &scene);
+        void RussianRoulette();
+
+        // WavefrontPathIntegrator Private Data
+        std::shared_ptr<const Camera> camera;
+        std::shared_ptr<Sampler> sampler;
+        const Bounds2i pixelBounds;
+        const int maxDepth;
+        const float rrThreshold;
+        const std::string lightSampleStrategy;
+        const int maxPathsInFlight;
+        std::unique_ptr<LightDistribution> lightDistribution;
+
+        PathStateQueue paths;
+        ShadowRayQueue shadowRays;
+        std::vector<int> active, next;
+};
+
+}
\ No newline at end of file
@@ -10,45 +10,54 @@ Spectrum WhittedIntegrator::Li(const RayDifferential &ray, const Scene &scene,
                                Sampler &sampler, int depth) const {
     Spectrum L(0.);
 
-    // Find closest ray intersection or return background radiance
+    // Trace the tree of specular paths below _ray_ depth first, following
+    // one branch in _path_ and keeping the others on _stack_
+    SpecularStack stack;
+    SpecularPath path = {ray, Spectrum(1.f), depth};
     SurfaceInteraction isect;
-    if (!scene.Intersect(ray, &isect)) {
-        for (const auto &light : scene.lights) L += light->Le(ray);
+    while (true) {
+        // Find closest ray intersection or add background radiance
+        if (!scene.Intersect(path.ray, &isect)) {
+            for (const auto &light : scene.lights)
+                L += path.beta * light->Le(path.ray);
+        } else {
+            // Compute scattering functions for surface interaction
+            isect.ComputeScatteringFunctions(path.ray);
+            if (!isect.bsdf) {
+                path.ray = isect.SpawnRay(path.ray.d);
+                continue;
+            }
 
-        return L;
-    }
+            // Compute emitted and reflected light at ray intersection point
 
-    // Compute emitted and reflected light at ray intersection point
-
-    // Initialize common variables for Whitted integrator
-    const Normal3f &n = isect.shading.n;
-    Vector3f wo = isect.wo;
-
-    // Compute scattering functions for surface interaction
-    isect.ComputeScatteringFunctions(ray);
-    if (!isect.bsdf)
-        return Li(isect.SpawnRay(ray.d), scene, sampler, depth);
-    
-    // Compute emitted light if ray hit an area light source
-    L += isect.Le(wo);
-
-    // Add contribution of each light source
-    for (const auto &light : scene.lights) {
-        Vector3f wi;
-        float pdf;
-        VisibilityTester visibility;
-        Spectrum Li =
-            light->Sample_Li(isect, sampler.Get2D(), &wi, &pdf, &visibility);
-        if (Li.IsBlack() || pdf == 0) continue;
-        Spectrum f = isect.bsdf->f(wo, wi);
-        if (!f.IsBlack() && visibility.Unoccluded(scene))
-            L += f * Li * AbsDot(wi, n) / pdf;
-    }
+            // Initialize common variables for Whitted integrator
+            const Normal3f &n = isect.shading.n;
+            Vector3f wo = isect.wo;
+
+            // Compute emitted light if ray hit an area light source
+            L += path.beta * isect.Le(wo);
+
+            // Add contribution of each light source
+            for (const auto &light : scene.lights) {
+                Vector3f wi;
+                float pdf;
+                VisibilityTester visibility;
+                Spectrum Li = light->Sample_Li(isect, sampler.Get2D(), &wi,
+                                               &pdf, &visibility);
+                if (Li.IsBlack() || pdf == 0) continue;
+                Spectrum f = isect.bsdf->f(wo, wi);
+                if (!f.IsBlack() && visibility.Unoccluded(scene))
+                    L += path.beta * f * Li * AbsDot(wi, n) / pdf;
+            }
+
+            // Follow specular reflection and refraction
+            if (path.depth + 1 < maxDepth &&
+                FollowSpecular(&path, isect, sampler, &stack))
+                continue;
+        }
 
-    if (depth + 1 < maxDepth) {
-        // Trace rays for specular reflection and refraction
-        L += SpecularReflect(ray, isect, scene, sampler, depth);
-        L += SpecularTransmit(ray, isect, scene, sampler, depth);
+        if (stack.Empty()) break;
+        path = stack.Pop();
     }
 
     return L;
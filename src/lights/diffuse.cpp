@@ -29,6 +29,14 @@ Spectrum DiffuseAreaLight::Power() const {
     return (twoSided ? 2 : 1) * Lemit * area * Pi;
 }
 
+bool DiffuseAreaLight::Bounds(LightBounds *bounds) const {
+    // Emission covers the hemisphere around each surface normal
+    DirectionCone nb = shape->NormalBounds();
+    *bounds = LightBounds(shape->WorldBound(), nb.w, Power().MaxComponentValue(),
+                          nb.cosTheta, 0, twoSided);
+    return true;
+}
+
 Spectrum DiffuseAreaLight::Sample_Li(const Interaction &ref, const Point2f &u,
                                      Vector3f *wi, float *pdf,
                                      VisibilityTester *vis) const {
@@ -50,6 +58,11 @@ float DiffuseAreaLight::Pdf_Li(const Interaction &ref,
     return shape->Pdf(ref, wi);
 }
 
+float DiffuseAreaLight::Pdf_Li(const Interaction &ref, const Vector3f &wi,
+                               const Interaction &pLight) const {
+    return shape->Pdf(ref, wi, pLight);
+}
+
 Spectrum DiffuseAreaLight::Sample_Le(const Point2f &u1, const Point2f &u2,
                                      float time, Ray *ray, Normal3f *nLight,
                                      float *pdfPos, float *pdfDir) const {
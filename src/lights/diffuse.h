@@ -20,9 +20,12 @@ class DiffuseAreaLight : public AreaLight {
         }
         
         Spectrum Power() const;
+        bool Bounds(LightBounds *bounds) const;
         Spectrum Sample_Li(const Interaction &ref, const Point2f &u, Vector3f *wo,
                            float *pdf, VisibilityTester *vis) const;
         float Pdf_Li(const Interaction &, const Vector3f &) const;
+        float Pdf_Li(const Interaction &ref, const Vector3f &wi,
+                     const Interaction &pLight) const;
         Spectrum Sample_Le(const Point2f &u1, const Point2f &u2, float time,
                            Ray *ray, Normal3f *nLight, float *pdfPos,
                            float *pdfDir) const;
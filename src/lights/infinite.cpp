@@ -3,78 +3,193 @@
 
 #include "ext/stbim/stb_image.h"
 
-namespace PBRender {
+#include "omp.h"
 
-void get_sphere_uv(const Vector3f &p, float &u, float &v) {
-    float phi = atan2(p.z, p.x);
-    if (phi < 0.f) phi += 2 * Pi;
+namespace PBRender {
 
-    float theta = Pi - acos(p.y);
+// Environment Light Local Definitions
+// Widest environment map whose sampling distribution is tabulated at twice
+// its resolution
+static const int MaxDoubledDistributionWidth = 1024;
+
+// Tabulates the luminance of _Lmap_, weighted by $\sin\theta$ for the
+// latitude-longitude mapping's compression of solid angle, for importance
+// sampling. Small maps are tabulated at twice their resolution, so that the
+// piecewise-constant density follows the bilinear lookups around small
+// bright features such as the sun; larger maps are tabulated at the finest
+// level's resolution, which keeps the table of an 8K map at a quarter of
+// the size and its construction at half the time.
+static std::unique_ptr<Distribution2D> ComputeEnvironmentDistribution(
+    const MIPMap<RGBSpectrum> &Lmap) {
+    int scale = Lmap.Width() <= MaxDoubledDistributionWidth ? 2 : 1;
+    int width = scale * Lmap.Width(), height = scale * Lmap.Height();
+    std::unique_ptr<float[]> img(new float[width * height]);
+    float fwidth = 0.5f / std::min(width, height);
+    #pragma omp parallel for schedule(dynamic, 32)
+    for (int v = 0; v < height; ++v) {
+        float vp = (v + .5f) / (float)height;
+        float sinTheta = std::sin(Pi * vp);
+        for (int u = 0; u < width; ++u) {
+            float up = (u + .5f) / (float)width;
+            img[u + v * width] =
+                Lmap.Lookup(Point2f(up, vp), fwidth).y() * sinTheta;
+        }
+    }
+    return std::unique_ptr<Distribution2D>(
+        new Distribution2D(img.get(), width, height, true));
+}
 
-    u = phi * Inv2Pi;
-    v = theta * InvPi;
+// SkyBoxLight Local Definitions
+// Image coordinates of light-space direction _w_: longitude from +x towards
+// +z, and v from the -y pole (v = 0) to the +y pole (v = 1)
+static Point2f SkyBoxUV(const Vector3f &w) {
+    float phi = std::atan2(w.z, w.x);
+    if (phi < 0.f) phi += 2 * Pi;
+    float theta = Pi - SafeACos(w.y);
+    return Point2f(phi * Inv2Pi, theta * InvPi);
 }
 
-Spectrum SkyBoxLight::Le(const Ray &r) const {
+// Inverse of _SkyBoxUV()_; also returns the sine of the polar angle, which
+// relates densities over the image to densities over solid angle
+static Vector3f SkyBoxDirection(const Point2f &uv, float *sinTheta) {
+    float theta = uv[1] * Pi, phi = uv[0] * 2 * Pi;
+    *sinTheta = std::sin(theta);
+    return Vector3f(*sinTheta * std::cos(phi), -std::cos(theta),
+                    *sinTheta * std::sin(phi));
+}
 
-    Vector3f oc = r.o - worldCenter;
+// Images are scaled down by this factor when they are loaded
+static const float SkyBoxImageScale = 1.f / 5.f;
+
+// SkyBoxLight Method Definitions
+SkyBoxLight::SkyBoxLight(const Transform &LightToWorld,
+                         const Point3f &worldCenter, float worldRadius,
+                         int nSamples)
+    : Light((int)LightFlags::Infinite, LightToWorld, nSamples),
+      worldCenter(worldCenter),
+      worldRadius(worldRadius) {
+    // Tabulate the default gradient sky, which maps directions to colors
+    const int width = 64, height = 32;
+    std::unique_ptr<RGBSpectrum[]> texels(new RGBSpectrum[width * height]);
+    for (int v = 0; v < height; ++v)
+        for (int u = 0; u < width; ++u) {
+            float sinTheta;
+            Vector3f w = SkyBoxDirection(
+                Point2f((u + .5f) / width, (v + .5f) / height), &sinTheta);
+            RGBSpectrum &c = texels[u + v * width];
+            for (int i = 0; i < 3; ++i) c[i] = (w[i] + 1) / 2;
+        }
+    Initialize(Point2i(width, height), texels.get());
+}
 
-    float a = Dot(r.d, r.d);
-    float b = 2.0 * Dot(oc, r.d);
-    float c = Dot(oc, oc) - worldRadius * worldRadius;
-    float discriminant = b*b - 4*a*c;
-    float t;
+void SkyBoxLight::Initialize(const Point2i &resolution,
+                             const RGBSpectrum *texels) {
+    Lmap.reset(new MIPMap<RGBSpectrum>(resolution, texels));
 
-    if (discriminant < 0) return 0.f;
+    distribution = ComputeEnvironmentDistribution(*Lmap);
+}
 
-    t = (-b + sqrt(discriminant)) / (2.0 * a);
-    Point3f hitPos = r.o + t * r.d;
-    Vector3f hitPos_temp = hitPos - worldCenter;
+bool SkyBoxLight::loadImage(char *imageFile) {
+    stbi_set_flip_vertically_on_load(true);
 
-    if (data) {
-        float u, v;
-        get_sphere_uv(hitPos_temp, u, v);
-        return getLightValue(u, v);
+    int width, height, nrComponents;
+    float *data = stbi_loadf(imageFile, &width, &height, &nrComponents, 0);
+    if (!data) return false;
+
+    // Convert the interleaved stb channels to RGB texels; grayscale images
+    // are replicated across the channels and alpha is dropped
+    std::unique_ptr<RGBSpectrum[]> texels(new RGBSpectrum[width * height]);
+    #pragma omp parallel for
+    for (int i = 0; i < width * height; ++i) {
+        const float *t = &data[i * nrComponents];
+        for (int c = 0; c < 3; ++c)
+            texels[i][c] = t[nrComponents >= 3 ? c : 0] * SkyBoxImageScale;
     }
+    stbi_image_free(data);
 
-    Spectrum Col;
-
-    Col[0] = (hitPos_temp.x + worldRadius) / (2.f * worldRadius);
-    Col[1] = (hitPos_temp.y + worldRadius) / (2.f * worldRadius);
-    Col[2] = (hitPos_temp.z + worldRadius) / (2.f * worldRadius);
-
-    return Col;
+    Initialize(Point2i(width, height), texels.get());
+    std::cout << "Successfully load file: " << imageFile << "!" << std::endl;
+    return true;
 }
 
-bool SkyBoxLight::loadImage(char *imageFile) {
-    stbi_set_flip_vertically_on_load(true);
-
-    data = stbi_loadf(imageFile, &imageWidth, &imageHeight, &nrComponents, 0);
+Spectrum SkyBoxLight::Power() const {
+    return Pi * worldRadius * worldRadius *
+           Spectrum(Lmap->Lookup(Point2f(.5f, .5f), .5f));
+}
 
-    if (data) {
-        std::cout << "Successfully load file: " << imageFile << "!" << std::endl;
-        return true;
-    }
-    return false;
+Spectrum SkyBoxLight::Le(const RayDifferential &r) const {
+    Point2f st = SkyBoxUV(Normalize(WorldToLight(r.d)));
+    if (!r.hasDifferentials) return Spectrum(Lmap->Lookup(st));
+
+    // Filter over the footprint of the differential rays, taking the
+    // shorter way around the seam in longitude
+    Point2f stx = SkyBoxUV(Normalize(WorldToLight(r.rxDirection)));
+    Point2f sty = SkyBoxUV(Normalize(WorldToLight(r.ryDirection)));
+    auto extent = [](const Point2f &a, const Point2f &b) {
+        float du = std::abs(a[0] - b[0]);
+        return std::max(std::min(du, 1 - du), std::abs(a[1] - b[1]));
+    };
+    float width = std::max(extent(st, stx), extent(st, sty));
+    return Spectrum(Lmap->Lookup(st, width));
 }
 
 Spectrum SkyBoxLight::Sample_Li(const Interaction &ref, const Point2f &u,
                                 Vector3f *wi, float *pdf,
                                 VisibilityTester *vis) const {
-    float theta = u.y * Pi;
-    float phi = u.x * 2 * Pi;
+    // Find $(u,v)$ sample coordinates in the sky image
+    float mapPdf;
+    Point2f uv = distribution->SampleContinuous(u, &mapPdf);
+    if (mapPdf == 0) return Spectrum(0.f);
 
-    float cosTheta = std::cos(theta);
-    float sinTheta = std::sin(theta);
+    // Convert the sample to a direction and its solid angle density
+    float sinTheta;
+    *wi = LightToWorld(SkyBoxDirection(uv, &sinTheta));
+    if (sinTheta == 0) return Spectrum(0.f);
+    *pdf = mapPdf / (2 * Pi * Pi * sinTheta);
 
-    float sinPhi = std::sin(phi);
-    float cosPhi = std::cos(phi);
+    *vis = VisibilityTester(ref, Interaction(ref.p + *wi * (2 * worldRadius),
+                                             ref.time));
+    return Spectrum(Lmap->Lookup(uv));
+}
 
-    *wi = LightToWorld(Vector3f(sinTheta * cosPhi, sinTheta * sinPhi, cosTheta));
-    *pdf = 1.f / (4 * Pi);
-    *vis = VisibilityTester(ref, Interaction(ref.p + *wi * (2 * worldRadius), ref.time));
+float SkyBoxLight::Pdf_Li(const Interaction &, const Vector3f &w) const {
+    Vector3f wi = Normalize(WorldToLight(w));
+    Point2f uv = SkyBoxUV(wi);
+    float sinTheta = std::sin(uv[1] * Pi);
+    if (sinTheta == 0) return 0;
+    return distribution->Pdf(uv) / (2 * Pi * Pi * sinTheta);
+}
+
+Spectrum SkyBoxLight::Sample_Le(const Point2f &u1, const Point2f &u2,
+                                float time, Ray *ray, Normal3f *nLight,
+                                float *pdfPos, float *pdfDir) const {
+    // Sample the direction towards the sky, as in _Sample_Li()_
+    float mapPdf;
+    Point2f uv = distribution->SampleContinuous(u1, &mapPdf);
+    if (mapPdf == 0) return Spectrum(0.f);
+    float sinTheta;
+    Vector3f d = -LightToWorld(SkyBoxDirection(uv, &sinTheta));
+    *nLight = (Normal3f)d;
 
-    return getLightValue(u.x, u.y);
+    // Start the ray on a disk facing _d_ outside the scene bounds
+    Vector3f v1, v2;
+    CoordinateSystem(-d, &v1, &v2);
+    Point2f cd = ConcentricSampleDisk(u2);
+    Point3f pDisk = worldCenter + worldRadius * (cd.x * v1 + cd.y * v2);
+    *ray = Ray(pDisk + worldRadius * -d, d, Infinity, time);
+
+    *pdfDir = sinTheta == 0 ? 0 : mapPdf / (2 * Pi * Pi * sinTheta);
+    *pdfPos = 1 / (Pi * worldRadius * worldRadius);
+    return Spectrum(Lmap->Lookup(uv));
+}
+
+void SkyBoxLight::Pdf_Le(const Ray &ray, const Normal3f &, float *pdfPos,
+                         float *pdfDir) const {
+    Point2f uv = SkyBoxUV(Normalize(-WorldToLight(ray.d)));
+    float sinTheta = std::sin(uv[1] * Pi);
+    *pdfDir = sinTheta == 0 ? 0 : distribution->Pdf(uv) /
+                                      (2 * Pi * Pi * sinTheta);
+    *pdfPos = 1 / (Pi * worldRadius * worldRadius);
 }
 
 // InfiniteAreaLight Method Definitions
@@ -87,41 +202,26 @@ InfiniteAreaLight::InfiniteAreaLight(const Transform &LightToWorld,
     // Read texel data from _texmap_ and initialize _Lmap_
     Point2i resolution;
     std::unique_ptr<RGBSpectrum[]> texels(nullptr);
-
-    float *data;
-    RGBSpectrum *data_s;
-
     if (texmap != "") {
-        // texels = ReadImage(texmap, &resolution);
-
-        // read with stb
-        int imageWidth, imageHeight, nrComponents;
-        data = stbi_loadf(texmap.c_str(), &imageWidth, &imageHeight, &nrComponents, 0);
-        data_s = new RGBSpectrum[imageWidth * imageHeight];
-
-        for (int i = 0; i < imageWidth; ++i)
-        {
-            for (int j = 0; j < imageHeight; ++j)
-            {
-                RGBSpectrum r;
-
-                r[0] = L[0] * data[(i + j * imageWidth) * nrComponents + 0];
-                r[1] = L[1] * data[(i + j * imageWidth) * nrComponents + 1];
-                r[2] = L[2] * data[(i + j * imageWidth) * nrComponents + 2];
-
-                data_s[i + j * imageWidth] = r;
+        int nrComponents;
+        float *data = stbi_loadf(texmap.c_str(), &resolution.x, &resolution.y,
+                                 &nrComponents, 0);
+        if (data) {
+            // Convert the stb channels to scaled texels in a single pass and
+            // release the stb buffer before the pyramid is built
+            int nTexels = resolution.x * resolution.y;
+            RGBSpectrum scale = L.ToRGBSpectrum();
+            texels.reset(new RGBSpectrum[nTexels]);
+            #pragma omp parallel for schedule(static)
+            for (int i = 0; i < nTexels; ++i) {
+                const float *t = &data[i * nrComponents];
+                for (int c = 0; c < 3; ++c)
+                    texels[i][c] = scale[c] * t[nrComponents >= 3 ? c : 0];
             }
-        }
-
-        resolution.x = imageWidth;
-        resolution.y = imageHeight;
-        
-        std::unique_ptr<RGBSpectrum[]> texels(data_s);
-        free(data_s);
-
-        if (texels)
-            for (int i = 0; i < resolution.x * resolution.y; ++i)
-                texels[i] *= L.ToRGBSpectrum();
+            stbi_image_free(data);
+        } else
+            std::cerr << "Unable to read environment map \"" << texmap
+                      << "\"" << std::endl;
     }
     if (!texels) {
         resolution.x = resolution.y = 1;
@@ -129,40 +229,10 @@ InfiniteAreaLight::InfiniteAreaLight(const Transform &LightToWorld,
         texels[0] = L.ToRGBSpectrum();
     }
     Lmap.reset(new MIPMap<RGBSpectrum>(resolution, texels.get()));
+    texels.reset();
 
     // Initialize sampling PDFs for infinite area light
-
-    // Compute scalar-valued image _img_ from environment map
-    int width = 2 * Lmap->Width(), height = 2 * Lmap->Height();
-    std::unique_ptr<float[]> img(new float[width * height]);
-    float fwidth = 0.5f / std::min(width, height);
-    // ParallelFor(
-    //     [&](int64_t v) {
-    //         float vp = (v + .5f) / (float)height;
-    //         float sinTheta = std::sin(Pi * (v + .5f) / height);
-    //         for (int u = 0; u < width; ++u) {
-    //             float up = (u + .5f) / (float)width;
-    //             img[u + v * width] = Lmap->Lookup(Point2f(up, vp), fwidth).y();
-    //             img[u + v * width] *= sinTheta;
-    //         }
-    //     },
-    //     height, 32);
-
-    for (int v = 0; v < height; ++v)
-    {
-        float vp = (v + .5f) / (float)height;
-        float sinTheta = std::sin(Pi * (v + .5f) / height);
-
-        for (int u = 0; u < width; ++u) {
-            float up = (u + .5f) / (float)width;
-            img[u + v * width] = Lmap->Lookup(Point2f(up, vp), fwidth).y();
-            img[u + v * width] *= sinTheta;
-        }
-    }
-    
-
-    // Compute sampling distributions for rows and columns of image
-    distribution.reset(new Distribution2D(img.get(), width, height));
+    distribution = ComputeEnvironmentDistribution(*Lmap);
 }
 
 Spectrum InfiniteAreaLight::Power() const {
@@ -171,7 +241,7 @@ Spectrum InfiniteAreaLight::Power() const {
                     SpectrumType::Illuminant);
 }
 
-Spectrum InfiniteAreaLight::Le(const Ray &ray) const {
+Spectrum InfiniteAreaLight::Le(const RayDifferential &ray) const {
     Vector3f w = Normalize(WorldToLight(ray.d));
     Point2f st(SphericalPhi(w) * Inv2Pi, SphericalTheta(w) * InvPi);
     return Spectrum(Lmap->Lookup(st), SpectrumType::Illuminant);
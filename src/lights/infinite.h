@@ -9,61 +9,52 @@
 
 namespace PBRender {
 
+// SkyBoxLight Declarations
+// Environment light for latitude-longitude HDR images with a y-up
+// convention (the image's bottom row is the direction -y). Radiance is kept
+// in a _MIPMap_, whose blocked pyramid levels give filtered lookups for
+// camera rays, and directions are importance sampled from a piecewise-
+// constant distribution over the image. Without an image the sky is a
+// gradient over directions.
 class SkyBoxLight : public Light {
     public:
         SkyBoxLight(const Transform &LightToWorld, const Point3f &worldCenter,
-                    float worldRadius, int nSamples)
-                    : Light((int)LightFlags::Infinite, LightToWorld, nSamples),
-                      worldCenter(worldCenter),
-                      worldRadius(worldRadius) {
-            imageHeight = 0;
-            imageWidth  = 0;
-            nrComponents= 0;
-            data = nullptr;
-        }
-        
-        ~SkyBoxLight() {
-            if (data) free(data);
-        }
+                    float worldRadius, int nSamples);
 
         void Preprocess(const Scene &scene) {}
-        Spectrum Power() const { return Spectrum(0.f); }
+        Spectrum Power() const;
 
-        Spectrum Le(const Ray &r) const;
+        Spectrum Le(const RayDifferential &r) const;
         
         Spectrum Sample_Li(const Interaction &ref, const Point2f &u,
                            Vector3f *wi, float *pdf,
                            VisibilityTester *vis) const;
-        float Pdf_Li(const Interaction &ref, const Vector3f &wi) const { return 0.0f; }
+        float Pdf_Li(const Interaction &ref, const Vector3f &wi) const;
 
         Spectrum Sample_Le(const Point2f &u1, const Point2f &u2, float time,
                            Ray *ray, Normal3f *nLight, float *pdfPos,
-                           float *pdfDir) const { return Spectrum(0.f); }
+                           float *pdfDir) const;
         
         void Pdf_Le(const Ray &ray, const Normal3f &nLight, float *pdfPos,
-                    float *pdfDir) const {}
+                    float *pdfDir) const;
         
         bool loadImage(char* imageFile);
 
+        // Bilinearly filtered radiance at image coordinates (u, v)
         Spectrum getLightValue(float u, float v) const {
-            int w = u * imageWidth;
-            int h = v * imageHeight;
-            int offset = (w + h*imageWidth) * nrComponents;
-
-            Spectrum Lv;
-            Lv[0] = data[offset + 0] / 5.f;
-            Lv[1] = data[offset + 1] / 5.f;
-            Lv[2] = data[offset + 2] / 5.f;
-
-            return Lv;
+            return Lmap->Lookup(Point2f(u, v));
         }
     
     private:
+        // SkyBoxLight Private Methods
+        void Initialize(const Point2i &resolution, const RGBSpectrum *texels);
+
+        // SkyBoxLight Private Data
         Point3f worldCenter;
         float worldRadius;
 
-        int imageWidth, imageHeight, nrComponents;
-        float *data;
+        std::unique_ptr<MIPMap<RGBSpectrum>> Lmap;
+        std::unique_ptr<Distribution2D> distribution;
 };
 
 // InfiniteAreaLight Declarations
@@ -79,8 +70,7 @@ class InfiniteAreaLight : public Light {
 
         Spectrum Power() const;
 
-        // Spectrum Le(const RayDifferential &ray) const;
-        Spectrum Le(const Ray &ray) const;
+        Spectrum Le(const RayDifferential &ray) const;
 
         Spectrum Sample_Li(const Interaction &ref, const Point2f &u, Vector3f *wi,
                            float *pdf, VisibilityTester *vis) const;
@@ -18,6 +18,12 @@ Spectrum PointLight::Sample_Li(const Interaction &ref, const Point2f &u,
 
 Spectrum PointLight::Power() const { return 4 * Pi * I; }
 
+bool PointLight::Bounds(LightBounds *bounds) const {
+    *bounds = LightBounds(Bounds3f(pLight, pLight), Vector3f(0, 0, 1),
+                          Power().MaxComponentValue(), -1, 0, false);
+    return true;
+}
+
 float PointLight::Pdf_Li(const Interaction &, const Vector3f &) const {
     return 0;
 }
@@ -20,6 +20,7 @@ class PointLight : public Light {
                            float *pdf, VisibilityTester *vis) const;
         
         Spectrum Power() const;
+        bool Bounds(LightBounds *bounds) const;
 
         float Pdf_Li(const Interaction &, const Vector3f &) const;
 
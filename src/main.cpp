@@ -8,6 +8,11 @@
 #include "cameras/orthographic.h"
 #include "cameras/perspective.h"
 
+#include "film.h"
+#include "filters/box.h"
+#include "filters/gaussian.h"
+#include "filters/mitchell.h"
+
 #include "sampler.h"
 #include "samplers/halton.h"
 
@@ -33,14 +38,31 @@
 #include "lights/diffuse.h"
 #include "lights/infinite.h"
 
+#include "medium.h"
+#include "media/homogeneous.h"
+#include "media/grid.h"
+
 #include "scene.h"
+#include "visibilitycache.h"
 
 #include "integrator.h"
+#include "progressive.h"
 #include "integrators/whitted.h"
 #include "integrators/directlighting.h"
 #include "integrators/path.h"
+#include "integrators/wavefront.h"
+#include "integrators/restir.h"
+#include "integrators/guidedpath.h"
+#include "integrators/bdpt.h"
+#include "integrators/sppm.h"
+#include "integrators/mlt.h"
+#include "integrators/adrrs.h"
+#include "integrators/volpath.h"
+#include "integrators/lighttracer.h"
 
 #include "imageio.h"
+#include "aov.h"
+#include "denoiser.h"
 
 // #define STB_IMAGE_IMPLEMENTATION
 // #include <stb_image.h>
@@ -87,7 +109,8 @@ std::shared_ptr<Material> getSmileFaceDiffuseMaterial() {
     return std::make_shared<MatteMaterial>(Kt, sigmaRed, bumpMap);
 }
 
-void test() {
+void test(const ProgressiveOptions &options, bool denoise, bool writeAOVs,
+          const std::string &lightStrategy) {
 
     // textures
     Spectrum floorColor, modelColor;
@@ -289,6 +312,24 @@ void test() {
         prims.push_back(std::make_shared<GeometricPrimitive>(trisFloor[i+offset], LeftWallMaterial, nullptr));
     
     offset += nTrianglesFloor;
+
+    // Occluder under the light, which leaves the room lit indirectly; this is
+    // where the ADRRS integrator below beats the path tracer at equal time
+    // Point3f P_Occluder[] = {
+    //     Point3f(1.3f, 4.5f, 1.3f), Point3f(1.3f, 4.5f, 3.7f), Point3f(3.7f, 4.5f, 3.7f),
+    //     Point3f(1.3f, 4.5f, 1.3f), Point3f(3.7f, 4.5f, 3.7f), Point3f(3.7f, 4.5f, 1.3f),
+    // };
+
+    // meshFloor = std::make_shared<TriangleMesh>(tri_Object2World2, nTrianglesFloor, vertexIndicesFloor,
+    //                                            nVerticesFloor, P_Occluder, nullptr, nullptr, nullptr, nullptr);
+
+    // for(int i = 0 ; i < nTrianglesFloor; ++i)
+    //     trisFloor.push_back(std::make_shared<Triangle>(&tri_Object2World2, &tri_World2Object2, false, meshFloor, i));
+    
+    // for(int i = 0 ; i < nTrianglesFloor; ++i)
+    //     prims.push_back(std::make_shared<GeometricPrimitive>(trisFloor[i+offset], CeilingMaterial, nullptr));
+    
+    // offset += nTrianglesFloor;
     
     std::cout << "Finish background!" << std::endl;
 
@@ -348,6 +389,10 @@ void test() {
     std::unique_ptr<Scene> worldScene;
     worldScene = std::make_unique<Scene>(CreateBVHAccelerator(prims), lights);
 
+    // precompute which voxels the lights certainly reach or certainly don't,
+    // so that shadow rays are only traced in the penumbra
+    // worldScene->visibilityCache = std::make_shared<VisibilityCache>(*worldScene);
+
     // initialize camera
     Point3f eye(2.5f, 2.5f, 6.0f), look(2.5, 2.5, 0.0f);
     Vector3f up(0.0f, 1.0f, 0.0f);
@@ -377,27 +422,169 @@ void test() {
     auto integrator = std::make_shared<PathIntegrator>(256,
                                                        camera,
                                                        sampler,
-                                                       imageBound);
+                                                       imageBound,
+                                                       1,
+                                                       lightStrategy);
+
+    // auto integrator = std::make_shared<WavefrontPathIntegrator>(256,
+    //                                                             camera,
+    //                                                             sampler,
+    //                                                             imageBound);
+    // integrator->Render(*worldScene, col);
 
-    std::cout << "Start rendering!" << std::endl;
+    // same path tracer, with the shadow rays of each tile traced in batches
+    // grouped by light
+    // auto integrator = std::make_shared<PathIntegrator>(256,
+    //                                                    camera,
+    //                                                    sampler,
+    //                                                    imageBound,
+    //                                                    1,
+    //                                                    lightStrategy,
+    //                                                    true);
+
+    // same path tracer, with paths that terminate into a radiance cache
+    // after one diffuse bounce; lower accuracy trades bias for speed
+    // RadianceCacheOptions cacheOptions;
+    // cacheOptions.diffuseBounces = 1;
+    // cacheOptions.accuracy = 0.5f;
+    // auto integrator = std::make_shared<PathIntegrator>(256,
+    //                                                    camera,
+    //                                                    sampler,
+    //                                                    imageBound,
+    //                                                    1,
+    //                                                    lightStrategy,
+    //                                                    false,
+    //                                                    cacheOptions);
+
+    // same path tracer, with the camera hits of each tile shaded in batches
+    // grouped by material, for scenes with many materials
+    // auto integrator = std::make_shared<PathIntegrator>(256,
+    //                                                    camera,
+    //                                                    sampler,
+    //                                                    imageBound,
+    //                                                    1,
+    //                                                    lightStrategy,
+    //                                                    false,
+    //                                                    RadianceCacheOptions(),
+    //                                                    true);
+
+    // direct lighting only: 32 resampled light candidates per shading point
+    // and reservoirs merged from 4 neighboring pixels in each tile
+    // auto integrator = std::make_shared<ReSTIRIntegrator>(64,
+    //                                                      camera,
+    //                                                      sampler,
+    //                                                      imageBound,
+    //                                                      32, 4, 8,
+    //                                                      lightStrategy);
+    // integrator->Render(*worldScene, col);
+
+    // path tracer that splits and terminates paths by comparing their
+    // expected contribution, learned in a 16 spp training pass, with the
+    // pixel's; use it only when most light arrives indirectly, as with the
+    // occluder above, as it is slower than the path tracer otherwise
+    // auto integrator = std::make_shared<ADRRSPathIntegrator>(256,
+    //                                                         camera,
+    //                                                         sampler,
+    //                                                         imageBound,
+    //                                                         1,
+    //                                                         lightStrategy);
+    // integrator->Render(*worldScene, col);
+
+    // path tracer guided by an SD-tree learned over doubling training passes;
+    // experimental, it does not beat the path tracer at equal time yet
+    // auto integrator = std::make_shared<GuidedPathIntegrator>(64,
+    //                                                          camera,
+    //                                                          sampler,
+    //                                                          imageBound,
+    //                                                          1.f,
+    //                                                          lightStrategy);
     // integrator->Render(*worldScene, col);
 
-    // rendering with openmp for now
-    integrator->Preprocess(*worldScene, *sampler);
+    // bidirectional path tracer; light subpaths seen by the camera are
+    // splatted into the film
+    // auto integrator = std::make_shared<BDPTIntegrator>(sampler,
+    //                                                    camera,
+    //                                                    64,
+    //                                                    imageBound);
+    // integrator->Render(*worldScene, col);
+
+    // stochastic progressive photon mapping for caustics seen through
+    // specular surfaces: 256 iterations of one photon per pixel each
+    // auto integrator = std::make_shared<SPPMIntegrator>(camera,
+    //                                                    256, -1, 64, 0.05f,
+    //                                                    imageBound);
+    // integrator->Render(*worldScene, col);
+
+    // metropolis light transport over the bdpt strategies: 100000 bootstrap
+    // paths per depth, 1000 chains and 256 mutations per pixel
+    // auto integrator = std::make_shared<MLTIntegrator>(camera, 64,
+    //                                                   100000, 1000, 256,
+    //                                                   0.01f, 0.3f,
+    //                                                   imageBound);
+    // integrator->Render(*worldScene, col);
+
+    // volumetric path tracer with the camera in a thin fog; smoke goes in a
+    // shape without material whose MediumInterface has a GridDensityMedium
+    // inside
+    // auto fog = std::make_shared<HomogeneousMedium>(Spectrum(0.01f),
+    //                                                Spectrum(0.05f), 0.f);
+    // camera->medium = fog.get();
+    // auto integrator = std::make_shared<VolPathIntegrator>(64,
+    //                                                       camera,
+    //                                                       sampler,
+    //                                                       imageBound,
+    //                                                       1,
+    //                                                       lightStrategy);
+    // integrator->Render(*worldScene, col);
 
-    // omp_set_num_threads(omp_get_num_procs());
-    omp_set_num_threads(8);
-    #pragma omp parallel for collapse(2) schedule(dynamic)
-    for (size_t i = 0; i < (int)fullResolution.x; ++i) {
-        for (size_t j = 0; j < (int)fullResolution.y; ++j) {
+    // light tracer for caustics on diffuse surfaces: 64 light paths per
+    // pixel, splatted into per-thread images
+    // auto integrator = std::make_shared<LightTracerIntegrator>(camera, 64,
+    //                                                           64,
+    //                                                           imageBound);
+    // integrator->Render(*worldScene, col);
 
-            int offset = (i + fullResolution.x * j);
-            auto colObj = integrator->RenderPixel(*worldScene, i, j);
+    std::cout << "Start rendering!" << std::endl;
+    // integrator->Render(*worldScene, col);
 
-            col[offset] = colObj;
+    // auxiliary channels recorded from the same camera samples
+    int aovChannels = (denoise ? AOVAlbedo | AOVNormal | AOVDepth : 0) |
+                      (writeAOVs ? AOVAllChannels : 0);
+    Point2i resolution(fullResolution.x, fullResolution.y);
+    AOVBuffers aovs(resolution, aovChannels);
+
+    if (options.timeBudget > 0 || !options.checkpointFile.empty() ||
+        options.adaptiveThreshold > 0) {
+        // progressive rendering that can be stopped and resumed
+        integrator->RenderProgressive(*worldScene, options, col,
+                                      aovChannels ? &aovs : nullptr);
+    } else {
+        // rendering with openmp in tiles, reconstructed by the film's filter
+        // omp_set_num_threads(omp_get_num_procs());
+        omp_set_num_threads(8);
+
+        std::unique_ptr<Filter> filter(CreateMitchellFilter());
+        Film film(resolution, std::move(filter));
+        integrator->Render(*worldScene, film, aovChannels ? &aovs : nullptr);
+        film.GetImage(col);
+    }
+
+    if (writeAOVs) {
+        const std::pair<AOVChannel, const char *> aovFiles[] = {
+            {AOVAlbedo, "albedo.png"}, {AOVNormal, "normal.png"},
+            {AOVDepth, "depth.png"}, {AOVMaterialId, "materialid.png"},
+            {AOVPrimitiveId, "primitiveid.png"}};
+        std::vector<Spectrum> aovCol(col.size());
+        std::vector<char> aovBuf(3 * col.size());
+        for (const auto &aovFile : aovFiles) {
+            aovs.GetImage(aovFile.first, aovCol);
+            color2Img(aovCol, aovBuf);
+            WriteImage(aovFile.second, aovBuf.data(), fullResolution);
         }
     }
 
+    // guide the denoiser with first-hit albedo, normal and depth
+    if (denoise) DenoiseImage(aovs, DenoiserOptions(), col);
 
     auto buf = std::vector<char>();
     buf.resize(3 * col.size());
@@ -447,7 +634,34 @@ int main(int argc, char *argv[]) {
 
     // delete[] mpdata;
 
-    test();
+    // --time <seconds> --checkpoint <file> --checkpoint-interval <seconds>
+    // --adaptive <relative error> --denoise --aovs
+    // --lightsampler <uniform|power|spatial|spatial-prefill|bvh>
+    ProgressiveOptions options;
+    bool denoise = false, writeAOVs = false;
+    std::string lightStrategy = "spatial";
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--denoise")
+            denoise = true;
+        else if (arg == "--aovs")
+            writeAOVs = true;
+        else if (arg == "--time" && hasValue)
+            options.timeBudget = std::stof(argv[++i]);
+        else if (arg == "--checkpoint" && hasValue)
+            options.checkpointFile = argv[++i];
+        else if (arg == "--checkpoint-interval" && hasValue)
+            options.checkpointInterval = std::stof(argv[++i]);
+        else if (arg == "--adaptive" && hasValue)
+            options.adaptiveThreshold = std::stof(argv[++i]);
+        else if (arg == "--lightsampler" && hasValue)
+            lightStrategy = argv[++i];
+        else
+            std::cerr << "Unknown option \"" << arg << "\"" << std::endl;
+    }
+
+    test(options, denoise, writeAOVs, lightStrategy);
     std::cout << "Finish!" << std::endl;
 
     return 0;
@@ -1,6 +1,7 @@
 #include "materials/glass.h"
 #include "spectrum.h"
 #include "reflection.h"
+#include "memory.h"
 // #include "paramset.h"
 #include "texture.h"
 #include "interaction.h"
@@ -12,36 +13,29 @@ void PerfectGlassMaterial::ComputeScatteringFunctions(SurfaceInteraction *si,
                                                       TransportMode mode,
                                                       bool allowMultipleLobes) const {
     // si->bsdf = new BSDF(*si);
-    si->bsdf = std::make_shared<BSDF>(*si);
+    si->bsdf = AllocShared<BSDF>(*si);
     float eta = index->Evaluate(*si);
 
     Spectrum R = Kr->Evaluate(*si).Clamp();
     Spectrum T = Kt->Evaluate(*si).Clamp();
 
     if (!R.IsBlack() && !T.IsBlack())
-        si->bsdf->Add(std::make_shared<SpecularTransmission>(SpecularTransmission(T, 1.0f, eta, mode)));
+        si->bsdf->Add(AllocShared<SpecularTransmission>(SpecularTransmission(T, 1.0f, eta, mode)));
 }
 
-void GlassMaterial::ComputeScatteringFunctions(SurfaceInteraction *si, 
-                                               // MemoryArena &arena,
-                                               TransportMode mode,
-                                               bool allowMultipleLobes) const {
-    // Perform bump mapping with _bumpMap_, if present
-    if (bumpMap) Bump(bumpMap, si);
-    float eta = index->Evaluate(*si);
-    float urough = uRoughness->Evaluate(*si);
-    float vrough = vRoughness->Evaluate(*si);
-    Spectrum R = Kr->Evaluate(*si).Clamp();
-    Spectrum T = Kt->Evaluate(*si).Clamp();
-
+// Allocates the BSDF of a _GlassMaterial_ hit from its texture values
+static void InitializeGlassBSDF(SurfaceInteraction *si, float eta,
+                                float urough, float vrough, Spectrum R,
+                                Spectrum T, bool remapRoughness,
+                                TransportMode mode, bool allowMultipleLobes) {
     // Initialize _bsdf_ for smooth or rough dielectric
-    si->bsdf = std::make_shared<BSDF>(*si, eta);
+    si->bsdf = AllocShared<BSDF>(*si, eta);
 
     if (R.IsBlack() && T.IsBlack()) return;
 
     bool isSpecular = urough == 0 && vrough == 0;
     if (isSpecular && allowMultipleLobes) {
-        si->bsdf->Add(std::make_shared<FresnelSpecular>(R, T, 1.f, eta, mode));
+        si->bsdf->Add(AllocShared<FresnelSpecular>(R, T, 1.f, eta, mode));
     } else {
         if (remapRoughness) {
             urough = TrowbridgeReitzDistribution::RoughnessToAlpha(urough);
@@ -49,22 +43,57 @@ void GlassMaterial::ComputeScatteringFunctions(SurfaceInteraction *si,
         }
 
         std::shared_ptr<MicrofacetDistribution> distrib = 
-            isSpecular ? nullptr : std::make_shared<TrowbridgeReitzDistribution>(urough, vrough);
+            isSpecular ? nullptr : AllocShared<TrowbridgeReitzDistribution>(urough, vrough);
     
         if (!R.IsBlack()) {
-            auto fresnel = std::make_shared<FresnelDielectric>(1.f, eta);
-            if (isSpecular) si->bsdf->Add(std::make_shared<SpecularReflection>(R, fresnel));
-            else si->bsdf->Add(std::make_shared<MicrofacetReflection>(R, distrib, fresnel));
+            auto fresnel = AllocShared<FresnelDielectric>(1.f, eta);
+            if (isSpecular) si->bsdf->Add(AllocShared<SpecularReflection>(R, fresnel));
+            else si->bsdf->Add(AllocShared<MicrofacetReflection>(R, distrib, fresnel));
         }
 
         if (!T.IsBlack()) {
             if (isSpecular)
-                si->bsdf->Add(std::make_shared<SpecularTransmission>(T, 1.f, eta, mode));
+                si->bsdf->Add(AllocShared<SpecularTransmission>(T, 1.f, eta, mode));
             else
-                si->bsdf->Add(std::make_shared<MicrofacetTransmission>(T, distrib, 1.f, eta, mode));
+                si->bsdf->Add(AllocShared<MicrofacetTransmission>(T, distrib, 1.f, eta, mode));
         }
 
     }
 }
 
+void GlassMaterial::ComputeScatteringFunctions(SurfaceInteraction *si, 
+                                               // MemoryArena &arena,
+                                               TransportMode mode,
+                                               bool allowMultipleLobes) const {
+    // Perform bump mapping with _bumpMap_, if present
+    if (bumpMap) Bump(bumpMap, si);
+    float eta = index->Evaluate(*si);
+    float urough = uRoughness->Evaluate(*si);
+    float vrough = vRoughness->Evaluate(*si);
+    Spectrum R = Kr->Evaluate(*si).Clamp();
+    Spectrum T = Kt->Evaluate(*si).Clamp();
+    InitializeGlassBSDF(si, eta, urough, vrough, R, T, remapRoughness, mode,
+                        allowMultipleLobes);
+}
+
+void GlassMaterial::ComputeScatteringFunctionsBatch(
+    SurfaceInteraction *const *si, int n, TransportMode mode,
+    bool allowMultipleLobes) const {
+    if (bumpMap)
+        for (int i = 0; i < n; ++i) Bump(bumpMap, si[i]);
+
+    // Evaluate each texture over the batch, then allocate the BSDFs
+    std::vector<float> eta(n), urough(n), vrough(n);
+    std::vector<Spectrum> R(n), T(n);
+    index->EvaluateBatch(si, n, eta.data());
+    uRoughness->EvaluateBatch(si, n, urough.data());
+    vRoughness->EvaluateBatch(si, n, vrough.data());
+    Kr->EvaluateBatch(si, n, R.data());
+    Kt->EvaluateBatch(si, n, T.data());
+    for (int i = 0; i < n; ++i)
+        InitializeGlassBSDF(si[i], eta[i], urough[i], vrough[i], R[i].Clamp(),
+                            T[i].Clamp(), remapRoughness, mode,
+                            allowMultipleLobes);
+}
+
 }
\ No newline at end of file
@@ -45,6 +45,9 @@ class GlassMaterial : public Material {
                                         // MemoryArena &arena,
                                         TransportMode mode,
                                         bool allowMultipleLobes) const;
+        void ComputeScatteringFunctionsBatch(SurfaceInteraction *const *si,
+                                             int n, TransportMode mode,
+                                             bool allowMultipleLobes) const;
     
     private:
         // GlassMaterial Private Data
@@ -1,6 +1,7 @@
 #include "materials/matte.h"
 // #include "paramset.h"
 #include "reflection.h"
+#include "memory.h"
 #include "interaction.h"
 #include "texture.h"
 #include "interaction.h"
@@ -36,15 +37,38 @@ void MatteMaterial::ComputeScatteringFunctions(SurfaceInteraction *si,
 
     // Evaluate textures for _MatteMaterial_ material and allocate BRDF
     // si->bsdf = new BSDF(*si);
-    si->bsdf = std::make_shared<BSDF>(*si);
+    si->bsdf = AllocShared<BSDF>(*si);
     Spectrum r = Kd->Evaluate(*si).Clamp();
     float sig = Clamp(sigma->Evaluate(*si), 0, 90);
     if (!r.IsBlack()) {
         if (sig == 0)
-            si->bsdf->Add(std::make_shared<LambertianReflection>(r));
+            si->bsdf->Add(AllocShared<LambertianReflection>(r));
         else
             // si->bsdf->Add(ARENA_ALLOC(arena, OrenNayar)(r, sig));
-            si->bsdf->Add(std::make_shared<OrenNayar>(r, sig));
+            si->bsdf->Add(AllocShared<OrenNayar>(r, sig));
+    }
+}
+
+void MatteMaterial::ComputeScatteringFunctionsBatch(
+    SurfaceInteraction *const *si, int n, TransportMode mode,
+    bool allowMultipleLobes) const {
+    if (bumpMap)
+        for (int i = 0; i < n; ++i) Bump(bumpMap, si[i]);
+
+    // Evaluate each texture over the batch, then allocate the BRDFs
+    std::vector<Spectrum> r(n);
+    std::vector<float> sig(n);
+    Kd->EvaluateBatch(si, n, r.data());
+    sigma->EvaluateBatch(si, n, sig.data());
+    for (int i = 0; i < n; ++i) {
+        si[i]->bsdf = AllocShared<BSDF>(*si[i]);
+        r[i] = r[i].Clamp();
+        if (r[i].IsBlack()) continue;
+        float s = Clamp(sig[i], 0, 90);
+        if (s == 0)
+            si[i]->bsdf->Add(AllocShared<LambertianReflection>(r[i]));
+        else
+            si[i]->bsdf->Add(AllocShared<OrenNayar>(r[i], s));
     }
 }
 
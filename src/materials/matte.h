@@ -18,6 +18,9 @@ class MatteMaterial : public Material {
                                         // MemoryArena &arena,
                                         TransportMode mode,
                                         bool allowMultipleLobes) const;
+        void ComputeScatteringFunctionsBatch(SurfaceInteraction *const *si,
+                                             int n, TransportMode mode,
+                                             bool allowMultipleLobes) const;
 
     private:
         // MatteMaterial Private Data
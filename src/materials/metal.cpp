@@ -1,5 +1,6 @@
 #include "materials/metal.h"
 #include "reflection.h"
+#include "memory.h"
 // #include "paramset.h"
 #include "texture.h"
 #include "interaction.h"
@@ -28,7 +29,7 @@ void MetalMaterial::ComputeScatteringFunctions(SurfaceInteraction *si,
     // Perform bump mapping with _bumpMap_, if present
     if (bumpMap) Bump(bumpMap, si);
 
-    si->bsdf = std::make_shared<BSDF>(*si);
+    si->bsdf = AllocShared<BSDF>(*si);
 
     float uRough =
         uRoughness ? uRoughness->Evaluate(*si) : roughness->Evaluate(*si);
@@ -40,10 +41,36 @@ void MetalMaterial::ComputeScatteringFunctions(SurfaceInteraction *si,
         vRough = TrowbridgeReitzDistribution::RoughnessToAlpha(vRough);
     }
 
-    auto frMf = std::make_shared<FresnelConductor>(1., eta->Evaluate(*si), k->Evaluate(*si));
-    auto distrib = std::make_shared<TrowbridgeReitzDistribution>(uRough, vRough);
+    auto frMf = AllocShared<FresnelConductor>(1., eta->Evaluate(*si), k->Evaluate(*si));
+    auto distrib = AllocShared<TrowbridgeReitzDistribution>(uRough, vRough);
 
-    si->bsdf->Add(std::make_shared<MicrofacetReflection>(1., distrib, frMf));
+    si->bsdf->Add(AllocShared<MicrofacetReflection>(1., distrib, frMf));
+}
+
+void MetalMaterial::ComputeScatteringFunctionsBatch(
+    SurfaceInteraction *const *si, int n, TransportMode mode,
+    bool allowMultipleLobes) const {
+    if (bumpMap)
+        for (int i = 0; i < n; ++i) Bump(bumpMap, si[i]);
+
+    // Evaluate each texture over the batch, then allocate the BRDFs
+    std::vector<float> uRough(n), vRough(n);
+    std::vector<Spectrum> etas(n), ks(n);
+    (uRoughness ? uRoughness : roughness)->EvaluateBatch(si, n, uRough.data());
+    (vRoughness ? vRoughness : roughness)->EvaluateBatch(si, n, vRough.data());
+    eta->EvaluateBatch(si, n, etas.data());
+    k->EvaluateBatch(si, n, ks.data());
+    for (int i = 0; i < n; ++i) {
+        if (remapRoughness) {
+            uRough[i] = TrowbridgeReitzDistribution::RoughnessToAlpha(uRough[i]);
+            vRough[i] = TrowbridgeReitzDistribution::RoughnessToAlpha(vRough[i]);
+        }
+        si[i]->bsdf = AllocShared<BSDF>(*si[i]);
+        auto frMf = AllocShared<FresnelConductor>(1., etas[i], ks[i]);
+        auto distrib =
+            AllocShared<TrowbridgeReitzDistribution>(uRough[i], vRough[i]);
+        si[i]->bsdf->Add(AllocShared<MicrofacetReflection>(1., distrib, frMf));
+    }
 }
 
 constexpr int CopperSamples = 56;
@@ -20,6 +20,9 @@ class MetalMaterial : public Material {
                                         // MemoryArena &arena,
                                         TransportMode mode,
                                         bool allowMultipleLobes) const;
+        void ComputeScatteringFunctionsBatch(SurfaceInteraction *const *si,
+                                             int n, TransportMode mode,
+                                             bool allowMultipleLobes) const;
     
     private:
         // MetalMaterial Private Data
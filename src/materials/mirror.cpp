@@ -1,6 +1,7 @@
 #include "materials/mirror.h"
 #include "spectrum.h"
 #include "reflection.h"
+#include "memory.h"
 // #include "paramset.h"
 #include "texture.h"
 #include "interaction.h"
@@ -16,12 +17,12 @@ void MirrorMaterial::ComputeScatteringFunctions(SurfaceInteraction *si,
 
     // si->bsdf = ARENA_ALLOC(arena, BSDF)(*si);
     // si->bsdf = new BSDF(*si);
-    si->bsdf = std::make_shared<BSDF>(*si);
+    si->bsdf = AllocShared<BSDF>(*si);
     Spectrum R = Kr->Evaluate(*si).Clamp();
     if (!R.IsBlack())
         // si->bsdf->Add(ARENA_ALLOC(arena, SpecularReflection)(
         //     R, ARENA_ALLOC(arena, FresnelNoOp)()));
-        si->bsdf->Add(std::make_shared<SpecularReflection>(SpecularReflection(R, std::make_shared<FresnelNoOp>(FresnelNoOp()))));
+        si->bsdf->Add(AllocShared<SpecularReflection>(SpecularReflection(R, AllocShared<FresnelNoOp>(FresnelNoOp()))));
 }
 
 }
\ No newline at end of file
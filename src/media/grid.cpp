@@ -0,0 +1,203 @@
+#include "media/grid.h"
+#include "interaction.h"
+#include "memory.h"
+#include "rng.h"
+#include "sampler.h"
+
+namespace PBRender {
+
+// Delta and ratio tracking take an unbounded number of random steps, so they
+// draw them from an RNG seeded with one sampler dimension and the ray
+// origin rather than from the sampler itself
+static RNG TrackingRNG(const Ray &ray, Sampler &sampler) {
+    uint64_t seed = (uint64_t)FloatToBits(sampler.Get1D()) << 32;
+    seed ^= FloatToBits(ray.o.x) ^ ((uint64_t)FloatToBits(ray.o.y) << 11) ^
+            ((uint64_t)FloatToBits(ray.o.z) << 22);
+    return RNG(seed);
+}
+
+// GridDensityMedium Method Definitions
+GridDensityMedium::GridDensityMedium(const Spectrum &sigma_a,
+                                     const Spectrum &sigma_s, float g, int nx,
+                                     int ny, int nz,
+                                     const Transform &mediumToWorld,
+                                     const float *d, int majorantResolution)
+    : sigma_a(sigma_a),
+      sigma_s(sigma_s),
+      g(g),
+      nx(nx),
+      ny(ny),
+      nz(nz),
+      WorldToMedium(Inverse(mediumToWorld)),
+      density(new float[nx * ny * nz]) {
+    memcpy((float *)density.get(), d, sizeof(float) * nx * ny * nz);
+    sigma_t = (sigma_a + sigma_s)[0];
+
+    // Compute the maximum density in each majorant cell. The trilinear
+    // interpolation within a cell only uses the lattice samples from the one
+    // before its lower corner to the one after its upper corner, and it
+    // never exceeds the largest of them.
+    int n[3] = {nx, ny, nz};
+    for (int i = 0; i < 3; ++i)
+        majorantRes[i] = Clamp(majorantResolution, 1, n[i]);
+    majorants.assign(majorantRes[0] * majorantRes[1] * majorantRes[2], 0.f);
+    #pragma omp parallel for
+    for (int index = 0; index < (int)majorants.size(); ++index) {
+        int cell[3] = {index % majorantRes[0],
+                       (index / majorantRes[0]) % majorantRes[1],
+                       index / (majorantRes[0] * majorantRes[1])};
+        int p0[3], p1[3];
+        for (int i = 0; i < 3; ++i) {
+            float c0 = (float)cell[i] / majorantRes[i];
+            float c1 = (float)(cell[i] + 1) / majorantRes[i];
+            p0[i] = Clamp((int)std::floor(c0 * n[i] - .5f), 0, n[i] - 1);
+            p1[i] = Clamp((int)std::floor(c1 * n[i] - .5f) + 1, 0, n[i] - 1);
+        }
+        float maxDensity = 0;
+        for (int z = p0[2]; z <= p1[2]; ++z)
+            for (int y = p0[1]; y <= p1[1]; ++y)
+                for (int x = p0[0]; x <= p1[0]; ++x)
+                    maxDensity = std::max(maxDensity, D(Point3i(x, y, z)));
+        majorants[index] = maxDensity;
+    }
+}
+
+float GridDensityMedium::Density(const Point3f &p) const {
+    // Compute voxel coordinates and offsets for _p_
+    Point3f pSamples(p.x * nx - .5f, p.y * ny - .5f, p.z * nz - .5f);
+    Point3i pi = (Point3i)Floor(pSamples);
+    Vector3f d = pSamples - (Point3f)pi;
+
+    // Trilinearly interpolate density values to compute local density
+    float d00 = Lerp(d.x, D(pi), D(pi + Vector3i(1, 0, 0)));
+    float d10 = Lerp(d.x, D(pi + Vector3i(0, 1, 0)), D(pi + Vector3i(1, 1, 0)));
+    float d01 = Lerp(d.x, D(pi + Vector3i(0, 0, 1)), D(pi + Vector3i(1, 0, 1)));
+    float d11 = Lerp(d.x, D(pi + Vector3i(0, 1, 1)), D(pi + Vector3i(1, 1, 1)));
+    float d0 = Lerp(d.y, d00, d10);
+    float d1 = Lerp(d.y, d01, d11);
+    return Lerp(d.z, d0, d1);
+}
+
+template <typename Func>
+void GridDensityMedium::TraverseMajorants(const Ray &ray, float tMin,
+                                          float tMax, Func segment) const {
+    // Set up the 3D DDA for the ray through the majorant grid
+    Point3f pStart = ray(tMin);
+    float nextCrossingT[3], deltaT[3];
+    int step[3], out[3], cell[3];
+    for (int axis = 0; axis < 3; ++axis) {
+        cell[axis] = Clamp((int)(pStart[axis] * majorantRes[axis]), 0,
+                           majorantRes[axis] - 1);
+        if (ray.d[axis] == 0) {
+            nextCrossingT[axis] = Infinity;
+            deltaT[axis] = Infinity;
+            step[axis] = 0;
+            out[axis] = -1;
+            continue;
+        }
+        deltaT[axis] = 1 / (std::abs(ray.d[axis]) * majorantRes[axis]);
+        if (ray.d[axis] > 0) {
+            float next = (float)(cell[axis] + 1) / majorantRes[axis];
+            nextCrossingT[axis] = tMin + (next - pStart[axis]) / ray.d[axis];
+            step[axis] = 1;
+            out[axis] = majorantRes[axis];
+        } else {
+            float next = (float)cell[axis] / majorantRes[axis];
+            nextCrossingT[axis] = tMin + (next - pStart[axis]) / ray.d[axis];
+            step[axis] = -1;
+            out[axis] = -1;
+        }
+    }
+
+    // Walk the cells until the ray leaves the grid or reaches _tMax_
+    float t0 = tMin;
+    while (true) {
+        int axis = 0;
+        if (nextCrossingT[1] < nextCrossingT[axis]) axis = 1;
+        if (nextCrossingT[2] < nextCrossingT[axis]) axis = 2;
+        float t1 = std::min(tMax, nextCrossingT[axis]);
+        float maxDensity =
+            majorants[(cell[2] * majorantRes[1] + cell[1]) * majorantRes[0] +
+                      cell[0]];
+        if (t1 > t0 && !segment(t0, t1, maxDensity)) return;
+        if (t1 >= tMax) return;
+        t0 = t1;
+        cell[axis] += step[axis];
+        if (cell[axis] == out[axis]) return;
+        nextCrossingT[axis] += deltaT[axis];
+    }
+}
+
+Spectrum GridDensityMedium::Sample(const Ray &rWorld, Sampler &sampler,
+                                   MediumInteraction *mi) const {
+    Ray rNorm(rWorld.o, Normalize(rWorld.d), rWorld.tMax * rWorld.d.Length());
+    Ray ray = WorldToMedium(rNorm);
+    RNG rng = TrackingRNG(rWorld, sampler);
+
+    // Compute $[\tmin, \tmax]$ interval of _ray_'s overlap with medium bounds
+    const Bounds3f b(Point3f(0, 0, 0), Point3f(1, 1, 1));
+    float tMin, tMax;
+    if (!b.IntersectP(ray, &tMin, &tMax)) return Spectrum(1.f);
+
+    // Run delta tracking in each majorant cell; the exponential steps are
+    // memoryless, so each cell starts afresh from its entry point
+    bool scattered = false;
+    TraverseMajorants(ray, tMin, tMax, [&](float t0, float t1,
+                                           float maxDensity) {
+        if (maxDensity == 0) return true;
+        float sigmaMaj = maxDensity * sigma_t;
+        float t = t0;
+        while (true) {
+            t -= std::log(1 - rng.UniformFloat()) / sigmaMaj;
+            if (t >= t1) return true;
+            if (Density(ray(t)) > rng.UniformFloat() * maxDensity) {
+                // Populate _mi_ with medium interaction information
+                *mi = MediumInteraction(rNorm(t), -rWorld.d, rWorld.time, this,
+                                        AllocShared<HenyeyGreenstein>(g));
+                scattered = true;
+                return false;
+            }
+        }
+    });
+    return scattered ? sigma_s / sigma_t : Spectrum(1.f);
+}
+
+Spectrum GridDensityMedium::Tr(const Ray &rWorld, Sampler &sampler) const {
+    Ray ray = WorldToMedium(
+        Ray(rWorld.o, Normalize(rWorld.d), rWorld.tMax * rWorld.d.Length()));
+    RNG rng = TrackingRNG(rWorld, sampler);
+
+    // Compute $[\tmin, \tmax]$ interval of _ray_'s overlap with medium bounds
+    const Bounds3f b(Point3f(0, 0, 0), Point3f(1, 1, 1));
+    float tMin, tMax;
+    if (!b.IntersectP(ray, &tMin, &tMax)) return Spectrum(1.f);
+
+    // Perform ratio tracking in each majorant cell to estimate the
+    // transmittance
+    float Tr = 1;
+    TraverseMajorants(ray, tMin, tMax, [&](float t0, float t1,
+                                           float maxDensity) {
+        if (maxDensity == 0) return true;
+        float sigmaMaj = maxDensity * sigma_t;
+        float t = t0;
+        while (true) {
+            t -= std::log(1 - rng.UniformFloat()) / sigmaMaj;
+            if (t >= t1) return true;
+            Tr *= 1 - std::max(0.f, Density(ray(t)) / maxDensity);
+
+            // Terminate low transmittance estimates with Russian roulette
+            const float rrThreshold = .1;
+            if (Tr < rrThreshold) {
+                float q = std::max(.05f, 1 - Tr);
+                if (rng.UniformFloat() < q) {
+                    Tr = 0;
+                    return false;
+                }
+                Tr /= 1 - q;
+            }
+        }
+    });
+    return Spectrum(Tr);
+}
+
+}
\ No newline at end of file
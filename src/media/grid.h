@@ -0,0 +1,62 @@
+#pragma once
+
+#include "PBRender.h"
+#include "medium.h"
+#include "transform.h"
+
+#include <vector>
+
+namespace PBRender {
+
+// GridDensityMedium Declarations
+// A heterogeneous medium whose density is trilinearly interpolated from an
+// _nx_ x _ny_ x _nz_ lattice of samples over the unit cube in medium space,
+// scaling _sigma_a_ and _sigma_s_. As with delta tracking in general, the
+// extinction is assumed to be the same in every channel; the first channel
+// of _sigma_a_ + _sigma_s_ is used.
+//
+// Distances are sampled with delta tracking and transmittance is estimated
+// with ratio tracking. Both walk a coarse grid of the maximum density in
+// each of its cells with a 3D DDA and take their tentative steps against
+// the cell's maximum rather than the global one, so the empty parts of
+// sparse smoke or fog are stepped over without any density lookups.
+class GridDensityMedium : public Medium {
+    public:
+        // GridDensityMedium Public Methods
+        GridDensityMedium(const Spectrum &sigma_a, const Spectrum &sigma_s,
+                          float g, int nx, int ny, int nz,
+                          const Transform &mediumToWorld, const float *d,
+                          int majorantResolution = 16);
+
+        float Density(const Point3f &p) const;
+        Spectrum Tr(const Ray &ray, Sampler &sampler) const;
+        Spectrum Sample(const Ray &ray, Sampler &sampler,
+                        MediumInteraction *mi) const;
+
+    private:
+        // GridDensityMedium Private Methods
+        float D(const Point3i &p) const {
+            if (p.x < 0 || p.x >= nx || p.y < 0 || p.y >= ny || p.z < 0 ||
+                p.z >= nz)
+                return 0;
+            return density[(p.z * ny + p.y) * nx + p.x];
+        }
+        // Calls _segment(t0, t1, maxDensity)_ for the majorant cells that
+        // the medium space _ray_ crosses from _tMin_ to _tMax_, in order,
+        // until it returns false
+        template <typename Func>
+        void TraverseMajorants(const Ray &ray, float tMin, float tMax,
+                               Func segment) const;
+
+        // GridDensityMedium Private Data
+        const Spectrum sigma_a, sigma_s;
+        const float g;
+        const int nx, ny, nz;
+        const Transform WorldToMedium;
+        std::unique_ptr<float[]> density;
+        float sigma_t;
+        int majorantRes[3];
+        std::vector<float> majorants;
+};
+
+}
\ No newline at end of file
@@ -3,6 +3,8 @@
 #include "textures/constant.h"
 #include "sampling.h"
 
+#include <array>
+
 namespace PBRender {
 
 static long long nTris   = 0;
@@ -10,6 +12,11 @@ static long long nMeshes = 0 ;
 static long long nHits   = 0 ;
 static long long nTests  = 0 ;
 
+// Solid angle sampling is numerically unreliable outside this range, so
+// triangles that subtend less or more fall back to area sampling
+static const float MinSphericalSampleArea = 3e-4f;
+static const float MaxSphericalSampleArea = 6.22f;
+
 TriangleMesh::TriangleMesh(
     const Transform &ObjectToWorld, int nTriangles, const int *vertexIndices,
     int nVertices, const Point3f *P, const Vector3f *S, const Normal3f *N,
@@ -464,6 +471,21 @@ float Triangle::Area() const {
     return 0.5 * Cross(p1 - p0, p2 - p0).Length();
 }
 
+DirectionCone Triangle::NormalBounds() const {
+    // Get triangle vertices in _p0_, _p1_, and _p2_
+    const Point3f &p0 = mesh->p[v[0]];
+    const Point3f &p1 = mesh->p[v[1]];
+    const Point3f &p2 = mesh->p[v[2]];
+    // Orient the geometric normal as _Triangle::Sample()_ does
+    Normal3f n = Normalize(Normal3f(Cross(p1 - p0, p2 - p0)));
+    if (mesh->n) {
+        Normal3f ns(mesh->n[v[0]] + mesh->n[v[1]] + mesh->n[v[2]]);
+        n = Faceforward(n, ns);
+    } else if (reverseOrientation ^ transformSwapsHandedness)
+        n *= -1;
+    return DirectionCone(Vector3f(n), 1);
+}
+
 Interaction Triangle::Sample(const Point2f &u, float *pdf) const {
     Point2f b = UniformSampleTriangle(u);
     // Get triangle vertices in _p0_, _p1_, and _p2_
@@ -487,11 +509,90 @@ Interaction Triangle::Sample(const Point2f &u, float *pdf) const {
     // Compute error bounds for sampled point on triangle
     Point3f pAbsSum =
         Abs(b[0] * p0) + Abs(b[1] * p1) + Abs((1 - b[0] - b[1]) * p2);
-    // it.pError = gamma(6) * Vector3f(pAbsSum.x, pAbsSum.y, pAbsSum.z);
+    it.pError = gamma(6) * Vector3f(pAbsSum.x, pAbsSum.y, pAbsSum.z);
     *pdf = 1 / Area();
     return it;
 }
 
+// Corner weights for warping spherical triangle samples by the cosine at
+// _ref_; _u_ = (0, 0) and (1, 0) map to the second vertex and (0, 1), (1, 1)
+// to the first and third.
+static void CosineWarpWeights(const Interaction &ref,
+                              const std::array<Point3f, 3> &p, float w[4]) {
+    Vector3f wi[3] = {Normalize(p[0] - ref.p), Normalize(p[1] - ref.p),
+                      Normalize(p[2] - ref.p)};
+    w[0] = w[1] = std::max(0.01f, AbsDot(ref.n, wi[1]));
+    w[2] = std::max(0.01f, AbsDot(ref.n, wi[0]));
+    w[3] = std::max(0.01f, AbsDot(ref.n, wi[2]));
+}
+
+Interaction Triangle::Sample(const Interaction &ref, const Point2f &u,
+                             float *pdf) const {
+    float solidAngle = SolidAngle(ref.p);
+    if (solidAngle < MinSphericalSampleArea ||
+        solidAngle > MaxSphericalSampleArea)
+        return Shape::Sample(ref, u, pdf);
+
+    // Get triangle vertices in _p0_, _p1_, and _p2_
+    const Point3f &p0 = mesh->p[v[0]];
+    const Point3f &p1 = mesh->p[v[1]];
+    const Point3f &p2 = mesh->p[v[2]];
+    std::array<Point3f, 3> pTri = {{p0, p1, p2}};
+
+    // Warp _u_ toward the cosine factor at surface reference points
+    Point2f uTri = u;
+    float warpPdf = 1;
+    if (ref.n != Normal3f(0, 0, 0)) {
+        float w[4];
+        CosineWarpWeights(ref, pTri, w);
+        uTri = SampleBilinear(u, w);
+        warpPdf = BilinearPdf(uTri, w);
+    }
+
+    float triPdf;
+    std::array<float, 3> b = SampleSphericalTriangle(pTri, ref.p, uTri, &triPdf);
+    if (triPdf == 0) {
+        *pdf = 0;
+        return Interaction();
+    }
+    *pdf = warpPdf * triPdf;
+
+    Interaction it;
+    it.p = b[0] * p0 + b[1] * p1 + b[2] * p2;
+    // Orient the geometric normal as _Triangle::Sample()_ does
+    it.n = Normalize(Normal3f(Cross(p1 - p0, p2 - p0)));
+    if (mesh->n) {
+        Normal3f ns(b[0] * mesh->n[v[0]] + b[1] * mesh->n[v[1]] +
+                    b[2] * mesh->n[v[2]]);
+        it.n = Faceforward(it.n, ns);
+    } else if (reverseOrientation ^ transformSwapsHandedness)
+        it.n *= -1;
+
+    // Compute error bounds for sampled point on triangle
+    Point3f pAbsSum = Abs(b[0] * p0) + Abs(b[1] * p1) + Abs(b[2] * p2);
+    it.pError = gamma(6) * Vector3f(pAbsSum.x, pAbsSum.y, pAbsSum.z);
+    return it;
+}
+
+float Triangle::Pdf(const Interaction &ref, const Vector3f &wi,
+                    const Interaction &pShape) const {
+    float solidAngle = SolidAngle(ref.p);
+    if (solidAngle < MinSphericalSampleArea ||
+        solidAngle > MaxSphericalSampleArea)
+        return Shape::Pdf(ref, wi, pShape);
+
+    float pdf = 1 / solidAngle;
+    if (ref.n != Normal3f(0, 0, 0)) {
+        std::array<Point3f, 3> pTri = {
+            {mesh->p[v[0]], mesh->p[v[1]], mesh->p[v[2]]}};
+        float w[4];
+        CosineWarpWeights(ref, pTri, w);
+        Point2f u = InvertSphericalTriangleSample(pTri, ref.p, wi);
+        pdf *= BilinearPdf(u, w);
+    }
+    return pdf;
+}
+
 float Triangle::SolidAngle(const Point3f &p, int nSamples) const {
     // Project the vertices into the unit sphere around p.
     std::array<Vector3f, 3> pSphere = {
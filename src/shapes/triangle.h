@@ -49,12 +49,23 @@ class Triangle : public Shape {
         float Area() const;
 
         using Shape::Sample;  // Bring in the other Sample() overload.
+        using Shape::Pdf;
         Interaction Sample(const Point2f &u, float *pdf) const;
 
+        // Samples the solid angle the triangle subtends from _ref_, warped
+        // toward the cosine at _ref_ when it lies on a surface; triangles too
+        // small or too large in solid angle fall back to area sampling.
+        Interaction Sample(const Interaction &ref, const Point2f &u,
+                           float *pdf) const;
+        float Pdf(const Interaction &ref, const Vector3f &wi,
+                  const Interaction &pShape) const;
+
         // Returns the solid angle subtended by the triangle w.r.t. the given
         // reference point p.
         float SolidAngle(const Point3f &p, int nSamples = 0) const;
 
+        DirectionCone NormalBounds() const;
+
     private:
         // Triangle Private Methods
         void GetUVs(Point2f uv[3]) const {
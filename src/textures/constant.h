@@ -3,6 +3,8 @@
 #include "PBRender.h"
 #include "texture.h"
 
+#include <algorithm>
+
 namespace PBRender {
 
 template <typename T>
@@ -11,6 +13,10 @@ class ConstantTexture : public Texture<T> {
         // ConstantTexture Public Methods
         ConstantTexture(const T &value) : value(value) {}
         T Evaluate(const SurfaceInteraction &) const { return value; }
+        void EvaluateBatch(SurfaceInteraction *const *, int n,
+                           T *values) const {
+            std::fill(values, values + n, value);
+        }
 
     private:
         T value;
@@ -57,6 +57,17 @@ public:
         return ret;
     }
 
+    void EvaluateBatch(SurfaceInteraction *const *si, int n,
+                       Treturn *values) const {
+        // Run all texture-space mappings before touching the MIP pyramid
+        std::vector<Point2f> st(n);
+        std::vector<Vector2f> dstdx(n), dstdy(n);
+        for (int i = 0; i < n; ++i)
+            st[i] = mapping->Map(*si[i], &dstdx[i], &dstdy[i]);
+        for (int i = 0; i < n; ++i)
+            convertOut(mipmap->Lookup(st[i], dstdx[i], dstdy[i]), &values[i]);
+    }
+
 private:
     // ImageTexture Private Methods
     static MIPMap<Tmemory> *GetTexture(const std::string &filename,